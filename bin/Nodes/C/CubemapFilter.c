@@ -13,6 +13,7 @@ typedef struct CubemapFilter_t
 typedef struct JobData_t
 {
 	int targetIndex;
+	int jobToken;
 	Image image;
 	CubemapFilterData param;
 	void *context;
@@ -29,23 +30,31 @@ int UploadImageJob(JobData *data)
 
 int FilterJob(JobData *data)
 {
-	if (CubemapFilter(&data->image, 32<<data->param.faceSize, data->param.lightingModel, data->param.excludeBase, data->param.glossScale, data->param.glossBias) == EVAL_OK)
+	int res = CubemapFilter(data->context, data->targetIndex, data->jobToken, &data->image, 32<<data->param.faceSize, data->param.lightingModel, data->param.excludeBase, data->param.glossScale, data->param.glossBias);
+	if (res == EVAL_OK)
 	{	
-		JobData dataUp = *data;
-		JobMain(data->context, UploadImageJob, &dataUp, sizeof(JobData));
+		// JobMain copies the job data: image bits ownership is transferred to the upload job
+		JobMain(data->context, UploadImageJob, data, sizeof(JobData));
+		return EVAL_OK;
 	}
+	FreeImage(&data->image);
+	// a cancelled job leaves the processing state to the job that replaced it
+	if (res != EVAL_DIRTY)
+		SetProcessing(data->context, data->targetIndex, 0);
 	return EVAL_OK;
 }		
 		
 int main(CubemapFilterData *param, Evaluation *evaluation, void *context)
 {
 	Image image;
+	image.bits = 0;
 	
 	if (GetEvaluationImage(context, evaluation->inputIndices[0], &image) == EVAL_OK)
 	{
 		JobData data;
 		data.image = image;
 		data.targetIndex = evaluation->targetIndex;
+		data.jobToken = GetJobToken(context, evaluation->targetIndex);
 		data.param = *param;
 		data.context = context;
 		SetProcessing(context, evaluation->targetIndex, 1);
@@ -0,0 +1,22 @@
+#include "Imogen.h"
+
+typedef struct GGXPrefilter_t
+{
+	int faceSize;
+	int sampleCount;
+} GGXPrefilter;
+
+
+int main(GGXPrefilter *param, Evaluation *evaluation, void *context)
+{
+	int size = 32 << param->faceSize;
+	// one roughness per mip, down to 8x8 faces
+	int mipmapCount = 1;
+	while ((size >> (mipmapCount + 3)) > 0)
+		mipmapCount++;
+	SetEvaluationCubeSize(context, evaluation->targetIndex, size, mipmapCount);
+	// sampled through a mip chained copy, the input target isn't modified
+	if (evaluation->inputIndices[0] != -1)
+		GenerateInputMipmaps(context, evaluation->targetIndex);
+	return EVAL_OK;
+}
@@ -41,8 +41,8 @@ int ReadJob(JobData *data)
 {
 	if (ReadImage(data->context, data->filename, &data->image) == EVAL_OK)
 	{
-		JobData dataUp = *data;
-		JobMain(data->context, UploadImageJob, &dataUp, sizeof(JobData));
+		// JobMain copies the job data: image bits ownership is transferred to the upload job
+		JobMain(data->context, UploadImageJob, data, sizeof(JobData));
 	}
 	else
 		SetProcessing(data->context, data->targetIndex, 0);
@@ -44,6 +44,12 @@ int main(ImageWrite *param, Evaluation *evaluation, void *context)
 	if (!evaluation->forcedDirty)
 		return EVAL_OK;
 	
+	if (param->format == 7)
+	{
+		// video frames are appended to the stream
+		return EncodeEvaluation(context, evaluation->inputIndices[0], param->width, param->height, param->filename);
+	}
+
 	image.bits = 0;
 	if (Evaluate(context, evaluation->inputIndices[0], param->width, param->height, &image) == EVAL_OK)
 	{
@@ -95,6 +95,8 @@ int SetEvaluationImageCube(void* context, int target, Image *image, int cubeFace
 // call FreeImage when done
 // set the bits pointer with an allocated memory
 int AllocateImage(Image *image);
+// images returned by the API own their bits. Copying an Image struct moves that ownership:
+// only one of the copies must be freed.
 int FreeImage(Image *image);
 int LoadSVG(const char *filename, Image *image, float dpi);
 
@@ -105,13 +107,29 @@ int SetThumbnailImage(void *context, Image *image);
 // force evaluation of a target with a specified size
 // no guarantee that the resulting Image will have that size.
 int Evaluate(void *context, int target, int width, int height, Image *image);
+// evaluate a target and append it to a video file. Color conversion is done on the GPU.
+int EncodeEvaluation(void *context, int target, int width, int height, const char *filename);
 
 void SetBlendingMode(void *context, int target, int blendSrc, int blendDst);
 void EnableDepthBuffer(void *context, int target, int enable);
 int GetEvaluationSize(void *context, int target, int *imageWidth, int *imageHeight);
 int SetEvaluationSize(void *context, int target, int imageWidth, int imageHeight);
-int SetEvaluationCubeSize(void *context, int target, int faceWidth);
-int CubemapFilter(Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias);
+// mipmapCount levels are allocated and each of them is rendered by GLSL nodes
+int SetEvaluationCubeSize(void *context, int target, int faceWidth, int mipmapCount);
+// builds the full mip chain of a target, for filtering in a following node
+int GenerateMipmaps(void *context, int target);
+// copies the first input of a target in a mip chained texture sampled by the target in place of
+// that input. The input itself isn't modified.
+int GenerateInputMipmaps(void *context, int target);
+// evaluating a target again cancels the jobs started by its previous evaluation.
+// get the token when queuing the job.
+int GetJobToken(void *context, int target);
+// filters on the task scheduler and updates target progress. returns EVAL_DIRTY when cancelled
+int CubemapFilter(void *context, int target, int jobToken, Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias);
+// projects a cubemap or an equirect image to L2 spherical harmonics. coefficients holds 9 RGB triplets
+int ProjectSH(Image *image, float *coefficients);
+// reconstructs the irradiance cubemap (divided by PI) of the coefficients
+int SHIrradiance(const float *coefficients, int faceSize, Image *image);
 
 int Job(void *context, int(*jobFunction)(void*), void *ptr, unsigned int size);
 int JobMain(void *context, int(*jobMainFunction)(void*), void *ptr, unsigned int size);
@@ -124,7 +142,14 @@ void SetProcessing(void *context, int target, int processing);
 // compute shader memory allocation
 int AllocateComputeBuffer(void *context, int target, int elementCount, int elementSize);
 
-int LoadScene(const char *filename, void **scene);
+// blocking LoadSceneAsync with the SBVH builder. Returns the load state, EVAL_OK when loaded
+int LoadScene(const char *filename, void **sceneHandle);
+// scenes are passed as handles. A scene stays loaded while a stage holds its handle with SetEvaluationScene,
+// handles of scenes no stage holds may be released by the scene cache and GetLoadedScene then returns EVAL_ERR.
+// loads the scene and builds its BVH in a job. bvhBuilder : 0 SBVH, 1 binned SAH (faster to build)
+// the handle is ready when GetLoadedScene returns EVAL_OK. It returns EVAL_DIRTY while loading.
+int LoadSceneAsync(void *context, const char *filename, int bvhBuilder, void **sceneHandle);
+int GetLoadedScene(void *sceneHandle, void **scene);
 int SetEvaluationScene(void *context, int target, void *scene);
 int GetEvaluationScene(void *context, int target, void **scene);
 int GetEvaluationRenderer(void *context, int target, void **renderer);
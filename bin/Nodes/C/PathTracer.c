@@ -7,21 +7,32 @@ typedef struct PathTracer_t
 
 int main(PathTracer *param, Evaluation *evaluation, void *context)
 {
+	void *sceneHandle;
 	void *scene;
-	void *renderer;
+	int loadState;
 	if (evaluation->inputIndices[0] == -1)
 		return EVAL_OK;
-	if (GetEvaluationScene(context, evaluation->inputIndices[0], &scene) != EVAL_OK)
+	if (GetEvaluationScene(context, evaluation->inputIndices[0], &sceneHandle) != EVAL_OK)
 		return EVAL_ERR;
-	if (!scene)
+	if (!sceneHandle)
 		return EVAL_OK;
-	if (GetEvaluationRenderer(context, evaluation->targetIndex, &renderer) != EVAL_OK)
-		return EVAL_ERR;
-	if (!renderer)
+	loadState = GetLoadedScene(sceneHandle, &scene);
+	if (loadState == EVAL_DIRTY)
 	{
-		if (InitRenderer(context, evaluation->targetIndex, 0, scene) != EVAL_OK)
-			return EVAL_ERR;
+		// progress placeholder until the scene is loaded
+		SetProcessing(context, evaluation->targetIndex, 1);
+		return EVAL_DIRTY;
 	}
+	if (loadState != EVAL_OK)
+	{
+		SetProcessing(context, evaluation->targetIndex, 0);
+		return EVAL_ERR;
+	}
+	// keeps the scene loaded while this stage renders it
+	SetEvaluationScene(context, evaluation->targetIndex, sceneHandle);
+	// creates the renderer, or recreates it when the mode changed
+	if (InitRenderer(context, evaluation->targetIndex, param->mode, scene) != EVAL_OK)
+		return EVAL_ERR;
 	SetEvaluationSize(context, evaluation->targetIndex, 1024, 1024);
 	SetProcessing(context, evaluation->targetIndex, 2);
 	
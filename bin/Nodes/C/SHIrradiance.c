@@ -0,0 +1,41 @@
+#include "Imogen.h"
+
+typedef struct SHIrradiance_t
+{
+	int faceSize;
+	float coefficients[9][4]; // L00 to L22, RGB. Written back by the node
+} SHIrradianceParam;
+
+int main(SHIrradianceParam *param, Evaluation *evaluation, void *context)
+{
+	Image image;
+	Image irradiance;
+	float coefficients[27];
+	int res = EVAL_ERR;
+	int i;
+	image.bits = 0;
+	irradiance.bits = 0;
+
+	if (GetEvaluationImage(context, evaluation->inputIndices[0], &image) != EVAL_OK)
+		return EVAL_OK;
+
+	// 9 coefficients are enough for diffuse lighting, no need for a radiance filter
+	if (ProjectSH(&image, coefficients) == EVAL_OK)
+	{
+		// the parameter block is the coefficient output : visible in the node, saved with the graph
+		for (i = 0; i < 9; i++)
+		{
+			param->coefficients[i][0] = coefficients[i * 3 + 0];
+			param->coefficients[i][1] = coefficients[i * 3 + 1];
+			param->coefficients[i][2] = coefficients[i * 3 + 2];
+			param->coefficients[i][3] = 0.f;
+		}
+		if (SHIrradiance(coefficients, 8 << param->faceSize, &irradiance) == EVAL_OK)
+		{
+			res = SetEvaluationImage(context, evaluation->targetIndex, &irradiance);
+			FreeImage(&irradiance);
+		}
+	}
+	FreeImage(&image);
+	return res;
+}
@@ -18,6 +18,7 @@ int main(SVG *param, Evaluation *evaluation, void *context)
 		if (LoadSVG(param->filename, &image, param->dpi) == EVAL_OK)
 		{
 			SetEvaluationImage(context, evaluation->targetIndex, &image);
+			FreeImage(&image);
 		}
 	}
 	return EVAL_OK;
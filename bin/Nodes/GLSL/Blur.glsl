@@ -2,10 +2,41 @@ layout (std140) uniform BlurBlock
 {
 	float angle;
 	float strength;
+	int pyramidLevels;
 } BlurParam;
 
+// dual filter (Kawase) blur, evaluated as a downsample/upsample pyramid of pyramidLevels levels.
+// Cost is constant per level and the radius doubles with each level : sigma is about 1.3, 2.9, 5.9, 12, 24, 48 pixels.
+vec4 DualFilterBlur()
+{
+	vec2 halfPixel = 0.5 / EvaluationParam.viewport.xy;
+	if (EvaluationParam.passNumber < EvaluationParam.mipmapCount)
+	{
+		vec4 sum = textureLod(Sampler0, vUV, 0.0) * 4.0;
+		sum += textureLod(Sampler0, vUV - halfPixel, 0.0);
+		sum += textureLod(Sampler0, vUV + halfPixel, 0.0);
+		sum += textureLod(Sampler0, vUV + vec2(halfPixel.x, -halfPixel.y), 0.0);
+		sum += textureLod(Sampler0, vUV - vec2(halfPixel.x, -halfPixel.y), 0.0);
+		return sum / 8.0;
+	}
+	vec4 sum = textureLod(Sampler0, vUV + vec2(-halfPixel.x * 2.0, 0.0), 0.0);
+	sum += textureLod(Sampler0, vUV + vec2(-halfPixel.x, halfPixel.y), 0.0) * 2.0;
+	sum += textureLod(Sampler0, vUV + vec2(0.0, halfPixel.y * 2.0), 0.0);
+	sum += textureLod(Sampler0, vUV + vec2(halfPixel.x, halfPixel.y), 0.0) * 2.0;
+	sum += textureLod(Sampler0, vUV + vec2(halfPixel.x * 2.0, 0.0), 0.0);
+	sum += textureLod(Sampler0, vUV + vec2(halfPixel.x, -halfPixel.y), 0.0) * 2.0;
+	sum += textureLod(Sampler0, vUV + vec2(0.0, -halfPixel.y * 2.0), 0.0);
+	sum += textureLod(Sampler0, vUV + vec2(-halfPixel.x, -halfPixel.y), 0.0) * 2.0;
+	return sum / 12.0;
+}
+
 vec4 Blur()
 {
+	if (BlurParam.pyramidLevels > 0)
+	{
+		return DualFilterBlur();
+	}
+
 	float g[15];
 	g[0] = 0.023089;
 	g[1] = 0.034587;
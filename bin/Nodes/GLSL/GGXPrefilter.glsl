@@ -0,0 +1,69 @@
+layout (std140) uniform GGXPrefilterBlock
+{
+	int faceSize;
+	int sampleCount;
+} GGXPrefilterParam;
+
+// roughness goes linearly from 0 at mip 0 to 1 at the last mip
+// source must have a mip chain, see GenerateInputMipmaps
+
+vec2 Hammersley(uint i, uint count)
+{
+	return vec2(float(i) / float(count), float(bitfieldReverse(i)) * 2.3283064365386963e-10);
+}
+
+float DistributionGGX(float NdotH, float alpha)
+{
+	float a2 = alpha * alpha;
+	float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+	return a2 / (PI * d * d);
+}
+
+vec3 ImportanceSampleGGX(vec2 xi, float alpha, vec3 N)
+{
+	float phi = TwoPI * xi.x;
+	float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (alpha * alpha - 1.0) * xi.y));
+	float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+	vec3 H = vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+
+	vec3 up = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+	vec3 tangentX = normalize(cross(up, N));
+	vec3 tangentY = cross(N, tangentX);
+	return tangentX * H.x + tangentY * H.y + N * H.z;
+}
+
+vec4 GGXPrefilter()
+{
+	vec3 N = normalize((EvaluationParam.viewRot * vec4(vUV * 2.0 - 1.0, 1.0, 0.0)).xyz);
+	if (EvaluationParam.mipmapNumber == 0 || EvaluationParam.mipmapCount < 2)
+		return textureLod(CubeSampler0, InvertCubeY(N), 0.0);
+
+	float roughness = float(EvaluationParam.mipmapNumber) / float(EvaluationParam.mipmapCount - 1);
+	float alpha = max(roughness * roughness, 0.001);
+
+	// PDF based source mip selection to hide undersampling
+	float sourceSize = float(textureSize(CubeSampler0, 0).x);
+	float texelSolidAngle = 4.0 * PI / (6.0 * sourceSize * sourceSize);
+
+	uint count = uint(clamp(GGXPrefilterParam.sampleCount, 1, 4096));
+	vec4 color = vec4(0.0);
+	float totalWeight = 0.0;
+	for (uint i = 0u; i < count; i++)
+	{
+		// V = N, so NdotH == VdotH and pdf = D / 4
+		vec3 H = ImportanceSampleGGX(Hammersley(i, count), alpha, N);
+		float NdotH = dot(N, H);
+		vec3 L = 2.0 * NdotH * H - N;
+		float NdotL = dot(N, L);
+		if (NdotL <= 0.0)
+			continue;
+
+		float pdf = DistributionGGX(NdotH, alpha) * 0.25;
+		float sampleSolidAngle = 1.0 / (float(count) * pdf + 0.0001);
+		float lod = max(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0, 0.0);
+
+		color += textureLod(CubeSampler0, InvertCubeY(L), lod) * NdotL;
+		totalWeight += NdotL;
+	}
+	return color / max(totalWeight, 0.0001);
+}
@@ -32,9 +32,12 @@ layout (std140) uniform EvaluationBlock
 	int passNumber;
 	vec4 mouse; // x,y, lbut down, rbut down
 	ivec4 inputIndices[2];
+	vec4 pad2;
 	
 	int frame;
 	int localFrame;
+	int mipmapNumber;
+	int mipmapCount;
 } EvaluationParam;
 
 struct Camera
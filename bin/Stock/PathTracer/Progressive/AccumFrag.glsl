@@ -1,11 +1,14 @@
 #version 330
 
-out vec4 color;
+layout(location = 0) out vec4 color;
+layout(location = 1) out float moment;
 in vec2 TexCoords;
 
 uniform sampler2D pathTraceTexture;
+uniform sampler2D pathTraceMomentTexture;
 
 void main()
 {
 	color = texture(pathTraceTexture, TexCoords);
+	moment = texture(pathTraceMomentTexture, TexCoords).x;
 }
\ No newline at end of file
@@ -6,7 +6,6 @@ in vec2 TexCoords;
 uniform sampler2D pathTraceTextureHalf;
 uniform sampler2D pathTraceTexture;
 
-uniform float invSampleCounter;
 uniform float fadeAmt;
 
 vec4 ToneMap(in vec4 c, float limit)
@@ -18,8 +17,11 @@ vec4 ToneMap(in vec4 c, float limit)
 
 void main()
 {
-	vec4 color1 = texture(pathTraceTextureHalf, TexCoords);
-	vec4 color2 = texture(pathTraceTexture, TexCoords) * invSampleCounter;
+	// alpha holds the sample count
+	vec4 accum1 = texture(pathTraceTextureHalf, TexCoords);
+	vec4 accum2 = texture(pathTraceTexture, TexCoords);
+	vec4 color1 = vec4(accum1.rgb / max(accum1.a, 1.0), 1.0);
+	vec4 color2 = vec4(accum2.rgb / max(accum2.a, 1.0), 1.0);
 
 	color1 = pow(ToneMap(color1, 1.5), vec4(1.0 / 2.2));
 	color2 = pow(ToneMap(color2, 1.5), vec4(1.0 / 2.2));
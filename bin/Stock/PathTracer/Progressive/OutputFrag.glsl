@@ -4,7 +4,6 @@ out vec4 color;
 in vec2 TexCoords;
 
 uniform sampler2D pathTraceTexture;
-uniform float invSampleCounter;
 
 vec4 ToneMap(in vec4 c, float limit)
 {
@@ -15,6 +14,8 @@ vec4 ToneMap(in vec4 c, float limit)
 
 void main()
 {
-	color = texture(pathTraceTexture, TexCoords) * invSampleCounter;
-	color = pow(ToneMap(color, 1.5), vec4(1.0 / 2.2));
+	// alpha holds the sample count
+	vec4 accum = texture(pathTraceTexture, TexCoords);
+	color = vec4(accum.rgb / max(accum.a, 1.0), 1.0);
+	color = vec4(pow(ToneMap(color, 1.5).rgb, vec3(1.0 / 2.2)), 1.0);
 }
\ No newline at end of file
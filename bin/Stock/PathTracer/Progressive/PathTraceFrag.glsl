@@ -1,6 +1,7 @@
 #version 330
 
-out vec3 color;
+layout(location = 0) out vec4 color; // sum of samples, sample count
+layout(location = 1) out float moment; // sum of squared luminances
 in vec2 TexCoords;
 uniform bool isCameraMoving;
 uniform bool useEnvMap;
@@ -9,6 +10,7 @@ uniform vec2 screenResolution;
 uniform float hdrTexSize;
 
 uniform sampler2D accumTexture;
+uniform sampler2D accumMomentTexture;
 uniform samplerBuffer BVH;
 uniform samplerBuffer triangleIndicesTex;
 uniform samplerBuffer verticesTex;
@@ -964,12 +966,18 @@ void main(void)
 
 	Ray ray = Ray(camera.position, rayDir);
 
-	vec3 accumColor = texture(accumTexture, TexCoords).xyz;
+	vec4 accumColor = texture(accumTexture, TexCoords);
+	float accumMoment = texture(accumMomentTexture, TexCoords).x;
 
 	if (isCameraMoving)
-		accumColor = vec3(0);
+	{
+		accumColor = vec4(0);
+		accumMoment = 0.0;
+	}
 
 	vec3 pixelColor = PathTrace(ray);
+	float luminance = dot(pixelColor, vec3(0.3, 0.6, 0.1));
 
-	color = pixelColor + accumColor;
+	color = vec4(pixelColor + accumColor.rgb, accumColor.a + 1.0);
+	moment = accumMoment + luminance * luminance;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 330
+
+out vec4 error;
+
+uniform sampler2D accumTexture;
+uniform sampler2D accumMomentTexture;
+uniform int tileSize;
+
+// relative standard error of the mean luminance, 1 texel per tile. Every other pixel is used.
+void main()
+{
+	ivec2 origin = ivec2(gl_FragCoord.xy) * tileSize;
+	ivec2 size = textureSize(accumTexture, 0);
+	float errorSum = 0.0;
+	float luminanceSum = 0.0;
+	for (int y = 0; y < tileSize; y += 2)
+	{
+		for (int x = 0; x < tileSize; x += 2)
+		{
+			ivec2 coord = min(origin + ivec2(x, y), size - 1);
+			vec4 accum = texelFetch(accumTexture, coord, 0);
+			float sampleCount = max(accum.a, 1.0);
+			float mean = dot(accum.rgb, vec3(0.3, 0.6, 0.1)) / sampleCount;
+			float variance = max(texelFetch(accumMomentTexture, coord, 0).x / sampleCount - mean * mean, 0.0);
+			errorSum += sqrt(variance / sampleCount);
+			luminanceSum += mean;
+		}
+	}
+	error = vec4(errorSum / max(luminanceSum, 0.001 * float(tileSize * tileSize / 4)), 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,59 @@
+#ifdef VERTEX_SHADER
+
+layout(location = 0)in vec2 inUV;
+out vec2 vUV;
+
+void main()
+{
+	gl_Position = vec4(inUV.xy*2.0 - 1.0,0.5,1.0); vUV = inUV;
+}
+
+#endif
+
+#ifdef FRAGMENT_SHADER
+
+// packs a planar YUV420 frame, 4 bytes per texel. Target is (encodedSize.x/4, encodedSize.y*3/2)
+// Y rows first, then U and V. BT.601 limited range, like swscale defaults.
+uniform sampler2D source;
+uniform ivec2 encodedSize;
+uniform int resample; // source size differs from the stream size : filtered fetch
+layout(location = 0) out vec4 outPixDiffuse;
+
+vec3 Fetch(ivec2 coord)
+{
+	// encoders expect rows from top to bottom
+	if (resample != 0)
+		return textureLod(source, vec2((float(coord.x) + 0.5) / float(encodedSize.x), 1.0 - (float(coord.y) + 0.5) / float(encodedSize.y)), 0.0).rgb;
+	ivec2 size = textureSize(source, 0);
+	coord = clamp(ivec2(coord.x, size.y - 1 - coord.y), ivec2(0), size - 1);
+	return texelFetch(source, coord, 0).rgb;
+}
+
+float PackedByte(int index)
+{
+	int width = encodedSize.x;
+	int lumaSize = width * encodedSize.y;
+	if (index < lumaSize)
+	{
+		vec3 c = Fetch(ivec2(index % width, index / width));
+		return (16.0 + dot(c, vec3(65.481, 128.553, 24.966))) / 255.0;
+	}
+	int chromaWidth = width / 2;
+	int chromaSize = chromaWidth * (encodedSize.y / 2);
+	int chromaIndex = index - lumaSize;
+	int local = chromaIndex % chromaSize;
+	ivec2 coord = ivec2(local % chromaWidth, local / chromaWidth) * 2;
+	vec3 c = (Fetch(coord) + Fetch(coord + ivec2(1, 0)) + Fetch(coord + ivec2(0, 1)) + Fetch(coord + ivec2(1, 1))) * 0.25;
+	if (chromaIndex < chromaSize)
+		return (128.0 + dot(c, vec3(-37.797, -74.203, 112.0))) / 255.0;
+	return (128.0 + dot(c, vec3(112.0, -93.786, -18.214))) / 255.0;
+}
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	int index = (texel.y * (encodedSize.x / 4) + texel.x) * 4;
+	outPixDiffuse = vec4(PackedByte(index), PackedByte(index + 1), PackedByte(index + 2), PackedByte(index + 3));
+}
+
+#endif
@@ -0,0 +1,1119 @@
+#include "Config.h"
+#include "CPURenderer.h"
+#include "Camera.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace GLSLPathTracer
+{
+    static const float kPi = 3.14159265358979323f;
+    static const float kTwoPi = 6.28318530717958648f;
+    static const float kInfinity = 1000000.f;
+    static const float kEps = 0.001f;
+    static const int kTileSize = 64;
+    static const int kMinTileSamples = 16; // below, the variance estimate isn't reliable
+    static const int kMaxTileSamples = 4096;
+    static const int kMaxPassesPerFrame = 32;
+    static const int kPacketSize = 4; // 2x2 pixels
+    static const int kStackSize = 64;
+
+    // a BVH deeper than the traversal stack loses subtrees and the image is wrong. Said once.
+    static std::atomic<bool> gStackOverflowReported(false);
+    static void ReportStackOverflow()
+    {
+        if (!gStackOverflowReported.exchange(true))
+            Log("CPU Renderer : BVH deeper than the traversal stack (%d), some triangles are skipped\n", kStackSize);
+    }
+
+    // Port of Progressive/PathTraceFrag.glsl. Function names match the shader ones.
+    struct Ray { glm::vec3 origin; glm::vec3 direction; };
+    struct Material { glm::vec4 albedo; glm::vec4 emission; glm::vec4 param; glm::vec4 texIDs; };
+    struct State { glm::vec3 normal; glm::vec3 ffnormal; glm::vec3 fhp; bool isEmitter; int depth; float hitDist; glm::vec2 texCoord; glm::vec3 bary; int triID; int matID; Material mat; bool specularBounce; };
+    struct BsdfSampleRec { glm::vec3 bsdfDir; float pdf; };
+    struct LightSampleRec { glm::vec3 surfacePos; glm::vec3 normal; glm::vec3 emission; float pdf; };
+
+    // xorshift seeded from the pixel and its sample count, so a sample doesn't depend on thread scheduling
+    struct Random
+    {
+        Random(unsigned int pixel, unsigned int sample) : state(Hash(pixel * 0x9E3779B9u ^ Hash(sample + 1)))
+        {
+            if (!state)
+                state = 1;
+        }
+        static unsigned int Hash(unsigned int x)
+        {
+            x ^= x >> 16;
+            x *= 0x7feb352du;
+            x ^= x >> 15;
+            x *= 0x846ca68bu;
+            x ^= x >> 16;
+            return x;
+        }
+        float operator()()
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return float(state >> 8) * (1.f / 16777216.f);
+        }
+        unsigned int state;
+    };
+
+    // primary rays of a 2x2 pixel quad. Structure of arrays so the per lane loops vectorize.
+    struct RayPacket
+    {
+        float ox[kPacketSize], oy[kPacketSize], oz[kPacketSize];
+        float dx[kPacketSize], dy[kPacketSize], dz[kPacketSize];
+        float idx[kPacketSize], idy[kPacketSize], idz[kPacketSize];
+        float t[kPacketSize]; // closest hit. -kInfinity for lanes outside the image
+        float u[kPacketSize], v[kPacketSize];
+        int triID[kPacketSize];
+    };
+
+    struct SceneView
+    {
+        const Scene *scene;
+        int numOfLights;
+        int maxDepth;
+        bool useEnvMap;
+        float hdrResolution;
+        float hdrMultiplier;
+    };
+
+    static int Wrap(int x, int size)
+    {
+        x %= size;
+        return x < 0 ? x + size : x;
+    }
+
+    static float Texel(const unsigned char *texel) { return float(*texel) * (1.f / 255.f); }
+    static float Texel(const float *texel) { return *texel; }
+
+    // GL_LINEAR with GL_REPEAT, 3 components per texel
+    template <typename T> static glm::vec3 SampleBilinear(const T *texels, int width, int height, glm::vec2 uv)
+    {
+        const float x = uv.x * float(width) - 0.5f;
+        const float y = uv.y * float(height) - 0.5f;
+        const float fx = floorf(x);
+        const float fy = floorf(y);
+        const int x0 = Wrap(int(fx), width), x1 = Wrap(int(fx) + 1, width);
+        const int y0 = Wrap(int(fy), height), y1 = Wrap(int(fy) + 1, height);
+        auto fetch = [&](int px, int py) {
+            const T *texel = texels + (size_t(py) * width + px) * 3;
+            return glm::vec3(Texel(texel), Texel(texel + 1), Texel(texel + 2));
+        };
+        const glm::vec3 bottom = glm::mix(fetch(x0, y0), fetch(x1, y0), x - fx);
+        const glm::vec3 top = glm::mix(fetch(x0, y1), fetch(x1, y1), x - fx);
+        return glm::mix(bottom, top, y - fy);
+    }
+
+    // GL_NEAREST with GL_REPEAT
+    static glm::vec2 SampleNearest(const glm::vec2 *texels, int width, int height, glm::vec2 uv)
+    {
+        const int x = Wrap(int(floorf(uv.x * float(width))), width);
+        const int y = Wrap(int(floorf(uv.y * float(height))), height);
+        return texels[size_t(y) * width + x];
+    }
+
+    static glm::vec3 SampleTextureArray(const unsigned char *textures, const glm::ivec2& size, int layer, glm::vec2 uv)
+    {
+        return SampleBilinear(textures + size_t(layer) * size.x * size.y * 3, size.x, size.y, uv);
+    }
+
+    //-----------------------------------------------------------------------
+    static float SphereIntersect(float rad, glm::vec3 pos, const Ray& r)
+    //-----------------------------------------------------------------------
+    {
+        glm::vec3 op = pos - r.origin;
+        float eps = 0.001f;
+        float b = glm::dot(op, r.direction);
+        float det = b * b - glm::dot(op, op) + rad * rad;
+        if (det < 0.f)
+            return kInfinity;
+
+        det = sqrtf(det);
+        float t1 = b - det;
+        if (t1 > eps)
+            return t1;
+
+        float t2 = b + det;
+        if (t2 > eps)
+            return t2;
+
+        return kInfinity;
+    }
+
+    //-----------------------------------------------------------------------
+    static float RectIntersect(const glm::vec3& pos, const glm::vec3& u, const glm::vec3& v, const glm::vec4& plane, const Ray& r)
+    //-----------------------------------------------------------------------
+    {
+        glm::vec3 n = glm::vec3(plane);
+        float dt = glm::dot(r.direction, n);
+        float t = (plane.w - glm::dot(n, r.origin)) / dt;
+        if (t > kEps)
+        {
+            glm::vec3 p = r.origin + r.direction * t;
+            glm::vec3 vi = p - pos;
+            float a1 = glm::dot(u, vi);
+            if (a1 >= 0.f && a1 <= 1.f)
+            {
+                float a2 = glm::dot(v, vi);
+                if (a2 >= 0.f && a2 <= 1.f)
+                    return t;
+            }
+        }
+
+        return kInfinity;
+    }
+
+    //----------------------------------------------------------------
+    static float IntersectRayAABB(const glm::vec3& minCorner, const glm::vec3& maxCorner, const Ray& r, const glm::vec3& invdir)
+    //----------------------------------------------------------------
+    {
+        glm::vec3 f = (maxCorner - r.origin) * invdir;
+        glm::vec3 n = (minCorner - r.origin) * invdir;
+
+        glm::vec3 tmax = glm::max(f, n);
+        glm::vec3 tmin = glm::min(f, n);
+
+        float t1 = glm::min(tmax.x, glm::min(tmax.y, tmax.z));
+        float t0 = glm::max(tmin.x, glm::max(tmin.y, tmin.z));
+
+        return (t1 >= t0) ? (t0 > 0.f ? t0 : t1) : -1.f;
+    }
+
+    // returns the closest light hit, kInfinity when none
+    //-----------------------------------------------------------------------
+    static float LightsIntersect(const SceneView& view, const Ray& r, State& state, LightSampleRec& lightSampleRec)
+    //-----------------------------------------------------------------------
+    {
+        float t = kInfinity;
+        float d;
+
+        for (int i = 0; i < view.numOfLights; i++)
+        {
+            const LightData& light = view.scene->lightData[i];
+            const glm::vec3& radiusAreaType = light.radiusAreaType;
+
+            if (radiusAreaType.z == 0.f) // Rectangular Area Light
+            {
+                glm::vec3 normal = glm::normalize(glm::cross(light.u, light.v));
+                if (glm::dot(normal, r.direction) > 0.f) // Hide backfacing quad light
+                    continue;
+                glm::vec4 plane = glm::vec4(normal, glm::dot(normal, light.position));
+                glm::vec3 u = light.u * (1.f / glm::dot(light.u, light.u));
+                glm::vec3 v = light.v * (1.f / glm::dot(light.v, light.v));
+
+                d = RectIntersect(light.position, u, v, plane, r);
+                if (d < 0.f)
+                    d = kInfinity;
+                if (d < t)
+                {
+                    t = d;
+                    float cosTheta = glm::dot(-r.direction, normal);
+                    lightSampleRec.emission = light.emission;
+                    lightSampleRec.pdf = (t * t) / (radiusAreaType.y * cosTheta);
+                    state.isEmitter = true;
+                }
+            }
+            if (radiusAreaType.z == 1.f) // Spherical Area Light
+            {
+                d = SphereIntersect(radiusAreaType.x, light.position, r);
+                if (d < 0.f)
+                    d = kInfinity;
+                if (d < t)
+                {
+                    t = d;
+                    lightSampleRec.emission = light.emission;
+                    lightSampleRec.pdf = (t * t) / radiusAreaType.y;
+                    state.isEmitter = true;
+                }
+            }
+        }
+        return t;
+    }
+
+    // Moller-Trumbore, same test as the shader. uvt.xy are the barycentrics of v1 and v2.
+    static bool TriangleIntersect(const Scene *scene, const glm::vec4& triIndex, const Ray& r, float maxDist, glm::vec3& uvt)
+    {
+        const glm::vec3& v0 = scene->vertexData[int(triIndex.x)].vertex;
+        const glm::vec3& v1 = scene->vertexData[int(triIndex.y)].vertex;
+        const glm::vec3& v2 = scene->vertexData[int(triIndex.z)].vertex;
+
+        glm::vec3 e0 = v1 - v0;
+        glm::vec3 e1 = v2 - v0;
+        glm::vec3 pv = glm::cross(r.direction, e1);
+        float det = glm::dot(e0, pv);
+
+        glm::vec3 tv = r.origin - v0;
+        glm::vec3 qv = glm::cross(tv, e0);
+
+        uvt = glm::vec3(glm::dot(tv, pv), glm::dot(r.direction, qv), glm::dot(e1, qv)) / det;
+        return uvt.x >= 0.f && uvt.y >= 0.f && uvt.z >= 0.f && 1.f - uvt.x - uvt.y >= 0.f && uvt.z < maxDist;
+    }
+
+    // any hit when shadow is true, closest hit otherwise. Returns the hit distance, maxDist when nothing is hit.
+    static float BVHIntersect(const Scene *scene, const Ray& r, float maxDist, bool shadow, int& triID, glm::vec3& bary)
+    {
+        const GPUBVHNode *nodes = scene->gpuBVH->gpuNodes;
+        const TriIndexData *triangles = scene->gpuBVH->bvhTriangleIndices.data();
+        const glm::vec3 invdir = 1.f / r.direction;
+        float t = maxDist;
+
+        int stack[kStackSize];
+        int ptr = 0;
+        stack[ptr++] = -1;
+
+        int idx = 0;
+        while (idx > -1)
+        {
+            const glm::vec3& LRLeaf = nodes[idx].LRLeaf;
+            int leftIndex = int(LRLeaf.x);
+            int rightIndex = int(LRLeaf.y);
+
+            if (int(LRLeaf.z) == 1)
+            {
+                for (int i = 0; i <= rightIndex; i++)
+                {
+                    const glm::vec4& triIndex = triangles[leftIndex + i].indices;
+                    glm::vec3 uvt;
+                    if (!TriangleIntersect(scene, triIndex, r, t, uvt))
+                        continue;
+                    if (shadow)
+                        return uvt.z;
+                    t = uvt.z;
+                    triID = int(triIndex.w);
+                    bary = glm::vec3(1.f - uvt.x - uvt.y, uvt.x, uvt.y);
+                }
+            }
+            else
+            {
+                float leftHit = IntersectRayAABB(nodes[leftIndex].BBoxMin, nodes[leftIndex].BBoxMax, r, invdir);
+                float rightHit = IntersectRayAABB(nodes[rightIndex].BBoxMin, nodes[rightIndex].BBoxMax, r, invdir);
+
+                if (leftHit > 0.f && rightHit > 0.f)
+                {
+                    idx = leftHit > rightHit ? rightIndex : leftIndex;
+                    if (ptr < kStackSize)
+                        stack[ptr++] = leftHit > rightHit ? leftIndex : rightIndex;
+                    else
+                        ReportStackOverflow();
+                    continue;
+                }
+                else if (leftHit > 0.f)
+                {
+                    idx = leftIndex;
+                    continue;
+                }
+                else if (rightHit > 0.f)
+                {
+                    idx = rightIndex;
+                    continue;
+                }
+            }
+            idx = stack[--ptr];
+        }
+        return t;
+    }
+
+    //-----------------------------------------------------------------------
+    static float SceneIntersect(const SceneView& view, const Ray& r, State& state, LightSampleRec& lightSampleRec)
+    //-----------------------------------------------------------------------
+    {
+        float t = LightsIntersect(view, r, state, lightSampleRec);
+        const float lightDist = t;
+        t = BVHIntersect(view.scene, r, t, false, state.triID, state.bary);
+        if (t < lightDist)
+        {
+            state.isEmitter = false;
+            state.fhp = r.origin + r.direction * t;
+        }
+        state.hitDist = t;
+        return t;
+    }
+
+    //-----------------------------------------------------------------------
+    static bool SceneIntersectShadow(const SceneView& view, const Ray& r, float maxDist)
+    //-----------------------------------------------------------------------
+    {
+        int triID;
+        glm::vec3 bary;
+        return BVHIntersect(view.scene, r, maxDist, true, triID, bary) < maxDist;
+    }
+
+    // closest hit of the 4 packet rays. A node is visited when any active ray hits its box.
+    static void PacketIntersect(const Scene *scene, RayPacket& p)
+    {
+        const GPUBVHNode *nodes = scene->gpuBVH->gpuNodes;
+        const TriIndexData *triangles = scene->gpuBVH->bvhTriangleIndices.data();
+
+        int stack[kStackSize];
+        int ptr = 0;
+        stack[ptr++] = 0;
+
+        while (ptr)
+        {
+            const GPUBVHNode& node = nodes[stack[--ptr]];
+            int hitMask = 0;
+            for (int lane = 0; lane < kPacketSize; lane++)
+            {
+                float tx0 = (node.BBoxMin.x - p.ox[lane]) * p.idx[lane], tx1 = (node.BBoxMax.x - p.ox[lane]) * p.idx[lane];
+                float ty0 = (node.BBoxMin.y - p.oy[lane]) * p.idy[lane], ty1 = (node.BBoxMax.y - p.oy[lane]) * p.idy[lane];
+                float tz0 = (node.BBoxMin.z - p.oz[lane]) * p.idz[lane], tz1 = (node.BBoxMax.z - p.oz[lane]) * p.idz[lane];
+                float t0 = glm::max(glm::max(glm::min(tx0, tx1), glm::min(ty0, ty1)), glm::min(tz0, tz1));
+                float t1 = glm::min(glm::min(glm::max(tx0, tx1), glm::max(ty0, ty1)), glm::max(tz0, tz1));
+                hitMask |= (t1 >= glm::max(t0, 0.f) && t0 < p.t[lane]) ? (1 << lane) : 0;
+            }
+            if (!hitMask)
+                continue;
+
+            int leftIndex = int(node.LRLeaf.x);
+            int rightIndex = int(node.LRLeaf.y);
+            if (int(node.LRLeaf.z) != 1)
+            {
+                if (ptr + 2 <= kStackSize)
+                {
+                    stack[ptr++] = rightIndex;
+                    stack[ptr++] = leftIndex;
+                }
+                else
+                {
+                    ReportStackOverflow();
+                }
+                continue;
+            }
+
+            for (int i = 0; i <= rightIndex; i++)
+            {
+                const glm::vec4& triIndex = triangles[leftIndex + i].indices;
+                const glm::vec3& v0 = scene->vertexData[int(triIndex.x)].vertex;
+                const glm::vec3 e0 = scene->vertexData[int(triIndex.y)].vertex - v0;
+                const glm::vec3 e1 = scene->vertexData[int(triIndex.z)].vertex - v0;
+                for (int lane = 0; lane < kPacketSize; lane++)
+                {
+                    // pv = cross(d, e1), tv = o - v0, qv = cross(tv, e0)
+                    float pvx = p.dy[lane] * e1.z - p.dz[lane] * e1.y;
+                    float pvy = p.dz[lane] * e1.x - p.dx[lane] * e1.z;
+                    float pvz = p.dx[lane] * e1.y - p.dy[lane] * e1.x;
+                    float invDet = 1.f / (e0.x * pvx + e0.y * pvy + e0.z * pvz);
+                    float tvx = p.ox[lane] - v0.x, tvy = p.oy[lane] - v0.y, tvz = p.oz[lane] - v0.z;
+                    float qvx = tvy * e0.z - tvz * e0.y;
+                    float qvy = tvz * e0.x - tvx * e0.z;
+                    float qvz = tvx * e0.y - tvy * e0.x;
+                    float u = (tvx * pvx + tvy * pvy + tvz * pvz) * invDet;
+                    float v = (p.dx[lane] * qvx + p.dy[lane] * qvy + p.dz[lane] * qvz) * invDet;
+                    float t = (e1.x * qvx + e1.y * qvy + e1.z * qvz) * invDet;
+                    bool hit = u >= 0.f && v >= 0.f && t >= 0.f && 1.f - u - v >= 0.f && t < p.t[lane];
+                    p.t[lane] = hit ? t : p.t[lane];
+                    p.u[lane] = hit ? u : p.u[lane];
+                    p.v[lane] = hit ? v : p.v[lane];
+                    p.triID[lane] = hit ? int(triIndex.w) : p.triID[lane];
+                }
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------
+    static glm::vec3 CosineSampleHemisphere(float u1, float u2)
+    //-----------------------------------------------------------------------
+    {
+        glm::vec3 dir;
+        float r = sqrtf(u1);
+        float phi = kTwoPi * u2;
+        dir.x = r * cosf(phi);
+        dir.y = r * sinf(phi);
+        dir.z = sqrtf(glm::max(0.f, 1.f - dir.x * dir.x - dir.y * dir.y));
+        return dir;
+    }
+
+    //-----------------------------------------------------------------------
+    static glm::vec3 UniformSampleSphere(float u1, float u2)
+    //-----------------------------------------------------------------------
+    {
+        float z = 1.f - 2.f * u1;
+        float r = sqrtf(glm::max(0.f, 1.f - z * z));
+        float phi = kTwoPi * u2;
+        return glm::vec3(r * cosf(phi), r * sinf(phi), z);
+    }
+
+    static void OrthonormalBasis(const glm::vec3& N, glm::vec3& tangentX, glm::vec3& tangentY)
+    {
+        glm::vec3 upVector = fabsf(N.z) < 0.999f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(1.f, 0.f, 0.f);
+        tangentX = glm::normalize(glm::cross(upVector, N));
+        tangentY = glm::cross(N, tangentX);
+    }
+
+    //-----------------------------------------------------------------------
+    static void GetNormalAndTexCoord(const SceneView& view, State& state, const Ray& r)
+    //-----------------------------------------------------------------------
+    {
+        const NormalTexData& data = view.scene->normalTexData[state.triID];
+
+        state.matID = int(data.texCoords[0].z);
+        state.texCoord = glm::vec2(data.texCoords[0]) * state.bary.x + glm::vec2(data.texCoords[1]) * state.bary.y + glm::vec2(data.texCoords[2]) * state.bary.z;
+
+        glm::vec3 normal = glm::normalize(data.normals[0] * state.bary.x + data.normals[1] * state.bary.y + data.normals[2] * state.bary.z);
+        state.normal = normal;
+        state.ffnormal = glm::dot(normal, r.direction) <= 0.f ? normal : -normal;
+    }
+
+    //-----------------------------------------------------------------------
+    static void GetMaterialsAndTextures(const SceneView& view, State& state, const Ray& r)
+    //-----------------------------------------------------------------------
+    {
+        const MaterialData& data = view.scene->materialData[state.matID];
+        const TexData& texData = view.scene->texData;
+        Material mat = { data.albedo, data.emission, data.params, data.texIDs };
+
+        if (int(mat.texIDs.x) >= 0 && texData.albedoTextures)
+        {
+            glm::vec3 albedo = SampleTextureArray(texData.albedoTextures, texData.albedoTextureSize, int(mat.texIDs.x), state.texCoord);
+            mat.albedo = glm::vec4(glm::vec3(mat.albedo) * glm::pow(albedo, glm::vec3(2.2f)), mat.albedo.w);
+        }
+
+        if (int(mat.texIDs.y) >= 0 && texData.metallicRoughnessTextures)
+        {
+            glm::vec3 metallicRoughness = SampleTextureArray(texData.metallicRoughnessTextures, texData.metallicRoughnessTextureSize, int(mat.texIDs.y), state.texCoord);
+            mat.param.x = powf(metallicRoughness.z, 2.2f);
+            mat.param.y = powf(metallicRoughness.y, 2.2f);
+        }
+
+        if (int(mat.texIDs.z) >= 0 && texData.normalTextures)
+        {
+            glm::vec3 nrm = SampleTextureArray(texData.normalTextures, texData.normalTextureSize, int(mat.texIDs.z), state.texCoord);
+            nrm = glm::normalize(nrm * 2.f - 1.f);
+
+            glm::vec3 tangentX, tangentY;
+            OrthonormalBasis(state.ffnormal, tangentX, tangentY);
+
+            nrm = tangentX * nrm.x + tangentY * nrm.y + state.ffnormal * nrm.z;
+            state.normal = glm::normalize(nrm);
+            state.ffnormal = glm::dot(state.normal, r.direction) <= 0.f ? state.normal : -state.normal;
+        }
+
+        state.mat = mat;
+    }
+
+    //----------------------------UE4 BRDF----------------------------------
+
+    static float SchlickFresnel(float u)
+    {
+        float m = glm::clamp(1.f - u, 0.f, 1.f);
+        float m2 = m * m;
+        return m2 * m2 * m; // pow(m,5)
+    }
+
+    static float GTR2(float NDotH, float a)
+    {
+        float a2 = a * a;
+        float t = 1.f + (a2 - 1.f) * NDotH * NDotH;
+        return a2 / (kPi * t * t);
+    }
+
+    static float SmithG_GGX(float NDotv, float alphaG)
+    {
+        float a = alphaG * alphaG;
+        float b = NDotv * NDotv;
+        return 1.f / (NDotv + sqrtf(a + b - a * b));
+    }
+
+    static float UE4Pdf(const Ray& ray, const State& state, const glm::vec3& bsdfDir)
+    {
+        glm::vec3 n = state.normal;
+        glm::vec3 V = -ray.direction;
+        glm::vec3 L = bsdfDir;
+
+        float specularAlpha = glm::max(0.001f, state.mat.param.y);
+
+        float diffuseRatio = 0.5f * (1.f - state.mat.param.x);
+        float specularRatio = 1.f - diffuseRatio;
+
+        glm::vec3 halfVec = glm::normalize(L + V);
+
+        float cosTheta = fabsf(glm::dot(halfVec, n));
+        float pdfGTR2 = GTR2(cosTheta, specularAlpha) * cosTheta;
+
+        float pdfSpec = pdfGTR2 / (4.f * fabsf(glm::dot(L, halfVec)));
+        float pdfDiff = fabsf(glm::dot(L, n)) * (1.f / kPi);
+
+        return diffuseRatio * pdfDiff + specularRatio * pdfSpec;
+    }
+
+    static glm::vec3 UE4Sample(const Ray& ray, const State& state, Random& rand)
+    {
+        glm::vec3 N = state.normal;
+        glm::vec3 V = -ray.direction;
+
+        float probability = rand();
+        float diffuseRatio = 0.5f * (1.f - state.mat.param.x);
+
+        float r1 = rand();
+        float r2 = rand();
+
+        glm::vec3 tangentX, tangentY;
+        OrthonormalBasis(N, tangentX, tangentY);
+
+        if (probability < diffuseRatio) // sample diffuse
+        {
+            glm::vec3 dir = CosineSampleHemisphere(r1, r2);
+            return tangentX * dir.x + tangentY * dir.y + N * dir.z;
+        }
+
+        float a = glm::max(0.001f, state.mat.param.y);
+        float phi = r1 * kTwoPi;
+
+        float cosTheta = sqrtf((1.f - r2) / (1.f + (a * a - 1.f) * r2));
+        float sinTheta = glm::clamp(sqrtf(1.f - (cosTheta * cosTheta)), 0.f, 1.f);
+
+        glm::vec3 halfVec = glm::vec3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+        halfVec = tangentX * halfVec.x + tangentY * halfVec.y + N * halfVec.z;
+
+        return 2.f * glm::dot(V, halfVec) * halfVec - V;
+    }
+
+    static glm::vec3 UE4Eval(const Ray& ray, const State& state, const glm::vec3& bsdfDir)
+    {
+        glm::vec3 N = state.normal;
+        glm::vec3 V = -ray.direction;
+        glm::vec3 L = bsdfDir;
+
+        float NDotL = glm::dot(N, L);
+        float NDotV = glm::dot(N, V);
+        if (NDotL <= 0.f || NDotV <= 0.f)
+            return glm::vec3(0.f);
+
+        glm::vec3 H = glm::normalize(L + V);
+        float NDotH = glm::dot(N, H);
+        float LDotH = glm::dot(L, H);
+
+        const glm::vec3 albedo = glm::vec3(state.mat.albedo);
+        float specular = 0.5f;
+        glm::vec3 specularCol = glm::mix(glm::vec3(0.08f * specular), albedo, state.mat.param.x);
+        float a = glm::max(0.001f, state.mat.param.y);
+        float Ds = GTR2(NDotH, a);
+        float FH = SchlickFresnel(LDotH);
+        glm::vec3 Fs = glm::mix(specularCol, glm::vec3(1.f), FH);
+        float roughg = (state.mat.param.y * 0.5f + 0.5f);
+        roughg = roughg * roughg;
+        float Gs = SmithG_GGX(NDotL, roughg) * SmithG_GGX(NDotV, roughg);
+
+        return (albedo / kPi) * (1.f - state.mat.param.x) + Gs * Fs * Ds;
+    }
+
+    //----------------------------Glass BSDF----------------------------------
+
+    static glm::vec3 GlassSample(const Ray& ray, const State& state, Random& rand)
+    {
+        float n1 = 1.f;
+        float n2 = state.mat.param.z;
+        float R0 = (n1 - n2) / (n1 + n2);
+        R0 *= R0;
+        float theta = glm::dot(-ray.direction, state.ffnormal);
+        float prob = R0 + (1.f - R0) * SchlickFresnel(theta);
+
+        float eta = glm::dot(state.normal, state.ffnormal) > 0.f ? (n1 / n2) : (n2 / n1);
+        float cos2t = 1.f - eta * eta * (1.f - theta * theta);
+
+        if (cos2t < 0.f || rand() < prob) // Reflection
+            return glm::normalize(glm::reflect(ray.direction, state.ffnormal));
+        return glm::normalize(glm::refract(ray.direction, state.ffnormal, eta));
+    }
+
+    //------------------------Direct Light Evaluation----------------------
+
+    static float powerHeuristic(float a, float b)
+    {
+        float t = a * a;
+        return t / (b * b + t);
+    }
+
+    static void sampleLight(const SceneView& view, const LightData& light, LightSampleRec& lightSampleRec, Random& rand)
+    {
+        float r1 = rand();
+        float r2 = rand();
+
+        if (int(light.radiusAreaType.z) == 0) // Quad Light
+        {
+            lightSampleRec.surfacePos = light.position + light.u * r1 + light.v * r2;
+            lightSampleRec.normal = glm::normalize(glm::cross(light.u, light.v));
+        }
+        else
+        {
+            lightSampleRec.surfacePos = light.position + UniformSampleSphere(r1, r2) * light.radiusAreaType.x;
+            lightSampleRec.normal = glm::normalize(lightSampleRec.surfacePos - light.position);
+        }
+        lightSampleRec.emission = light.emission * float(view.numOfLights);
+    }
+
+    static glm::vec2 EnvUV(const glm::vec3& direction)
+    {
+        return glm::vec2((kPi + atan2f(direction.z, direction.x)) * (1.f / kTwoPi), acosf(glm::clamp(direction.y, -1.f, 1.f)) * (1.f / kPi));
+    }
+
+    static float EnvPdf(const SceneView& view, const Ray& r)
+    {
+        const HDRLoaderResult& hdr = view.scene->hdrLoaderRes;
+        glm::vec2 uv = EnvUV(r.direction);
+        float pdf = SampleNearest(hdr.conditionalDistData, hdr.width, hdr.height, uv).y * SampleNearest(hdr.marginalDistData, hdr.height, 1, glm::vec2(uv.y, 0.f)).y;
+        return (pdf * view.hdrResolution) / (2.f * kPi * kPi * sinf(uv.y * kPi));
+    }
+
+    static glm::vec4 EnvSample(const SceneView& view, glm::vec3& color, Random& rand)
+    {
+        const HDRLoaderResult& hdr = view.scene->hdrLoaderRes;
+        float r1 = rand();
+        float r2 = rand();
+
+        float v = SampleNearest(hdr.marginalDistData, hdr.height, 1, glm::vec2(r1, 0.f)).x;
+        float u = SampleNearest(hdr.conditionalDistData, hdr.width, hdr.height, glm::vec2(r2, v)).x;
+
+        color = SampleBilinear(hdr.cols, hdr.width, hdr.height, glm::vec2(u, v)) * view.hdrMultiplier;
+        float pdf = SampleNearest(hdr.conditionalDistData, hdr.width, hdr.height, glm::vec2(u, v)).y * SampleNearest(hdr.marginalDistData, hdr.height, 1, glm::vec2(v, 0.f)).y;
+
+        float phi = u * kTwoPi;
+        float theta = v * kPi;
+
+        if (sinf(theta) == 0.f)
+            pdf = 0.f;
+
+        return glm::vec4(-sinf(theta) * cosf(phi), cosf(theta), -sinf(theta) * sinf(phi), (pdf * view.hdrResolution) / (2.f * kPi * kPi * sinf(theta)));
+    }
+
+    static glm::vec3 DirectLight(const SceneView& view, const Ray& r, const State& state, Random& rand)
+    {
+        glm::vec3 L = glm::vec3(0.f);
+
+        glm::vec3 surfacePos = state.fhp + state.normal * kEps;
+
+        /* Environment Light */
+        if (view.useEnvMap)
+        {
+            glm::vec3 color;
+            glm::vec4 dirPdf = EnvSample(view, color, rand);
+            glm::vec3 lightDir = glm::vec3(dirPdf);
+            float lightPdf = dirPdf.w;
+
+            Ray shadowRay = { surfacePos, lightDir };
+            if (lightPdf > 0.f && !SceneIntersectShadow(view, shadowRay, kInfinity - kEps))
+            {
+                float bsdfPdf = UE4Pdf(r, state, lightDir);
+                glm::vec3 f = UE4Eval(r, state, lightDir);
+
+                float misWeight = powerHeuristic(lightPdf, bsdfPdf);
+                if (misWeight > 0.f)
+                    L += misWeight * f * fabsf(glm::dot(lightDir, state.normal)) * color / lightPdf;
+            }
+        }
+
+        /* Sample Analytic Lights */
+        if (view.numOfLights > 0)
+        {
+            LightSampleRec lightSampleRec;
+
+            //Pick a light to sample
+            int index = glm::min(int(rand() * float(view.numOfLights)), view.numOfLights - 1);
+            const LightData& light = view.scene->lightData[index];
+            sampleLight(view, light, lightSampleRec, rand);
+
+            glm::vec3 lightDir = lightSampleRec.surfacePos - surfacePos;
+            float lightDist = glm::length(lightDir);
+            float lightDistSq = lightDist * lightDist;
+            lightDir /= lightDist;
+
+            if (glm::dot(lightDir, state.normal) <= 0.f || glm::dot(lightDir, lightSampleRec.normal) >= 0.f)
+                return L;
+
+            Ray shadowRay = { surfacePos, lightDir };
+            if (!SceneIntersectShadow(view, shadowRay, lightDist - kEps))
+            {
+                float bsdfPdf = UE4Pdf(r, state, lightDir);
+                glm::vec3 f = UE4Eval(r, state, lightDir);
+                float lightPdf = lightDistSq / (light.radiusAreaType.y * fabsf(glm::dot(lightSampleRec.normal, lightDir)));
+
+                L += powerHeuristic(lightPdf, bsdfPdf) * f * fabsf(glm::dot(state.normal, lightDir)) * lightSampleRec.emission / lightPdf;
+            }
+        }
+
+        return L;
+    }
+
+    // state and lightSampleRec hold the primary hit at distance t, traced with the packet
+    static glm::vec3 PathTrace(const SceneView& view, Ray r, State state, LightSampleRec lightSampleRec, float t, Random& rand)
+    {
+        glm::vec3 radiance = glm::vec3(0.f);
+        glm::vec3 throughput = glm::vec3(1.f);
+        BsdfSampleRec bsdfSampleRec = { glm::vec3(0.f), 1.f };
+        state.specularBounce = false;
+
+        for (int depth = 0; depth < view.maxDepth; depth++)
+        {
+            state.depth = depth;
+            if (depth > 0)
+                t = SceneIntersect(view, r, state, lightSampleRec);
+
+            if (t >= kInfinity)
+            {
+                if (view.useEnvMap)
+                {
+                    float misWeight = 1.f;
+                    if (depth > 0 && !state.specularBounce)
+                        misWeight = powerHeuristic(bsdfSampleRec.pdf, EnvPdf(view, r));
+
+                    const HDRLoaderResult& hdr = view.scene->hdrLoaderRes;
+                    radiance += misWeight * SampleBilinear(hdr.cols, hdr.width, hdr.height, EnvUV(r.direction)) * throughput * view.hdrMultiplier;
+                }
+                break;
+            }
+
+            if (state.isEmitter)
+            {
+                if (state.depth == 0 || state.specularBounce)
+                    radiance += lightSampleRec.emission * throughput;
+                else
+                    radiance += powerHeuristic(bsdfSampleRec.pdf, lightSampleRec.pdf) * lightSampleRec.emission * throughput;
+                break;
+            }
+
+            GetNormalAndTexCoord(view, state, r);
+            GetMaterialsAndTextures(view, state, r);
+
+            radiance += glm::vec3(state.mat.emission) * throughput;
+
+            if (state.mat.albedo.w == 0.f) // UE4 Brdf
+            {
+                state.specularBounce = false;
+                if (depth < view.maxDepth - 1)
+                    radiance += DirectLight(view, r, state, rand) * throughput;
+
+                bsdfSampleRec.bsdfDir = UE4Sample(r, state, rand);
+                bsdfSampleRec.pdf = UE4Pdf(r, state, bsdfSampleRec.bsdfDir);
+
+                if (bsdfSampleRec.pdf > 0.f)
+                    throughput *= UE4Eval(r, state, bsdfSampleRec.bsdfDir) * fabsf(glm::dot(state.normal, bsdfSampleRec.bsdfDir)) / bsdfSampleRec.pdf;
+                else
+                    break;
+            }
+            else // Glass
+            {
+                state.specularBounce = true;
+
+                bsdfSampleRec.bsdfDir = GlassSample(r, state, rand);
+                bsdfSampleRec.pdf = 1.f;
+
+                throughput *= glm::vec3(state.mat.albedo);
+            }
+
+            r.direction = bsdfSampleRec.bsdfDir;
+            r.origin = state.fhp + r.direction * kEps;
+        }
+
+        return radiance;
+    }
+
+    void CPURenderer::init()
+    {
+        if (initialized)
+            return;
+
+        if (scene == nullptr || !scene->gpuBVH || !scene->gpuBVH->numNodes)
+        {
+            Log("Error: No Scene Found\n");
+            return;
+        }
+
+        // only the result is uploaded, the scene stays in memory
+        quad = new Quad();
+        numOfLights = int(scene->lightData.size());
+
+        outputShader = loadShaders(shadersDirectory + "OutputVert.glsl", shadersDirectory + "OutputFrag.glsl");
+        outputShader->use();
+        glUniform1i(glGetUniformLocation(outputShader->object(), "pathTraceTexture"), 0);
+        outputShader->stopUsing();
+
+        glGenTextures(1, &accumTexture);
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, screenSize.x, screenSize.y, 0, GL_RGBA, GL_FLOAT, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        const size_t pixelCount = size_t(screenSize.x) * screenSize.y;
+        accum.assign(pixelCount, glm::vec4(0.f));
+        accumMoment.assign(pixelCount, 0.f);
+
+        tileCountX = (screenSize.x + kTileSize - 1) / kTileSize;
+        tileCountY = (screenSize.y + kTileSize - 1) / kTileSize;
+        resetTiles();
+
+        initialized = true;
+    }
+
+    void CPURenderer::finish()
+    {
+        if (!initialized)
+            return;
+
+        cancelJob();
+        glDeleteTextures(1, &accumTexture);
+        delete outputShader;
+        delete quad;
+        accum.clear();
+        accumMoment.clear();
+
+        initialized = false;
+        Log("Renderer finished!\n");
+    }
+
+    void CPURenderer::resetTiles()
+    {
+        const size_t tileCount = size_t(tileCountX * tileCountY);
+        tileSamples.assign(tileCount, 0);
+        tileError.assign(tileCount, 1.f);
+        tileActive.assign(tileCount, 1);
+        convergedTileCount = 0;
+    }
+
+    void CPURenderer::setFrameBudget(float milliseconds, float noiseThreshold)
+    {
+        frameBudget = milliseconds;
+        this->noiseThreshold = noiseThreshold;
+    }
+
+    // 1 sample for every pixel of the tile, then the tile noise estimate. Tiles don't share pixels.
+    void CPURenderer::renderTile(int tileIndex)
+    {
+        SceneView view = { scene, numOfLights, maxDepth, scene->renderOptions.useEnvMap, float(scene->hdrLoaderRes.width * scene->hdrLoaderRes.height), scene->renderOptions.hdrMultiplier };
+        const PassCamera& camera = passCamera;
+        const glm::vec2 resolution(screenSize);
+        const float tanHalfFov = tanf(camera.fov / 2.f);
+
+        const int x0 = (tileIndex % tileCountX) * kTileSize;
+        const int y0 = (tileIndex / tileCountX) * kTileSize;
+        const int x1 = glm::min(x0 + kTileSize, screenSize.x);
+        const int y1 = glm::min(y0 + kTileSize, screenSize.y);
+
+        for (int y = y0; y < y1; y += 2)
+        {
+            for (int x = x0; x < x1; x += 2)
+            {
+                RayPacket packet;
+                Ray rays[kPacketSize];
+                State states[kPacketSize];
+                LightSampleRec lightSampleRecs[kPacketSize];
+                size_t pixels[kPacketSize];
+                bool valid[kPacketSize];
+
+                for (int lane = 0; lane < kPacketSize; lane++)
+                {
+                    const int px = x + (lane & 1);
+                    const int py = y + (lane >> 1);
+                    valid[lane] = px < x1 && py < y1;
+                    pixels[lane] = size_t(glm::min(py, y1 - 1)) * screenSize.x + glm::min(px, x1 - 1);
+
+                    // tent filtered jitter, as in the shader main
+                    Random rand(unsigned(pixels[lane]), unsigned(accum[pixels[lane]].w));
+                    float r1 = 2.f * rand();
+                    float r2 = 2.f * rand();
+                    glm::vec2 jitter;
+                    jitter.x = r1 < 1.f ? sqrtf(r1) - 1.f : 1.f - sqrtf(2.f - r1);
+                    jitter.y = r2 < 1.f ? sqrtf(r2) - 1.f : 1.f - sqrtf(2.f - r2);
+                    jitter /= (resolution * 0.5f);
+
+                    const glm::vec2 texCoords = (glm::vec2(float(px), float(py)) + 0.5f) / resolution;
+                    glm::vec2 d = (2.f * texCoords - 1.f) + jitter;
+                    d.x *= resolution.x / resolution.y * tanHalfFov;
+                    d.y *= tanHalfFov;
+                    rays[lane] = { camera.position, glm::normalize(d.x * camera.right + d.y * camera.up + camera.forward) };
+
+                    states[lane].triID = -1;
+                    states[lane].isEmitter = false;
+                    const float lightDist = LightsIntersect(view, rays[lane], states[lane], lightSampleRecs[lane]);
+
+                    packet.ox[lane] = rays[lane].origin.x;
+                    packet.oy[lane] = rays[lane].origin.y;
+                    packet.oz[lane] = rays[lane].origin.z;
+                    packet.dx[lane] = rays[lane].direction.x;
+                    packet.dy[lane] = rays[lane].direction.y;
+                    packet.dz[lane] = rays[lane].direction.z;
+                    packet.idx[lane] = 1.f / rays[lane].direction.x;
+                    packet.idy[lane] = 1.f / rays[lane].direction.y;
+                    packet.idz[lane] = 1.f / rays[lane].direction.z;
+                    packet.t[lane] = valid[lane] ? lightDist : -kInfinity;
+                    packet.u[lane] = packet.v[lane] = 0.f;
+                    packet.triID[lane] = -1;
+                }
+
+                PacketIntersect(scene, packet);
+
+                for (int lane = 0; lane < kPacketSize; lane++)
+                {
+                    if (!valid[lane])
+                        continue;
+
+                    State& state = states[lane];
+                    const float t = packet.t[lane];
+                    if (packet.triID[lane] >= 0)
+                    {
+                        state.isEmitter = false;
+                        state.triID = packet.triID[lane];
+                        state.bary = glm::vec3(1.f - packet.u[lane] - packet.v[lane], packet.u[lane], packet.v[lane]);
+                        state.fhp = rays[lane].origin + rays[lane].direction * t;
+                    }
+                    state.hitDist = t;
+
+                    glm::vec4& pixelAccum = accum[pixels[lane]];
+                    // different stream than the jitter one
+                    Random rand(unsigned(pixels[lane]) ^ 0x5bd1e995u, unsigned(pixelAccum.w));
+                    glm::vec3 pixelColor = PathTrace(view, rays[lane], state, lightSampleRecs[lane], t, rand);
+                    // a degenerate triangle or pdf would spoil the pixel for good
+                    if (!std::isfinite(pixelColor.x) || !std::isfinite(pixelColor.y) || !std::isfinite(pixelColor.z))
+                        pixelColor = glm::vec3(0.f);
+                    const float luminance = glm::dot(pixelColor, glm::vec3(0.3f, 0.6f, 0.1f));
+
+                    pixelAccum += glm::vec4(pixelColor, 1.f);
+                    accumMoment[pixels[lane]] += luminance * luminance;
+                }
+            }
+        }
+
+        // relative standard error of the mean luminance, every other pixel, as TileErrorFrag.glsl
+        float errorSum = 0.f;
+        float luminanceSum = 0.f;
+        for (int y = y0; y < y1; y += 2)
+        {
+            for (int x = x0; x < x1; x += 2)
+            {
+                const size_t pixel = size_t(y) * screenSize.x + x;
+                const float sampleCount = glm::max(accum[pixel].w, 1.f);
+                const float mean = glm::dot(glm::vec3(accum[pixel]), glm::vec3(0.3f, 0.6f, 0.1f)) / sampleCount;
+                const float variance = glm::max(accumMoment[pixel] / sampleCount - mean * mean, 0.f);
+                errorSum += sqrtf(variance / sampleCount);
+                luminanceSum += mean;
+            }
+        }
+        tileError[tileIndex] = errorSum / glm::max(luminanceSum, 0.001f * float(kTileSize * kTileSize / 4));
+        tileSamples[tileIndex]++;
+    }
+
+    // passes until the next one would go over the budget
+    void CPURenderer::renderPasses(const std::vector<int>& activeTiles)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        auto job = [this, &activeTiles](int index) {
+            if (!jobCancelled)
+                renderTile(activeTiles[index]);
+        };
+        for (int pass = 0; pass < kMaxPassesPerFrame && !jobCancelled; pass++)
+        {
+            if (parallelFor)
+                parallelFor(int(activeTiles.size()), job);
+            else
+            {
+                for (int i = 0; i < int(activeTiles.size()); i++)
+                    job(i);
+            }
+
+            const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+            passTime = elapsed / float(pass + 1);
+            if (frameBudget <= 0.f || elapsed + passTime > frameBudget)
+                break;
+        }
+    }
+
+    // waits for the passes in flight and drops them, the accumulation is about to be cleared
+    void CPURenderer::cancelJob()
+    {
+        if (!jobStarted)
+            return;
+        jobCancelled = true;
+        asyncJob.wait();
+        jobCancelled = false;
+        jobStarted = false;
+    }
+
+    void CPURenderer::render()
+    {
+        if (!initialized)
+        {
+            Log("CPU Renderer is not initialized\n");
+            return;
+        }
+
+        if (jobStarted)
+        {
+            // the worker is still tracing : the previous result stays on screen
+            if (!asyncJob.isDone())
+                return;
+            jobStarted = false;
+            finishPasses();
+        }
+
+        std::vector<int> activeTiles;
+        for (size_t i = 0; i < tileActive.size(); i++)
+        {
+            if (tileActive[i])
+                activeTiles.push_back(int(i));
+        }
+        if (activeTiles.empty())
+            return;
+
+        const Camera& camera = *scene->camera;
+        passCamera = { camera.position, camera.right, camera.up, camera.forward, camera.fov };
+        if (asyncJob.start)
+        {
+            jobStarted = true;
+            asyncJob.start([this, activeTiles]() { renderPasses(activeTiles); });
+            return;
+        }
+        renderPasses(activeTiles);
+        finishPasses();
+    }
+
+    // convergence and upload of the passes done, on the GL thread
+    void CPURenderer::finishPasses()
+    {
+        convergedTileCount = 0;
+        for (size_t i = 0; i < tileActive.size(); i++)
+        {
+            const bool converged = tileSamples[i] >= kMaxTileSamples || (tileSamples[i] >= kMinTileSamples && tileError[i] < noiseThreshold);
+            tileActive[i] = converged ? 0 : 1;
+            convergedTileCount += converged ? 1 : 0;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, screenSize.x, screenSize.y, GL_RGBA, GL_FLOAT, accum.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    float CPURenderer::getProgress() const
+    {
+        if (tileActive.empty())
+            return 0.f;
+        return float(convergedTileCount) / float(tileActive.size());
+    }
+
+    void CPURenderer::present() const
+    {
+        if (!initialized)
+            return;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        quad->Draw(outputShader);
+    }
+
+    void CPURenderer::update(float secondsElapsed)
+    {
+        if (!initialized)
+            return;
+
+        if (scene->camera->isMoving)
+        {
+            cancelJob();
+            std::fill(accum.begin(), accum.end(), glm::vec4(0.f));
+            std::fill(accumMoment.begin(), accumMoment.end(), 0.f);
+            resetTiles();
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Renderer.h"
+#include <vector>
+#include <atomic>
+#include <functional>
+
+namespace GLSLPathTracer
+{
+    // Path traces on the CPU with the scene GPU BVH and the shading of Progressive/PathTraceFrag.glsl.
+    // Tiles are spread with parallelFor, primary rays are traced as 2x2 pixel packets.
+    // The accumulation buffer has the progressive layout: sum of samples and sample count, sum of squared luminances.
+    // With an AsyncJob, passes run on a worker and render() only uploads the passes done since the last call.
+    class CPURenderer : public Renderer
+    {
+    public:
+        // one job at a time. start runs job on a worker thread, wait returns once it's done
+        struct AsyncJob
+        {
+            std::function<void(const std::function<void()>& job)> start;
+            std::function<bool()> isDone;
+            std::function<void()> wait;
+        };
+
+    private:
+        Program *outputShader;
+        GLuint accumTexture;
+        int maxDepth;
+        ParallelFor parallelFor;
+        std::vector<glm::vec4> accum;
+        std::vector<float> accumMoment;
+
+        // adaptive sampling, same tiles and convergence test as the progressive renderer
+        int tileCountX, tileCountY, convergedTileCount;
+        std::vector<int> tileSamples;
+        std::vector<float> tileError;
+        std::vector<unsigned char> tileActive;
+        float frameBudget, noiseThreshold, passTime;
+
+        // copy of the scene camera taken by render(), the application moves the scene one while passes run
+        struct PassCamera { glm::vec3 position, right, up, forward; float fov; } passCamera;
+
+        AsyncJob asyncJob;
+        bool jobStarted;
+        std::atomic<bool> jobCancelled;
+
+        void resetTiles();
+        void renderTile(int tileIndex);
+        void renderPasses(const std::vector<int>& activeTiles);
+        void finishPasses();
+        void cancelJob();
+
+    public:
+        CPURenderer(const Scene *scene, const std::string& shadersDirectory, const ParallelFor& parallelFor, const AsyncJob& asyncJob = AsyncJob()) : Renderer(scene, shadersDirectory)
+            , maxDepth(scene->renderOptions.maxDepth)
+            , parallelFor(parallelFor)
+            , frameBudget(0.f)
+            , noiseThreshold(0.01f)
+            , passTime(0.f)
+            , asyncJob(asyncJob)
+            , jobStarted(false)
+            , jobCancelled(false)
+        {
+        };
+        // the scene isn't uploaded, Renderer::finish must not run on the unused GL names
+        ~CPURenderer() { finish(); }
+
+        void init();
+        void finish();
+
+        void render();
+        void present() const;
+        void update(float secondsElapsed);
+        float getProgress() const;
+        void setFrameBudget(float milliseconds, float noiseThreshold);
+        RendererType getType() const { return Renderer_CPU; }
+    };
+}
@@ -52,9 +52,20 @@ namespace GLSLPathTracer
         createGPUBVH();
     }
 
+    GPUBVH::~GPUBVH()
+    {
+        delete[] gpuNodes;
+        if (bvh)
+        {
+            delete bvh->getScene();
+            delete bvh;
+        }
+    }
+
     void GPUBVH::createGPUBVH()
     {
-        gpuNodes = new GPUBVHNode[bvh->getNumNodes()];
+        numNodes = bvh->getNumNodes();
+        gpuNodes = new GPUBVHNode[numNodes];
         traverseBVH(bvh->getRoot());
     }
 }
\ No newline at end of file
@@ -22,10 +22,14 @@ namespace GLSLPathTracer
     {
     public:
         GPUBVH(const BVH *bvh);
+        // empty, filled by the scene cache
+        GPUBVH() : gpuNodes(nullptr), numNodes(0), bvh(nullptr) {}
+        ~GPUBVH();
         void createGPUBVH();
         int traverseBVH(BVHNode *root);
         GPUBVHNode *gpuNodes;
-        const BVH *bvh;
+        int numNodes;
+        const BVH *bvh; // null when loaded from cache
         std::vector<TriIndexData> bvhTriangleIndices;
     };
 }
\ No newline at end of file
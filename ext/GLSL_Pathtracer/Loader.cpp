@@ -31,6 +31,7 @@ freely, subject to the following restrictions:
 #include <iostream>
 #include <iterator>
 #include <algorithm>
+#include <map>
 #include <SOIL.h>
 #include "linear_math.h"
 #include "Scene.h"
@@ -44,6 +45,91 @@ namespace GLSLPathTracer
     static const int kMaxLineLength = 2048;
     int(*Log)(const char* szFormat, ...) = printf;
 
+    struct DecodedTexture
+    {
+        unsigned char *pixels;
+        int width, height;
+    };
+
+    static void RunJobs(const ParallelFor &parallelFor, int count, const std::function<void(int)>& job)
+    {
+        if (parallelFor)
+        {
+            parallelFor(count, job);
+            return;
+        }
+        for (int i = 0; i < count; i++)
+            job(i);
+    }
+
+    // bilinear, clamped to the edges. Copies when the sizes match.
+    static void ResizeRGB(const unsigned char *source, int sourceWidth, int sourceHeight, unsigned char *destination, int width, int height)
+    {
+        if (sourceWidth == width && sourceHeight == height)
+        {
+            memcpy(destination, source, size_t(width) * height * 3);
+            return;
+        }
+        const float scaleX = float(sourceWidth) / float(width);
+        const float scaleY = float(sourceHeight) / float(height);
+        for (int y = 0; y < height; y++)
+        {
+            const float sy = std::max((float(y) + 0.5f) * scaleY - 0.5f, 0.f);
+            const int y0 = std::min(int(sy), sourceHeight - 1);
+            const int y1 = std::min(y0 + 1, sourceHeight - 1);
+            const float fy = sy - float(y0);
+            for (int x = 0; x < width; x++)
+            {
+                const float sx = std::max((float(x) + 0.5f) * scaleX - 0.5f, 0.f);
+                const int x0 = std::min(int(sx), sourceWidth - 1);
+                const int x1 = std::min(x0 + 1, sourceWidth - 1);
+                const float fx = sx - float(x0);
+                const unsigned char *p00 = source + (size_t(y0) * sourceWidth + x0) * 3;
+                const unsigned char *p10 = source + (size_t(y0) * sourceWidth + x1) * 3;
+                const unsigned char *p01 = source + (size_t(y1) * sourceWidth + x0) * 3;
+                const unsigned char *p11 = source + (size_t(y1) * sourceWidth + x1) * 3;
+                unsigned char *texel = destination + (size_t(y) * width + x) * 3;
+                for (int c = 0; c < 3; c++)
+                {
+                    const float top = p00[c] + (p10[c] - p00[c]) * fx;
+                    const float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                    texel[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+                }
+            }
+        }
+    }
+
+    // one RGB layer per path, in the upload layout. Layers that failed to load are filled with a neutral value.
+    static unsigned char* PackTextureLayers(const std::vector<std::string>& paths, const std::map<std::string, DecodedTexture>& decodedTextures, const unsigned char fill[3], glm::ivec2& size, const ParallelFor &parallelFor)
+    {
+        size = glm::ivec2(0, 0);
+        for (auto& path : paths)
+        {
+            const DecodedTexture& decoded = decodedTextures.at(path);
+            if (decoded.pixels)
+                size = glm::max(size, glm::ivec2(decoded.width, decoded.height));
+        }
+        if (paths.empty())
+            return nullptr;
+        if (!size.x || !size.y)
+            size = glm::ivec2(1, 1);
+
+        const size_t layerSize = size_t(size.x) * size.y * 3;
+        unsigned char *layers = new unsigned char[layerSize * paths.size()];
+        RunJobs(parallelFor, int(paths.size()), [&](int index) {
+            const DecodedTexture& decoded = decodedTextures.at(paths[index]);
+            unsigned char *layer = layers + layerSize * index;
+            if (decoded.pixels)
+            {
+                ResizeRGB(decoded.pixels, decoded.width, decoded.height, layer, size.x, size.y);
+                return;
+            }
+            for (size_t i = 0; i < layerSize; i += 3)
+                memcpy(layer + i, fill, 3);
+        });
+        return layers;
+    }
+
     bool LoadModel(Scene *scene, const std::string &filename, float materialId)
     {
         tinyobj::attrib_t attrib;
@@ -130,7 +216,7 @@ namespace GLSLPathTracer
         return true;
     }
 
-    Scene* LoadScene(const std::string &filename)
+    Scene* LoadScene(const std::string &filename, const ParallelFor &parallelFor)
     {
         FILE* file;
         fopen_s(&file, filename.c_str(), "r");
@@ -160,6 +246,7 @@ namespace GLSLPathTracer
         //Defaults
         MaterialData defaultMat;
         Scene *scene = new Scene(filename);
+        scene->sourceFiles.push_back(filename);
         scene->materialData.push_back(defaultMat);
         materialCount++;
         Camera *defaultCamera = new Camera(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), 35.0f);
@@ -354,7 +441,8 @@ namespace GLSLPathTracer
                     if (strcmp(envMap, "None") != 0)
                     {
                         HDRLoader hdrLoader;
-                        hdrLoader.load(envMap, scene->hdrLoaderRes);
+                        hdrLoader.load(envMap, scene->hdrLoaderRes, parallelFor);
+                        scene->sourceFiles.push_back(envMap);
                         scene->renderOptions.useEnvMap = true;
                     }
                     scene->renderOptions.rendererType = std::string(rendererType);
@@ -399,6 +487,7 @@ namespace GLSLPathTracer
                 if (!meshPath.empty())
                 {
                     Log("Loading Model: %s\n", meshPath.c_str());
+                    scene->sourceFiles.push_back(meshPath);
                     if (!LoadModel(scene, meshPath, materialId))
                     {
                         return false;
@@ -410,49 +499,49 @@ namespace GLSLPathTracer
         if (!cameraAdded)
             scene->camera = defaultCamera;
 
-        //Load all textures 
-        //(Assume for now that all textures have same width and height as their group (albedo, metallic etc))
-        int width, height;
-
+        //Load all textures. Each file is decoded once on the worker threads, then packed into its group layers.
+        //Layers take the largest size of their group, smaller textures are resized.
         scene->texData.albedoTexCount = int(albedoTex.size());
         scene->texData.metallicRoughnessTexCount = int(metallicRoughnessTex.size());
         scene->texData.normalTexCount = int(normalTex.size());
+        scene->sourceFiles.insert(scene->sourceFiles.end(), albedoTex.begin(), albedoTex.end());
+        scene->sourceFiles.insert(scene->sourceFiles.end(), metallicRoughnessTex.begin(), metallicRoughnessTex.end());
+        scene->sourceFiles.insert(scene->sourceFiles.end(), normalTex.begin(), normalTex.end());
 
-        //Load albedo Textures
-        for (size_t i = 0; i < albedoTex.size(); i++)
+        std::map<std::string, DecodedTexture> decodedTextures;
+        for (auto textures : { &albedoTex, &metallicRoughnessTex, &normalTex })
         {
-            Log("Loading Texture: %s\n", albedoTex[i].c_str());
-            unsigned char * texture = SOIL_load_image(albedoTex[i].c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-            if (i == 0) // Alloc memory based on first texture size
-                scene->texData.albedoTextures = new unsigned char[width * height * 3 * albedoTex.size()];
-            memcpy(&(scene->texData.albedoTextures[width * height * 3 * i]), &texture[0], width * height * 3);
-            delete texture;
+            for (auto& path : *textures)
+                decodedTextures[path] = DecodedTexture{ nullptr, 0, 0 };
         }
-        scene->texData.albedoTextureSize = glm::vec2(width, height);
-
-        //Load MetallicRoughness textures
-        for (size_t i = 0; i < metallicRoughnessTex.size(); i++)
+        std::vector<std::pair<const std::string, DecodedTexture>*> decodeJobs;
+        for (auto& decoded : decodedTextures)
+        {
+            Log("Loading Texture: %s\n", decoded.first.c_str());
+            decodeJobs.push_back(&decoded);
+        }
+        RunJobs(parallelFor, int(decodeJobs.size()), [&decodeJobs](int index) {
+            DecodedTexture& decoded = decodeJobs[index]->second;
+            decoded.pixels = SOIL_load_image(decodeJobs[index]->first.c_str(), &decoded.width, &decoded.height, 0, SOIL_LOAD_RGB);
+        });
+        for (auto& decoded : decodedTextures)
         {
-            Log("Loading Texture: %s\n", metallicRoughnessTex[i].c_str());
-            unsigned char * texture = SOIL_load_image(metallicRoughnessTex[i].c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-            if (i == 0) // Alloc memory based on first texture size
-                scene->texData.metallicRoughnessTextures = new unsigned char[width * height * 3 * metallicRoughnessTex.size()];
-            memcpy(&(scene->texData.metallicRoughnessTextures[width * height * 3 * i]), &texture[0], width * height * 3);
-            delete texture;
+            if (!decoded.second.pixels)
+                Log("Unable to load texture %s\n", decoded.first.c_str());
         }
-        scene->texData.metallicRoughnessTextureSize = glm::vec2(width, height);
 
-        //Load normal textures
-        for (size_t i = 0; i < normalTex.size(); i++)
+        static const unsigned char albedoFill[3] = { 255, 255, 255 };
+        static const unsigned char metallicRoughnessFill[3] = { 0, 255, 0 };
+        static const unsigned char normalFill[3] = { 128, 128, 255 };
+        scene->texData.albedoTextures = PackTextureLayers(albedoTex, decodedTextures, albedoFill, scene->texData.albedoTextureSize, parallelFor);
+        scene->texData.metallicRoughnessTextures = PackTextureLayers(metallicRoughnessTex, decodedTextures, metallicRoughnessFill, scene->texData.metallicRoughnessTextureSize, parallelFor);
+        scene->texData.normalTextures = PackTextureLayers(normalTex, decodedTextures, normalFill, scene->texData.normalTextureSize, parallelFor);
+
+        for (auto& decoded : decodedTextures)
         {
-            Log("Loading Texture: %s\n", normalTex[i].c_str());
-            unsigned char * texture = SOIL_load_image(normalTex[i].c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-            if (i == 0) // Alloc memory based on first texture size
-                scene->texData.normalTextures = new unsigned char[width * height * 3 * normalTex.size()];
-            memcpy(&(scene->texData.normalTextures[width * height * 3 * i]), &texture[0], width * height * 3);
-            delete texture;
+            if (decoded.second.pixels)
+                SOIL_free_image_data(decoded.second.pixels);
         }
-        scene->texData.normalTextureSize = glm::vec2(width, height);
 
         return scene;
     }
@@ -1,13 +1,15 @@
 #pragma once
 
 #include <string>
+#include "ParallelFor.h"
 
 namespace GLSLPathTracer
 {
     class Scene;
 
     bool LoadModel(Scene *scene, const std::string &filename, float materialId);
-    Scene* LoadScene(const std::string &filename);
+    // parallelFor is used for texture decoding and the environment map tables. Jobs run on the calling thread when empty
+    Scene* LoadScene(const std::string &filename, const ParallelFor &parallelFor = ParallelFor());
     // logger function. might be set at init time
     extern int(*Log)(const char* szFormat, ...);
 }
\ No newline at end of file
@@ -1,9 +1,43 @@
 #include "Config.h"
 #include "ProgressiveRenderer.h"
 #include "Camera.h"
+#include <chrono>
+#include <string.h>
 
 namespace GLSLPathTracer
 {
+    static const int kTileSize = 64;
+    static const int kMinTileSamples = 16; // below, the variance estimate isn't reliable
+    static const int kMaxTileSamples = 4096;
+    static const int kMaxPassesPerFrame = 32;
+    static const int kErrorUpdateInterval = 4; // frames between tile error read backs
+
+    static GLuint CreateTexture(GLint internalFormat, GLenum format, int width, int height)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    static bool IsSoftwareRenderer()
+    {
+        const char *renderer = (const char*)glGetString(GL_RENDERER);
+        if (!renderer)
+            return false;
+        static const char *softwareRenderers[] = { "llvmpipe", "softpipe", "Software", "SwiftShader", "GDI Generic" };
+        for (auto name : softwareRenderers)
+        {
+            if (strstr(renderer, name))
+                return true;
+        }
+        return false;
+    }
+
     void ProgressiveRenderer::init()
     {
         if (initialized)
@@ -25,6 +59,7 @@ namespace GLSLPathTracer
         accumShader = loadShaders(shadersDirectory + "AccumVert.glsl", shadersDirectory + "AccumFrag.glsl");
         outputShader = loadShaders(shadersDirectory + "OutputVert.glsl", shadersDirectory + "OutputFrag.glsl");
         outputFadeShader = loadShaders(shadersDirectory + "OutputFadeVert.glsl", shadersDirectory + "OutputFadeFrag.glsl");
+        tileErrorShader = loadShaders(shadersDirectory + "TileErrorVert.glsl", shadersDirectory + "TileErrorFrag.glsl");
 
         //----------------------------------------------------------
         // FBO Setup
@@ -33,14 +68,13 @@ namespace GLSLPathTracer
         glGenFramebuffers(1, &pathTraceFBO);
         glBindFramebuffer(GL_FRAMEBUFFER, pathTraceFBO);
 
-        //Create Texture for FBO
-        glGenTextures(1, &pathTraceTexture);
-        glBindTexture(GL_TEXTURE_2D, pathTraceTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, screenSize.x, screenSize.y, 0, GL_RGB, GL_FLOAT, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        //Create Textures for FBO. Sum of samples and sample count, sum of squared luminances
+        const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        pathTraceTexture = CreateTexture(GL_RGBA32F, GL_RGBA, screenSize.x, screenSize.y);
+        pathTraceMomentTexture = CreateTexture(GL_R32F, GL_RED, screenSize.x, screenSize.y);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pathTraceTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, pathTraceMomentTexture, 0);
+        glDrawBuffers(2, drawBuffers);
 
         //Create Half Res FBOs for path trace shader
         glGenFramebuffers(1, &pathTraceFBOHalf);
@@ -49,7 +83,7 @@ namespace GLSLPathTracer
         //Create Half Res Texture for FBO
         glGenTextures(1, &pathTraceTextureHalf);
         glBindTexture(GL_TEXTURE_2D, pathTraceTextureHalf);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, screenSize.x / 2, screenSize.y / 2, 0, GL_RGB, GL_FLOAT, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, screenSize.x / 2, screenSize.y / 2, 0, GL_RGBA, GL_FLOAT, 0);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glBindTexture(GL_TEXTURE_2D, 0);
@@ -59,14 +93,28 @@ namespace GLSLPathTracer
         glGenFramebuffers(1, &accumFBO);
         glBindFramebuffer(GL_FRAMEBUFFER, accumFBO);
 
-        //Create Texture for FBO
-        glGenTextures(1, &accumTexture);
-        glBindTexture(GL_TEXTURE_2D, accumTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, screenSize.x, screenSize.y, 0, GL_RGB, GL_FLOAT, 0);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        //Create Textures for FBO
+        accumTexture = CreateTexture(GL_RGBA32F, GL_RGBA, screenSize.x, screenSize.y);
+        accumMomentTexture = CreateTexture(GL_R32F, GL_RED, screenSize.x, screenSize.y);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, accumMomentTexture, 0);
+        glDrawBuffers(2, drawBuffers);
+
+        //Create FBO for the noise estimate, 1 texel per tile
+        tileCountX = (screenSize.x + kTileSize - 1) / kTileSize;
+        tileCountY = (screenSize.y + kTileSize - 1) / kTileSize;
+        glGenFramebuffers(1, &tileErrorFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, tileErrorFBO);
+        tileErrorTexture = CreateTexture(GL_R32F, GL_RED, tileCountX, tileCountY);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tileErrorTexture, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        resetTiles();
+
+        glGenQueries(timerQueryCount, timerQueries);
+        for (int i = 0; i < timerQueryCount; i++)
+            timerQueryPending[i] = false;
+        timerQueryIndex = 0;
+        softwareGL = IsSoftwareRenderer();
 
         GLuint shaderObject;
 
@@ -93,8 +141,38 @@ namespace GLSLPathTracer
         glUniform1i(glGetUniformLocation(shaderObject, "hdrTexture"), 10);
         glUniform1i(glGetUniformLocation(shaderObject, "hdrMarginalDistTexture"), 11);
         glUniform1i(glGetUniformLocation(shaderObject, "hdrCondDistTexture"), 12);
+        glUniform1i(glGetUniformLocation(shaderObject, "accumMomentTexture"), 13);
 
         pathTraceShader->stopUsing();
+
+        accumShader->use();
+        shaderObject = accumShader->object();
+        glUniform1i(glGetUniformLocation(shaderObject, "pathTraceTexture"), 0);
+        glUniform1i(glGetUniformLocation(shaderObject, "pathTraceMomentTexture"), 14);
+        accumShader->stopUsing();
+
+        tileErrorShader->use();
+        shaderObject = tileErrorShader->object();
+        glUniform1i(glGetUniformLocation(shaderObject, "accumTexture"), 0);
+        glUniform1i(glGetUniformLocation(shaderObject, "accumMomentTexture"), 13);
+        glUniform1i(glGetUniformLocation(shaderObject, "tileSize"), kTileSize);
+        tileErrorShader->stopUsing();
+    }
+
+    void ProgressiveRenderer::resetTiles()
+    {
+        const size_t tileCount = size_t(tileCountX * tileCountY);
+        tileSamples.assign(tileCount, 0);
+        tileError.assign(tileCount, 1.f);
+        tileActive.assign(tileCount, 1);
+        convergedTileCount = 0;
+        framesSinceErrorUpdate = 0;
+    }
+
+    void ProgressiveRenderer::setFrameBudget(float milliseconds, float noiseThreshold)
+    {
+        frameBudget = milliseconds;
+        this->noiseThreshold = noiseThreshold;
     }
 
     void ProgressiveRenderer::finish()
@@ -106,14 +184,22 @@ namespace GLSLPathTracer
         glDeleteFramebuffers(1, &pathTraceFBOHalf);
         glDeleteFramebuffers(1, &accumFBO);
 
+        glDeleteFramebuffers(1, &tileErrorFBO);
+
         glDeleteTextures(1, &pathTraceTexture);
         glDeleteTextures(1, &pathTraceTextureHalf);
         glDeleteTextures(1, &accumTexture);
+        glDeleteTextures(1, &pathTraceMomentTexture);
+        glDeleteTextures(1, &accumMomentTexture);
+        glDeleteTextures(1, &tileErrorTexture);
+
+        glDeleteQueries(timerQueryCount, timerQueries);
 
         delete pathTraceShader;
         delete accumShader;
         delete outputShader;
         delete outputFadeShader;
+        delete tileErrorShader;
 
         Renderer::finish();
     }
@@ -152,6 +238,8 @@ namespace GLSLPathTracer
         glBindTexture(GL_TEXTURE_1D, hdrMarginalDistTexture);
         glActiveTexture(GL_TEXTURE12);
         glBindTexture(GL_TEXTURE_2D, hdrConditionalDistTexture);
+        glActiveTexture(GL_TEXTURE13);
+        glBindTexture(GL_TEXTURE_2D, accumMomentTexture);
 
         if (lowRes)
         {
@@ -166,21 +254,142 @@ namespace GLSLPathTracer
         }
         else
         {
-            //---------------------------------------------------------
-            // Pass 1: Path trace to full-res texture
-            //---------------------------------------------------------
-            glBindFramebuffer(GL_FRAMEBUFFER, pathTraceFBO);
-            glViewport(0, 0, screenSize.x, screenSize.y);
-            quad->Draw(pathTraceShader);
+            readTimerQueries();
+
+            // the query slot is still in flight when the GPU is more than timerQueryCount frames late
+            const bool timed = !softwareGL && !timerQueryPending[timerQueryIndex];
+            if (timed)
+                glBeginQuery(GL_TIME_ELAPSED, timerQueries[timerQueryIndex]);
+            auto startTime = std::chrono::high_resolution_clock::now();
+
+            const int passCount = getPassCount();
+            const size_t tileCount = tileActive.size();
+            const bool allActive = convergedTileCount == 0;
+            int tilePasses = 0;
+            for (int pass = 0; pass < passCount; pass++)
+            {
+                pathTraceShader->use();
+                glUniform3f(glGetUniformLocation(pathTraceShader->object(), "randomVector"), float(rand()) / RAND_MAX, float(rand()) / RAND_MAX, float(rand()) / RAND_MAX);
+                pathTraceShader->stopUsing();
+
+                //---------------------------------------------------------
+                // Pass 1: Path trace to full-res texture, only the tiles not converged yet
+                //---------------------------------------------------------
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, accumTexture);
+                glActiveTexture(GL_TEXTURE13);
+                glBindTexture(GL_TEXTURE_2D, accumMomentTexture);
+                glBindFramebuffer(GL_FRAMEBUFFER, pathTraceFBO);
+                glViewport(0, 0, screenSize.x, screenSize.y);
+                if (allActive)
+                {
+                    quad->Draw(pathTraceShader);
+                }
+                else
+                {
+                    glEnable(GL_SCISSOR_TEST);
+                    for (size_t i = 0; i < tileCount; i++)
+                    {
+                        if (!tileActive[i])
+                            continue;
+                        glScissor(int(i % tileCountX) * kTileSize, int(i / tileCountX) * kTileSize, kTileSize, kTileSize);
+                        quad->Draw(pathTraceShader);
+                    }
+                    glDisable(GL_SCISSOR_TEST);
+                }
+
+                //----------------------------------------------------------
+                // Pass 2: Accumulation buffer
+                //---------------------------------------------------------
+                glBindFramebuffer(GL_FRAMEBUFFER, accumFBO);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, pathTraceTexture);
+                glActiveTexture(GL_TEXTURE14);
+                glBindTexture(GL_TEXTURE_2D, pathTraceMomentTexture);
+                quad->Draw(accumShader);
+
+                for (size_t i = 0; i < tileCount; i++)
+                {
+                    if (tileActive[i])
+                    {
+                        tileSamples[i]++;
+                        tilePasses++;
+                    }
+                }
+                sampleCounter += 1;
+            }
 
-            //----------------------------------------------------------
-            // Pass 2: Accumulation buffer
-            //---------------------------------------------------------
-            glBindFramebuffer(GL_FRAMEBUFFER, accumFBO);
-            glViewport(0, 0, screenSize.x, screenSize.y);
+            if (timed)
+            {
+                glEndQuery(GL_TIME_ELAPSED);
+                timerQueryPending[timerQueryIndex] = true;
+                timerQueryTilePasses[timerQueryIndex] = tilePasses;
+                timerQueryIndex = (timerQueryIndex + 1) % timerQueryCount;
+            }
+            else if (softwareGL)
+            {
+                glFinish();
+                const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+                const float passTime = elapsed / float(tilePasses);
+                tilePassTime = (tilePassTime > 0.f) ? glm::mix(tilePassTime, passTime, 0.5f) : passTime;
+            }
+
+            if (++framesSinceErrorUpdate >= kErrorUpdateInterval)
+                updateTileError();
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, pathTraceTexture);
-            quad->Draw(accumShader);
+        }
+    }
+
+    void ProgressiveRenderer::readTimerQueries()
+    {
+        // results are read when available, never waited for
+        for (int i = 0; i < timerQueryCount; i++)
+        {
+            if (!timerQueryPending[i])
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(timerQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timerQueries[i], GL_QUERY_RESULT, &nanoseconds);
+            timerQueryPending[i] = false;
+            if (!timerQueryTilePasses[i])
+                continue;
+            const float passTime = float(double(nanoseconds) / 1000000.0) / float(timerQueryTilePasses[i]);
+            tilePassTime = (tilePassTime > 0.f) ? glm::mix(tilePassTime, passTime, 0.5f) : passTime;
+        }
+    }
+
+    int ProgressiveRenderer::getPassCount() const
+    {
+        const int activeTileCount = int(tileActive.size()) - convergedTileCount;
+        if (frameBudget <= 0.f || tilePassTime <= 0.f || !activeTileCount)
+            return 1;
+        const int passCount = int(frameBudget / (tilePassTime * float(activeTileCount)));
+        return glm::clamp(passCount, 1, kMaxPassesPerFrame);
+    }
+
+    void ProgressiveRenderer::updateTileError()
+    {
+        framesSinceErrorUpdate = 0;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, tileErrorFBO);
+        glViewport(0, 0, tileCountX, tileCountY);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        glActiveTexture(GL_TEXTURE13);
+        glBindTexture(GL_TEXTURE_2D, accumMomentTexture);
+        quad->Draw(tileErrorShader);
+        // small read back, a few frames apart
+        glReadPixels(0, 0, tileCountX, tileCountY, GL_RED, GL_FLOAT, tileError.data());
+
+        convergedTileCount = 0;
+        for (size_t i = 0; i < tileActive.size(); i++)
+        {
+            const bool converged = tileSamples[i] >= kMaxTileSamples || (tileSamples[i] >= kMinTileSamples && tileError[i] < noiseThreshold);
+            tileActive[i] = converged ? 0 : 1;
+            convergedTileCount += converged ? 1 : 0;
         }
     }
 
@@ -188,7 +397,7 @@ namespace GLSLPathTracer
     {
         if (lowRes || fadeIn)
             return 0.f;
-        return 1.f;
+        return float(convergedTileCount) / float(tileActive.size());
     }
 
     void ProgressiveRenderer::present() const
@@ -226,15 +435,13 @@ namespace GLSLPathTracer
         if (!initialized)
             return;
 
-        float r1, r2, r3;
-        r1 = r2 = r3 = 0;
-
         if (scene->camera->isMoving)
         {
             lowRes = true;
             lowResTimer = 0;
             fadeTimer = 0;
             sampleCounter = 1;
+            resetTiles();
 
         }
         else if (lowResTimer < 1.0)
@@ -249,10 +456,9 @@ namespace GLSLPathTracer
                 glBindFramebuffer(GL_FRAMEBUFFER, accumFBO);
                 glClear(GL_COLOR_BUFFER_BIT);
                 glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                resetTiles();
             }
             lowRes = false;
-            sampleCounter += 1;
-            r1 = ((float)rand() / (RAND_MAX)), r2 = ((float)rand() / (RAND_MAX)), r3 = ((float)rand() / (RAND_MAX));
         }
 
         if (!lowRes && fadeTimer < timeToFade)
@@ -274,23 +480,17 @@ namespace GLSLPathTracer
         glUniform1f(glGetUniformLocation(shaderObject, "camera.fov"), scene->camera->fov);
         glUniform1f(glGetUniformLocation(shaderObject, "camera.focalDist"), scene->camera->focalDist);
         glUniform1f(glGetUniformLocation(shaderObject, "camera.aperture"), scene->camera->aperture);
-        glUniform3fv(glGetUniformLocation(shaderObject, "randomVector"), 1, glm::value_ptr(glm::vec3(r1, r2, r3)));
+        glUniform3fv(glGetUniformLocation(shaderObject, "randomVector"), 1, glm::value_ptr(glm::vec3(0.f)));
         glUniform1i(glGetUniformLocation(shaderObject, "sampleCounter"), int(sampleCounter));
         glUniform1i(glGetUniformLocation(shaderObject, "maxDepth"), lowRes ? 2 : maxDepth);
         glUniform1i(glGetUniformLocation(shaderObject, "isCameraMoving"), scene->camera->isMoving);
         glUniform2f(glGetUniformLocation(shaderObject, "screenResolution"), float(screenSize.x), float(screenSize.y));
         pathTraceShader->stopUsing();
 
-        outputShader->use();
-        shaderObject = outputShader->object();
-        glUniform1f(glGetUniformLocation(shaderObject, "invSampleCounter"), lowRes ? 1.0f : (1.0f / sampleCounter));
-        outputShader->stopUsing();
-
         outputFadeShader->use();
         shaderObject = outputFadeShader->object();
         glUniform1i(glGetUniformLocation(shaderObject, "pathTraceTextureHalf"), 0);
         glUniform1i(glGetUniformLocation(shaderObject, "pathTraceTexture"), 1);
-        glUniform1f(glGetUniformLocation(shaderObject, "invSampleCounter"), 1.0f / sampleCounter);
         glUniform1f(glGetUniformLocation(shaderObject, "fadeAmt"), glm::min(fadeTimer / timeToFade, 1.0f));
         outputFadeShader->stopUsing();
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Renderer.h"
+#include <vector>
 
 namespace GLSLPathTracer
 {
@@ -14,12 +15,39 @@ namespace GLSLPathTracer
         float sampleCounter, timeToFade, fadeTimer, lowResTimer;
         bool lowRes, fadeIn;
 
+        // adaptive sampling. Accumulation alpha holds the sample count, moment textures the sum of squared luminances.
+        // Tiles whose relative noise is under the threshold stop receiving samples.
+        GLuint pathTraceMomentTexture, accumMomentTexture;
+        GLuint tileErrorFBO, tileErrorTexture;
+        Program *tileErrorShader;
+        int tileCountX, tileCountY, convergedTileCount, framesSinceErrorUpdate;
+        std::vector<int> tileSamples;
+        std::vector<float> tileError;
+        std::vector<unsigned char> tileActive;
+
+        // time budget. GPU time is measured with timer queries read back a few frames later, wall time under software GL.
+        static const int timerQueryCount = 3;
+        GLuint timerQueries[timerQueryCount];
+        int timerQueryTilePasses[timerQueryCount];
+        bool timerQueryPending[timerQueryCount];
+        int timerQueryIndex;
+        bool softwareGL;
+        float frameBudget, noiseThreshold, tilePassTime;
+
+        void resetTiles();
+        void readTimerQueries();
+        void updateTileError();
+        int getPassCount() const;
+
     public:
         ProgressiveRenderer(const Scene *scene, const std::string& shadersDirectory) : Renderer(scene, shadersDirectory)
             , maxDepth(scene->renderOptions.maxDepth)
+            , frameBudget(0.f)
+            , noiseThreshold(0.01f)
+            , tilePassTime(0.f)
         {
         };
-        
+
         void init();
         void finish();
 
@@ -27,6 +55,7 @@ namespace GLSLPathTracer
         void present() const;
         void update(float secondsElapsed);
         float getProgress() const;
+        void setFrameBudget(float milliseconds, float noiseThreshold);
         RendererType getType() const { return Renderer_Progressive; }
     };
-}
\ No newline at end of file
+}
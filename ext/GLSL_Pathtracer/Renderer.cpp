@@ -56,7 +56,7 @@ namespace GLSLPathTracer
         //Create Texture for BVH Tree
         glGenBuffers(1, &BVHBuffer);
         glBindBuffer(GL_TEXTURE_BUFFER, BVHBuffer);
-        glBufferData(GL_TEXTURE_BUFFER, sizeof(GPUBVHNode) * scene->gpuBVH->bvh->getNumNodes(), &scene->gpuBVH->gpuNodes[0], GL_STATIC_DRAW);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(GPUBVHNode) * scene->gpuBVH->numNodes, &scene->gpuBVH->gpuNodes[0], GL_STATIC_DRAW);
         glGenTextures(1, &BVHTexture);
         glBindTexture(GL_TEXTURE_BUFFER, BVHTexture);
         glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, BVHBuffer);
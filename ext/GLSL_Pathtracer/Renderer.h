@@ -15,6 +15,7 @@ namespace GLSLPathTracer
     {
         Renderer_Progressive,
         Renderer_Tiled,
+        Renderer_CPU,
     };
     class Renderer
     {
@@ -56,6 +57,9 @@ namespace GLSLPathTracer
         virtual void update(float secondsElapsed) = 0;
         // range is [0..1]
         virtual float getProgress() const = 0;
+        // GPU time spent per render call and relative noise at which a tile stops receiving samples.
+        // 0 milliseconds renders a single pass per call.
+        virtual void setFrameBudget(float milliseconds, float noiseThreshold) {}
         // used for UI
         virtual RendererType getType() const = 0;
     };
@@ -15,8 +15,14 @@ namespace GLSLPathTracer
     {
         delete camera;
         delete gpuBVH;
+        delete[] texData.albedoTextures;
+        delete[] texData.metallicRoughnessTextures;
+        delete[] texData.normalTextures;
+        delete[] hdrLoaderRes.cols;
+        delete[] hdrLoaderRes.marginalDistData;
+        delete[] hdrLoaderRes.conditionalDistData;
     }
-    void Scene::buildBVH()
+    void Scene::buildBVH(const BVH::BuildParams& params)
     {
         Array<GPUScene::Triangle> tris;
         Array<Vec3f> verts;
@@ -42,12 +48,10 @@ namespace GLSLPathTracer
         std::cout << "Building a new GPU Scene\n";
         GPUScene* gpuScene = new GPUScene(triCount, verCount, tris, verts);
 
-        std::cout << "Building BVH with spatial splits\n";
+        std::cout << (params.binned ? "Building binned SAH BVH\n" : "Building BVH with spatial splits\n");
         // create a default platform
         Platform defaultplatform;
-        BVH::BuildParams defaultparams;
-        BVH::Stats stats;
-        BVH *myBVH = new BVH(gpuScene, defaultplatform, defaultparams);
+        BVH *myBVH = new BVH(gpuScene, defaultplatform, params);
 
         std::cout << "Building GPU-BVH\n";
         gpuBVH = new GPUBVH(myBVH);
@@ -43,6 +43,14 @@ namespace GLSLPathTracer
 
     struct TexData
     {
+        TexData() : albedoTextures(nullptr)
+            , metallicRoughnessTextures(nullptr)
+            , normalTextures(nullptr)
+            , albedoTexCount(0)
+            , metallicRoughnessTexCount(0)
+            , normalTexCount(0)
+        {
+        }
         unsigned char* albedoTextures;
         unsigned char* metallicRoughnessTextures;
         unsigned char* normalTextures;
@@ -107,7 +115,8 @@ namespace GLSLPathTracer
         TexData texData;
         RenderOptions renderOptions;
         HDRLoaderResult hdrLoaderRes;
-        void buildBVH();
+        std::vector<std::string> sourceFiles; // scene, meshes, textures and environment map, used to validate the cache
+        void buildBVH(const BVH::BuildParams& params = BVH::BuildParams());
         const std::string& getSceneName() const { return filename; }
     protected:
         std::string filename;
@@ -0,0 +1,317 @@
+#include "SceneCache.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "Scene.h"
+#include "Camera.h"
+#include "Loader.h"
+
+namespace GLSLPathTracer
+{
+    static const uint32_t kCacheMagic = 0x43534D49; // 'IMSC'
+    static const uint32_t kCacheVersion = 1;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t buildKey;
+        // record sizes, a layout change invalidates the cache
+        uint32_t recordSizes[7];
+    };
+
+    static CacheHeader MakeHeader(unsigned int buildKey)
+    {
+        CacheHeader header = { kCacheMagic, kCacheVersion, buildKey, {
+            uint32_t(sizeof(TriangleData)), uint32_t(sizeof(NormalTexData)), uint32_t(sizeof(VertexData)),
+            uint32_t(sizeof(MaterialData)), uint32_t(sizeof(LightData)), uint32_t(sizeof(GPUBVHNode)),
+            uint32_t(sizeof(TriIndexData)) } };
+        return header;
+    }
+
+    static int64_t GetModificationTime(const std::string& filename)
+    {
+        struct stat fileStat;
+        if (stat(filename.c_str(), &fileStat) != 0)
+            return -1;
+        return int64_t(fileStat.st_mtime);
+    }
+
+    struct CacheWriter
+    {
+        FILE *fp;
+
+        template<typename T> bool Write(const T& value)
+        {
+            return fwrite(&value, sizeof(T), 1, fp) == 1;
+        }
+        template<typename T> bool WriteArray(const T* data, size_t count)
+        {
+            if (!Write(uint64_t(count)))
+                return false;
+            return !count || fwrite(data, sizeof(T), count, fp) == count;
+        }
+        template<typename T> bool WriteVector(const std::vector<T>& data)
+        {
+            return WriteArray(data.data(), data.size());
+        }
+        bool WriteString(const std::string& str)
+        {
+            return WriteArray(str.c_str(), str.size());
+        }
+    };
+
+    // arrays are read in a single call straight into their final storage
+    struct CacheReader
+    {
+        FILE *fp;
+        uint64_t remaining;
+
+        bool ReadBytes(void *data, uint64_t size)
+        {
+            if (size > remaining)
+                return false;
+            remaining -= size;
+            return !size || fread(data, size_t(size), 1, fp) == 1;
+        }
+        template<typename T> bool Read(T& value)
+        {
+            return ReadBytes(&value, sizeof(T));
+        }
+        template<typename T> bool ReadCount(uint64_t& count)
+        {
+            // a corrupted count can't be bigger than what's left in the file
+            return Read(count) && count <= remaining / sizeof(T);
+        }
+        template<typename T> bool ReadVector(std::vector<T>& data)
+        {
+            uint64_t count;
+            if (!ReadCount<T>(count))
+                return false;
+            data.resize(size_t(count));
+            return ReadBytes(data.data(), count * sizeof(T));
+        }
+        // expectedCount is checked against the stored count
+        template<typename T> bool ReadArray(T*& data, uint64_t expectedCount)
+        {
+            uint64_t count;
+            if (!ReadCount<T>(count) || count != expectedCount)
+                return false;
+            data = count ? new T[size_t(count)] : nullptr;
+            return ReadBytes(data, count * sizeof(T));
+        }
+        bool ReadString(std::string& str)
+        {
+            uint64_t count;
+            if (!ReadCount<char>(count))
+                return false;
+            str.resize(size_t(count));
+            return ReadBytes(&str[0], count);
+        }
+    };
+
+    static uint64_t TextureByteCount(int count, const glm::ivec2& size)
+    {
+        if (count <= 0)
+            return 0;
+        return uint64_t(size.x) * uint64_t(size.y) * 3 * uint64_t(count);
+    }
+
+    std::string GetSceneCachePath(const std::string &filename, unsigned int buildKey)
+    {
+        return filename + ".bvh" + std::to_string(buildKey) + ".cache";
+    }
+
+    static bool ReadScene(CacheReader& reader, Scene *scene, unsigned int buildKey)
+    {
+        CacheHeader header, expected = MakeHeader(buildKey);
+        if (!reader.Read(header) || memcmp(&header, &expected, sizeof(CacheHeader)))
+            return false;
+
+        // every file used by the load must be unchanged
+        uint32_t sourceCount;
+        if (!reader.Read(sourceCount))
+            return false;
+        for (uint32_t i = 0; i < sourceCount; i++)
+        {
+            std::string sourceFile;
+            int64_t modificationTime;
+            if (!reader.ReadString(sourceFile) || !reader.Read(modificationTime))
+                return false;
+            if (modificationTime != GetModificationTime(sourceFile))
+                return false;
+            scene->sourceFiles.push_back(sourceFile);
+        }
+
+        if (!reader.ReadVector(scene->triangleIndices) ||
+            !reader.ReadVector(scene->normalTexData) ||
+            !reader.ReadVector(scene->vertexData) ||
+            !reader.ReadVector(scene->materialData) ||
+            !reader.ReadVector(scene->lightData))
+            return false;
+
+        // camera
+        glm::vec3 position, worldUp;
+        float pitch, yaw, fov, focalDist, aperture;
+        if (!reader.Read(position) || !reader.Read(worldUp) || !reader.Read(pitch) || !reader.Read(yaw) ||
+            !reader.Read(fov) || !reader.Read(focalDist) || !reader.Read(aperture))
+            return false;
+        scene->camera = new Camera(glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), 35.0f);
+        scene->camera->position = position;
+        scene->camera->worldUp = worldUp;
+        scene->camera->pitch = pitch;
+        scene->camera->yaw = yaw;
+        scene->camera->fov = fov;
+        scene->camera->focalDist = focalDist;
+        scene->camera->aperture = aperture;
+        scene->camera->updateCamera();
+
+        // render options
+        RenderOptions& options = scene->renderOptions;
+        uint8_t useEnvMap;
+        if (!reader.ReadString(options.rendererType) || !reader.Read(options.resolution) || !reader.Read(options.maxSamples) ||
+            !reader.Read(options.maxDepth) || !reader.Read(options.numTilesX) || !reader.Read(options.numTilesY) ||
+            !reader.Read(useEnvMap) || !reader.Read(options.hdrMultiplier))
+            return false;
+        options.useEnvMap = useEnvMap != 0;
+
+        // textures
+        TexData& texData = scene->texData;
+        if (!reader.Read(texData.albedoTexCount) || !reader.Read(texData.metallicRoughnessTexCount) || !reader.Read(texData.normalTexCount) ||
+            !reader.Read(texData.albedoTextureSize) || !reader.Read(texData.metallicRoughnessTextureSize) || !reader.Read(texData.normalTextureSize))
+            return false;
+        if (!reader.ReadArray(texData.albedoTextures, TextureByteCount(texData.albedoTexCount, texData.albedoTextureSize)) ||
+            !reader.ReadArray(texData.metallicRoughnessTextures, TextureByteCount(texData.metallicRoughnessTexCount, texData.metallicRoughnessTextureSize)) ||
+            !reader.ReadArray(texData.normalTextures, TextureByteCount(texData.normalTexCount, texData.normalTextureSize)))
+            return false;
+
+        // environment map and its sampling distributions
+        if (options.useEnvMap)
+        {
+            HDRLoaderResult& hdr = scene->hdrLoaderRes;
+            if (!reader.Read(hdr.width) || !reader.Read(hdr.height) || hdr.width <= 0 || hdr.height <= 0)
+                return false;
+            const uint64_t pixelCount = uint64_t(hdr.width) * uint64_t(hdr.height);
+            if (!reader.ReadArray(hdr.cols, pixelCount * 3) ||
+                !reader.ReadArray(hdr.marginalDistData, uint64_t(hdr.height)) ||
+                !reader.ReadArray(hdr.conditionalDistData, pixelCount))
+                return false;
+        }
+
+        // GPU BVH
+        GPUBVH *gpuBVH = new GPUBVH();
+        scene->gpuBVH = gpuBVH;
+        uint64_t nodeCount;
+        if (!reader.ReadCount<GPUBVHNode>(nodeCount) || !nodeCount)
+            return false;
+        gpuBVH->numNodes = int(nodeCount);
+        gpuBVH->gpuNodes = new GPUBVHNode[size_t(nodeCount)];
+        if (!reader.ReadBytes(gpuBVH->gpuNodes, nodeCount * sizeof(GPUBVHNode)) ||
+            !reader.ReadVector(gpuBVH->bvhTriangleIndices))
+            return false;
+
+        uint32_t endMagic;
+        return reader.Read(endMagic) && endMagic == kCacheMagic && !reader.remaining;
+    }
+
+    Scene* LoadSceneCache(const std::string &filename, unsigned int buildKey)
+    {
+        const std::string cachePath = GetSceneCachePath(filename, buildKey);
+        FILE *fp = fopen(cachePath.c_str(), "rb");
+        if (!fp)
+            return nullptr;
+
+        fseek(fp, 0, SEEK_END);
+        const long fileSize = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        CacheReader reader = { fp, uint64_t(fileSize > 0 ? fileSize : 0) };
+        Scene *scene = new Scene(filename);
+        const bool valid = ReadScene(reader, scene, buildKey);
+        fclose(fp);
+
+        if (!valid)
+        {
+            Log("Scene cache %s is outdated or invalid\n", cachePath.c_str());
+            // arrays read before the failure belong to the scene : its destructor is the only place freeing them
+            delete scene;
+            return nullptr;
+        }
+        Log("Scene loaded from cache %s\n", cachePath.c_str());
+        return scene;
+    }
+
+    bool SaveSceneCache(const Scene *scene, unsigned int buildKey)
+    {
+        if (!scene->gpuBVH || !scene->camera)
+            return false;
+
+        // written to a temporary file first so an interrupted save never leaves a partial cache
+        const std::string cachePath = GetSceneCachePath(scene->getSceneName(), buildKey);
+        const std::string tempPath = cachePath + ".tmp";
+        FILE *fp = fopen(tempPath.c_str(), "wb");
+        if (!fp)
+            return false;
+
+        CacheWriter writer = { fp };
+        bool written = writer.Write(MakeHeader(buildKey));
+
+        written = written && writer.Write(uint32_t(scene->sourceFiles.size()));
+        for (const auto& sourceFile : scene->sourceFiles)
+            written = written && writer.WriteString(sourceFile) && writer.Write(GetModificationTime(sourceFile));
+
+        written = written &&
+            writer.WriteVector(scene->triangleIndices) &&
+            writer.WriteVector(scene->normalTexData) &&
+            writer.WriteVector(scene->vertexData) &&
+            writer.WriteVector(scene->materialData) &&
+            writer.WriteVector(scene->lightData);
+
+        const Camera *camera = scene->camera;
+        written = written && writer.Write(camera->position) && writer.Write(camera->worldUp) && writer.Write(camera->pitch) &&
+            writer.Write(camera->yaw) && writer.Write(camera->fov) && writer.Write(camera->focalDist) && writer.Write(camera->aperture);
+
+        const RenderOptions& options = scene->renderOptions;
+        written = written && writer.WriteString(options.rendererType) && writer.Write(options.resolution) && writer.Write(options.maxSamples) &&
+            writer.Write(options.maxDepth) && writer.Write(options.numTilesX) && writer.Write(options.numTilesY) &&
+            writer.Write(uint8_t(options.useEnvMap ? 1 : 0)) && writer.Write(options.hdrMultiplier);
+
+        const TexData& texData = scene->texData;
+        written = written && writer.Write(texData.albedoTexCount) && writer.Write(texData.metallicRoughnessTexCount) && writer.Write(texData.normalTexCount) &&
+            writer.Write(texData.albedoTextureSize) && writer.Write(texData.metallicRoughnessTextureSize) && writer.Write(texData.normalTextureSize) &&
+            writer.WriteArray(texData.albedoTextures, size_t(TextureByteCount(texData.albedoTexCount, texData.albedoTextureSize))) &&
+            writer.WriteArray(texData.metallicRoughnessTextures, size_t(TextureByteCount(texData.metallicRoughnessTexCount, texData.metallicRoughnessTextureSize))) &&
+            writer.WriteArray(texData.normalTextures, size_t(TextureByteCount(texData.normalTexCount, texData.normalTextureSize)));
+
+        if (options.useEnvMap)
+        {
+            const HDRLoaderResult& hdr = scene->hdrLoaderRes;
+            const size_t pixelCount = size_t(hdr.width) * size_t(hdr.height);
+            written = written && writer.Write(hdr.width) && writer.Write(hdr.height) &&
+                writer.WriteArray(hdr.cols, pixelCount * 3) &&
+                writer.WriteArray(hdr.marginalDistData, size_t(hdr.height)) &&
+                writer.WriteArray(hdr.conditionalDistData, pixelCount);
+        }
+
+        written = written &&
+            writer.WriteArray(scene->gpuBVH->gpuNodes, size_t(scene->gpuBVH->numNodes)) &&
+            writer.WriteVector(scene->gpuBVH->bvhTriangleIndices) &&
+            writer.Write(kCacheMagic);
+
+        written = (fclose(fp) == 0) && written;
+        if (!written)
+        {
+            remove(tempPath.c_str());
+            Log("Unable to write scene cache %s\n", cachePath.c_str());
+            return false;
+        }
+        remove(cachePath.c_str());
+        if (rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
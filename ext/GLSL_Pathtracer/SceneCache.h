@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace GLSLPathTracer
+{
+    class Scene;
+
+    // Binary snapshot of a loaded scene and its GPU BVH, stored next to the scene file.
+    // buildKey identifies the BVH builder settings. The cache is ignored when the key, the format version
+    // or the modification time of any file the scene was loaded from doesn't match.
+    std::string GetSceneCachePath(const std::string &filename, unsigned int buildKey);
+    Scene* LoadSceneCache(const std::string &filename, unsigned int buildKey);
+    bool SaveSceneCache(const Scene *scene, unsigned int buildKey);
+}
@@ -16,6 +16,8 @@
 #include <math.h>
 #include <memory.h>
 #include <stdio.h>
+#include <algorithm>
+#include <vector>
 
 typedef unsigned char RGBE[4];
 #define R			0
@@ -35,102 +37,96 @@ float Luminance(const glm::vec3 &c)
 	return c.x*0.3f + c.y*0.6f + c.z*0.1f;
 }
 
-int LowerBound(const float* array, int lower, int upper, const float value)
+// for every i, the first index whose cdf value isn't below i / count. The queries grow with i
+// and the cdf doesn't decrease, so one walk gives the indices a binary search per query would.
+static void InvertCDF(const float *cdf, int count, glm::vec2 *dist)
 {
-	while (lower < upper)
+	int index = 0;
+	for (int i = 0; i < count; i++)
 	{
-		int mid = lower + (upper - lower) / 2;
-
-		if (array[mid] < value)
-		{
-			lower = mid + 1;
-		}
-		else
-		{
-			upper = mid;
-		}
+		float value = (float)i / count;
+		while (index < count && cdf[index] < value)
+			index++;
+		dist[i].x = index / (float)count;
 	}
-
-	return lower;
 }
 
-void HDRLoader::buildDistributions(HDRLoaderResult &res)
+static const int kRowsPerJob = 16;
+
+void HDRLoader::buildDistributions(HDRLoaderResult &res, const ParallelFor &parallelFor)
 {
 	int width  = res.width;
 	int height = res.height;
 
-	float *pdf2D = new float[width*height];
-	float *cdf2D = new float[width*height];
-
-	float *pdf1D = new float[height];
-	float *cdf1D = new float[height];
-
 	res.marginalDistData    = new glm::vec2[height];
 	res.conditionalDistData = new glm::vec2[width*height];
 
-	float colWeightSum = 0.0f;
+	std::vector<float> rowWeightSums(height);
 
-	for (int j = 0; j < height; j++)
+	// rows are independent. The pdf is written in place, each job reuses one cdf row.
+	// Sums keep the sequential order so the tables don't depend on the thread count.
+	auto buildRows = [&](int job)
 	{
-		float rowWeightSum = 0.0f;
-
-		for (int i = 0; i < width; ++i)
+		std::vector<float> cdf2D(width);
+		int lastRow = std::min((job + 1) * kRowsPerJob, height);
+		for (int j = job * kRowsPerJob; j < lastRow; j++)
 		{
-			float weight = Luminance(glm::vec3(res.cols[j*width * 3 + i * 3 + 0], res.cols[j*width * 3 + i * 3 + 1], res.cols[j*width * 3 + i * 3 + 2]));
+			const float *cols = res.cols + size_t(j) * width * 3;
+			glm::vec2 *dist = res.conditionalDistData + size_t(j) * width;
+			float rowWeightSum = 0.0f;
 
-			rowWeightSum += weight;
+			for (int i = 0; i < width; ++i)
+			{
+				float weight = Luminance(glm::vec3(cols[i * 3 + 0], cols[i * 3 + 1], cols[i * 3 + 2]));
 
-			pdf2D[j*width + i] = weight;
-			cdf2D[j*width + i] = rowWeightSum;
-		}
+				rowWeightSum += weight;
 
-		/* Convert to range 0,1 */
-		for (int i = 0; i < width; i++)
-		{
-			pdf2D[j*width + i] /= rowWeightSum;
-			cdf2D[j*width + i] /= rowWeightSum;
-		}
+				dist[i].y = weight;
+				cdf2D[i] = rowWeightSum;
+			}
 
-		colWeightSum += rowWeightSum;
+			/* Convert to range 0,1 */
+			for (int i = 0; i < width; i++)
+			{
+				dist[i].y /= rowWeightSum;
+				cdf2D[i] /= rowWeightSum;
+			}
 
-		pdf1D[j] = rowWeightSum;
-		cdf1D[j] = colWeightSum;
-	}
-	
-	/* Convert to range 0,1 */
-	for (int j = 0; j < height; j++)
+			/* Precalculate col to avoid binary search during lookup in the shader */
+			InvertCDF(cdf2D.data(), width, dist);
+			rowWeightSums[j] = rowWeightSum;
+		}
+	};
+
+	int jobCount = (height + kRowsPerJob - 1) / kRowsPerJob;
+	if (parallelFor)
+		parallelFor(jobCount, buildRows);
+	else
 	{
-		cdf1D[j] /= colWeightSum;
-		pdf1D[j] /= colWeightSum;
+		for (int job = 0; job < jobCount; job++)
+			buildRows(job);
 	}
 
-	/* Precalculate row and col to avoid binary search during lookup in the shader */
-	for (int i = 0; i < height; i++)
+	std::vector<float> cdf1D(height);
+	float colWeightSum = 0.0f;
+	for (int j = 0; j < height; j++)
 	{
-		float invHeight = (float)i / height;
-		int row = LowerBound(cdf1D, 0, height, invHeight);
-		res.marginalDistData[i].x = row / (float)height;
-		res.marginalDistData[i].y = pdf1D[i];
+		colWeightSum += rowWeightSums[j];
+		cdf1D[j] = colWeightSum;
 	}
 
+	/* Convert to range 0,1 */
 	for (int j = 0; j < height; j++)
 	{
-		for (int i = 0; i < width; i++)
-		{
-			float invWidth = (float)i / width;
-			int col = LowerBound(cdf2D, j*width, (j + 1)*width, invWidth) - j * width;
-			res.conditionalDistData[j*width + i].x = col / (float)width;
-			res.conditionalDistData[j*width + i].y = pdf2D[j*width + i];
-		}
+		cdf1D[j] /= colWeightSum;
+		res.marginalDistData[j].y = rowWeightSums[j] / colWeightSum;
 	}
 
-	delete[] pdf2D;
-	delete[] pdf1D;
-	delete[] cdf2D;
-	delete[] cdf1D;
+	/* Precalculate row to avoid binary search during lookup in the shader */
+	InvertCDF(cdf1D.data(), height, res.marginalDistData);
 }
 
-bool HDRLoader::load(const char *fileName, HDRLoaderResult &res)
+bool HDRLoader::load(const char *fileName, HDRLoaderResult &res, const ParallelFor &parallelFor)
 {
 	int i;
 	char str[200];
@@ -169,7 +165,7 @@ bool HDRLoader::load(const char *fileName, HDRLoaderResult &res)
 	}
 
 	int w, h;
-	if (!sscanf(reso, "-Y %ld +X %ld", &h, &w)) {
+	if (sscanf(reso, "-Y %d +X %d", &h, &w) != 2) {
 		fclose(file);
 		return false;
 	}
@@ -197,7 +193,7 @@ bool HDRLoader::load(const char *fileName, HDRLoaderResult &res)
 	delete [] scanline;
 	fclose(file);
 
-	buildDistributions(res);
+	buildDistributions(res, parallelFor);
 	return true;
 }
 
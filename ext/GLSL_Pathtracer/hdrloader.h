@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include "ParallelFor.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 /***********************************************************************************
@@ -20,6 +21,8 @@ public:
 	{
 		width = height = 0;
 		cols = NULL;
+		marginalDistData = NULL;
+		conditionalDistData = NULL;
 	}
 	int width, height;
 	// each pixel takes 3 float32, each component can be of any value...
@@ -30,8 +33,9 @@ public:
 
 class HDRLoader {
 private:
-	static void buildDistributions(HDRLoaderResult &res);
+	static void buildDistributions(HDRLoaderResult &res, const ParallelFor &parallelFor);
 public:
-	static bool load(const char *fileName, HDRLoaderResult &res);
+	// rows of the importance sampling tables are built with parallelFor. On the calling thread when empty
+	static bool load(const char *fileName, HDRLoaderResult &res, const ParallelFor &parallelFor = ParallelFor());
 };
 
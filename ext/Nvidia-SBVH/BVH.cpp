@@ -29,6 +29,7 @@
 
 #include "BVH.h"
 #include "SplitBVHBuilder.h"
+#include "BinnedBVHBuilder.h"
 
 
 BVH::BVH(GPUScene* scene, const Platform& platform, const BuildParams& params)
@@ -41,7 +42,10 @@ BVH::BVH(GPUScene* scene, const Platform& platform, const BuildParams& params)
 		printf("BVH builder: %d tris, %d vertices\n", scene->getNumTriangles(), scene->getNumVertices());
 
 	// SplitBVHBuilder() builds the actual BVH
-	m_root = SplitBVHBuilder(*this, params).run(m_numNodes);
+	if (params.binned)
+		m_root = BinnedBVHBuilder(*this, params).run(m_numNodes);
+	else
+		m_root = SplitBVHBuilder(*this, params).run(m_numNodes);
 
 	if (params.enablePrints)
 		printf("BVH: Scene bounds: (%.1f,%.1f,%.1f) - (%.1f,%.1f,%.1f)\n", m_root->m_bounds.min().x, m_root->m_bounds.min().y, m_root->m_bounds.min().z,
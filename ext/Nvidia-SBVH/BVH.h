@@ -30,6 +30,7 @@
 #include "BVHNode.h"
 #include <cstdio>
 #include <string>
+#include "ParallelFor.h"
 
 typedef float F32;
 
@@ -69,12 +70,15 @@ public:
 		Stats*      stats;
 		bool        enablePrints;
 		F32         splitAlpha;     // spatial split area threshold, see Nvidia paper on SBVH by Martin Stich, usually 0.05
+		bool        binned;         // binned SAH without spatial splits: faster to build, slower to traverse
+		ParallelFor parallelFor;    // used by the binned builder. Jobs run on the calling thread when empty
 
 		BuildParams(void)
 		{
 			stats = NULL;
 			enablePrints = true;
 			splitAlpha = 1.0e-5f;
+			binned = false;
 		}
 
 	};
@@ -0,0 +1,306 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "BinnedBVHBuilder.h"
+#include <algorithm>
+
+BinnedBVHBuilder::BinnedBVHBuilder(BVH& bvh, const BVH::BuildParams& params)
+	: m_bvh(bvh),
+	m_platform(bvh.getPlatform()),
+	m_params(params),
+	m_subtreeSize(MinSubtreeSize),
+	m_numNodes(0)
+{
+}
+
+//------------------------------------------------------------------------
+
+BinnedBVHBuilder::~BinnedBVHBuilder(void)
+{
+}
+
+//------------------------------------------------------------------------
+
+BVHNode* BinnedBVHBuilder::run(int &numNodes)
+{
+	const GPUScene::Triangle* tris = m_bvh.getScene()->getTrianglePtr();
+	const Vec3f* verts = m_bvh.getScene()->getVertexPtr();
+	const S32 numRef = m_bvh.getScene()->getNumTriangles();
+
+	// Reference bounds, reduced by chunk.
+
+	m_refs.resize(numRef);
+	const int numChunks = (numRef + ChunkSize - 1) / ChunkSize;
+	std::vector<NodeSpec> chunkSpecs(numChunks);
+	parallelFor(numChunks, [&](int chunk) {
+		NodeSpec& chunkSpec = chunkSpecs[chunk];
+		const S32 end = min1i((chunk + 1) * ChunkSize, numRef);
+		for (S32 i = chunk * ChunkSize; i < end; i++)
+		{
+			Reference& ref = m_refs[i];
+			ref.triIdx = i;
+			ref.bounds = AABB();
+			for (int j = 0; j < 3; j++)
+				ref.bounds.grow(verts[tris[i].vertices._v[j]]);
+			ref.centroid = ref.bounds.midPoint();
+			chunkSpec.bounds.grow(ref.bounds);
+			chunkSpec.centroidBounds.grow(ref.centroid);
+		}
+	});
+
+	NodeSpec rootSpec;
+	rootSpec.begin = 0;
+	rootSpec.end = numRef;
+	for (const NodeSpec& chunkSpec : chunkSpecs)
+	{
+		rootSpec.bounds.grow(chunkSpec.bounds);
+		rootSpec.centroidBounds.grow(chunkSpec.centroidBounds);
+	}
+
+	// Top of the tree on this thread, enough subtrees to keep the workers busy.
+
+	m_subtreeSize = max1i(numRef / 256, MinSubtreeSize);
+	m_numNodes = 0;
+	std::vector<Subtree> subtrees;
+	BVHNode* root = NULL;
+	root = buildNode(rootSpec, 0, &root, &subtrees);
+
+	// Subtrees in parallel. They own disjoint reference ranges.
+
+	parallelFor(int(subtrees.size()), [&](int index) {
+		const Subtree& subtree = subtrees[index];
+		*subtree.slot = buildNode(subtree.spec, subtree.level, subtree.slot, NULL);
+	});
+
+	Array<S32>& triIndices = m_bvh.getTriIndices();
+	triIndices.reset(numRef);
+	for (S32 i = 0; i < numRef; i++)
+		triIndices[i] = m_refs[i].triIdx;
+
+	numNodes = m_numNodes;
+	if (m_params.enablePrints)
+		printf("BinnedBVHBuilder: %d nodes, %d subtrees\n", numNodes, int(subtrees.size()));
+	return root;
+}
+
+//------------------------------------------------------------------------
+
+void BinnedBVHBuilder::parallelFor(int count, const std::function<void(int)>& job) const
+{
+	if (m_params.parallelFor && count > 1)
+	{
+		m_params.parallelFor(count, job);
+		return;
+	}
+	for (int i = 0; i < count; i++)
+		job(i);
+}
+
+//------------------------------------------------------------------------
+
+int BinnedBVHBuilder::getBinIndex(const NodeSpec& spec, const Vec3f& centroid, int dim) const
+{
+	const F32 mn = spec.centroidBounds.min()._v[dim];
+	const F32 extent = spec.centroidBounds.max()._v[dim] - mn;
+	if (extent <= 0.0f)
+		return 0;
+	const int index = int((centroid._v[dim] - mn) * (F32(NumBins) / extent));
+	return max1i(min1i(index, NumBins - 1), 0);
+}
+
+//------------------------------------------------------------------------
+
+void BinnedBVHBuilder::binReferences(Bin* bins, const NodeSpec& spec, S32 begin, S32 end) const
+{
+	for (S32 i = begin; i < end; i++)
+	{
+		const Reference& ref = m_refs[i];
+		for (int dim = 0; dim < 3; dim++)
+		{
+			Bin& bin = bins[dim * NumBins + getBinIndex(spec, ref.centroid, dim)];
+			bin.bounds.grow(ref.bounds);
+			bin.centroidBounds.grow(ref.centroid);
+			bin.count++;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+
+void BinnedBVHBuilder::computeBounds(NodeSpec& spec) const
+{
+	spec.bounds = AABB();
+	spec.centroidBounds = AABB();
+	for (S32 i = spec.begin; i < spec.end; i++)
+	{
+		spec.bounds.grow(m_refs[i].bounds);
+		spec.centroidBounds.grow(m_refs[i].centroid);
+	}
+}
+
+//------------------------------------------------------------------------
+
+BVHNode* BinnedBVHBuilder::buildNode(const NodeSpec& spec, int level, BVHNode** slot, std::vector<Subtree>* subtrees)
+{
+	const S32 numRef = spec.end - spec.begin;
+
+	// Small enough for a job => built later.
+
+	if (subtrees && numRef <= m_subtreeSize)
+	{
+		Subtree subtree;
+		subtree.spec = spec;
+		subtree.level = level;
+		subtree.slot = slot;
+		subtrees->push_back(subtree);
+		return NULL;
+	}
+	m_numNodes++;
+
+	// Small enough or too deep => create leaf.
+
+	if (numRef <= m_platform.getMinLeafSize() || level >= MaxDepth)
+		return createLeaf(spec);
+
+	// Bin references. Top nodes are binned by chunks in parallel.
+
+	Bin bins[3 * NumBins];
+	const int numChunks = (numRef + ChunkSize - 1) / ChunkSize;
+	if (subtrees && numChunks > 1)
+	{
+		std::vector<Bin> chunkBins(numChunks * 3 * NumBins);
+		parallelFor(numChunks, [&](int chunk) {
+			binReferences(&chunkBins[chunk * 3 * NumBins], spec, spec.begin + chunk * ChunkSize, min1i(spec.begin + (chunk + 1) * ChunkSize, spec.end));
+		});
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			for (int i = 0; i < 3 * NumBins; i++)
+			{
+				const Bin& chunkBin = chunkBins[chunk * 3 * NumBins + i];
+				if (!chunkBin.count)
+					continue;
+				bins[i].bounds.grow(chunkBin.bounds);
+				bins[i].centroidBounds.grow(chunkBin.centroidBounds);
+				bins[i].count += chunkBin.count;
+			}
+		}
+	}
+	else
+	{
+		binReferences(bins, spec, spec.begin, spec.end);
+	}
+
+	// Find the cheapest bin boundary: sweep from the right, then from the left.
+
+	F32 area = spec.bounds.area();
+	F32 leafSAH = area * m_platform.getTriangleCost(numRef);
+	F32 nodeSAH = area * m_platform.getNodeCost(2);
+	F32 bestSAH = FW_F32_MAX;
+	int bestDim = -1;
+	int bestBin = 0;
+	for (int dim = 0; dim < 3; dim++)
+	{
+		const Bin* dimBins = &bins[dim * NumBins];
+		F32 rightArea[NumBins];
+		S32 rightCount[NumBins];
+		AABB bounds;
+		S32 count = 0;
+		for (int i = NumBins - 1; i > 0; i--)
+		{
+			if (dimBins[i].count)
+				bounds.grow(dimBins[i].bounds);
+			count += dimBins[i].count;
+			rightArea[i] = bounds.area();
+			rightCount[i] = count;
+		}
+
+		bounds = AABB();
+		count = 0;
+		for (int i = 0; i < NumBins - 1; i++)
+		{
+			if (dimBins[i].count)
+				bounds.grow(dimBins[i].bounds);
+			count += dimBins[i].count;
+			if (!count || !rightCount[i + 1])
+				continue;
+			F32 sah = nodeSAH + bounds.area() * m_platform.getTriangleCost(count) + rightArea[i + 1] * m_platform.getTriangleCost(rightCount[i + 1]);
+			if (sah < bestSAH)
+			{
+				bestSAH = sah;
+				bestDim = dim;
+				bestBin = i + 1;
+			}
+		}
+	}
+
+	// Leaf SAH is the lowest => create leaf.
+
+	if (leafSAH <= bestSAH && numRef <= m_platform.getMaxLeafSize())
+		return createLeaf(spec);
+
+	// Partition references.
+
+	NodeSpec left, right;
+	left.begin = spec.begin;
+	right.end = spec.end;
+	if (bestDim != -1)
+	{
+		Reference* refs = m_refs.data();
+		Reference* mid = std::partition(refs + spec.begin, refs + spec.end, [&](const Reference& ref) {
+			return getBinIndex(spec, ref.centroid, bestDim) < bestBin;
+		});
+		left.end = right.begin = S32(mid - refs);
+		for (int i = 0; i < NumBins; i++)
+		{
+			const Bin& bin = bins[bestDim * NumBins + i];
+			if (!bin.count)
+				continue;
+			NodeSpec& child = (i < bestBin) ? left : right;
+			child.bounds.grow(bin.bounds);
+			child.centroidBounds.grow(bin.centroidBounds);
+		}
+	}
+	else
+	{
+		// centroids can't be separated => split in the middle
+		left.end = right.begin = spec.begin + numRef / 2;
+		computeBounds(left);
+		computeBounds(right);
+	}
+
+	// Create inner node. Children can be built later by a job.
+
+	InnerNode* node = new InnerNode(spec.bounds, NULL, NULL);
+	node->m_children[0] = buildNode(left, level + 1, &node->m_children[0], subtrees);
+	node->m_children[1] = buildNode(right, level + 1, &node->m_children[1], subtrees);
+	return node;
+}
+
+//------------------------------------------------------------------------
+
+BVHNode* BinnedBVHBuilder::createLeaf(const NodeSpec& spec)
+{
+	return new LeafNode(spec.bounds, spec.begin, spec.end);
+}
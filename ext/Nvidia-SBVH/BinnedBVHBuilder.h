@@ -0,0 +1,105 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+#include "BVH.h"
+#include <atomic>
+#include <vector>
+
+// binned SAH builder, see "On fast Construction of SAH-based Bounding Volume Hierarchies" by Ingo Wald, 2007
+// no spatial splits : references are partitioned in place and leaves point to ranges of the reference array.
+// Large nodes are binned by chunks in parallel, then the remaining subtrees are built in parallel.
+class BinnedBVHBuilder
+{
+private:
+	enum
+	{
+		MaxDepth = 64,
+		NumBins = 16,
+		ChunkSize = 16384,      // references per parallel binning job
+		MinSubtreeSize = 1024,  // smallest subtree handed to a job
+	};
+
+	struct Reference
+	{
+		S32                 triIdx;
+		AABB                bounds;
+		Vec3f               centroid;
+	};
+
+	struct Bin
+	{
+		AABB                bounds;
+		AABB                centroidBounds;
+		S32                 count;
+
+		Bin(void) : count(0) {}
+	};
+
+	struct NodeSpec
+	{
+		S32                 begin;           // range in the reference array
+		S32                 end;
+		AABB                bounds;
+		AABB                centroidBounds;  // bins are distributed over the centroid bounds
+
+		NodeSpec(void) : begin(0), end(0) {}
+	};
+
+	struct Subtree
+	{
+		NodeSpec            spec;
+		int                 level;
+		BVHNode**           slot;            // child pointer in the parent node
+	};
+
+public:
+	BinnedBVHBuilder(BVH& bvh, const BVH::BuildParams& params);
+	~BinnedBVHBuilder(void);
+
+	BVHNode*                run(int &numNodes);
+
+private:
+	void                    parallelFor(int count, const std::function<void(int)>& job) const;
+	int                     getBinIndex(const NodeSpec& spec, const Vec3f& centroid, int dim) const;
+	void                    binReferences(Bin* bins, const NodeSpec& spec, S32 begin, S32 end) const;
+	void                    computeBounds(NodeSpec& spec) const;
+
+	BVHNode*                buildNode(const NodeSpec& spec, int level, BVHNode** slot, std::vector<Subtree>* subtrees);
+	BVHNode*                createLeaf(const NodeSpec& spec);
+
+private:
+	BinnedBVHBuilder(const BinnedBVHBuilder&); // forbidden
+	BinnedBVHBuilder&       operator=           (const BinnedBVHBuilder&); // forbidden
+
+private:
+	BVH&                    m_bvh;
+	const Platform&         m_platform;
+	const BVH::BuildParams& m_params;
+
+	std::vector<Reference>  m_refs;
+	S32                     m_subtreeSize;   // nodes up to that size are built by parallel jobs
+	std::atomic<int>        m_numNodes;
+};
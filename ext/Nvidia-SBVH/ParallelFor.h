@@ -0,0 +1,6 @@
+#pragma once
+#include <functional>
+
+// calls job for every index in [0, count), possibly from several threads, and returns when all are done.
+// Shared by the BVH builders and the GLSL path tracer loaders.
+typedef std::function<void(int count, const std::function<void(int index)>& job)> ParallelFor;
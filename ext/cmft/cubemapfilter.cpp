@@ -871,15 +871,20 @@ namespace cmft
                       , const Image* _imageRgba32f
                       , const uint32_t _faceOffsets[CUBE_FACE_NUM]
                       , EdgeFixup::Enum _fixup
+                      , uint32_t _yBegin
+                      , uint32_t _yEnd
                       )
     {
         const float mfs = float(int32_t(_mipFaceSize));
         const float invMfs = 1.0f/mfs;
 
+        // Only rows [_yBegin.._yEnd) are processed.
+        _dstPtr += _yBegin*_mipFaceSize*4;
+
         if (EdgeFixup::None == _fixup)
         {
-            float yyf = 1.0f;
-            for (uint32_t yy = 0; yy < _mipFaceSize; ++yy, yyf+=2.0f)
+            float yyf = 1.0f + 2.0f*float(_yBegin);
+            for (uint32_t yy = _yBegin; yy < _yEnd; ++yy, yyf+=2.0f)
             {
                 float xxf = 1.0f;
                 for (uint32_t xx = 0; xx < _mipFaceSize; ++xx, xxf+=2.0f)
@@ -921,8 +926,8 @@ namespace cmft
         {
             const float warp = warpFixupFactor(mfs);
 
-            float yyf = 1.0f;
-            for (uint32_t yy = 0; yy < _mipFaceSize; ++yy, yyf+=2.0f)
+            float yyf = 1.0f + 2.0f*float(_yBegin);
+            for (uint32_t yy = _yBegin; yy < _yEnd; ++yy, yyf+=2.0f)
             {
                 float xxf = 1.0f;
                 for (uint32_t xx = 0; xx < _mipFaceSize; ++xx, xxf+=2.0f)
@@ -1137,6 +1142,8 @@ namespace cmft
                          , params->m_imageRgba32f
                          , params->m_faceOffsets
                          , params->m_edgeFixup
+                         , 0
+                         , params->m_mipFaceSize
                          );
 
             // Determine task duration.
@@ -1854,6 +1861,124 @@ namespace cmft
         };
     }
 
+    static void radianceMipParams(float& _filterSize
+                                , float& _specularPower
+                                , float& _cosAngle
+                                , uint32_t _mipFaceSize
+                                , uint32_t _mip
+                                , float _mipCountf
+                                , float _glossScalef
+                                , float _glossBiasf
+                                , LightingModel::Enum _lightingModel
+                                )
+    {
+        const float mipFaceSizef = float(int32_t(_mipFaceSize));
+        const float minAngle = atan2f(1.0f, mipFaceSizef);
+        const float maxAngle = (0.5f*CMFT_PI);
+        const float toFilterSize = 1.0f/(minAngle*mipFaceSizef*2.0f);
+        const float specularPowerRef = specularPowerFor(float(int32_t(_mip)), _mipCountf, _glossScalef, _glossBiasf);
+        const float specularPower = applyLightningModel(specularPowerRef, _lightingModel);
+        const float filterAngle = CMFT_CLAMP(cosinePowerFilterAngle(specularPower), minAngle, maxAngle);
+        const float texelSize = 1.0f/mipFaceSizef;
+
+        _specularPower = specularPower;
+        _cosAngle = CMFT_MAX(0.0f, cosf(filterAngle));
+        _filterSize = CMFT_MAX(texelSize, filterAngle * toFilterSize);
+    }
+
+    static void radianceCopyBase(void* _dstData
+                               , const uint32_t _dstOffsets[CUBE_FACE_NUM][MAX_MIP_NUM]
+                               , uint32_t _dstFaceSize
+                               , const Image& _imageRgba32f
+                               , const uint32_t _srcFaceOffsets[CUBE_FACE_NUM]
+                               )
+    {
+        const uint32_t bytesPerPixel  = 4 /*numChannels*/ * 4 /*bytesPerChannel*/;
+        const float    dstToSrcRatiof = cmft::utof(_imageRgba32f.m_width)/cmft::utof(_dstFaceSize);
+        const uint32_t dstToSrcRatio  = CMFT_MAX(UINT32_C(1), cmft::ftou(dstToSrcRatiof));
+        const uint32_t dstFacePitch   = _dstFaceSize * bytesPerPixel;
+        const uint32_t srcFacePitch   = _imageRgba32f.m_width * bytesPerPixel;
+
+        // For all top level cubemap faces:
+        for(uint8_t face = 0; face < 6; ++face)
+        {
+            const uint8_t* srcFaceData = (const uint8_t*)_imageRgba32f.m_data + _srcFaceOffsets[face];
+            uint8_t* dstFaceData = (uint8_t*)_dstData + _dstOffsets[face][0];
+
+            // Iterate through destination pixels.
+            float yDstf = 0.0f;
+            for (uint32_t yDst = 0; yDst < _dstFaceSize; ++yDst, yDstf+=1.0f)
+            {
+                uint8_t* dstFaceRow = (uint8_t*)dstFaceData + yDst*dstFacePitch;
+
+                float xDstf = 0.0f;
+                for (uint32_t xDst = 0; xDst < _dstFaceSize; ++xDst, xDstf+=1.0f)
+                {
+                    float* dstFaceColumn = (float*)((uint8_t*)dstFaceRow + xDst*bytesPerPixel);
+
+                    // For each destination pixel, sample and accumulate color from source.
+                    float color[3] = { 0.0f, 0.0f, 0.0f };
+                    uint32_t weightAccum = 0;
+
+                    for (uint32_t ySrc = cmft::ftou(yDstf*dstToSrcRatiof)
+                        , yEnd = ySrc + dstToSrcRatio
+                        ; ySrc < yEnd ; ++ySrc)
+                    {
+                        const uint8_t* srcRowData = (const uint8_t*)srcFaceData + ySrc*srcFacePitch;
+
+                        for (uint32_t xSrc = cmft::ftou(xDstf*dstToSrcRatiof)
+                            , xEnd = xSrc + dstToSrcRatio
+                            ; xSrc < xEnd ; ++xSrc)
+                        {
+                            const float* srcColumnData = (const float*)((const uint8_t*)srcRowData + xSrc*bytesPerPixel);
+                            color[0] += srcColumnData[0];
+                            color[1] += srcColumnData[1];
+                            color[2] += srcColumnData[2];
+                            weightAccum++;
+                        }
+                    }
+
+                    // Divide by weight and save to destination pixel.
+                    const float invWeight = 1.0f/cmft::utof(CMFT_MAX(weightAccum, UINT32_C(1)));
+                    dstFaceColumn[0] = color[0] * invWeight;
+                    dstFaceColumn[1] = color[1] * invWeight;
+                    dstFaceColumn[2] = color[2] * invWeight;
+                    dstFaceColumn[3] = 1.0f;
+                }
+            }
+        }
+    }
+
+    static void radianceAverageLastMip(void* _dstData
+                                     , const uint32_t _dstOffsets[CUBE_FACE_NUM][MAX_MIP_NUM]
+                                     , uint32_t _dstFaceSize
+                                     , uint8_t _mipCount
+                                     )
+    {
+        if ((_dstFaceSize>>(_mipCount-1)) > 1)
+        {
+            return;
+        }
+
+        float* face0 = (float*)((uint8_t*)_dstData + _dstOffsets[0][_mipCount-1]);
+        float* face1 = (float*)((uint8_t*)_dstData + _dstOffsets[1][_mipCount-1]);
+        float* face2 = (float*)((uint8_t*)_dstData + _dstOffsets[2][_mipCount-1]);
+        float* face3 = (float*)((uint8_t*)_dstData + _dstOffsets[3][_mipCount-1]);
+        float* face4 = (float*)((uint8_t*)_dstData + _dstOffsets[4][_mipCount-1]);
+        float* face5 = (float*)((uint8_t*)_dstData + _dstOffsets[5][_mipCount-1]);
+
+        const float color[3] =
+        {
+            (face0[0] + face1[0] + face2[0] + face3[0] + face4[0] + face5[0]) / 6.0f,
+            (face0[1] + face1[1] + face2[1] + face3[1] + face4[1] + face5[1]) / 6.0f,
+            (face0[2] + face1[2] + face2[2] + face3[2] + face4[2] + face5[2]) / 6.0f,
+        };
+
+        face0[0] = face1[0] = face2[0] = face3[0] = face4[0] = face5[0] = color[0];
+        face0[1] = face1[1] = face2[1] = face3[1] = face4[1] = face5[1] = color[1];
+        face0[2] = face1[2] = face2[2] = face3[2] = face4[2] = face5[2] = color[2];
+    }
+
     bool imageRadianceFilter(Image& _dst
                            , uint32_t _dstFaceSize
                            , LightingModel::Enum _lightingModel
@@ -1996,59 +2121,7 @@ namespace cmft
         {
             INFO("Radiance -> Excluding base image.");
 
-            const float    dstToSrcRatiof = cmft::utof(imageRgba32f.m_width)/cmft::utof(dstFaceSize);
-            const uint32_t dstToSrcRatio  = CMFT_MAX(UINT32_C(1), cmft::ftou(dstToSrcRatiof));
-            const uint32_t dstFacePitch   = dstFaceSize * bytesPerPixel;
-            const uint32_t srcFacePitch   = imageRgba32f.m_width * bytesPerPixel;
-
-            // For all top level cubemap faces:
-            for(uint8_t face = 0; face < 6; ++face)
-            {
-                const uint8_t* srcFaceData = (const uint8_t*)imageRgba32f.m_data + srcFaceOffsets[face];
-                uint8_t* dstFaceData = (uint8_t*)dstData + dstOffsets[face][0];
-
-                // Iterate through destination pixels.
-                float yDstf = 0.0f;
-                for (uint32_t yDst = 0; yDst < dstFaceSize; ++yDst, yDstf+=1.0f)
-                {
-                    uint8_t* dstFaceRow = (uint8_t*)dstFaceData + yDst*dstFacePitch;
-
-                    float xDstf = 0.0f;
-                    for (uint32_t xDst = 0; xDst < dstFaceSize; ++xDst, xDstf+=1.0f)
-                    {
-                        float* dstFaceColumn = (float*)((uint8_t*)dstFaceRow + xDst*bytesPerPixel);
-
-                        // For each destination pixel, sample and accumulate color from source.
-                        float color[3] = { 0.0f, 0.0f, 0.0f };
-                        uint32_t weightAccum = 0;
-
-                        for (uint32_t ySrc = cmft::ftou(yDstf*dstToSrcRatiof)
-                            , yEnd = ySrc + dstToSrcRatio
-                            ; ySrc < yEnd ; ++ySrc)
-                        {
-                            const uint8_t* srcRowData = (const uint8_t*)srcFaceData + ySrc*srcFacePitch;
-
-                            for (uint32_t xSrc = cmft::ftou(xDstf*dstToSrcRatiof)
-                                , xEnd = xSrc + dstToSrcRatio
-                                ; xSrc < xEnd ; ++xSrc)
-                            {
-                                const float* srcColumnData = (const float*)((const uint8_t*)srcRowData + xSrc*bytesPerPixel);
-                                color[0] += srcColumnData[0];
-                                color[1] += srcColumnData[1];
-                                color[2] += srcColumnData[2];
-                                weightAccum++;
-                            }
-                        }
-
-                        // Divide by weight and save to destination pixel.
-                        const float invWeight = 1.0f/cmft::utof(CMFT_MAX(weightAccum, UINT32_C(1)));
-                        dstFaceColumn[0] = color[0] * invWeight;
-                        dstFaceColumn[1] = color[1] * invWeight;
-                        dstFaceColumn[2] = color[2] * invWeight;
-                        dstFaceColumn[3] = 1.0f;
-                    }
-                }
-            }
+            radianceCopyBase(dstData, dstOffsets, dstFaceSize, imageRgba32f, srcFaceOffsets);
         }
 
         if (mipCount - uint8_t(_excludeBase) <= 0)
@@ -2096,16 +2169,8 @@ namespace cmft
             {
                 // Determine filter parameters.
                 const uint32_t mipFaceSize = CMFT_MAX(1, dstFaceSize >> mip);
-                const float mipFaceSizef = float(int32_t(mipFaceSize));
-                const float minAngle = atan2f(1.0f, mipFaceSizef);
-                const float maxAngle = (0.5f*CMFT_PI);
-                const float toFilterSize = 1.0f/(minAngle*mipFaceSizef*2.0f);
-                const float specularPowerRef = specularPowerFor(float(int32_t(mip)), mipCountf, glossScalef, glossBiasf);
-                const float specularPower = applyLightningModel(specularPowerRef, _lightingModel);
-                const float filterAngle = CMFT_CLAMP(cosinePowerFilterAngle(specularPower), minAngle, maxAngle);
-                const float cosAngle = CMFT_MAX(0.0f, cosf(filterAngle));
-                const float texelSize = 1.0f/mipFaceSizef;
-                const float filterSize = CMFT_MAX(texelSize, filterAngle * toFilterSize);
+                float filterSize, specularPower, cosAngle;
+                radianceMipParams(filterSize, specularPower, cosAngle, mipFaceSize, mip, mipCountf, glossScalef, glossBiasf, _lightingModel);
 
                 for (uint8_t face = 0; face < 6; ++face)
                 {
@@ -2178,26 +2243,7 @@ namespace cmft
             }
 
             // Average 1x1 face size.
-            if ((dstFaceSize>>(mipCount-1)) <= 1)
-            {
-                float* face0 = (float*)((uint8_t*)dstData + dstOffsets[0][mipCount-1]);
-                float* face1 = (float*)((uint8_t*)dstData + dstOffsets[1][mipCount-1]);
-                float* face2 = (float*)((uint8_t*)dstData + dstOffsets[2][mipCount-1]);
-                float* face3 = (float*)((uint8_t*)dstData + dstOffsets[3][mipCount-1]);
-                float* face4 = (float*)((uint8_t*)dstData + dstOffsets[4][mipCount-1]);
-                float* face5 = (float*)((uint8_t*)dstData + dstOffsets[5][mipCount-1]);
-
-                const float color[3] =
-                {
-                    (face0[0] + face1[0] + face2[0] + face3[0] + face4[0] + face5[0]) / 6.0f,
-                    (face0[1] + face1[1] + face2[1] + face3[1] + face4[1] + face5[1]) / 6.0f,
-                    (face0[2] + face1[2] + face2[2] + face3[2] + face4[2] + face5[2]) / 6.0f,
-                };
-
-                face0[0] = face1[0] = face2[0] = face3[0] = face4[0] = face5[0] = color[0];
-                face0[1] = face1[1] = face2[1] = face3[1] = face4[1] = face5[1] = color[1];
-                face0[2] = face1[2] = face2[2] = face3[2] = face4[2] = face5[2] = color[2];
-            }
+            radianceAverageLastMip(dstData, dstOffsets, dstFaceSize, mipCount);
 
             // Get filter duration.
             const double freq = double(cmft::getHPFrequency());
@@ -2271,6 +2317,207 @@ namespace cmft
         return false;
     }
 
+    struct RadianceFilterTiles
+    {
+        struct Tile
+        {
+            uint8_t m_mip;
+            uint8_t m_face;
+            uint32_t m_yBegin;
+            uint32_t m_yEnd;
+        };
+
+        RadianceFilterParams m_params[MAX_MIP_NUM][CUBE_FACE_NUM];
+        uint32_t m_dstOffsets[CUBE_FACE_NUM][MAX_MIP_NUM];
+        uint32_t m_srcFaceOffsets[CUBE_FACE_NUM];
+        Tile* m_tiles;
+        uint32_t m_tileCount;
+        void* m_dstData;
+        uint32_t m_dstDataSize;
+        uint32_t m_dstFaceSize;
+        uint8_t m_mipCount;
+        float* m_cubemapVectors;
+        ImageSoftRef m_imageRgba32f;
+        TextureFormat::Enum m_srcFormat;
+        AllocatorI* m_allocator;
+    };
+
+    RadianceFilterTiles* radianceFilterTilesCreate(const Image& _src
+                                                 , uint32_t _dstFaceSize
+                                                 , LightingModel::Enum _lightingModel
+                                                 , bool _excludeBase
+                                                 , uint8_t _mipCount
+                                                 , uint8_t _glossScale
+                                                 , uint8_t _glossBias
+                                                 , EdgeFixup::Enum _edgeFixup
+                                                 , AllocatorI* _allocator
+                                                 )
+    {
+        // Input image must be a cubemap.
+        if (!imageIsCubemap(_src))
+        {
+            WARN("Image is not cubemap.");
+
+            return NULL;
+        }
+
+        RadianceFilterTiles* tiles = new RadianceFilterTiles;
+        tiles->m_allocator = _allocator;
+        tiles->m_srcFormat = (TextureFormat::Enum)_src.m_format;
+
+        // Processing is done in Rgba32f format.
+        imageRefOrConvert(tiles->m_imageRgba32f, TextureFormat::RGBA32F, _src, _allocator);
+        imageGetFaceOffsets(tiles->m_srcFaceOffsets, tiles->m_imageRgba32f);
+
+        // Alloc dst data.
+        const uint32_t dstFaceSize = (0 == _dstFaceSize) ? _src.m_width : _dstFaceSize;
+        const uint8_t mipMin = 1;
+        const uint8_t mipMax = uint8_t(cmft::ftou(cmft::log2f(cmft::utof(dstFaceSize))) + 1);
+        const uint8_t mipCount = CMFT_CLAMP(_mipCount, mipMin, mipMax);
+        const uint32_t bytesPerPixel = 4 /*numChannels*/ * 4 /*bytesPerChannel*/;
+        uint32_t dstDataSize = 0;
+        for (uint8_t face = 0; face < 6; ++face)
+        {
+            for (uint8_t mip = 0; mip < mipCount; ++mip)
+            {
+                tiles->m_dstOffsets[face][mip] = dstDataSize;
+                uint32_t faceSize = CMFT_MAX(1, dstFaceSize >> mip);
+                dstDataSize += faceSize * faceSize * bytesPerPixel;
+            }
+        }
+        tiles->m_dstData = CMFT_ALLOC(&g_crtAllocator, dstDataSize);
+        MALLOC_CHECK(tiles->m_dstData);
+        tiles->m_dstDataSize = dstDataSize;
+        tiles->m_dstFaceSize = dstFaceSize;
+        tiles->m_mipCount = mipCount;
+
+        if (_excludeBase)
+        {
+            radianceCopyBase(tiles->m_dstData, tiles->m_dstOffsets, dstFaceSize, tiles->m_imageRgba32f, tiles->m_srcFaceOffsets);
+        }
+
+        tiles->m_cubemapVectors = buildCubemapNormalSolidAngle(tiles->m_imageRgba32f.m_width, _edgeFixup, &g_crtAllocator);
+
+        // Tiles hold roughly the same number of texels. Big mips are split in several row ranges.
+        const uint32_t tileTexelCount = 64*64;
+        const uint8_t mipStart = uint8_t(_excludeBase);
+        uint32_t tileCount = 0;
+        for (uint32_t mip = mipStart; mip < mipCount; ++mip)
+        {
+            const uint32_t mipFaceSize = CMFT_MAX(1, dstFaceSize >> mip);
+            const uint32_t tileRows = CMFT_MAX(1, tileTexelCount / mipFaceSize);
+            tileCount += 6 * ((mipFaceSize + tileRows - 1) / tileRows);
+        }
+        tiles->m_tiles = (RadianceFilterTiles::Tile*)CMFT_ALLOC(&g_crtAllocator, CMFT_MAX(1, tileCount) * sizeof(RadianceFilterTiles::Tile));
+        MALLOC_CHECK(tiles->m_tiles);
+        tiles->m_tileCount = 0;
+
+        const float mipCountf   = float(int32_t(mipCount));
+        const float glossScalef = float(int32_t(_glossScale));
+        const float glossBiasf  = float(int32_t(_glossBias));
+
+        // Smallest mips first : they are the most expensive per texel.
+        for (uint32_t mip = mipCount; mip-- > mipStart; )
+        {
+            const uint32_t mipFaceSize = CMFT_MAX(1, dstFaceSize >> mip);
+            const uint32_t tileRows = CMFT_MAX(1, tileTexelCount / mipFaceSize);
+            float filterSize, specularPower, cosAngle;
+            radianceMipParams(filterSize, specularPower, cosAngle, mipFaceSize, mip, mipCountf, glossScalef, glossBiasf, _lightingModel);
+
+            for (uint8_t face = 0; face < 6; ++face)
+            {
+                RadianceFilterParams& params = tiles->m_params[mip][face];
+                params.m_dstPtr = (float*)((uint8_t*)tiles->m_dstData + tiles->m_dstOffsets[face][mip]);
+                params.m_face = face;
+                params.m_mipFaceSize = mipFaceSize;
+                params.m_filterSize = filterSize;
+                params.m_specularPower = specularPower;
+                params.m_specularAngle = cosAngle;
+                params.m_cubemapVectors = tiles->m_cubemapVectors;
+                params.m_imageRgba32f = &tiles->m_imageRgba32f;
+                params.m_faceOffsets = tiles->m_srcFaceOffsets;
+                params.m_edgeFixup = _edgeFixup;
+
+                for (uint32_t yy = 0; yy < mipFaceSize; yy += tileRows)
+                {
+                    RadianceFilterTiles::Tile& tile = tiles->m_tiles[tiles->m_tileCount++];
+                    tile.m_mip = uint8_t(mip);
+                    tile.m_face = face;
+                    tile.m_yBegin = yy;
+                    tile.m_yEnd = CMFT_MIN(mipFaceSize, yy + tileRows);
+                }
+            }
+        }
+
+        return tiles;
+    }
+
+    uint32_t radianceFilterTilesCount(const RadianceFilterTiles* _tiles)
+    {
+        return _tiles->m_tileCount;
+    }
+
+    void radianceFilterTile(RadianceFilterTiles* _tiles, uint32_t _tile)
+    {
+        const RadianceFilterTiles::Tile& tile = _tiles->m_tiles[_tile];
+        const RadianceFilterParams* params = &_tiles->m_params[tile.m_mip][tile.m_face];
+        radianceFilter(params->m_dstPtr
+                     , params->m_face
+                     , params->m_mipFaceSize
+                     , params->m_filterSize
+                     , params->m_specularPower
+                     , params->m_specularAngle
+                     , params->m_cubemapVectors
+                     , params->m_imageRgba32f
+                     , params->m_faceOffsets
+                     , params->m_edgeFixup
+                     , tile.m_yBegin
+                     , tile.m_yEnd
+                     );
+    }
+
+    bool radianceFilterTilesFinish(Image& _dst, RadianceFilterTiles* _tiles)
+    {
+        radianceAverageLastMip(_tiles->m_dstData, _tiles->m_dstOffsets, _tiles->m_dstFaceSize, _tiles->m_mipCount);
+
+        // Fill result structure.
+        Image result;
+        result.m_width = _tiles->m_dstFaceSize;
+        result.m_height = _tiles->m_dstFaceSize;
+        result.m_dataSize = _tiles->m_dstDataSize;
+        result.m_format = TextureFormat::RGBA32F;
+        result.m_numMips = _tiles->m_mipCount;
+        result.m_numFaces = 6;
+        result.m_data = _tiles->m_dstData;
+        _tiles->m_dstData = NULL;
+
+        // Convert back to source format.
+        if (TextureFormat::RGBA32F == _tiles->m_srcFormat)
+        {
+            imageMove(_dst, result, _tiles->m_allocator);
+        }
+        else
+        {
+            imageConvert(_dst, _tiles->m_srcFormat, result, _tiles->m_allocator);
+            imageUnload(result, _tiles->m_allocator);
+        }
+
+        radianceFilterTilesDestroy(_tiles);
+        return true;
+    }
+
+    void radianceFilterTilesDestroy(RadianceFilterTiles* _tiles)
+    {
+        if (NULL != _tiles->m_dstData)
+        {
+            CMFT_FREE(&g_crtAllocator, _tiles->m_dstData);
+        }
+        CMFT_FREE(&g_crtAllocator, _tiles->m_tiles);
+        CMFT_FREE(&g_crtAllocator, _tiles->m_cubemapVectors);
+        imageUnload(_tiles->m_imageRgba32f, _tiles->m_allocator);
+        delete _tiles;
+    }
+
 } // namespace cmft
 
 /* vim: set sw=4 ts=4 expandtab: */
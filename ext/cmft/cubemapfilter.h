@@ -101,6 +101,34 @@ namespace cmft
                            , AllocatorI* _allocator = g_allocator
                            );
 
+    /// Radiance filter split into tiles, for callers running the work on their own scheduler.
+    /// A tile is a range of rows of one face of one mip. Tiles can be filtered concurrently,
+    /// in any order, and filtering can be stopped between two tiles.
+    struct RadianceFilterTiles;
+
+    /// Prepares destination data and the tile list. Returns NULL if source is not a cubemap.
+    RadianceFilterTiles* radianceFilterTilesCreate(const Image& _src
+                                                 , uint32_t _dstFaceSize
+                                                 , LightingModel::Enum _lightingModel
+                                                 , bool _excludeBase
+                                                 , uint8_t _mipCount
+                                                 , uint8_t _glossScale
+                                                 , uint8_t _glossBias
+                                                 , EdgeFixup::Enum _edgeFixup = EdgeFixup::None
+                                                 , AllocatorI* _allocator = g_allocator
+                                                 );
+
+    uint32_t radianceFilterTilesCount(const RadianceFilterTiles* _tiles);
+
+    /// Filters one tile. Thread safe for distinct tiles.
+    void radianceFilterTile(RadianceFilterTiles* _tiles, uint32_t _tile);
+
+    /// Once every tile is filtered, moves the result into _dst with the source format and releases tiles.
+    bool radianceFilterTilesFinish(Image& _dst, RadianceFilterTiles* _tiles);
+
+    /// Releases tiles without producing a result.
+    void radianceFilterTilesDestroy(RadianceFilterTiles* _tiles);
+
 } // namespace cmft
 
 #endif // CMFT_CUBEMAPFILTER_H_HEADER_GUARD
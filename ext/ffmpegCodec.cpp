@@ -1,6 +1,7 @@
 #include "ffmpegCodec.h"
 
 #include <iostream>
+#include <sys/stat.h>
 
 namespace FFMPEGCodec
 {
@@ -104,6 +105,213 @@ namespace FFMPEGCodec
         av_register_all();
     }
 
+    FrameCache gFrameCache;
+
+    FrameData FrameCache::Get(const std::string& filename, int position)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mEntryMap.find(Key(filename, position));
+        if (iter == mEntryMap.end())
+            return FrameData();
+        mEntries.splice(mEntries.begin(), mEntries, iter->second);
+        return iter->second->mData;
+    }
+
+    void FrameCache::Add(const std::string& filename, int position, FrameData frameData)
+    {
+        if (!frameData)
+            return;
+        // shared with the decode ahead ring : buffers still referenced here are never recycled
+        std::lock_guard<std::mutex> lock(mMutex);
+        Key key(filename, position);
+        auto iter = mEntryMap.find(key);
+        if (iter != mEntryMap.end())
+        {
+            mSize -= iter->second->mData->size();
+            mEntries.erase(iter->second);
+            mEntryMap.erase(iter);
+        }
+        mEntries.push_front({ key, frameData });
+        mEntryMap[key] = mEntries.begin();
+        mSize += frameData->size();
+        Evict();
+    }
+
+    void FrameCache::Remove(const std::string& filename)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto iter = mEntries.begin(); iter != mEntries.end();)
+        {
+            if (iter->mKey.first == filename)
+            {
+                mSize -= iter->mData->size();
+                mEntryMap.erase(iter->mKey);
+                iter = mEntries.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    void FrameCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEntries.clear();
+        mEntryMap.clear();
+        mSize = 0;
+    }
+
+    void FrameCache::SetBudget(size_t budget)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBudget = budget;
+        Evict();
+    }
+
+    void FrameCache::Evict()
+    {
+        while (mSize > mBudget && !mEntries.empty())
+        {
+            const Entry& entry = mEntries.back();
+            mSize -= entry.mData->size();
+            mEntryMap.erase(entry.mKey);
+            mEntries.pop_back();
+        }
+    }
+
+    DecoderPool gDecoderPool;
+    std::atomic<uintptr_t> Decoder::mHandleCounter(0);
+
+    static int64_t GetModificationTime(const std::string& filename)
+    {
+        struct stat fileStat;
+        if (stat(filename.c_str(), &fileStat) != 0)
+            return -1;
+        return int64_t(fileStat.st_mtime);
+    }
+
+    std::shared_ptr<Decoder> DecoderPool::Find(const std::string& filename, int64_t modificationTime)
+    {
+        for (size_t i = 0; i < mEntries.size(); i++)
+        {
+            Entry& entry = mEntries[i];
+            if (entry.mFilename != filename)
+                continue;
+            if (entry.mModificationTime == modificationTime)
+            {
+                entry.mLastUse = std::chrono::steady_clock::now();
+                entry.mLastUseCollect = mCollectCount;
+                return entry.mDecoder;
+            }
+            // file changed on disk. Stages still using the old decoder keep it alive.
+            Release(i);
+            break;
+        }
+        return NULL;
+    }
+
+    std::shared_ptr<Decoder> DecoderPool::Acquire(const std::string& filename)
+    {
+        const int64_t modificationTime = GetModificationTime(filename);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto decoder = Find(filename, modificationTime);
+            if (decoder)
+                return decoder;
+        }
+
+        // opening scans the keyframes : done unlocked so other decoder users don't wait for the file
+        auto decoder = std::make_shared<Decoder>();
+        if (!decoder->Open(filename))
+            return NULL;
+        decoder->SetCacheKey(filename + "@" + std::to_string(modificationTime));
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        // opened by another thread meanwhile
+        auto opened = Find(filename, modificationTime);
+        if (opened)
+            return opened;
+        mEntries.push_back({ filename, modificationTime, decoder, std::chrono::steady_clock::now(), mCollectCount });
+        mHandles[decoder->GetHandle()] = decoder;
+        Collect();
+        return decoder;
+    }
+
+    std::shared_ptr<Decoder> DecoderPool::Lock(uintptr_t handle)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mHandles.find(handle);
+        if (iter == mHandles.end())
+            return NULL;
+        return iter->second.lock();
+    }
+
+    void DecoderPool::SetBudget(size_t maxOpenDecoders, size_t maxMemory)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mMaxOpenDecoders = maxOpenDecoders;
+        mMaxMemory = maxMemory;
+        Collect();
+    }
+
+    void DecoderPool::CollectIdle()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Collect();
+        mCollectCount++;
+    }
+
+    void DecoderPool::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        while (!mEntries.empty())
+            Release(mEntries.size() - 1);
+        mHandles.clear();
+    }
+
+    void DecoderPool::Collect()
+    {
+        // images only hold a decoder handle : a decoder closed here makes Lock return NULL.
+        // Recently acquired decoders may still be waiting for their upload
+        while (true)
+        {
+            size_t memory = 0;
+            size_t idleIndex = mEntries.size();
+            for (size_t i = 0; i < mEntries.size(); i++)
+            {
+                Entry& entry = mEntries[i];
+                memory += entry.mDecoder->GetMemoryUsage();
+                const bool recentlyUsed = mCollectCount - entry.mLastUseCollect < 2;
+                if (entry.mDecoder.use_count() == 1 && !recentlyUsed && (idleIndex == mEntries.size() || entry.mLastUse < mEntries[idleIndex].mLastUse))
+                    idleIndex = i;
+            }
+            if (idleIndex == mEntries.size() || (mEntries.size() <= mMaxOpenDecoders && memory <= mMaxMemory))
+                break;
+            Release(idleIndex);
+        }
+        for (auto iter = mHandles.begin(); iter != mHandles.end();)
+        {
+            if (iter->second.expired())
+                iter = mHandles.erase(iter);
+            else
+                ++iter;
+        }
+    }
+
+    void DecoderPool::Release(size_t index)
+    {
+        gFrameCache.Remove(mEntries[index].mDecoder->GetCacheKey());
+        mEntries.erase(mEntries.begin() + index);
+    }
+
+    size_t Decoder::GetMemoryUsage()
+    {
+        std::lock_guard<std::mutex> lock(mDecodeMutex);
+        return (mDecodedFrames.size() + mFreeFrames.size() + (mCurrentFrame ? 1 : 0)) * m_rgb_buffer_size;
+    }
+
     bool Decoder::Open(const std::string &filename)
     {
         av_log_set_level(AV_LOG_FATAL);
@@ -189,28 +397,7 @@ namespace FFMPEGCodec
 
         mFrameCount = m_frames = stream->nb_frames;
         m_start_time = stream->start_time;
-        if (!m_frames)
-        {
-            Seek(0);
-            AVPacket pkt;
-            av_init_packet(&pkt);
-            av_read_frame(m_format_context, &pkt);
-            int64_t first_pts = pkt.pts;
-            int64_t max_pts = 0;
-            av_free_packet(&pkt); //because seek(int) uses m_format_context
-            Seek(1 << 29);
-            av_init_packet(&pkt); //Is this needed?
-            while (stream && av_read_frame(m_format_context, &pkt) >= 0)
-            {
-                int64_t current_pts = static_cast<int64_t> (av_q2d(stream->time_base) * (pkt.pts - first_pts) * Fps());
-                if (current_pts > max_pts)
-                {
-                    max_pts = current_pts + 1;
-                }
-                av_free_packet(&pkt); //Always free before format_context usage
-            }
-            m_frames = max_pts;
-        }
+        BuildKeyFrameIndex();
         m_frame = av_frame_alloc();
         m_rgb_frame = av_frame_alloc();
 
@@ -260,12 +447,9 @@ namespace FFMPEGCodec
             break;
         }
 
-        m_rgb_buffer.resize(
-            avpicture_get_size(m_dst_pix_format,
-                m_codec_context->width,
-                m_codec_context->height),
-            0
-        );
+        m_rgb_buffer_size = avpicture_get_size(m_dst_pix_format,
+            m_codec_context->width,
+            m_codec_context->height);
 
         m_sws_rgb_context = sws_getContext(
             m_codec_context->width,
@@ -283,9 +467,61 @@ namespace FFMPEGCodec
         mHeight = m_codec_context->height;
         m_nsubimages = m_frames;
         m_filename = filename;
+        if (mCacheKey.empty())
+            mCacheKey = filename;
         return true;
     }
 
+    void Decoder::BuildKeyFrameIndex()
+    {
+        // one pass over the packets without decoding them. Gets keyframe positions
+        // and the frame count when the container doesn't provide it.
+        AVStream *stream = m_format_context->streams[m_video_stream];
+        const int64_t startPts = (stream->start_time != int64_t(AV_NOPTS_VALUE)) ? stream->start_time : 0;
+        mKeyFrames.clear();
+        av_seek_frame(m_format_context, m_video_stream, startPts, AVSEEK_FLAG_BACKWARD);
+
+        int lastPosition = -1;
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        while (av_read_frame(m_format_context, &pkt) >= 0)
+        {
+            int64_t pts = (pkt.pts != int64_t(AV_NOPTS_VALUE)) ? pkt.pts : pkt.dts;
+            if (pkt.stream_index == m_video_stream && pts != int64_t(AV_NOPTS_VALUE))
+            {
+                const int position = PtsToFrame(pts);
+                lastPosition = std::max(lastPosition, position);
+                if (pkt.flags & AV_PKT_FLAG_KEY)
+                    mKeyFrames.push_back({ position, pts });
+            }
+            av_free_packet(&pkt);
+        }
+        std::sort(mKeyFrames.begin(), mKeyFrames.end(), [](const KeyFrame& a, const KeyFrame& b) { return a.mPosition < b.mPosition; });
+        if (!m_frames)
+        {
+            mFrameCount = m_frames = lastPosition + 1;
+        }
+
+        av_seek_frame(m_format_context, m_video_stream, startPts, AVSEEK_FLAG_BACKWARD);
+        avcodec_flush_buffers(m_codec_context);
+        m_last_decoded_pos = -1;
+    }
+
+    const Decoder::KeyFrame* Decoder::FindKeyFrame(int pos) const
+    {
+        auto iter = std::upper_bound(mKeyFrames.begin(), mKeyFrames.end(), pos, [](int position, const KeyFrame& keyFrame) { return position < keyFrame.mPosition; });
+        if (iter == mKeyFrames.begin())
+            return NULL;
+        return &(*(iter - 1));
+    }
+
+    int Decoder::PtsToFrame(int64_t pts) const
+    {
+        const int64_t startTime = (m_start_time != int64_t(AV_NOPTS_VALUE)) ? m_start_time : 0;
+        double seconds = av_q2d(m_format_context->streams[m_video_stream]->time_base) * (pts - startTime);
+        return int(seconds * Fps() + 0.5);
+    }
+
     bool Decoder::SeekSubimage(int subimage, int miplevel)
     {
         if (subimage < 0 || subimage >= m_nsubimages || miplevel > 0)
@@ -303,13 +539,15 @@ namespace FFMPEGCodec
 
     void *Decoder::GetRGBData()
     {
-        if (!m_rgb_frame)
+        std::lock_guard<std::mutex> lock(mDecodeMutex);
+        if (!mCurrentFrame)
             return NULL;
-        return m_rgb_frame->data[0];
+        return mCurrentFrame->data();
     }
 
     bool Decoder::Close(void)
     {
+        StopDecodeAhead();
         if (m_codec_context)
             avcodec_close(m_codec_context);
         if (m_format_context)
@@ -324,18 +562,159 @@ namespace FFMPEGCodec
 
     void Decoder::ReadFrame(int frame)
     {
-        if (!m_codec_context)
-            return;
-        if (m_last_decoded_pos + 1 != frame)
+        FrameData frameData = GetFrame(frame);
+        std::lock_guard<std::mutex> lock(mDecodeMutex);
+        mCurrentFrame = frameData;
+    }
+
+    FrameData Decoder::GetFrame(int frame)
+    {
+        if (!m_codec_context || m_frames <= 0)
+            return FrameData();
+        frame = std::max(std::min(frame, int(m_frames) - 1), 0);
+
+        std::unique_lock<std::mutex> lock(mDecodeMutex);
+        if (!mbDecodeAheadRunning)
+            StartDecodeAhead();
+
+        auto findFrame = [&]() {
+            return std::find_if(mDecodedFrames.begin(), mDecodedFrames.end(), [frame](const DecodedFrame& decoded) { return decoded.mPosition == frame; });
+        };
+        auto iter = findFrame();
+        if (iter == mDecodedFrames.end())
+        {
+            // scrubbing back to a recently decoded frame
+            FrameData cached = gFrameCache.Get(mCacheKey, frame);
+            if (cached)
+                return cached;
+        }
+        if (iter == mDecodedFrames.end())
+        {
+            // drop the ring even when the frame is the next one to decode : a full ring would block the decoding thread
+            for (auto& decoded : mDecodedFrames)
+                RecycleFrame(decoded.mData);
+            mDecodedFrames.clear();
+            if (frame != mNextDecodePosition)
+            {
+                // scrub or loop : restart decoding from the new position
+                mNextDecodePosition = frame;
+                mDecodeGeneration++;
+            }
+            mDecodeCondition.notify_one();
+        }
+        while (iter == mDecodedFrames.end() && mbDecodeAheadRunning)
+        {
+            mFrameReadyCondition.wait(lock);
+            iter = findFrame();
+        }
+        if (iter == mDecodedFrames.end())
+            return FrameData();
+
+        FrameData frameData = iter->mData;
+        // frames before the read position will not be used by playback anymore.
+        // The read frame stays in the ring : a paused timeline or another consumer reads it again.
+        for (auto consumed = mDecodedFrames.begin(); consumed != iter; ++consumed)
+        {
+            if (consumed->mData != frameData)
+                RecycleFrame(consumed->mData);
+        }
+        mDecodedFrames.erase(mDecodedFrames.begin(), iter);
+        mDecodeCondition.notify_one();
+        return frameData;
+    }
+
+    void Decoder::StartDecodeAhead()
+    {
+        mbDecodeAheadRunning = true;
+        mDecodeThread = std::thread([this]() { DecodeAheadLoop(); });
+    }
+
+    void Decoder::StopDecodeAhead()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mDecodeMutex);
+            if (!mbDecodeAheadRunning)
+                return;
+            mbDecodeAheadRunning = false;
+        }
+        mDecodeCondition.notify_all();
+        mFrameReadyCondition.notify_all();
+        if (mDecodeThread.joinable())
+            mDecodeThread.join();
+    }
+
+    FrameData Decoder::AllocateFrame()
+    {
+        // reuse a buffer nobody holds anymore
+        while (!mFreeFrames.empty())
+        {
+            FrameData frameData = mFreeFrames.back();
+            mFreeFrames.pop_back();
+            if (frameData.use_count() == 1)
+                return frameData;
+        }
+        return std::make_shared<std::vector<uint8_t> >(m_rgb_buffer_size);
+    }
+
+    void Decoder::RecycleFrame(FrameData frameData)
+    {
+        if (frameData && mFreeFrames.size() < mDecodeAheadSize)
+            mFreeFrames.push_back(frameData);
+    }
+
+    void Decoder::DecodeAheadLoop()
+    {
+        std::unique_lock<std::mutex> lock(mDecodeMutex);
+        while (true)
+        {
+            mDecodeCondition.wait(lock, [&]() {
+                // + 1 for the last read frame at the front of the ring
+                return !mbDecodeAheadRunning || (mDecodedFrames.size() < mDecodeAheadSize + 1 && mNextDecodePosition < int(m_frames));
+            });
+            if (!mbDecodeAheadRunning)
+                break;
+
+            const int position = mNextDecodePosition;
+            const unsigned int generation = mDecodeGeneration;
+            FrameData frameData = AllocateFrame();
+            lock.unlock();
+
+            // AVFormatContext and codec are only used by this thread once decode ahead is running
+            bool decoded = DecodeFrame(position, frameData->data());
+            if (decoded)
+                gFrameCache.Add(mCacheKey, position, frameData);
+
+            lock.lock();
+            if (generation != mDecodeGeneration)
+            {
+                // playhead moved while decoding
+                RecycleFrame(frameData);
+                continue;
+            }
+            // an empty frame still unblocks readers waiting for that position
+            mDecodedFrames.push_back({ position, decoded ? frameData : FrameData() });
+            mNextDecodePosition = position + 1;
+            mFrameReadyCondition.notify_all();
+        }
+    }
+
+    bool Decoder::DecodeFrame(int frame, uint8_t *rgb)
+    {
+        // keep decoding forward when the frame is in the current GOP
+        const KeyFrame* keyFrame = FindKeyFrame(frame);
+        bool decodeForward = m_last_decoded_pos >= 0 && m_last_decoded_pos < frame &&
+            (m_last_decoded_pos + 1 == frame || (keyFrame && keyFrame->mPosition <= m_last_decoded_pos));
+        if (!decodeForward)
         {
             Seek(frame);
         }
+        bool found = false;
         AVPacket pkt;
         int finished = 0;
         int ret = 0;
         while ((ret = av_read_frame(m_format_context, &pkt)) == 0 || m_codec_cap_delay)
         {
-            if (pkt.stream_index == m_video_stream)
+            if (pkt.stream_index == m_video_stream || ret < 0)
             {
                 if (ret < 0 && m_codec_cap_delay)
                 {
@@ -345,15 +724,13 @@ namespace FFMPEGCodec
 
                 finished = receive_frame(m_codec_context, m_frame, &pkt);
 
-                //int64_t pts = m_frame->pts;
-                
-                double pts = 0;
-                //if (static_cast<int64_t>(m_frame->pkt_pts) != int64_t(AV_NOPTS_VALUE))
+                if (ret < 0 && !finished)
                 {
-                    pts = av_q2d(m_format_context->streams[m_video_stream]->time_base) *  (m_frame->pts - m_start_time);
+                    // end of stream and delayed frames are flushed
+                    break;
                 }
-                
-                int current_frame = int((pts) * Fps() + 0.5f);
+
+                int current_frame = PtsToFrame(m_frame->pts);
 
                 //Log("Current frame %d\n", current_frame2);
 
@@ -364,7 +741,7 @@ namespace FFMPEGCodec
                     avpicture_fill
                     (
                         reinterpret_cast<AVPicture*>(m_rgb_frame),
-                        &m_rgb_buffer[0],
+                        rgb,
                         m_dst_pix_format,
                         m_codec_context->width,
                         m_codec_context->height
@@ -381,12 +758,14 @@ namespace FFMPEGCodec
                     );
                     m_last_decoded_pos = current_frame;
                     av_free_packet(&pkt);
+                    found = true;
                     break;
                 }
             }
             av_free_packet(&pkt);
         }
         m_read_frame = true;
+        return found;
     }
 
     int64_t FrameToPts(AVStream* pavStream, int frame)
@@ -398,10 +777,18 @@ namespace FFMPEGCodec
 
     bool Decoder::Seek(int frame)
     {
+        avcodec_flush_buffers(m_codec_context);
+        m_last_decoded_pos = -1;
+        const KeyFrame* keyFrame = FindKeyFrame(frame);
+        if (keyFrame)
+        {
+            // land exactly on the GOP start
+            av_seek_frame(m_format_context, m_video_stream, keyFrame->mPts, AVSEEK_FLAG_BACKWARD);
+            return true;
+        }
         //int64_t offset = TimeStamp(frame);
         int64_t offset = FrameToPts(m_format_context->streams[m_video_stream], frame);
         int flags = AVSEEK_FLAG_BACKWARD;// AVSEEK_FLAG_ANY | AVSEEK_FLAG_FRAME;
-        avcodec_flush_buffers(m_codec_context);
         av_seek_frame(m_format_context, -1, offset, flags);
         return true;
     }
@@ -436,6 +823,8 @@ namespace FFMPEGCodec
     void Encoder::Init(const std::string& filename, int width, int height, int fpsrate, int bitrate)
     {
         mFilename = filename;
+        mWidth = width;
+        mHeight = height;
         fps = fpsrate;
 
         int err;
@@ -481,6 +870,9 @@ namespace FFMPEGCodec
         cctx->time_base = { 1, fps };
         cctx->max_b_frames = 2;
         cctx->gop_size = 12;
+        // let the codec pick its thread count
+        cctx->thread_count = 0;
+        cctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
         /*if (videoStream->codecpar->codec_id == AV_CODEC_ID_H264) {
         av_opt_set(cctx, "preset", "ultrafast", 0);
         }*/
@@ -510,11 +902,79 @@ namespace FFMPEGCodec
         }
 
         av_dump_format(ofctx, 0, VIDEO_TMP_FILE, 1);
+
+        mbEncoding = true;
+        mEncodeThread = std::thread([this]() { EncodeLoop(); });
     }
 
     void Encoder::AddFrame(uint8_t *data, int width, int height) 
+    {
+        QueueFrame(data, size_t(width) * height * 4, width, height, false);
+    }
+
+    void Encoder::AddFrameYUV420(const uint8_t *data, int width, int height)
+    {
+        QueueFrame(data, size_t(width) * height * 3 / 2, width, height, true);
+    }
+
+    void Encoder::QueueFrame(const uint8_t *data, size_t size, int width, int height, bool yuv420)
+    {
+        std::unique_lock<std::mutex> lock(mQueueMutex);
+        if (!mbEncoding)
+            return;
+        mQueueSpaceCondition.wait(lock, [&]() { return mQueue.size() < mMaxQueuedFrames; });
+
+        std::vector<uint8_t> buffer;
+        if (!mFreeBuffers.empty())
+        {
+            buffer.swap(mFreeBuffers.back());
+            mFreeBuffers.pop_back();
+        }
+        buffer.assign(data, data + size);
+        mQueue.push_back({ std::move(buffer), width, height, yuv420 });
+        mQueueCondition.notify_one();
+    }
+
+    void Encoder::EncodeLoop()
+    {
+        std::unique_lock<std::mutex> lock(mQueueMutex);
+        while (true)
+        {
+            mQueueCondition.wait(lock, [&]() { return !mbEncoding || !mQueue.empty(); });
+            if (mQueue.empty())
+                break;
+
+            QueuedFrame frame = std::move(mQueue.front());
+            mQueue.pop_front();
+            mQueueSpaceCondition.notify_one();
+            lock.unlock();
+
+            EncodeFrame(frame);
+
+            lock.lock();
+            mFreeBuffers.push_back(std::move(frame.mData));
+        }
+    }
+
+    void Encoder::StopEncoding()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mQueueMutex);
+            mbEncoding = false;
+        }
+        // queued frames are encoded before the thread exits
+        mQueueCondition.notify_all();
+        if (mEncodeThread.joinable())
+            mEncodeThread.join();
+        mFreeBuffers.clear();
+    }
+
+    void Encoder::EncodeFrame(QueuedFrame& frame)
     {
         int err;
+        uint8_t *data = frame.mData.data();
+        const int width = frame.mWidth;
+        const int height = frame.mHeight;
         if (!videoFrame) {
 
             videoFrame = av_frame_alloc();
@@ -527,29 +987,56 @@ namespace FFMPEGCodec
                 return;
             }
         }
+        if (frame.mbYUV420 && (width != cctx->width || height != cctx->height)) {
+            Debug("YUV420 frame size doesn't match the encoder size", 0);
+            return;
+        }
+        // the codec may still reference the previous frame
+        if ((err = av_frame_make_writable(videoFrame)) < 0) {
+            Debug("Failed to make picture writable", err);
+            return;
+        }
 
-        // flip
-        for (int i = 0; i < (height >> 1); i++)
+        if (frame.mbYUV420)
         {
-            uint32_t *src = ((uint32_t*)data) + i * width;
-            uint32_t *dst = ((uint32_t*)data) + (height-i-1) * width;
-            for (int j = 0; j < width; j++)
+            // converted on the GPU : copy planes
+            const uint8_t *src = data;
+            for (int plane = 0; plane < 3; plane++)
             {
-                uint32_t t = *dst;
-                *dst++ = *src;
-                *src++ = t;
+                const int planeWidth = plane ? (width >> 1) : width;
+                const int planeHeight = plane ? (height >> 1) : height;
+                for (int j = 0; j < planeHeight; j++)
+                {
+                    memcpy(videoFrame->data[plane] + j * videoFrame->linesize[plane], src, planeWidth);
+                    src += planeWidth;
+                }
             }
         }
+        else
+        {
+            // flip
+            for (int i = 0; i < (height >> 1); i++)
+            {
+                uint32_t *src = ((uint32_t*)data) + i * width;
+                uint32_t *dst = ((uint32_t*)data) + (height-i-1) * width;
+                for (int j = 0; j < width; j++)
+                {
+                    uint32_t t = *dst;
+                    *dst++ = *src;
+                    *src++ = t;
+                }
+            }
 
-        if (!swsCtx) {
-            swsCtx = sws_getContext(cctx->width, cctx->height, AV_PIX_FMT_RGBA, cctx->width, cctx->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, 0, 0, 0);
-        }
+            if (!swsCtx) {
+                swsCtx = sws_getContext(cctx->width, cctx->height, AV_PIX_FMT_RGBA, cctx->width, cctx->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, 0, 0, 0);
+            }
 
-        int inLinesize[1] = { 4 * width };
+            int inLinesize[1] = { 4 * width };
 
-        // From RGB to YUV
+            // From RGB to YUV
 
-        sws_scale(swsCtx, (const uint8_t * const *)&data, inLinesize, 0, height, videoFrame->data, videoFrame->linesize);
+            sws_scale(swsCtx, (const uint8_t * const *)&data, inLinesize, 0, height, videoFrame->data, videoFrame->linesize);
+        }
 
         videoFrame->pts = frameCounter++;
 
@@ -563,7 +1050,8 @@ namespace FFMPEGCodec
         pkt.data = NULL;
         pkt.size = 0;
 
-        if (avcodec_receive_packet(cctx, &pkt) == 0) {
+        // threaded codecs can output several packets at once
+        while (avcodec_receive_packet(cctx, &pkt) == 0) {
             pkt.flags |= AV_PKT_FLAG_KEY;
             av_interleaved_write_frame(ofctx, &pkt);
             av_packet_unref(&pkt);
@@ -571,6 +1059,12 @@ namespace FFMPEGCodec
     }
 
     void Encoder::Finish() {
+        StopEncoding();
+        if (!cctx || !ofctx) {
+            Free();
+            return;
+        }
+
         //DELAYED FRAMES
         AVPacket pkt;
         av_init_packet(&pkt);
@@ -12,6 +12,15 @@
 #include <string.h>
 #include <algorithm>
 #include <string> 
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <chrono>
+#include <atomic>
 
 namespace FFMPEGCodec
 {
@@ -19,10 +28,45 @@ namespace FFMPEGCodec
 
     using namespace std;
 
+    // decoded RGB frame. Shared between the decode ahead ring and its consumers.
+    typedef std::shared_ptr<std::vector<uint8_t> > FrameData;
+
+    // LRU cache of decoded frames, shared by every decoder reading the same file.
+    // Least recently used frames are dropped when the memory budget is exceeded.
+    class FrameCache
+    {
+    public:
+        FrameCache() : mSize(0), mBudget(256 * 1024 * 1024) {}
+
+        FrameData Get(const std::string& filename, int position);
+        void Add(const std::string& filename, int position, FrameData frameData);
+        void Remove(const std::string& filename);
+        void Clear();
+
+        void SetBudget(size_t budget);
+        size_t GetSize() const { return mSize; }
+
+    private:
+        typedef std::pair<std::string, int> Key;
+        struct Entry
+        {
+            Key mKey;
+            FrameData mData;
+        };
+        std::mutex mMutex;
+        std::list<Entry> mEntries; // most recently used first
+        std::map<Key, std::list<Entry>::iterator> mEntryMap;
+        size_t mSize;
+        size_t mBudget;
+
+        void Evict();
+    };
+    extern FrameCache gFrameCache;
+
     class Decoder
     {
     public:
-        Decoder() { Init(); }
+        Decoder() : mHandle(++mHandleCounter), mbDecodeAheadRunning(false), mDecodeAheadSize(8) { Init(); }
         virtual ~Decoder() 
         { 
             Close(); 
@@ -36,6 +80,9 @@ namespace FFMPEGCodec
 
         void *GetRGBData();
         void ReadFrame(int pos);
+        // returns the RGB frame at pos. Frames are decoded ahead of pos by a background thread
+        // so sequential reads usually return immediately. Thread safe.
+        FrameData GetFrame(int pos);
 
         bool Seek(int pos);
         double Fps() const;
@@ -44,7 +91,54 @@ namespace FFMPEGCodec
         size_t mWidth, mHeight;
         size_t mFrameCount;
         const std::string GetFilename() const { return m_filename; }
+        // frames are shared in gFrameCache with every decoder using the same key. Defaults to the file name.
+        void SetCacheKey(const std::string& cacheKey) { mCacheKey = cacheKey; }
+        const std::string& GetCacheKey() const { return mCacheKey; }
+        // decoded frames held by this decoder, frame cache excluded
+        size_t GetMemoryUsage();
+        // identifies the decoder in an Image without keeping it alive. See DecoderPool::Lock
+        uintptr_t GetHandle() const { return mHandle; }
     private:
+        std::string mCacheKey;
+        uintptr_t mHandle;
+        static std::atomic<uintptr_t> mHandleCounter;
+
+        // decode ahead
+        struct DecodedFrame
+        {
+            int mPosition;
+            FrameData mData;
+        };
+        std::thread mDecodeThread;
+        std::mutex mDecodeMutex;
+        std::condition_variable mDecodeCondition; // wakes up the decoding thread
+        std::condition_variable mFrameReadyCondition; // wakes up readers
+        std::deque<DecodedFrame> mDecodedFrames; // contiguous positions, ahead of the last read
+        std::vector<FrameData> mFreeFrames;
+        FrameData mCurrentFrame;
+        bool mbDecodeAheadRunning;
+        size_t mDecodeAheadSize;
+        int mNextDecodePosition;
+        unsigned int mDecodeGeneration; // incremented when the ring is resynced on scrub/loop
+
+        void StartDecodeAhead();
+        void StopDecodeAhead();
+        void DecodeAheadLoop();
+        FrameData AllocateFrame();
+        void RecycleFrame(FrameData frameData);
+        bool DecodeFrame(int pos, uint8_t *rgb);
+
+        // keyframe index, built when opening : random access decodes at most one GOP
+        struct KeyFrame
+        {
+            int mPosition;
+            int64_t mPts;
+        };
+        std::vector<KeyFrame> mKeyFrames;
+        void BuildKeyFrameIndex();
+        const KeyFrame* FindKeyFrame(int pos) const;
+        int PtsToFrame(int64_t pts) const;
+
 
         std::string m_filename;
         int m_subimage;
@@ -58,7 +152,7 @@ namespace FFMPEGCodec
         AVPixelFormat m_dst_pix_format;
         SwsContext *m_sws_rgb_context;
         AVRational m_frame_rate;
-        std::vector<uint8_t> m_rgb_buffer;
+        size_t m_rgb_buffer_size;
         std::vector<int> m_video_indexes;
         int m_video_stream;
         int64_t m_frames;
@@ -72,6 +166,7 @@ namespace FFMPEGCodec
         // init to initialize state
         void Init(void) {
             m_filename.clear();
+            mCacheKey.clear();
             m_format_context = 0;
             m_codec_context = 0;
             m_codec = 0;
@@ -79,7 +174,7 @@ namespace FFMPEGCodec
             m_rgb_frame = 0;
             m_sws_rgb_context = 0;
             m_stride = 0;
-            m_rgb_buffer.clear();
+            m_rgb_buffer_size = 0;
             m_video_indexes.clear();
             m_video_stream = -1;
             m_frames = 0;
@@ -91,8 +186,55 @@ namespace FFMPEGCodec
             m_subimage = 0;
             m_start_time = 0;
             mFrameCount = 0;
+            mDecodedFrames.clear();
+            mFreeFrames.clear();
+            mCurrentFrame.reset();
+            mNextDecodePosition = 0;
+            mDecodeGeneration = 0;
+            mKeyFrames.clear();
         }
     };
+
+    // Process wide pool of opened decoders, keyed by path and modification time.
+    // Stages and evaluation contexts reading the same clip share one decoder.
+    // Decoders not referenced outside the pool are closed, least recently used first,
+    // when the count of opened files or the decoders memory exceeds the budget.
+    class DecoderPool
+    {
+    public:
+        DecoderPool() : mMaxOpenDecoders(16), mMaxMemory(512 * 1024 * 1024), mCollectCount(0) {}
+
+        // returns NULL if the file can't be opened as a video
+        std::shared_ptr<Decoder> Acquire(const std::string& filename);
+        // returns the decoder with that handle or NULL if it has been closed
+        std::shared_ptr<Decoder> Lock(uintptr_t handle);
+        void SetBudget(size_t maxOpenDecoders, size_t maxMemory);
+        // called once per frame. Decoders acquired during the last 2 calls are kept : images returned by Read
+        // only hold a handle until SetEvaluationImage gives the decoder to the stage
+        void CollectIdle();
+        void Clear();
+
+    private:
+        struct Entry
+        {
+            std::string mFilename;
+            int64_t mModificationTime;
+            std::shared_ptr<Decoder> mDecoder;
+            std::chrono::steady_clock::time_point mLastUse;
+            unsigned int mLastUseCollect; // mCollectCount when last acquired
+        };
+        std::mutex mMutex;
+        std::vector<Entry> mEntries;
+        std::map<uintptr_t, std::weak_ptr<Decoder> > mHandles; // every decoder opened by the pool, closed ones are swept by Collect
+        size_t mMaxOpenDecoders;
+        size_t mMaxMemory;
+        unsigned int mCollectCount;
+
+        std::shared_ptr<Decoder> Find(const std::string& filename, int64_t modificationTime);
+        void Collect();
+        void Release(size_t index);
+    };
+    extern DecoderPool gDecoderPool;
     
     
     class Encoder {
@@ -103,22 +245,56 @@ namespace FFMPEGCodec
             ofctx = NULL;
             videoStream = NULL;
             videoFrame = NULL;
+            cctx = NULL;
             swsCtx = NULL;
             frameCounter = 0;
+            mbEncoding = false;
+            mMaxQueuedFrames = 4;
+            mWidth = mHeight = 0;
         }
 
         ~Encoder() {
+            StopEncoding();
             Free();
         }
 
         void Init(const std::string& filename, int width, int height, int fpsrate, int bitrate);
 
+        // frames are copied and encoded by the encoder thread. Blocks while the queue is full.
+        // RGBA, bottom-up rows
         void AddFrame(uint8_t *data, int width, int height);
+        // planar YUV420, top-down rows, at the encoder size
+        void AddFrameYUV420(const uint8_t *data, int width, int height);
+        // stream size, set by Init
+        int GetWidth() const { return mWidth; }
+        int GetHeight() const { return mHeight; }
 
         void Finish();
 
     private:
+        struct QueuedFrame
+        {
+            std::vector<uint8_t> mData;
+            int mWidth;
+            int mHeight;
+            bool mbYUV420;
+        };
+        std::thread mEncodeThread;
+        std::mutex mQueueMutex;
+        std::condition_variable mQueueCondition; // wakes up the encoder thread
+        std::condition_variable mQueueSpaceCondition; // wakes up producers
+        std::deque<QueuedFrame> mQueue;
+        std::vector<std::vector<uint8_t> > mFreeBuffers;
+        size_t mMaxQueuedFrames;
+        bool mbEncoding;
+
+        void QueueFrame(const uint8_t *data, size_t size, int width, int height, bool yuv420);
+        void EncodeLoop();
+        void StopEncoding();
+        void EncodeFrame(QueuedFrame& frame);
+
         std::string mFilename;
+        int mWidth, mHeight;
         AVOutputFormat *oformat;
         AVFormatContext *ofctx;
 
@@ -40,10 +40,12 @@
 
 #include "cmft/image.h"
 #include "cmft/cubemapfilter.h"
+#include "cmft/cubemaputils.h"
 #include "cmft/print.h"
 #include "ffmpegCodec.h"
 
 extern cmft::ClContext* clContext;
+ImageBufferPool gImageBufferPool;
 ImageCache gImageCache;
 DefaultShaders gDefaultShader;
 
@@ -90,11 +92,118 @@ const unsigned int glCubeFace[] = {
 const unsigned int textureFormatSize[] = { 3,3,6,6,12, 4,4,4,8,8,16,4 };
 const unsigned int textureComponentCount[] = { 3,3,3,3,3, 4,4,4,4,4,4,4 };
 
+ImageBufferPool::~ImageBufferPool()
+{
+    Clear();
+}
+
+size_t ImageBufferPool::GetBucketSize(size_t size)
+{
+    // 4 buckets per power of 2 : at most 25% of the buffer is wasted
+    size_t power = 1;
+    while ((power << 1) < size)
+        power <<= 1;
+    const size_t step = (power >= 4) ? (power >> 2) : 1;
+    return (size + step - 1) & ~(step - 1);
+}
+
+unsigned char* ImageBufferPool::Allocate(size_t size)
+{
+    static const size_t minPooledSize = 64 * 1024;
+    if (size < minPooledSize)
+        return (unsigned char*)malloc(size);
+
+    const size_t bucketSize = GetBucketSize(size);
+    std::lock_guard<std::mutex> lock(mMutex);
+    unsigned char* bits = NULL;
+    auto iter = mFreeBuffers.find(bucketSize);
+    if (iter != mFreeBuffers.end() && !iter->second.empty())
+    {
+        bits = iter->second.back();
+        iter->second.pop_back();
+        mRetainedSize -= bucketSize;
+    }
+    else
+    {
+        bits = (unsigned char*)malloc(bucketSize);
+        if (!bits)
+            return NULL;
+    }
+    mPoolBuffers[bits] = bucketSize;
+    return bits;
+}
+
+void ImageBufferPool::Retain(unsigned char* bits)
+{
+    if (!bits)
+        return;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRetainCounts[bits]++;
+}
+
+void ImageBufferPool::Release(unsigned char* bits)
+{
+    if (!bits)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto retain = mRetainCounts.find(bits);
+        if (retain != mRetainCounts.end())
+        {
+            if (!--retain->second)
+                mRetainCounts.erase(retain);
+            return;
+        }
+        auto iter = mPoolBuffers.find(bits);
+        if (iter != mPoolBuffers.end())
+        {
+            const size_t bucketSize = iter->second;
+            mPoolBuffers.erase(iter);
+            if (mRetainedSize + bucketSize <= mMaxRetainedSize)
+            {
+                mFreeBuffers[bucketSize].push_back(bits);
+                mRetainedSize += bucketSize;
+                return;
+            }
+        }
+    }
+    free(bits);
+}
+
+void ImageBufferPool::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& bucket : mFreeBuffers)
+    {
+        for (auto bits : bucket.second)
+            free(bits);
+    }
+    mFreeBuffers.clear();
+    mRetainedSize = 0;
+}
+
+void ImageBufferPool::SetMaxRetainedSize(size_t maxRetainedSize)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMaxRetainedSize = maxRetainedSize;
+    // drop biggest buffers first
+    for (auto iter = mFreeBuffers.rbegin(); iter != mFreeBuffers.rend() && mRetainedSize > mMaxRetainedSize; ++iter)
+    {
+        auto& buffers = iter->second;
+        while (!buffers.empty() && mRetainedSize > mMaxRetainedSize)
+        {
+            free(buffers.back());
+            buffers.pop_back();
+            mRetainedSize -= iter->first;
+        }
+    }
+}
+
 Image Image::DecodeImage(FFMPEGCodec::Decoder *decoder, int frame)
 {
-    decoder->ReadFrame(frame);
+    FFMPEGCodec::FrameData frameData = decoder->GetFrame(frame);
     Image image;
-    image.mDecoder = decoder;
+    image.mDecoder = (void*)decoder->GetHandle();
     image.mNumMips = 1;
     image.mNumFaces = 1;
     image.mFormat = TextureFormat::BGR8;
@@ -105,7 +214,7 @@ Image Image::DecodeImage(FFMPEGCodec::Decoder *decoder, int frame)
     image.Allocate(imgDataSize);
 
     unsigned char *pdst = image.GetBits();
-    unsigned char *psrc = (unsigned char*)decoder->GetRGBData();
+    unsigned char *psrc = frameData ? frameData->data() : NULL;
     if (psrc && pdst)
     {
         psrc += imgDataSize - lineSize;
@@ -134,12 +243,11 @@ int Image::LoadSVG(const char *filename, Image *image, float dpi)
 
     // Allocate memory for image
     size_t imgSize = width * height * 4;
-    unsigned char* img = (unsigned char*)malloc(imgSize);
+    image->Allocate(imgSize);
 
     // Rasterize
-    nsvgRasterize(rast, svgImage, 0, 0, 1, img, width, height, width * 4);
+    nsvgRasterize(rast, svgImage, 0, 0, 1, image->GetBits(), width, height, width * 4);
 
-    image->SetBits(img, imgSize);
     image->mWidth = width;
     image->mHeight = height;
     image->mNumMips = 1;
@@ -170,7 +278,8 @@ int Image::Read(const char *filename, Image *image)
             return EVAL_ERR;
         }
         cmft::imageTransformUseMacroInstead(&img, cmft::IMAGE_OP_FLIP_X, UINT32_MAX);
-        image->SetBits((unsigned char*)img.m_data, img.m_dataSize);
+        image->AdoptBits((unsigned char*)img.m_data, img.m_dataSize);
+        img.m_data = NULL;
         image->mWidth = img.m_width;
         image->mHeight = img.m_height;
         image->mNumMips = img.m_numMips;
@@ -180,7 +289,7 @@ int Image::Read(const char *filename, Image *image)
         return EVAL_OK;
     }
 
-    image->SetBits(bits, image->mWidth * image->mHeight * components);
+    image->AdoptBits(bits, image->mWidth * image->mHeight * components);
     image->mNumMips = 1;
     image->mNumFaces = 1;
     image->mFormat = (components == 3) ? TextureFormat::RGB8 : TextureFormat::RGBA8;
@@ -217,7 +326,7 @@ int Image::ReadMem(unsigned char *data, size_t dataSize, Image *image)
     unsigned char *bits = stbi_load_from_memory(data, int(dataSize), &image->mWidth, &image->mHeight, &components, 0);
     if (!bits)
         return EVAL_ERR;
-    image->SetBits(bits, image->mWidth * image->mHeight * components);
+    image->AdoptBits(bits, image->mWidth * image->mHeight * components);
     return EVAL_OK;
 }
 
@@ -271,12 +380,15 @@ int Image::Write(const char *filename, Image *image, int format, int quality)
         img.m_numMips = image->mNumMips;
         img.m_data = image->GetBits();
         img.m_dataSize = image->mDataSize;
+        // convert to a temporary : image bits are owned by the pool, not by cmft
+        cmft::Image converted;
         if (img.m_format == cmft::TextureFormat::RGBA8)
-            cmft::imageConvert(img, cmft::TextureFormat::BGRA8);
+            cmft::imageConvert(converted, cmft::TextureFormat::BGRA8, img);
         else if (img.m_format == cmft::TextureFormat::RGB8)
-            cmft::imageConvert(img, cmft::TextureFormat::BGR8);
-        image->SetBits((unsigned char*)img.m_data, img.m_dataSize);
-        if (!cmft::imageSave(img, filename, cmft::ImageFileType::DDS))
+            cmft::imageConvert(converted, cmft::TextureFormat::BGR8, img);
+        bool saved = cmft::imageSave(converted.m_data ? converted : img, filename, cmft::ImageFileType::DDS);
+        cmft::imageUnload(converted);
+        if (!saved)
             return EVAL_ERR;
     }
     break;
@@ -317,7 +429,7 @@ int Image::EncodePng(Image *image, std::vector<unsigned char> &pngImage)
     return EVAL_OK;
 }
 
-int Image::CubemapFilter(Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias)
+int Image::CubemapFilter(Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias, const TileRunner& runTiles)
 {
     cmft::Image img;
     img.m_data = image->GetBits();
@@ -328,42 +440,212 @@ int Image::CubemapFilter(Image *image, int faceSize, int lightingModel, int excl
     img.m_height = image->mHeight;
     img.m_format = (cmft::TextureFormat::Enum)image->mFormat;
 
-    extern unsigned int gCPUCount;
-
     cmft::setWarningPrintf(Log);
     cmft::setInfoPrintf(Log);
 
-    faceSize = 16;
-    if (!cmft::imageRadianceFilter(img
+    // face size of the node, the source one when not set. A latlong source is 4 faces wide
+    if (faceSize <= 0)
+        faceSize = (image->mNumFaces == 6) ? image->mWidth : image->mWidth / 4;
+    if (faceSize < 2)
+        return EVAL_ERR;
+    uint8_t mipCount = uint8_t(log2(faceSize));
+    cmft::Image filtered;
+    // an OpenCL device filters the whole cubemap at once, CPU work is split into tiles
+    bool filteredWithCL = clContext && cmft::imageRadianceFilter(filtered
         , faceSize // face size
         , (cmft::LightingModel::Enum)lightingModel
         , (excludeBase != 0)
-        , uint8_t(log2(faceSize)) // map mip count
+        , mipCount
         , glossScale
         , glossBias
+        , img
         , cmft::EdgeFixup::None
-        , gCPUCount
-        , clContext))
-        return EVAL_ERR;
+        , 1 // calling thread finishes what the device could not process
+        , clContext);
+    if (!filteredWithCL)
+    {
+        cmft::RadianceFilterTiles* tiles = cmft::radianceFilterTilesCreate(img
+            , faceSize
+            , (cmft::LightingModel::Enum)lightingModel
+            , (excludeBase != 0)
+            , mipCount
+            , glossScale
+            , glossBias);
+        if (!tiles)
+            return EVAL_ERR;
+        if (!runTiles(cmft::radianceFilterTilesCount(tiles), [tiles](unsigned int tile) { cmft::radianceFilterTile(tiles, tile); }))
+        {
+            cmft::radianceFilterTilesDestroy(tiles);
+            return EVAL_DIRTY;
+        }
+        cmft::radianceFilterTilesFinish(filtered, tiles);
+    }
 
-    image->SetBits((unsigned char*)img.m_data, img.m_dataSize);
-    image->mNumMips = img.m_numMips;
-    image->mNumFaces = img.m_numFaces;
-    image->mWidth = img.m_width;
-    image->mHeight = img.m_height;
-    image->mFormat = img.m_format;
+    image->AdoptBits((unsigned char*)filtered.m_data, filtered.m_dataSize);
+    filtered.m_data = NULL;
+    image->mNumMips = filtered.m_numMips;
+    image->mNumFaces = filtered.m_numFaces;
+    image->mWidth = filtered.m_width;
+    image->mHeight = filtered.m_height;
+    image->mFormat = filtered.m_format;
     return EVAL_OK;
 }
 
+static const double PI = 3.14159265358979323846;
+
+// same direction convention as GLSL nodes : texels of a face are rendered with viewRot and sampled with InvertCubeY
+static void CubeTexelDirection(int face, float u, float v, float *dir)
+{
+    const float directions[6][3] = { { 1.f, -v, -u }, { -1.f, -v, u }, { u, 1.f, v }, { u, -1.f, -v }, { u, -v, 1.f }, { -u, -v, -1.f } };
+    const float invLength = 1.f / sqrtf(u * u + v * v + 1.f);
+    dir[0] = directions[face][0] * invLength;
+    dir[1] = -directions[face][1] * invLength;
+    dir[2] = directions[face][2] * invLength;
+}
+
+static void EvalSHBasis(const float *dir, float *basis)
+{
+    const float x = dir[0], y = dir[1], z = dir[2];
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * y;
+    basis[2] = 0.488603f * z;
+    basis[3] = 0.488603f * x;
+    basis[4] = 1.092548f * x * y;
+    basis[5] = 1.092548f * y * z;
+    basis[6] = 0.315392f * (3.f * z * z - 1.f);
+    basis[7] = 1.092548f * x * z;
+    basis[8] = 0.546274f * (x * x - y * y);
+}
+
+int Image::ProjectSH(const Image *image, float *coefficients, const TileRunner& runTiles)
+{
+    const bool isBGR = image->mFormat == TextureFormat::BGR8 || image->mFormat == TextureFormat::BGRA8;
+    const bool isRGB = image->mFormat == TextureFormat::RGB8 || image->mFormat == TextureFormat::RGBA8;
+    if ((!isBGR && !isRGB) || !image->GetBits() || (image->mNumFaces != 1 && image->mNumFaces != 6))
+        return EVAL_ERR;
+
+    const int width = image->mWidth;
+    const int height = image->mHeight;
+    const int texelSize = textureFormatSize[image->mFormat];
+    // faces are stored with their mips. Only mip 0 is used
+    size_t faceStride = 0;
+    for (int i = 0; i < image->mNumMips; i++)
+        faceStride += (width >> i) * (height >> i) * texelSize;
+
+    // 1 tile per row. Partial sums are kept per tile so the result doesn't depend on scheduling
+    const unsigned int rowCount = height * image->mNumFaces;
+    std::vector<double> partialSums(rowCount * 28, 0.);
+    auto projectRow = [&](unsigned int row) {
+        const int face = row / height;
+        const int y = row % height;
+        const unsigned char *texel = image->GetBits() + face * faceStride + y * width * texelSize;
+        double *sums = &partialSums[row * 28];
+        for (int x = 0; x < width; x++, texel += texelSize)
+        {
+            float dir[3];
+            float weight;
+            if (image->mNumFaces == 6)
+            {
+                const float u = (float(x) + 0.5f) / float(width) * 2.f - 1.f;
+                const float v = (float(y) + 0.5f) / float(height) * 2.f - 1.f;
+                CubeTexelDirection(face, u, v, dir);
+                weight = cmft::texelSolidAngle(u, v, 1.f / float(width));
+            }
+            else
+            {
+                // equirect mapping used by EquirectConverter
+                const float phi = (float(y) + 0.5f) / float(height) * float(PI);
+                const float theta = (float(x) + 0.5f) / float(width) * 2.f * float(PI) - float(PI);
+                dir[0] = -sinf(phi) * sinf(theta);
+                dir[1] = -cosf(phi);
+                dir[2] = sinf(phi) * cosf(theta);
+                weight = (2.f * float(PI) / float(width)) * (float(PI) / float(height)) * sinf(phi);
+            }
+            float basis[9];
+            EvalSHBasis(dir, basis);
+            const float r = texel[isBGR ? 2 : 0] / 255.f;
+            const float g = texel[1] / 255.f;
+            const float b = texel[isBGR ? 0 : 2] / 255.f;
+            for (int i = 0; i < 9; i++)
+            {
+                sums[i * 3 + 0] += r * basis[i] * weight;
+                sums[i * 3 + 1] += g * basis[i] * weight;
+                sums[i * 3 + 2] += b * basis[i] * weight;
+            }
+            sums[27] += weight;
+        }
+    };
+    if (!runTiles(rowCount, projectRow))
+        return EVAL_DIRTY;
+
+    double total[28] = { 0. };
+    for (unsigned int row = 0; row < rowCount; row++)
+    {
+        for (int i = 0; i < 28; i++)
+            total[i] += partialSums[row * 28 + i];
+    }
+    // texel weights don't exactly sum to the sphere area
+    const double normalization = (total[27] > 0.) ? (4. * PI) / total[27] : 0.;
+    for (int i = 0; i < 27; i++)
+        coefficients[i] = float(total[i] * normalization);
+    return EVAL_OK;
+}
+
+int Image::SHIrradiance(const float *coefficients, int faceSize, Image *image, const TileRunner& runTiles)
+{
+    if (faceSize < 1)
+        return EVAL_ERR;
+
+    // cosine lobe convolution (Ramamoorthi and Hanrahan) then division by PI
+    const float bandFactors[3] = { 1.f, 2.f / 3.f, 1.f / 4.f };
+    const int bands[9] = { 0, 1, 1, 1, 2, 2, 2, 2, 2 };
+    float irradiance[27];
+    for (int i = 0; i < 27; i++)
+        irradiance[i] = coefficients[i] * bandFactors[bands[i / 3]];
+
+    image->Allocate(faceSize * faceSize * 4 * 6);
+    image->mWidth = faceSize;
+    image->mHeight = faceSize;
+    image->mNumMips = 1;
+    image->mNumFaces = 6;
+    image->mFormat = TextureFormat::RGBA8;
+
+    auto reconstructRow = [&](unsigned int row) {
+        const int face = row / faceSize;
+        const int y = row % faceSize;
+        unsigned char *texel = image->GetBits() + (face * faceSize + y) * faceSize * 4;
+        for (int x = 0; x < faceSize; x++, texel += 4)
+        {
+            float dir[3];
+            CubeTexelDirection(face, (float(x) + 0.5f) / float(faceSize) * 2.f - 1.f, (float(y) + 0.5f) / float(faceSize) * 2.f - 1.f, dir);
+            float basis[9];
+            EvalSHBasis(dir, basis);
+            for (int c = 0; c < 3; c++)
+            {
+                float value = 0.f;
+                for (int i = 0; i < 9; i++)
+                    value += irradiance[i * 3 + c] * basis[i];
+                texel[c] = (unsigned char)(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+            }
+            texel[3] = 255;
+        }
+    };
+    if (!runTiles(faceSize * 6, reconstructRow))
+        return EVAL_DIRTY;
+    return EVAL_OK;
+}
+
 void DefaultShaders::Init()
 {
     std::ifstream prgStr("Stock/ProgressingNode.glsl");
     std::ifstream cubStr("Stock/DisplayCubemap.glsl");
     std::ifstream nodeErrStr("Stock/NodeError.glsl");
+    std::ifstream yuvStr("Stock/RGBAToYUV420.glsl");
 
     mProgressShader = prgStr.good() ? LoadShader(std::string(std::istreambuf_iterator<char>(prgStr), std::istreambuf_iterator<char>()), "progressShader") : 0;
     mDisplayCubemapShader = cubStr.good() ? LoadShader(std::string(std::istreambuf_iterator<char>(cubStr), std::istreambuf_iterator<char>()), "cubeDisplay") : 0;
     mNodeErrorShader = nodeErrStr.good() ? LoadShader(std::string(std::istreambuf_iterator<char>(nodeErrStr), std::istreambuf_iterator<char>()), "nodeError") : 0;
+    mRGBAToYUV420Shader = yuvStr.good() ? LoadShader(std::string(std::istreambuf_iterator<char>(yuvStr), std::istreambuf_iterator<char>()), "RGBAToYUV420") : 0;
 }
 
 unsigned int ImageCache::GetTexture(const std::string& filename)
@@ -399,9 +681,34 @@ void RenderTarget::BindAsCubeTarget() const
     glViewport(0, 0, mImage.mWidth, mImage.mHeight);
 }
 
-void RenderTarget::BindCubeFace(size_t face)
+void RenderTarget::BindCubeFace(size_t face, int mipmap)
 {
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face), mGLTexID, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face), mGLTexID, mipmap);
+    glViewport(0, 0, mImage.mWidth >> mipmap, mImage.mHeight >> mipmap);
+}
+
+void RenderTarget::BindMipmap(int mipmap)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, mFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mGLTexID, mipmap);
+    glViewport(0, 0, std::max(mImage.mWidth >> mipmap, 1), std::max(mImage.mHeight >> mipmap, 1));
+}
+
+void RenderTarget::GenerateMipmaps()
+{
+    if (!mGLTexID)
+        return;
+    int mipmapCount = 1;
+    while ((std::max(mImage.mWidth, mImage.mHeight) >> mipmapCount) > 0)
+        mipmapCount++;
+
+    unsigned int targetType = (mImage.mNumFaces == 6) ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    glBindTexture(targetType, mGLTexID);
+    glTexParameteri(targetType, GL_TEXTURE_MAX_LEVEL, mipmapCount - 1);
+    glGenerateMipmap(targetType);
+    glBindTexture(targetType, 0);
+    mImage.mNumMips = mipmapCount;
+    mbMipmapsGenerated = true;
 }
 
 void RenderTarget::Destroy()
@@ -417,6 +724,7 @@ void RenderTarget::Destroy()
     mFbo = 0;
     mImage.mWidth = mImage.mHeight = 0;
     mGLTexID = 0;
+    mbMipmapsGenerated = false;
 }
 
 void RenderTarget::Clone(const RenderTarget &other)
@@ -432,6 +740,7 @@ void RenderTarget::Swap(RenderTarget &other)
     ::Swap(mGLTexDepth, other.mGLTexDepth);
     ::Swap(mDepthBuffer, other.mDepthBuffer);
     ::Swap(mFbo, other.mFbo);
+    ::Swap(mbMipmapsGenerated, other.mbMipmapsGenerated);
 }
 
 void RenderTarget::InitBuffer(int width, int height, bool depthBuffer)
@@ -480,15 +789,15 @@ void RenderTarget::InitBuffer(int width, int height, bool depthBuffer)
     glViewport(last_viewport[0], last_viewport[1], (GLsizei)last_viewport[2], (GLsizei)last_viewport[3]);
 }
 
-void RenderTarget::InitCube(int width)
+void RenderTarget::InitCube(int width, int mipmapCount)
 {
-    if ((width == mImage.mWidth) && (mImage.mHeight == width) && mImage.mNumFaces == 6)
+    if ((width == mImage.mWidth) && (mImage.mHeight == width) && mImage.mNumFaces == 6 && mImage.mNumMips == mipmapCount)
         return;
     Destroy();
 
     mImage.mWidth = width;
     mImage.mHeight = width;
-    mImage.mNumMips = 1;
+    mImage.mNumMips = mipmapCount;
     mImage.mNumFaces = 6;
     mImage.mFormat = TextureFormat::RGBA8;
 
@@ -498,11 +807,14 @@ void RenderTarget::InitCube(int width)
     glGenTextures(1, &mGLTexID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, mGLTexID);
 
-    for (int i = 0; i < 6; i++)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, width, width, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-
+    for (int mip = 0; mip < mipmapCount; mip++)
+    {
+        for (int i = 0; i < 6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mip, GL_RGBA8, width >> mip, width >> mip, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipmapCount - 1);
 
-    TexParam(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_TEXTURE_CUBE_MAP);
+    TexParam((mipmapCount > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_TEXTURE_CUBE_MAP);
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, mGLTexID, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -27,6 +27,10 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <utility>
+#include <functional>
 #include <string.h>
 
 namespace FFMPEGCodec
@@ -58,6 +62,36 @@ struct TextureFormat
     };
 };
 
+// recycles image payload allocations.
+// sizes are rounded up to a bucket (4 steps per power of 2) so buffers released by an image
+// can be handed to the next image of a similar size without going back to the heap.
+// buffers not allocated by the pool (adopted from stb, nanosvg, cmft...) are freed on release.
+struct ImageBufferPool
+{
+    ImageBufferPool() : mRetainedSize(0), mMaxRetainedSize(256 * 1024 * 1024) {}
+    ~ImageBufferPool();
+
+    unsigned char* Allocate(size_t size);
+    // Retain adds a reference to a buffer, each Release drops one. The last one frees it
+    void Retain(unsigned char* bits);
+    void Release(unsigned char* bits);
+    void Clear();
+
+    size_t GetRetainedSize() const { return mRetainedSize; }
+    void SetMaxRetainedSize(size_t maxRetainedSize);
+
+protected:
+    static size_t GetBucketSize(size_t size);
+
+    std::mutex mMutex;
+    std::map<size_t, std::vector<unsigned char*> > mFreeBuffers; // bucket size -> released buffers
+    std::unordered_map<unsigned char*, size_t> mPoolBuffers; // buffers allocated by the pool -> bucket size
+    std::unordered_map<unsigned char*, int> mRetainCounts; // references added by Retain
+    size_t mRetainedSize;
+    size_t mMaxRetainedSize;
+};
+extern ImageBufferPool gImageBufferPool;
+
 struct Image
 {
     Image() : mDecoder(NULL), mBits(NULL), mDataSize(0)
@@ -67,12 +101,16 @@ struct Image
     {
         *this = other;
     }
+    Image(Image&& other) : mBits(NULL), mDataSize(0)
+    {
+        *this = std::move(other);
+    }
     ~Image()
     {
-        free(mBits);
+        DoFree();
     }
 
-    void *mDecoder;
+    void *mDecoder; // FFMPEGCodec::Decoder handle, resolved with gDecoderPool.Lock
     int mWidth, mHeight;
     uint32_t mDataSize;
     uint8_t mNumMips;
@@ -80,30 +118,51 @@ struct Image
     uint8_t mFormat;
     Image& operator = (const Image &other)
     {
-        mDecoder = other.mDecoder;
-        mWidth = other.mWidth;
-        mHeight = other.mHeight;
-        mNumMips = other.mNumMips;
-        mNumFaces = other.mNumFaces;
-        mFormat = other.mFormat;
-        SetBits(other.mBits, other.mDataSize);
+        if (this == &other)
+            return *this;
+        CopyInfos(other);
+        if (other.mBits)
+            SetBits(other.mBits, other.mDataSize);
+        else
+            DoFree();
+        return *this;
+    }
+    Image& operator = (Image &&other)
+    {
+        if (this == &other)
+            return *this;
+        CopyInfos(other);
+        AdoptBits(other.mBits, other.mDataSize);
+        other.mBits = NULL;
+        other.mDataSize = 0;
         return *this;
     }
     unsigned char *GetBits() const { return mBits; }
-    void SetBits(unsigned char* bits, size_t size)
+    void SetBits(const unsigned char* bits, size_t size)
     {
         Allocate(size);
         memcpy(mBits, bits, size);
     }
+    // take ownership of a malloc'd buffer. It will be freed with the image.
+    void AdoptBits(unsigned char* bits, size_t size)
+    {
+        if (bits != mBits)
+        {
+            DoFree();
+            mBits = bits;
+        }
+        mDataSize = uint32_t(size);
+    }
     void Allocate(size_t size)
     {
-        if (mDataSize != size)
-            free(mBits);
-        mBits = (unsigned char*)malloc(size);
+        if (mBits && mDataSize == size)
+            return;
+        DoFree();
+        mBits = gImageBufferPool.Allocate(size);
         mDataSize = uint32_t(size);
     }
     void DoFree() {
-        free(mBits); mBits = NULL; mDataSize = 0;
+        gImageBufferPool.Release(mBits); mBits = NULL; mDataSize = 0;
     }
 
     static int Read(const char *filename, Image *image);
@@ -114,10 +173,26 @@ struct Image
     static void VFlip(Image *image);
     static int Write(const char *filename, Image *image, int format, int quality);
     static int EncodePng(Image *image, std::vector<unsigned char> &pngImage);
-    static int CubemapFilter(Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias);
+    // radiance filtering is split into tiles. runTiles is called with the tile count and must call filterTile
+    // for every tile, from any thread. It returns false when filtering is cancelled, CubemapFilter then returns EVAL_DIRTY
+    typedef std::function<bool(unsigned int tileCount, const std::function<void(unsigned int tile)>& filterTile)> TileRunner;
+    static int CubemapFilter(Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias, const TileRunner& runTiles);
+    // L2 spherical harmonics, 9 RGB coefficients (27 floats). The source is a cubemap or an equirect 8bits image
+    static int ProjectSH(const Image *image, float *coefficients, const TileRunner& runTiles);
+    // cosine convolved RGBA8 cubemap, divided by PI so it can be used like a radiance
+    static int SHIrradiance(const float *coefficients, int faceSize, Image *image, const TileRunner& runTiles);
     static Image DecodeImage(FFMPEGCodec::Decoder *decoder, int frame);
 
 protected:
+    void CopyInfos(const Image& other)
+    {
+        mDecoder = other.mDecoder;
+        mWidth = other.mWidth;
+        mHeight = other.mHeight;
+        mNumMips = other.mNumMips;
+        mNumFaces = other.mNumFaces;
+        mFormat = other.mFormat;
+    }
     unsigned char *mBits;
 };
 
@@ -143,6 +218,8 @@ struct DefaultShaders
     unsigned int mDisplayCubemapShader;
     // error shader
     unsigned int mNodeErrorShader;
+    // video encoding
+    unsigned int mRGBAToYUV420Shader;
 
     void Init();
 };
@@ -154,16 +231,21 @@ class RenderTarget
 {
 
 public:
-    RenderTarget() : mGLTexID(0), mGLTexDepth(0), mFbo(0), mDepthBuffer(0)
+    RenderTarget() : mGLTexID(0), mGLTexDepth(0), mFbo(0), mDepthBuffer(0), mbMipmapsGenerated(false)
     {
         memset(&mImage, 0, sizeof(Image));
     }
 
     void InitBuffer(int width, int height, bool depthBuffer);
-    void InitCube(int width);
+    void InitCube(int width, int mipmapCount = 1);
     void BindAsTarget() const;
     void BindAsCubeTarget() const;
-    void BindCubeFace(size_t face);
+    void BindCubeFace(size_t face, int mipmap = 0);
+    // renders to a mip level of a 2D target, the attachment stays on that level until the next call
+    void BindMipmap(int mipmap);
+    // builds the mip chain from level 0 and updates mImage.mNumMips. The chain is only sampled :
+    // rendering keeps using level 0 like a single mip target.
+    void GenerateMipmaps();
     void Destroy();
     void CheckFBO();
     void Clone(const RenderTarget &other);
@@ -175,4 +257,5 @@ public:
     unsigned int mGLTexDepth;
     unsigned int mDepthBuffer;
     unsigned int mFbo;
+    bool mbMipmapsGenerated; // mips after level 0 come from GenerateMipmaps
 };
@@ -32,9 +32,14 @@
 
 static const unsigned int wrap[] = { GL_REPEAT, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_BORDER, GL_MIRRORED_REPEAT };
 static const unsigned int filter[] = { GL_LINEAR, GL_NEAREST };
+static const unsigned int filterMipmap[] = { GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST_MIPMAP_NEAREST };
 static const char* sampler2DName[] = { "Sampler0", "Sampler1", "Sampler2", "Sampler3", "Sampler4", "Sampler5", "Sampler6", "Sampler7" };
 static const char* samplerCubeName[] = { "CubeSampler0", "CubeSampler1", "CubeSampler2", "CubeSampler3", "CubeSampler4", "CubeSampler5", "CubeSampler6", "CubeSampler7" };
 
+// shader storage bindings of compute shader stages
+static const unsigned int COMPUTE_SOURCE_BINDING = 0;
+static const unsigned int COMPUTE_DESTINATION_BINDING = 1;
+
 static const unsigned int GLBlends[] = { GL_ZERO, GL_ONE, GL_SRC_COLOR, GL_ONE_MINUS_SRC_COLOR, GL_DST_COLOR, GL_ONE_MINUS_DST_COLOR,GL_SRC_ALPHA,
     GL_ONE_MINUS_SRC_ALPHA, GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA, GL_CONSTANT_COLOR, GL_ONE_MINUS_CONSTANT_COLOR, GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA, GL_SRC_ALPHA_SATURATE };
 
@@ -84,6 +89,7 @@ EvaluationContext::EvaluationContext(EvaluationStages& evaluation, bool synchron
     , mDefaultWidth(defaultWidth)
     , mDefaultHeight(defaultHeight)
     , mRuntimeUniqueId(-1)
+    , mbSharedTargets(false)
 {
     mFSQuad.Init();
 }
@@ -96,6 +102,13 @@ EvaluationContext::~EvaluationContext()
         delete stream.second;
     }
     mWriteStreams.clear();
+    if (mPyramidTarget)
+        mPyramidTarget->Destroy();
+    for (auto& inputMipmaps : mInputMipmaps)
+    {
+        if (inputMipmaps)
+            inputMipmaps->Destroy();
+    }
     mFSQuad.Finish();
 }
 
@@ -111,11 +124,30 @@ void EvaluationContext::Clear()
 {
     mStageTarget.clear();
     for (auto& buffer : mComputeBuffers)
+    {
         glDeleteBuffers(1, &buffer.mBuffer);
+        glDeleteBuffers(1, &buffer.mDispatchBuffer);
+        glDeleteVertexArrays(1, &buffer.mVertexArray);
+    }
     mComputeBuffers.clear();
     mbDirty.clear();
     mbProcessing.clear();
     mProgress.clear();
+    mOutputGeneration.clear();
+    mEvaluatedGeneration.clear();
+    mbSourceDirty.clear();
+    mbFusedStale.clear();
+    mbDisplayed.clear();
+    for (auto& inputMipmaps : mInputMipmaps)
+    {
+        if (inputMipmaps)
+            inputMipmaps->Destroy();
+    }
+    mInputMipmaps.clear();
+    mbSharedTargets = false;
+    std::lock_guard<std::mutex> lock(mJobMutex);
+    for (auto& token : mJobTokens)
+        token++;
 }
 
 unsigned int EvaluationContext::GetEvaluationTexture(size_t target)
@@ -124,6 +156,9 @@ unsigned int EvaluationContext::GetEvaluationTexture(size_t target)
         return 0;
     if (!mStageTarget[target])
         return 0;
+    if (target < mbDisplayed.size())
+        mbDisplayed[target] = true;
+    RealizeFusedStage(target);
     return mStageTarget[target]->mGLTexID;
 }
 
@@ -204,15 +239,16 @@ void EvaluationContext::BindTextures(const EvaluationStage& evaluationStage, uns
             if (tgt)
             {
                 const InputSampler& inputSampler = evaluationStage.mInputSamplers[inputIndex];
+                const unsigned int filterMin = (tgt->mImage.mNumMips > 1) ? filterMipmap[inputSampler.mFilterMin] : filter[inputSampler.mFilterMin];
                 if (tgt->mImage.mNumFaces == 1)
                 {
                     glBindTexture(GL_TEXTURE_2D, tgt->mGLTexID);
-                    TexParam(filter[inputSampler.mFilterMin], filter[inputSampler.mFilterMag], wrap[inputSampler.mWrapU], wrap[inputSampler.mWrapV], GL_TEXTURE_2D);
+                    TexParam(filterMin, filter[inputSampler.mFilterMag], wrap[inputSampler.mWrapU], wrap[inputSampler.mWrapV], GL_TEXTURE_2D);
                 }
                 else
                 {
                     glBindTexture(GL_TEXTURE_CUBE_MAP, tgt->mGLTexID);
-                    TexParam(filter[inputSampler.mFilterMin], filter[inputSampler.mFilterMag], wrap[inputSampler.mWrapU], wrap[inputSampler.mWrapV], GL_TEXTURE_CUBE_MAP);
+                    TexParam(filterMin, filter[inputSampler.mFilterMag], wrap[inputSampler.mWrapU], wrap[inputSampler.mWrapV], GL_TEXTURE_CUBE_MAP);
                 }
             }
         }
@@ -255,32 +291,19 @@ void EvaluationContext::EvaluateGLSLCompute(const EvaluationStage& evaluationSta
 
     const Evaluator& evaluator = gEvaluators.GetEvaluator(evaluationStage.mType);
     const unsigned int program = evaluator.mGLSLProgram;
+    if (!program)
+        return;
 
     // allocate buffer
-    unsigned int feedbackVertexArray = 0;
-    ComputeBuffer* destinationBuffer = NULL;
     int computeBufferIndex = GetBindedComputeBuffer(evaluationStage);
     if (computeBufferIndex != -1)
-    {
         AllocateComputeBuffer(int(index), mComputeBuffers[computeBufferIndex].mElementCount, mComputeBuffers[computeBufferIndex].mElementSize);
- 
-        /// build source VAO
-        glGenVertexArrays(1, &feedbackVertexArray);
-        glBindVertexArray(feedbackVertexArray);
-        glBindBuffer(GL_ARRAY_BUFFER, mComputeBuffers[computeBufferIndex].mBuffer);
-        const int transformElementCount = mComputeBuffers[computeBufferIndex].mElementSize / (4 * sizeof(float));
-        for (int i = 0; i < transformElementCount;i++)
-        {
-            glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4 * transformElementCount, (void*)(4 * sizeof(float) * i));
-            glEnableVertexAttribArray(i);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        glBindVertexArray(0);
-    }
     if (mComputeBuffers.size() <= index)
         return; // no compute buffer destination, no source either -> non connected node -> early exit
-    destinationBuffer = &mComputeBuffers[index];
+    ComputeBuffer& destinationBuffer = mComputeBuffers[index];
+    const ComputeBuffer* sourceBuffer = (computeBufferIndex != -1) ? &mComputeBuffers[computeBufferIndex] : nullptr;
+    if (!destinationBuffer.mBuffer || !destinationBuffer.mElementCount)
+        return;
 
     // compute buffer
     glUseProgram(program);
@@ -295,20 +318,73 @@ void EvaluationContext::EvaluateGLSLCompute(const EvaluationStage& evaluationSta
 
 
     BindTextures(evaluationStage, program, std::shared_ptr<RenderTarget>());
+
+    if (evaluator.mComputeLocalSize)
+    {
+        // source and destination elements are shader storage buffers.
+        // Without a source, the binding is cleared so the previous compute stage's elements are not read
+        if (sourceBuffer)
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COMPUTE_SOURCE_BINDING, sourceBuffer->mBuffer, 0, sourceBuffer->mElementCount * sourceBuffer->mElementSize);
+        else
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTE_SOURCE_BINDING, 0);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COMPUTE_DESTINATION_BINDING, destinationBuffer.mBuffer, 0, destinationBuffer.mElementCount * destinationBuffer.mElementSize);
+
+        // group counts are uploaded when the element count changes
+        const unsigned int groupCount = (destinationBuffer.mElementCount + evaluator.mComputeLocalSize - 1) / evaluator.mComputeLocalSize;
+        if (!destinationBuffer.mDispatchBuffer)
+            glGenBuffers(1, &destinationBuffer.mDispatchBuffer);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, destinationBuffer.mDispatchBuffer);
+        if (groupCount != destinationBuffer.mDispatchGroupCount)
+        {
+            const unsigned int groupCounts[3] = { groupCount, 1, 1 };
+            glBufferData(GL_DISPATCH_INDIRECT_BUFFER, sizeof(groupCounts), groupCounts, GL_STATIC_DRAW);
+            destinationBuffer.mDispatchGroupCount = groupCount;
+        }
+        glDispatchComputeIndirect(0);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+        // elements are read as vertex attributes by display stages and as storage by the next compute stage
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        glUseProgram(0);
+        return;
+    }
+
+    // source VAO, built again when the source buffer changes
+    const unsigned int vertexArraySource = sourceBuffer ? sourceBuffer->mBuffer : 0;
+    const unsigned int vertexArrayElementSize = sourceBuffer ? sourceBuffer->mElementSize : 0;
+    if (!destinationBuffer.mVertexArray || destinationBuffer.mVertexArraySource != vertexArraySource || destinationBuffer.mVertexArrayElementSize != vertexArrayElementSize)
+    {
+        if (destinationBuffer.mVertexArray)
+            glDeleteVertexArrays(1, &destinationBuffer.mVertexArray);
+        glGenVertexArrays(1, &destinationBuffer.mVertexArray);
+        glBindVertexArray(destinationBuffer.mVertexArray);
+        if (sourceBuffer)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, sourceBuffer->mBuffer);
+            const int transformElementCount = sourceBuffer->mElementSize / (4 * sizeof(float));
+            for (int i = 0; i < transformElementCount; i++)
+            {
+                glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4 * transformElementCount, (void*)(4 * sizeof(float) * i));
+                glEnableVertexAttribArray(i);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        glBindVertexArray(0);
+        destinationBuffer.mVertexArraySource = vertexArraySource;
+        destinationBuffer.mVertexArrayElementSize = vertexArrayElementSize;
+    }
+
     glEnable(GL_RASTERIZER_DISCARD);
-    glBindVertexArray(feedbackVertexArray);
-    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, destinationBuffer->mBuffer, 0, destinationBuffer->mElementCount * destinationBuffer->mElementSize);
+    glBindVertexArray(destinationBuffer.mVertexArray);
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, destinationBuffer.mBuffer, 0, destinationBuffer.mElementCount * destinationBuffer.mElementSize);
 
     glBeginTransformFeedback(GL_POINTS);
-    glDrawArrays(GL_POINTS, 0, destinationBuffer->mElementCount);
+    glDrawArrays(GL_POINTS, 0, destinationBuffer.mElementCount);
     glEndTransformFeedback();
 
     glDisable(GL_RASTERIZER_DISCARD);
     glBindVertexArray(0);
     glUseProgram(0);
-
-    if (feedbackVertexArray)
-        glDeleteVertexArrays(1, &feedbackVertexArray);
 }
 
 void EvaluationContext::EvaluateGLSL(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo)
@@ -345,6 +421,16 @@ void EvaluationContext::EvaluateGLSL(const EvaluationStage& evaluationStage, siz
         camera->ComputeViewProjectionMatrix(evaluationInfo.viewProjection, evaluationInfo.viewInverse);
     }
 
+    int pyramidLevels = mEvaluationStages.GetIntParameter(index, "pyramidLevels", 0);
+    if (pyramidLevels > 0 && !evaluationInfo.uiPass && tgt->mImage.mNumFaces == 1)
+    {
+        if (EvaluatePyramid(evaluationStage, index, evaluationInfo, pyramidLevels))
+        {
+            glDisable(GL_BLEND);
+            return;
+        }
+    }
+
     int passCount = mEvaluationStages.GetIntParameter(index, "passCount", 1);
     auto transientTarget = std::make_shared<RenderTarget>(RenderTarget());
     if (passCount > 1)
@@ -363,17 +449,23 @@ void EvaluationContext::EvaluateGLSL(const EvaluationStage& evaluationStage, siz
                 tgt->BindAsTarget();
         }
 
+        // every mip of a cube target is rendered, the shader picks its content with mipmapNumber
         size_t faceCount = evaluationInfo.uiPass ? 1 : tgt->mImage.mNumFaces;
-        for (size_t face = 0; face < faceCount; face++)
+        int mipmapCount = (evaluationInfo.uiPass || tgt->mImage.mNumFaces != 6 || tgt->mbMipmapsGenerated) ? 1 : tgt->mImage.mNumMips;
+        for (size_t renderIndex = 0; renderIndex < faceCount * mipmapCount; renderIndex++)
         {
+            size_t face = renderIndex % faceCount;
+            int mipmap = int(renderIndex / faceCount);
             if (tgt->mImage.mNumFaces == 6)
-                tgt->BindCubeFace(face);
+                tgt->BindCubeFace(face, mipmap);
 
             memcpy(evaluationInfo.viewRot, rotMatrices[face], sizeof(float) * 16);
             memcpy(evaluationInfo.inputIndices, input.mInputs, sizeof(input.mInputs));
-            evaluationInfo.viewport[0] = float(tgt->mImage.mWidth);
-            evaluationInfo.viewport[1] = float(tgt->mImage.mHeight);
+            evaluationInfo.viewport[0] = float(tgt->mImage.mWidth >> mipmap);
+            evaluationInfo.viewport[1] = float(tgt->mImage.mHeight >> mipmap);
             evaluationInfo.passNumber = passNumber;
+            evaluationInfo.mipmapNumber = mipmap;
+            evaluationInfo.mipmapCount = mipmapCount;
 
             glBindBuffer(GL_UNIFORM_BUFFER, gEvaluators.gEvaluationStateGLSLBuffer);
             glBufferData(GL_UNIFORM_BUFFER, sizeof(EvaluationInfo), &evaluationInfo, GL_DYNAMIC_DRAW);
@@ -383,7 +475,7 @@ void EvaluationContext::EvaluateGLSL(const EvaluationStage& evaluationStage, siz
             glBindBufferBase(GL_UNIFORM_BUFFER, 1, evaluationStage.mParametersBuffer);
             glBindBufferBase(GL_UNIFORM_BUFFER, 2, gEvaluators.gEvaluationStateGLSLBuffer);
 
-            BindTextures(evaluationStage, program, passNumber?transientTarget:std::shared_ptr<RenderTarget>());
+            BindTextures(evaluationStage, program, passNumber?transientTarget:mInputMipmaps[index]);
 
             //
 #if 0
@@ -438,9 +530,281 @@ void EvaluationContext::EvaluateGLSL(const EvaluationStage& evaluationStage, siz
             }
         } // passNumber
     }
+    // keep a mip chain built by GenerateMipmaps in sync with the new content
+    if (!evaluationInfo.uiPass && tgt->mbMipmapsGenerated)
+        tgt->GenerateMipmaps();
     glDisable(GL_BLEND);
 }
 
+bool EvaluationContext::EvaluatePyramid(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo, int levels)
+{
+    auto tgt = mStageTarget[index];
+    const unsigned int program = gEvaluators.GetEvaluator(evaluationStage.mType).mGLSLProgram;
+
+    // the smallest level is at least 1 pixel wide
+    int maxLevels = 0;
+    while ((std::min(tgt->mImage.mWidth, tgt->mImage.mHeight) >> (maxLevels + 1)) > 0)
+        maxLevels++;
+    levels = std::min(levels, maxLevels);
+    if (!levels)
+        return false;
+
+    // pyramid level n is 2^(n+1) times smaller than the target. Its texture and FBO are kept from one evaluation to the next.
+    if (!mPyramidTarget)
+        mPyramidTarget = std::make_shared<RenderTarget>();
+    mPyramidTarget->InitBuffer(std::max(tgt->mImage.mWidth >> 1, 1), std::max(tgt->mImage.mHeight >> 1, 1), false);
+    if (mPyramidTarget->mImage.mNumMips < levels)
+        mPyramidTarget->GenerateMipmaps();
+
+    memcpy(evaluationInfo.viewRot, rotMatrices[0], sizeof(float) * 16);
+    memcpy(evaluationInfo.inputIndices, evaluationStage.mInput.mInputs, sizeof(evaluationStage.mInput.mInputs));
+    evaluationInfo.mipmapCount = levels;
+    for (int passNumber = 0; passNumber < levels * 2; passNumber++)
+    {
+        // level -1 is the input when downsampling and the stage target when upsampling
+        const bool downsample = passNumber < levels;
+        const int sourceLevel = downsample ? passNumber - 1 : levels * 2 - 1 - passNumber;
+        const int destinationLevel = downsample ? passNumber : sourceLevel - 1;
+        if (destinationLevel < 0)
+        {
+            // only the last pass is blended with the target
+            tgt->BindAsTarget();
+            glEnable(GL_BLEND);
+            evaluationInfo.viewport[0] = float(tgt->mImage.mWidth);
+            evaluationInfo.viewport[1] = float(tgt->mImage.mHeight);
+        }
+        else
+        {
+            mPyramidTarget->BindMipmap(destinationLevel);
+            glDisable(GL_BLEND);
+            evaluationInfo.viewport[0] = float(std::max(mPyramidTarget->mImage.mWidth >> destinationLevel, 1));
+            evaluationInfo.viewport[1] = float(std::max(mPyramidTarget->mImage.mHeight >> destinationLevel, 1));
+        }
+        evaluationInfo.passNumber = passNumber;
+        evaluationInfo.mipmapNumber = destinationLevel;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, gEvaluators.gEvaluationStateGLSLBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(EvaluationInfo), &evaluationInfo, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, 1, evaluationStage.mParametersBuffer);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 2, gEvaluators.gEvaluationStateGLSLBuffer);
+
+        BindTextures(evaluationStage, program, (sourceLevel < 0) ? std::shared_ptr<RenderTarget>() : mPyramidTarget);
+        if (sourceLevel >= 0)
+        {
+            // only the source level can be sampled, the level rendered to is out of the texture range
+            glActiveTexture(GL_TEXTURE0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, sourceLevel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, sourceLevel);
+        }
+        mFSQuad.Render();
+    }
+
+    glBindTexture(GL_TEXTURE_2D, mPyramidTarget->mGLTexID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mPyramidTarget->mImage.mNumMips - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (tgt->mImage.mNumMips > 1)
+        tgt->GenerateMipmaps();
+    return true;
+}
+
+bool EvaluationContext::IsFusible(size_t nodeIndex) const
+{
+    // baking targets of the previous stages may already be used by others, a stage couldn't be written later
+    if (mbSharedTargets)
+        return false;
+    const EvaluationStage& stage = mEvaluationStages.GetEvaluationStage(nodeIndex);
+    if (stage.gEvaluationMask != EvaluationGLSL || !gMetaNodes[stage.mType].mbPointwise)
+        return false;
+    if (stage.mBlendingSrc != ONE || stage.mBlendingDst != ZERO || stage.mbDepthBuffer)
+        return false;
+    if (mEvaluationStages.GetIntParameter(nodeIndex, "passCount", 1) > 1 || mEvaluationStages.GetCameraParameter(nodeIndex))
+        return false;
+    if (nodeIndex >= mStageTarget.size() || !mStageTarget[nodeIndex])
+        return false;
+    const auto& target = *mStageTarget[nodeIndex];
+    return !target.mGLTexID || (target.mImage.mNumFaces == 1 && target.mImage.mNumMips <= 1);
+}
+
+size_t EvaluationContext::GetFusedStageCount(size_t nodeIndex) const
+{
+    size_t count = 1;
+    for (auto input : mEvaluationStages.GetEvaluationStage(nodeIndex).mInput.mInputs)
+    {
+        if (input >= 0 && mbFusedStale[input])
+            count += GetFusedStageCount(input);
+    }
+    return count;
+}
+
+bool EvaluationContext::IsFusedInUser(size_t nodeIndex, const std::vector<bool>& evaluated) const
+{
+    const EvaluationStage& stage = mEvaluationStages.GetEvaluationStage(nodeIndex);
+    // a displayed stage would be written again for its thumbnail
+    if (mEvaluationInfo.uiPass || stage.mUseCountByOthers != 1 || mbDisplayed[nodeIndex] || !IsFusible(nodeIndex))
+        return false;
+    const auto& outputs = mEvaluationStages.GetStageOutputs(nodeIndex);
+    if (outputs.size() != 1)
+        return false;
+    const size_t user = outputs[0];
+    const EvaluationStage& userStage = mEvaluationStages.GetEvaluationStage(user);
+    if (!evaluated[user] || gEvaluationTime < userStage.mStartFrame || gEvaluationTime > userStage.mEndFrame || !IsFusible(user))
+        return false;
+    // the user samples the stage at its pixel centers
+    const auto& target = *mStageTarget[nodeIndex];
+    const auto& userTarget = *mStageTarget[user];
+    if (target.mGLTexID && userTarget.mGLTexID && (target.mImage.mWidth != userTarget.mImage.mWidth || target.mImage.mHeight != userTarget.mImage.mHeight))
+        return false;
+    for (auto input : stage.mInput.mInputs)
+    {
+        if (input >= 0 && mbProcessing[input])
+            return false;
+    }
+    return GetFusedStageCount(nodeIndex) < FUSED_MAX_STEPS;
+}
+
+bool EvaluationContext::CollectFusedStages(size_t nodeIndex, std::vector<size_t>& stages)
+{
+    stages.clear();
+    if (mEvaluationInfo.uiPass || !IsFusible(nodeIndex))
+        return false;
+    size_t stepCount = 1;
+    AddFusedStages(nodeIndex, stages, stepCount);
+    return stages.size() > 1;
+}
+
+void EvaluationContext::AddFusedStages(size_t nodeIndex, std::vector<size_t>& stages, size_t& stepCount)
+{
+    // inputs first. Stale inputs past the step count are written to their target.
+    for (auto input : mEvaluationStages.GetEvaluationStage(nodeIndex).mInput.mInputs)
+    {
+        if (input < 0 || !mbFusedStale[input])
+            continue;
+        if (stepCount >= FUSED_MAX_STEPS)
+        {
+            RealizeFusedStage(input);
+            continue;
+        }
+        stepCount++;
+        AddFusedStages(input, stages, stepCount);
+    }
+    stages.push_back(nodeIndex);
+}
+
+bool EvaluationContext::EvaluateFused(const std::vector<size_t>& stages, EvaluationInfo& evaluationInfo)
+{
+    // inputs not computed in the pass are bound to sampler units, once per target
+    std::vector<FusedStep> steps(stages.size());
+    std::vector<int> samplerTargets;
+    std::vector<InputSampler> samplerStates;
+    bool valid = true;
+    for (size_t stepIndex = 0; stepIndex < stages.size(); stepIndex++)
+    {
+        const EvaluationStage& stage = mEvaluationStages.GetEvaluationStage(stages[stepIndex]);
+        FusedStep& step = steps[stepIndex];
+        step.mNodeType = stage.mType;
+        for (int i = 0; i < 8; i++)
+        {
+            const int input = stage.mInput.mInputs[i];
+            step.mInputStep[i] = -1;
+            step.mInputSampler[i] = -1;
+            if (input < 0)
+                continue;
+            auto stageIter = std::find(stages.begin(), stages.end(), size_t(input));
+            if (stageIter != stages.end())
+            {
+                step.mInputStep[i] = int(stageIter - stages.begin());
+                continue;
+            }
+            auto samplerIter = std::find(samplerTargets.begin(), samplerTargets.end(), input);
+            step.mInputSampler[i] = int(samplerIter - samplerTargets.begin());
+            if (samplerIter == samplerTargets.end())
+            {
+                samplerTargets.push_back(input);
+                samplerStates.push_back(stage.mInputSamplers[i]);
+                valid &= mStageTarget[input] && mStageTarget[input]->mImage.mNumFaces == 1;
+            }
+        }
+    }
+    const unsigned int program = (valid && samplerTargets.size() <= 8) ? gEvaluators.GetFusedProgram(steps) : 0;
+    if (!program)
+    {
+        for (auto stageIndex : stages)
+            RealizeFusedStage(stageIndex);
+        return false;
+    }
+
+    const size_t index = stages.back();
+    const EvaluationStage& evaluationStage = mEvaluationStages.GetEvaluationStage(index);
+    auto tgt = mStageTarget[index];
+
+    glUseProgram(program);
+    tgt->BindAsTarget();
+
+    memcpy(evaluationInfo.viewRot, rotMatrices[0], sizeof(float) * 16);
+    memcpy(evaluationInfo.inputIndices, evaluationStage.mInput.mInputs, sizeof(evaluationStage.mInput.mInputs));
+    evaluationInfo.viewport[0] = float(tgt->mImage.mWidth);
+    evaluationInfo.viewport[1] = float(tgt->mImage.mHeight);
+    evaluationInfo.passNumber = 0;
+    evaluationInfo.mipmapNumber = 0;
+    evaluationInfo.mipmapCount = 1;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, gEvaluators.gEvaluationStateGLSLBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(EvaluationInfo), &evaluationInfo, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 2, gEvaluators.gEvaluationStateGLSLBuffer);
+    for (size_t stepIndex = 0; stepIndex < stages.size(); stepIndex++)
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, FUSED_PARAMETERS_BINDING + int(stepIndex), mEvaluationStages.GetEvaluationStage(stages[stepIndex]).mParametersBuffer);
+    }
+
+    for (size_t unit = 0; unit < samplerTargets.size(); unit++)
+    {
+        const RenderTarget& source = *mStageTarget[samplerTargets[unit]];
+        const InputSampler& inputSampler = samplerStates[unit];
+        const unsigned int filterMin = (source.mImage.mNumMips > 1) ? filterMipmap[inputSampler.mFilterMin] : filter[inputSampler.mFilterMin];
+        glActiveTexture(GL_TEXTURE0 + int(unit));
+        glBindTexture(GL_TEXTURE_2D, source.mGLTexID);
+        TexParam(filterMin, filter[inputSampler.mFilterMag], wrap[inputSampler.mWrapU], wrap[inputSampler.mWrapV], GL_TEXTURE_2D);
+        glUniform1i(glGetUniformLocation(program, sampler2DName[unit]), int(unit));
+    }
+
+    mFSQuad.Render();
+    return true;
+}
+
+void EvaluationContext::RealizeFusedStage(size_t target)
+{
+    if (target >= mbFusedStale.size() || !mbFusedStale[target])
+        return;
+    mbFusedStale[target] = false;
+    if (target >= mStageTarget.size() || !mStageTarget[target])
+        return;
+
+    const EvaluationStage& stage = mEvaluationStages.GetEvaluationStage(target);
+    for (auto input : stage.mInput.mInputs)
+    {
+        if (input >= 0)
+            RealizeFusedStage(input);
+    }
+
+    EvaluationInfo evaluationInfo = mEvaluationInfo;
+    evaluationInfo.targetIndex = int(target);
+    evaluationInfo.uiPass = 0;
+    memcpy(evaluationInfo.inputIndices, stage.mInput.mInputs, sizeof(evaluationInfo.inputIndices));
+    SetMouseInfos(evaluationInfo, stage);
+
+    if (!mStageTarget[target]->mGLTexID)
+        mStageTarget[target]->InitBuffer(mDefaultWidth, mDefaultHeight, stage.mbDepthBuffer);
+    EvaluateGLSL(stage, target, evaluationInfo);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glUseProgram(0);
+}
+
 void EvaluationContext::EvaluateC(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo)
 {
     try // todo: find a better solution than a try catch
@@ -466,7 +830,14 @@ void EvaluationContext::EvaluatePython(const EvaluationStage& evaluationStage, s
     try // todo: find a better solution than a try catch
     {
         const Evaluator& evaluator = gEvaluators.GetEvaluator(evaluationStage.mType);
-        evaluator.RunPython();
+        if (evaluator.RunPython(this, evaluationInfo) == EVAL_DIRTY)
+        {
+            mStillDirty.push_back(uint32_t(index));
+        }
+    }
+    catch (std::exception& ex)
+    {
+        Log("%s\n", ex.what());
     }
     catch (...)
     {
@@ -492,6 +863,7 @@ void EvaluationContext::AllocRenderTargetsForBaking(const std::vector<size_t>& n
 {
     if (!mStageTarget.empty())
         return;
+    mbSharedTargets = true;
 
     //auto evaluationOrderList = mEvaluationStages.GetForwardEvaluationOrder();
     size_t stageCount = mEvaluationStages.GetStagesCount();
@@ -538,6 +910,33 @@ void EvaluationContext::PreRun()
     mbDirty.resize(mEvaluationStages.GetStagesCount(), false);
     mbProcessing.resize(mEvaluationStages.GetStagesCount(), 0);
     mProgress.resize(mEvaluationStages.GetStagesCount(), 0.f);
+    mOutputGeneration.resize(mEvaluationStages.GetStagesCount(), 0);
+    mEvaluatedGeneration.resize(mEvaluationStages.GetStagesCount());
+    mbSourceDirty.resize(mEvaluationStages.GetStagesCount(), true);
+    mbFusedStale.resize(mEvaluationStages.GetStagesCount(), false);
+    mbDisplayed.resize(mEvaluationStages.GetStagesCount(), false);
+    mInputMipmaps.resize(mEvaluationStages.GetStagesCount());
+}
+
+bool EvaluationContext::StageIsUnchanged(size_t nodeIndex) const
+{
+    if (mbSourceDirty[nodeIndex])
+        return false;
+    if (nodeIndex >= mStageTarget.size() || !mStageTarget[nodeIndex] || (!mStageTarget[nodeIndex]->mGLTexID && !mbFusedStale[nodeIndex]))
+        return false;
+    const StageGeneration& generation = mEvaluatedGeneration[nodeIndex];
+    const EvaluationStage& stage = mEvaluationStages.GetEvaluationStage(nodeIndex);
+    if (!generation.mbValid || generation.mParameters != stage.mGeneration)
+        return false;
+    for (size_t i = 0; i < 8; i++)
+    {
+        int input = stage.mInput.mInputs[i];
+        if (generation.mInputs[i] != input)
+            return false;
+        if (input >= 0 && generation.mInputOutputs[i] != mOutputGeneration[input])
+            return false;
+    }
+    return true;
 }
 
 void EvaluationContext::RunNode(size_t nodeIndex)
@@ -558,12 +957,29 @@ void EvaluationContext::RunNode(size_t nodeIndex)
     }
 
     mbProcessing[nodeIndex] = 0;
+    {
+        std::lock_guard<std::mutex> lock(mJobMutex);
+        mJobTokens.resize(mEvaluationStages.GetStagesCount(), 0);
+        mJobTokens[nodeIndex]++;
+    }
 
     mEvaluationInfo.targetIndex = int(nodeIndex);
     mEvaluationInfo.mFrame = gEvaluationTime;
     memcpy(mEvaluationInfo.inputIndices, input.mInputs, sizeof(mEvaluationInfo.inputIndices));
     SetMouseInfos(mEvaluationInfo, currentStage);
 
+    // inputs computed in the pass of another stage are written, unless this pass computes them too
+    std::vector<size_t> fusedStages;
+    const bool fused = CollectFusedStages(nodeIndex, fusedStages);
+    if (!fused)
+    {
+        for (auto inp : input.mInputs)
+        {
+            if (inp >= 0)
+                RealizeFusedStage(inp);
+        }
+    }
+
     if (currentStage.gEvaluationMask&EvaluationC)
         EvaluateC(currentStage, nodeIndex, mEvaluationInfo);
 
@@ -580,19 +996,58 @@ void EvaluationContext::RunNode(size_t nodeIndex)
         if (!mStageTarget[nodeIndex]->mGLTexID)
             mStageTarget[nodeIndex]->InitBuffer(mDefaultWidth, mDefaultHeight, currentStage.mbDepthBuffer);
 
-        EvaluateGLSL(currentStage, nodeIndex, mEvaluationInfo);
+        if (!fused || !EvaluateFused(fusedStages, mEvaluationInfo))
+            EvaluateGLSL(currentStage, nodeIndex, mEvaluationInfo);
     }
+    StageEvaluated(nodeIndex);
+}
+
+void EvaluationContext::StageEvaluated(size_t nodeIndex)
+{
+    const EvaluationStage& currentStage = mEvaluationStages.GetEvaluationStage(nodeIndex);
+    const Input& input = currentStage.mInput;
     mbDirty[nodeIndex] = false;
+    mbSourceDirty[nodeIndex] = false;
+    mOutputGeneration[nodeIndex]++;
+
+    StageGeneration& generation = mEvaluatedGeneration[nodeIndex];
+    generation.mbValid = true;
+    generation.mParameters = currentStage.mGeneration;
+    for (size_t i = 0; i < 8; i++)
+    {
+        int inputIndex = input.mInputs[i];
+        generation.mInputs[i] = inputIndex;
+        generation.mInputOutputs[i] = (inputIndex >= 0) ? mOutputGeneration[inputIndex] : 0;
+    }
 }
 
-bool EvaluationContext::RunNodeList(const std::vector<size_t>& nodesToEvaluate)
+bool EvaluationContext::RunNodeList(const std::vector<size_t>& nodesToEvaluate, bool skipUnchanged)
 {
+    std::vector<bool> evaluated(mEvaluationStages.GetStagesCount(), false);
+    for (size_t nodeIndex : nodesToEvaluate)
+        evaluated[nodeIndex] = true;
+
     // run C nodes
     bool anyNodeIsProcessing = false;
     for (size_t nodeIndex : nodesToEvaluate)
     {
         if (gEvaluationTime < mEvaluationStages.mStages[nodeIndex].mStartFrame || gEvaluationTime > mEvaluationStages.mStages[nodeIndex].mEndFrame)
             continue;
+        // inputs are evaluated first so their generations are up to date
+        if (skipUnchanged && StageIsUnchanged(nodeIndex))
+        {
+            mbDirty[nodeIndex] = false;
+            continue;
+        }
+        const bool fusedInUser = IsFusedInUser(nodeIndex, evaluated);
+        // asked for again by the next frame if it's still displayed
+        mbDisplayed[nodeIndex] = false;
+        if (fusedInUser)
+        {
+            mbFusedStale[nodeIndex] = true;
+            StageEvaluated(nodeIndex);
+            continue;
+        }
         RunNode(nodeIndex);
         anyNodeIsProcessing |= mbProcessing[nodeIndex] != 0;
     }
@@ -618,8 +1073,13 @@ void EvaluationContext::RunSingle(size_t nodeIndex, EvaluationInfo& evaluationIn
     glUseProgram(0);
 }
 
-void EvaluationContext::RecurseBackward(size_t target, std::vector<size_t>& usedNodes)
+void EvaluationContext::RecurseBackward(size_t target, std::vector<size_t>& usedNodes, std::vector<bool>& visited)
 {
+    // shared inputs are visited once
+    if (visited[target])
+        return;
+    visited[target] = true;
+
     const EvaluationStage& evaluation = mEvaluationStages.GetEvaluationStage(target);
     const Input& input = evaluation.mInput;
 
@@ -628,11 +1088,10 @@ void EvaluationContext::RecurseBackward(size_t target, std::vector<size_t>& used
         int targetIndex = input.mInputs[inputIndex];
         if (targetIndex == -1)
             continue;
-        RecurseBackward(targetIndex, usedNodes);
+        RecurseBackward(targetIndex, usedNodes, visited);
     }
 
-    if (std::find(usedNodes.begin(), usedNodes.end(), target) == usedNodes.end())
-        usedNodes.push_back(target);
+    usedNodes.push_back(target);
 }
 
 void EvaluationContext::RunDirty()
@@ -648,7 +1107,7 @@ void EvaluationContext::RunDirty()
             nodesToEvaluate.push_back(currentNodeIndex);
     }
     AllocRenderTargetsForEditingPreview();
-    RunNodeList(nodesToEvaluate);
+    RunNodeList(nodesToEvaluate, true);
 }
 
 void EvaluationContext::RunAll()
@@ -667,7 +1126,8 @@ bool EvaluationContext::RunBackward(size_t nodeIndex)
     memset(&mEvaluationInfo, 0, sizeof(EvaluationInfo));
     mEvaluationInfo.forcedDirty = true;
     std::vector<size_t> nodesToEvaluate;
-    RecurseBackward(nodeIndex, nodesToEvaluate);
+    std::vector<bool> visited(mEvaluationStages.GetStagesCount(), false);
+    RecurseBackward(nodeIndex, nodesToEvaluate, visited);
     AllocRenderTargetsForBaking(nodesToEvaluate);
     return RunNodeList(nodesToEvaluate);
 }
@@ -689,32 +1149,55 @@ FFMPEGCodec::Encoder *EvaluationContext::GetEncoder(const std::string &filename,
     return encoder;
 }
 
+bool EvaluationContext::ReadbackYUV420(size_t target, int width, int height, unsigned char *yuv)
+{
+    auto sourceTarget = GetRenderTarget(target);
+    unsigned int program = gDefaultShader.mRGBAToYUV420Shader;
+    if (!sourceTarget || !sourceTarget->mGLTexID || sourceTarget->mImage.mNumFaces != 1 || !program)
+        return false;
+
+    // 4 bytes per RGBA8 texel : 1.5 bytes per pixel read back instead of 4
+    RenderTarget packedTarget;
+    packedTarget.InitBuffer(width / 4, height * 3 / 2, false);
+    packedTarget.BindAsTarget();
+    glDisable(GL_BLEND);
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sourceTarget->mGLTexID);
+    glUniform1i(glGetUniformLocation(program, "source"), 0);
+    glUniform2i(glGetUniformLocation(program, "encodedSize"), width, height);
+    // the source is only padded to the encoded size when it has the size of the stream
+    const bool resample = align(sourceTarget->mImage.mWidth, 4) != width || align(sourceTarget->mImage.mHeight, 4) != height;
+    glUniform1i(glGetUniformLocation(program, "resample"), resample ? 1 : 0);
+    mFSQuad.Render();
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width / 4, height * 3 / 2, GL_RGBA, GL_UNSIGNED_BYTE, yuv);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    packedTarget.Destroy();
+    return true;
+}
+
 void EvaluationContext::SetTargetDirty(size_t target, bool onlyChild)
 {
-    mbDirty.resize(mEvaluationStages.GetStagesCount(), false);
-    auto evaluationOrderList = mEvaluationStages.GetForwardEvaluationOrder();
+    PreRun();
     mbDirty[target] = true;
-    for (size_t i = 0; i < evaluationOrderList.size(); i++)
+    if (onlyChild)
+        mOutputGeneration[target]++; // output written outside of evaluation
+    else
+        mbSourceDirty[target] = true;
+    // only the stages using the target, directly or not
+    std::vector<size_t> stack(1, target);
+    while (!stack.empty())
     {
-        size_t currentNodeIndex = evaluationOrderList[i];
-        if (currentNodeIndex != target)
-            continue;
-
-        for (i++; i < evaluationOrderList.size(); i++)
+        size_t currentNodeIndex = stack.back();
+        stack.pop_back();
+        for (auto output : mEvaluationStages.GetStageOutputs(currentNodeIndex))
         {
-            currentNodeIndex = evaluationOrderList[i];
-            if (currentNodeIndex >= mbDirty.size() || mbDirty[currentNodeIndex]) // TODOUNDO
+            if (mbDirty[output])
                 continue;
-
-            auto& currentEvaluation = mEvaluationStages.GetEvaluationStage(currentNodeIndex);
-            for (auto inp : currentEvaluation.mInput.mInputs)
-            {
-                if (inp >= 0 && mbDirty[inp])
-                {
-                    mbDirty[currentNodeIndex] = true;
-                    break;
-                }
-            }
+            mbDirty[output] = true;
+            stack.push_back(output);
         }
     }
     if (onlyChild)
@@ -727,11 +1210,23 @@ void EvaluationContext::UserAddStage()
     URAdd<bool> undoRedoAddDirty(int(mbDirty.size()), [&]() {return &mbDirty; });
     URAdd<int> undoRedoAddProcessing(int(mbProcessing.size()), [&]() {return &mbProcessing; });
     URAdd<float> undoRedoAddProgress(int(mProgress.size()), [&]() {return &mProgress; });
+    URAdd<unsigned int> undoRedoAddOutputGeneration(int(mOutputGeneration.size()), [&]() {return &mOutputGeneration; });
+    URAdd<StageGeneration> undoRedoAddEvaluatedGeneration(int(mEvaluatedGeneration.size()), [&]() {return &mEvaluatedGeneration; });
+    URAdd<bool> undoRedoAddSourceDirty(int(mbSourceDirty.size()), [&]() {return &mbSourceDirty; });
+    URAdd<bool> undoRedoAddFusedStale(int(mbFusedStale.size()), [&]() {return &mbFusedStale; });
+    URAdd<bool> undoRedoAddDisplayed(int(mbDisplayed.size()), [&]() {return &mbDisplayed; });
+    URAdd<std::shared_ptr<RenderTarget>> undoRedoAddInputMipmaps(int(mInputMipmaps.size()), [&]() {return &mInputMipmaps; });
 
     mStageTarget.push_back(std::make_shared<RenderTarget>());
     mbDirty.push_back(true);
     mbProcessing.push_back(0);
     mProgress.push_back(0.f);
+    mOutputGeneration.push_back(0);
+    mEvaluatedGeneration.push_back(StageGeneration());
+    mbSourceDirty.push_back(true);
+    mbFusedStale.push_back(false);
+    mbDisplayed.push_back(false);
+    mInputMipmaps.push_back(std::shared_ptr<RenderTarget>());
 }
 
 void EvaluationContext::UserDeleteStage(size_t index)
@@ -740,11 +1235,79 @@ void EvaluationContext::UserDeleteStage(size_t index)
     URDel<bool> undoRedoDelDirty(int(index), [&]() {return &mbDirty; });
     URDel<int> undoRedoDelProcessing(int(index), [&]() {return &mbProcessing; });
     URDel<float> undoRedoDelProgress(int(index), [&]() {return &mProgress; });
+    URDel<unsigned int> undoRedoDelOutputGeneration(int(index), [&]() {return &mOutputGeneration; });
+    URDel<StageGeneration> undoRedoDelEvaluatedGeneration(int(index), [&]() {return &mEvaluatedGeneration; });
+    URDel<bool> undoRedoDelSourceDirty(int(index), [&]() {return &mbSourceDirty; });
+    URDel<bool> undoRedoDelFusedStale(int(index), [&]() {return &mbFusedStale; });
+    URDel<bool> undoRedoDelDisplayed(int(index), [&]() {return &mbDisplayed; });
+    URDel<std::shared_ptr<RenderTarget>> undoRedoDelInputMipmaps(int(index), [&]() {return &mInputMipmaps; });
 
     mStageTarget.erase(mStageTarget.begin() + index);
     mbDirty.erase(mbDirty.begin() + index);
     mbProcessing.erase(mbProcessing.begin() + index);
     mProgress.erase(mProgress.begin() + index);
+    mOutputGeneration.erase(mOutputGeneration.begin() + index);
+    mEvaluatedGeneration.erase(mEvaluatedGeneration.begin() + index);
+    mbSourceDirty.erase(mbSourceDirty.begin() + index);
+    mbFusedStale.erase(mbFusedStale.begin() + index);
+    mbDisplayed.erase(mbDisplayed.begin() + index);
+    mInputMipmaps.erase(mInputMipmaps.begin() + index);
+
+    // jobs of the following stages refer to a target index that is no longer valid
+    std::lock_guard<std::mutex> lock(mJobMutex);
+    if (index < mJobTokens.size())
+    {
+        mJobTokens.erase(mJobTokens.begin() + index);
+        for (size_t i = index; i < mJobTokens.size(); i++)
+            mJobTokens[i]++;
+    }
+}
+
+bool EvaluationContext::GenerateInputMipmaps(size_t target)
+{
+    if (target >= mInputMipmaps.size())
+        return false;
+    const int sourceIndex = mEvaluationStages.mStages[target].mInput.mInputs[0];
+    auto source = (sourceIndex < 0) ? std::shared_ptr<RenderTarget>() : GetRenderTarget(sourceIndex);
+    if (!source || !source->mGLTexID)
+        return false;
+
+    auto& copy = mInputMipmaps[target];
+    if (!copy)
+        copy = std::make_shared<RenderTarget>();
+    const int width = source->mImage.mWidth;
+    const int height = source->mImage.mHeight;
+    const bool cube = source->mImage.mNumFaces == 6;
+    if (cube)
+    {
+        // same mip count as GenerateMipmaps so the copy is only allocated once
+        int mipmapCount = 1;
+        while ((width >> mipmapCount) > 0)
+            mipmapCount++;
+        copy->InitCube(width, mipmapCount);
+    }
+    else
+    {
+        copy->InitBuffer(width, height, false);
+    }
+
+    // blit converts the input format to the RGBA8 of the copy
+    unsigned int readFbo;
+    glGenFramebuffers(1, &readFbo);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copy->mFbo);
+    for (int face = 0; face < source->mImage.mNumFaces; face++)
+    {
+        const GLenum faceTarget = cube ? GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face) : GLenum(GL_TEXTURE_2D);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, faceTarget, source->mGLTexID, 0);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, faceTarget, copy->mGLTexID, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &readFbo);
+
+    copy->GenerateMipmaps();
+    return true;
 }
 
 void EvaluationContext::AllocateComputeBuffer(int target, int elementCount, int elementSize)
@@ -757,9 +1320,13 @@ void EvaluationContext::AllocateComputeBuffer(int target, int elementCount, int
     if (!buffer.mBuffer)
         glGenBuffers(1, &buffer.mBuffer);
 
+    const unsigned int size = elementSize * elementCount;
+    if (size <= buffer.mCapacity)
+        return;
     glBindBuffer(GL_ARRAY_BUFFER, buffer.mBuffer);
-    glBufferData(GL_ARRAY_BUFFER, elementSize * elementCount, NULL, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_COPY);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    buffer.mCapacity = size;
 }
 
 const EvaluationContext::ComputeBuffer* EvaluationContext::GetComputeBuffer(size_t index) const
@@ -787,6 +1354,22 @@ void EvaluationContext::StageSetProgress(size_t target, float progress)
     mProgress[target] = progress;
 }
 
+int EvaluationContext::StageGetJobToken(size_t target) const
+{
+    std::lock_guard<std::mutex> lock(mJobMutex);
+    if (target >= mJobTokens.size())
+        return 0;
+    return mJobTokens[target];
+}
+
+bool EvaluationContext::StageJobIsCancelled(size_t target, int token) const
+{
+    std::lock_guard<std::mutex> lock(mJobMutex);
+    if (target >= mJobTokens.size())
+        return true;
+    return mJobTokens[target] != token;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 Builder::Builder()
@@ -44,20 +44,31 @@ struct EvaluationContext
     { 
         if (target >= mStageTarget.size())
             return NULL;
+        RealizeFusedStage(target);
         return mStageTarget[target]; 
     }
 
     FFMPEGCodec::Encoder *GetEncoder(const std::string &filename, int width, int height);
+    // converts the target to planar YUV420 on the GPU. yuv must hold width * height * 3 / 2 bytes.
+    // width and height are the encoded size, multiple of 4.
+    bool ReadbackYUV420(size_t target, int width, int height, unsigned char *yuv);
     bool IsSynchronous() const { return mbSynchronousEvaluation; }
     void SetTargetDirty(size_t target, bool onlyChild = false);
     int StageIsProcessing(size_t target) const { if (target >= mbProcessing.size()) return 0; return mbProcessing[target]; }
     float StageGetProgress(size_t target) const { if (target >= mProgress.size()) return 0.f; return mProgress[target]; }
     void StageSetProcessing(size_t target, int processing);
     void StageSetProgress(size_t target, float progress);
+    // asynchronous jobs. Evaluating a stage again cancels the jobs started by its previous evaluation.
+    // thread safe
+    int StageGetJobToken(size_t target) const;
+    bool StageJobIsCancelled(size_t target, int token) const;
 
     void AllocRenderTargetsForEditingPreview();
 
     void AllocateComputeBuffer(int target, int elementCount, int elementSize);
+    // copies input 0 of the stage into a mip chained target owned by the stage and sampled in place of
+    // the input. The input target isn't modified.
+    bool GenerateInputMipmaps(size_t target);
     // edit context only
     void UserAddStage();
     void UserDeleteStage(size_t index);
@@ -67,6 +78,14 @@ struct EvaluationContext
         unsigned int mBuffer{ 0 };
         unsigned int mElementCount;
         unsigned int mElementSize;
+        unsigned int mCapacity{ 0 }; // allocated bytes, the storage is only reallocated to grow
+
+        // kept from one evaluation to the next
+        unsigned int mVertexArray{ 0 }; // transform feedback source attributes
+        unsigned int mVertexArraySource{ 0 };
+        unsigned int mVertexArrayElementSize{ 0 };
+        unsigned int mDispatchBuffer{ 0 }; // indirect dispatch group counts
+        unsigned int mDispatchGroupCount{ 0 };
     };
 
     const ComputeBuffer* GetComputeBuffer(size_t index) const;
@@ -85,11 +104,28 @@ protected:
     void EvaluateC(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo);
     void EvaluatePython(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo);
     void EvaluateGLSLCompute(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo);
+    // dual filter pyramid for stages with a pyramidLevels parameter: levels downsampling passes into mPyramidTarget
+    // then as many upsampling passes, the last one to the stage target. Returns false when the target is too small.
+    bool EvaluatePyramid(const EvaluationStage& evaluationStage, size_t index, EvaluationInfo& evaluationInfo, int levels);
     // return true if any node is still in processing state
-    bool RunNodeList(const std::vector<size_t>& nodesToEvaluate);
+    // skipUnchanged : nodes only dirtied by their inputs are skipped when those inputs didn't change
+    bool RunNodeList(const std::vector<size_t>& nodesToEvaluate, bool skipUnchanged = false);
     void RunNode(size_t nodeIndex);
-
-    void RecurseBackward(size_t target, std::vector<size_t>& usedNodes);
+    bool StageIsUnchanged(size_t nodeIndex) const;
+    void StageEvaluated(size_t nodeIndex);
+
+    // pointwise stages used by a single pointwise stage are evaluated in the pass of that stage and their
+    // own target isn't written. It's written on demand, when the target is asked for. Displayed stages
+    // and baking with shared targets don't fuse.
+    bool IsFusible(size_t nodeIndex) const;
+    bool IsFusedInUser(size_t nodeIndex, const std::vector<bool>& evaluated) const;
+    size_t GetFusedStageCount(size_t nodeIndex) const;
+    bool CollectFusedStages(size_t nodeIndex, std::vector<size_t>& stages);
+    void AddFusedStages(size_t nodeIndex, std::vector<size_t>& stages, size_t& stepCount);
+    bool EvaluateFused(const std::vector<size_t>& stages, EvaluationInfo& evaluationInfo);
+    void RealizeFusedStage(size_t target);
+
+    void RecurseBackward(size_t target, std::vector<size_t>& usedNodes, std::vector<bool>& visited);
 
     void BindTextures(const EvaluationStage& evaluationStage, unsigned int program, std::shared_ptr<RenderTarget> reusableTarget);
     void AllocRenderTargetsForBaking(const std::vector<size_t>& nodesToEvaluate);
@@ -99,6 +135,7 @@ protected:
     int GetBindedComputeBuffer(const EvaluationStage& evaluationStage) const;
 
     std::vector<std::shared_ptr<RenderTarget> > mStageTarget; // 1 per stage
+    std::shared_ptr<RenderTarget> mPyramidTarget; // half resolution mip chain shared by pyramid stages
     std::vector<ComputeBuffer> mComputeBuffers;
     std::map<std::string, FFMPEGCodec::Encoder*> mWriteStreams;
     std::vector<bool> mbDirty;
@@ -106,6 +143,30 @@ protected:
     std::vector<float> mProgress;
     EvaluationInfo mEvaluationInfo;
 
+    // change tracking
+    struct StageGeneration
+    {
+        StageGeneration() : mbValid(false), mParameters(0)
+        {
+            memset(mInputs, -1, sizeof(mInputs));
+            memset(mInputOutputs, 0, sizeof(mInputOutputs));
+        }
+        bool mbValid;
+        unsigned int mParameters;
+        int mInputs[8];
+        unsigned int mInputOutputs[8];
+    };
+    std::vector<unsigned int> mOutputGeneration; // bumped each time the stage output is written
+    std::vector<StageGeneration> mEvaluatedGeneration; // stage and inputs state at last evaluation
+    std::vector<bool> mbSourceDirty; // dirtied for itself, not because of an input
+    std::vector<bool> mbFusedStale; // evaluated in the pass of its user, target not written
+    std::vector<bool> mbDisplayed; // texture asked for since the last evaluation, thumbnail or preview
+    std::vector<std::shared_ptr<RenderTarget> > mInputMipmaps; // mip chained copy of input 0, see GenerateInputMipmaps
+    bool mbSharedTargets; // baking targets are reused by stages evaluated later
+
+    mutable std::mutex mJobMutex;
+    std::vector<int> mJobTokens; // 1 per stage, guarded by mJobMutex
+
     std::vector<int> mStillDirty;
     int mDefaultWidth;
     int mDefaultHeight;
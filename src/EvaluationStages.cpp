@@ -51,8 +51,6 @@ void EvaluationStages::AddSingleEvaluation(size_t nodeType)
     evaluation.mLocalTime             = 0;
     evaluation.gEvaluationMask        = gEvaluators.GetMask(nodeType);
     evaluation.mbDepthBuffer          = false;
-    evaluation.scene                  = nullptr;
-    evaluation.renderer               = nullptr;
     evaluation.mRuntimeUniqueId       = GetRuntimeId();
     const size_t inputCount = gMetaNodes[nodeType].mInputs.size();
     evaluation.mInputSamplers.resize(inputCount);
@@ -60,6 +58,7 @@ void EvaluationStages::AddSingleEvaluation(size_t nodeType)
     evaluation.mEndFrame              = mFrameMax;
 
     InitDefaultParameters(evaluation);
+    GetTopology().AddNode();
     mStages.push_back(evaluation);
 }
 
@@ -76,12 +75,25 @@ void EvaluationStages::StageIsAdded(int index)
                 inp++;
         }
     }
+
+    if (mTopology.GetNodeCount() + 1 != mStages.size())
+    {
+        RebuildTopology();
+        return;
+    }
+    mTopology.InsertNode(index);
+    for (auto inp : mStages[index].mInput.mInputs)
+    {
+        if (inp >= 0)
+            mTopology.AddEdge(inp, index);
+    }
 }
 
 void EvaluationStages::StageIsDeleted(int index)
 {
     EvaluationStage& ev = mStages[index];
     ev.Clear();
+    GetTopology().DeleteNode(index);
 
     // shift all connections
     for (auto& evaluation : mStages)
@@ -111,39 +123,84 @@ void EvaluationStages::UserDeleteEvaluation(size_t target)
     mStages.erase(mStages.begin() + target);
 }
 
-void EvaluationStages::SetEvaluationParameters(size_t target, const std::vector<unsigned char> &parameters)
+bool EvaluationStages::SetEvaluationParameters(size_t target, const std::vector<unsigned char> &parameters)
 {
     EvaluationStage& stage = mStages[target];
     stage.mParameters = parameters;
 
+    // widgets report interaction even when the value ends up identical
+    bool bufferIsValid = !(stage.gEvaluationMask&EvaluationGLSL) || stage.mParametersBuffer;
+    if (bufferIsValid && stage.mParametersSnapshot == parameters)
+        return false;
+    stage.mParametersSnapshot = parameters;
+    stage.mGeneration++;
+
     if (stage.gEvaluationMask&EvaluationGLSL)
         BindGLSLParameters(stage);
     if (stage.mDecoder)
         stage.mDecoder = NULL;
+    return true;
 }
 
-void EvaluationStages::SetEvaluationSampler(size_t target, const std::vector<InputSampler>& inputSamplers)
+bool EvaluationStages::SetEvaluationSampler(size_t target, const std::vector<InputSampler>& inputSamplers)
 {
-    mStages[target].mInputSamplers = inputSamplers;
+    EvaluationStage& stage = mStages[target];
+    stage.mInputSamplers = inputSamplers;
+    if (stage.mInputSamplersSnapshot == inputSamplers)
+        return false;
+    stage.mInputSamplersSnapshot = inputSamplers;
+    stage.mGeneration++;
+    return true;
 }
 
-void EvaluationStages::AddEvaluationInput(size_t target, int slot, int source)
+bool EvaluationStages::AddEvaluationInput(size_t target, int slot, int source)
 {
     if (mStages[target].mInput.mInputs[slot] == source)
-        return;
+        return true;
+    // the edge of the previous input never makes the new one create a loop
+    if (!GetTopology().AddEdge(source, target))
+    {
+        Log("Acyclic graph. Loop is not allowed.\n");
+        return false;
+    }
+    if (mStages[target].mInput.mInputs[slot] >= 0)
+        DelEvaluationInput(target, slot);
     mStages[target].mInput.mInputs[slot] = source;
     mStages[source].mUseCountByOthers++;
+    return true;
 }
 
 void EvaluationStages::DelEvaluationInput(size_t target, int slot)
 {
-    mStages[mStages[target].mInput.mInputs[slot]].mUseCountByOthers--;
+    int source = mStages[target].mInput.mInputs[slot];
+    if (source < 0)
+        return;
+    GetTopology().DelEdge(source, target);
+    mStages[source].mUseCountByOthers--;
     mStages[target].mInput.mInputs[slot] = -1;
 }
 
-void EvaluationStages::SetEvaluationOrder(const std::vector<size_t> nodeOrderList)
+GraphTopology& EvaluationStages::GetTopology()
+{
+    // undo/redo can add or remove stages without notification
+    if (mTopology.GetNodeCount() != mStages.size())
+        RebuildTopology();
+    return mTopology;
+}
+
+void EvaluationStages::RebuildTopology()
 {
-    mEvaluationOrderList = nodeOrderList;
+    mTopology.Clear();
+    for (size_t i = 0; i < mStages.size(); i++)
+        mTopology.AddNode();
+    for (size_t i = 0; i < mStages.size(); i++)
+    {
+        for (auto inp : mStages[i].mInput.mInputs)
+        {
+            if (inp >= 0)
+                mTopology.AddEdge(inp, i);
+        }
+    }
 }
 
 void EvaluationStages::Clear()
@@ -152,7 +209,7 @@ void EvaluationStages::Clear()
         ev.Clear();
 
     mStages.clear();
-    mEvaluationOrderList.clear();
+    mTopology.Clear();
     mAnimTrack.clear();
 }
 
@@ -201,16 +258,10 @@ void EvaluationStages::SetStageLocalTime(EvaluationContext *evaluationContext, s
     }
 }
 
-FFMPEGCodec::Decoder* EvaluationStages::FindDecoder(const std::string& filename)
+std::shared_ptr<FFMPEGCodec::Decoder> EvaluationStages::FindDecoder(const std::string& filename)
 {
-    for (auto& evaluation : mStages)
-    {
-        if (evaluation.mDecoder && evaluation.mDecoder->GetFilename() == filename)
-            return evaluation.mDecoder.get();
-    }
-    auto decoder = new FFMPEGCodec::Decoder;
-    decoder->Open(filename);
-    return decoder;
+    // shared with every stage and evaluation context reading the same clip
+    return FFMPEGCodec::gDecoderPool.Acquire(filename);
 }
 
 Camera *EvaluationStages::GetCameraParameter(size_t index)
@@ -235,11 +286,11 @@ Camera *EvaluationStages::GetCameraParameter(size_t index)
 
     return NULL;
 }
-// TODO : create parameter struct with templated accessors
-int EvaluationStages::GetIntParameter(size_t index, const char *parameterName, int defaultValue)
+// value of the first parameter with that name and type, defaultValue when the node has none
+template<typename T> T EvaluationStages::GetParameter(size_t index, const char *parameterName, ConTypes parameterType, T defaultValue)
 {
     if (index >= mStages.size())
-        return NULL;
+        return defaultValue;
     EvaluationStage& stage = mStages[index];
     const MetaNode* metaNodes = gMetaNodes.data();
     const MetaNode& currentMeta = metaNodes[stage.mType];
@@ -248,19 +299,23 @@ int EvaluationStages::GetIntParameter(size_t index, const char *parameterName, i
     unsigned char *paramBuffer = stage.mParameters.data();
     for (const MetaParameter& param : currentMeta.mParams)
     {
-        if (param.mType == Con_Int)
-        {
-            if (!strcmp(param.mName.c_str(), parameterName))
-            {
-                int *value = (int*)paramBuffer;
-                return *value;
-            }
-        }
+        if (param.mType == parameterType && !strcmp(param.mName.c_str(), parameterName))
+            return *(T*)paramBuffer;
         paramBuffer += GetParameterTypeSize(param.mType);
     }
     return defaultValue;
 }
-
+
+int EvaluationStages::GetIntParameter(size_t index, const char *parameterName, int defaultValue)
+{
+    return GetParameter(index, parameterName, Con_Int, defaultValue);
+}
+
+float EvaluationStages::GetFloatParameter(size_t index, const char *parameterName, float defaultValue)
+{
+    return GetParameter(index, parameterName, Con_Float, defaultValue);
+}
+
 void EvaluationStages::InitDefaultParameters(EvaluationStage& stage)
 {
     const MetaNode* metaNodes = gMetaNodes.data();
@@ -319,9 +374,8 @@ void EvaluationStages::ApplyAnimationForNode(EvaluationContext *context, size_t
             animatedNodes = true;
         }
     }
-    if (animatedNodes)
+    if (animatedNodes && SetEvaluationParameters(nodeIndex, stage.mParameters))
     {
-        SetEvaluationParameters(nodeIndex, stage.mParameters);
         context->SetTargetDirty(nodeIndex);
     }
 }
@@ -342,8 +396,9 @@ void EvaluationStages::ApplyAnimation(EvaluationContext *context, int frame)
     {
         if (!animatedNodes[i])
             continue;
-        SetEvaluationParameters(i, mStages[i].mParameters);
-        context->SetTargetDirty(i);
+        // constant segments of a curve don't dirty the graph
+        if (SetEvaluationParameters(i, mStages[i].mParameters))
+            context->SetTargetDirty(i);
     }
 }
 
@@ -445,10 +500,25 @@ void EvaluationStages::SetTime(EvaluationContext *evaluationContext, int time, b
     }
 }
 
+size_t GetOwnedMemorySize(const EvaluationStage& stage)
+{
+    size_t size = stage.mParameters.capacity() + stage.mParametersSnapshot.capacity();
+    size += (stage.mInputSamplers.capacity() + stage.mInputSamplersSnapshot.capacity()) * sizeof(InputSampler);
+#ifdef _DEBUG
+    size += stage.mTypename.capacity();
+#endif
+    // the scene and its renderers stay alive while a copy references them. Each copy counts its share
+    if (stage.mScene)
+        size += EvaluationAPI::GetSceneLoadMemorySize(stage.mScene.get()) / stage.mScene.use_count();
+    return size;
+}
+
 void EvaluationStage::Clear()
 {
     if (gEvaluationMask&EvaluationGLSL)
         glDeleteBuffers(1, &mParametersBuffer);
     mParametersBuffer = 0;
+    mRenderer.reset();
+    mScene.reset();
 }
 
@@ -28,6 +28,7 @@
 #include <vector>
 #include <map>
 #include "Library.h"
+#include "GraphTopology.h"
 #include "libtcc/libtcc.h"
 #include "Imogen.h"
 #include <string.h>
@@ -40,6 +41,14 @@
 struct ImDrawList;
 struct ImDrawCmd;
 struct EvaluationContext;
+namespace EvaluationAPI
+{
+    struct SceneLoad;
+}
+namespace GLSLPathTracer
+{
+    class Renderer;
+}
 
 enum BlendOp
 {
@@ -79,6 +88,8 @@ struct EvaluationInfo
 
     int mFrame;
     int mLocalFrame;
+    int mipmapNumber;
+    int mipmapCount;
 };
 
 
@@ -103,6 +114,10 @@ struct EvaluationStage
     std::vector<unsigned char> mParameters;
     Input mInput;
     std::vector<InputSampler> mInputSamplers;
+    // values last pushed to the evaluation. mGeneration is bumped only when bytes differ
+    std::vector<unsigned char> mParametersSnapshot;
+    std::vector<InputSampler> mInputSamplersSnapshot;
+    unsigned int mGeneration{ 0 };
     int gEvaluationMask; // see EvaluationMask
     int mUseCountByOthers;
     int mBlendingSrc;
@@ -118,9 +133,9 @@ struct EvaluationStage
     bool mLButDown;
     bool mRButDown;
     void Clear();
-    // scene render
-    void *scene;
-    void *renderer;
+    // scene render. The scene stays in the scene cache while a stage references it
+    std::shared_ptr<EvaluationAPI::SceneLoad> mScene;
+    std::shared_ptr<GLSLPathTracer::Renderer> mRenderer;
     Image DecodeImage();
 
     bool operator != (const EvaluationStage& other) const
@@ -150,6 +165,9 @@ struct EvaluationStage
     }
 };
 
+// memory kept by undo copies of a stage, see URState
+size_t GetOwnedMemorySize(const EvaluationStage& stage);
+
 // simple API
 struct EvaluationStages
 {
@@ -164,11 +182,12 @@ struct EvaluationStages
     size_t GetStageType(size_t target) const { return mStages[target].mType; }
     size_t GetEvaluationImageDuration(size_t target);
     
-    void SetEvaluationParameters(size_t target, const std::vector<unsigned char>& parameters);
-    void SetEvaluationSampler(size_t target, const std::vector<InputSampler>& inputSamplers);
-    void AddEvaluationInput(size_t target, int slot, int source);
+    // return true if the values differ from the ones previously set
+    bool SetEvaluationParameters(size_t target, const std::vector<unsigned char>& parameters);
+    bool SetEvaluationSampler(size_t target, const std::vector<InputSampler>& inputSamplers);
+    // returns false if source depends on target. The previous input of the slot is kept.
+    bool AddEvaluationInput(size_t target, int slot, int source);
     void DelEvaluationInput(size_t target, int slot);
-    void SetEvaluationOrder(const std::vector<size_t> nodeOrderList);
     void SetMouse(int target, float rx, float ry, bool lButDown, bool rButDown);
     void Clear();
     
@@ -178,7 +197,11 @@ struct EvaluationStages
 
 
 
-    const std::vector<size_t>& GetForwardEvaluationOrder() const { return mEvaluationOrderList; }
+    // topology, updated incrementally when stages and inputs are added or removed
+    const std::vector<size_t>& GetForwardEvaluationOrder() { return GetTopology().GetOrder(); }
+    const std::vector<size_t>& GetStageOutputs(size_t target) { return GetTopology().GetFanOut(target); }
+    // true if 'to' uses 'from' directly or indirectly
+    bool IsReachable(size_t from, size_t to) { return GetTopology().IsReachable(from, to); }
 
     
     const EvaluationStage& GetEvaluationStage(size_t index) const {    return mStages[index]; }
@@ -186,6 +209,8 @@ struct EvaluationStages
     
     Camera *GetCameraParameter(size_t index);
     int GetIntParameter(size_t index, const char *parameterName, int defaultValue);
+    float GetFloatParameter(size_t index, const char *parameterName, float defaultValue);
+    template<typename T> T GetParameter(size_t index, const char *parameterName, ConTypes parameterType, T defaultValue);
     Mat4x4* GetParameterViewMatrix(size_t index) { if (index >= mStages.size()) return NULL; return &mStages[index].mParameterViewMatrix; }
     float GetParameterComponentValue(size_t index, int parameterIndex, int componentIndex);
 
@@ -202,12 +227,11 @@ struct EvaluationStages
 
         
     // ffmpeg encoders
-    FFMPEGCodec::Decoder* FindDecoder(const std::string& filename);
+    std::shared_ptr<FFMPEGCodec::Decoder> FindDecoder(const std::string& filename);
 
     // Data
     std::vector<AnimTrack> mAnimTrack;
     std::vector<EvaluationStage> mStages;
-    std::vector<size_t> mEvaluationOrderList;
     std::vector<uint32_t> mPinnedParameters;
     int mFrameMin, mFrameMax;
 
@@ -217,4 +241,8 @@ protected:
     void StageIsAdded(int index);
     void StageIsDeleted(int index);
     void InitDefaultParameters(EvaluationStage& stage);
+
+    GraphTopology mTopology;
+    GraphTopology& GetTopology();
+    void RebuildTopology();
 };
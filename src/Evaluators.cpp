@@ -32,13 +32,23 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 #include "Scene.h"
 #include "Loader.h"
+#include "SceneCache.h"
 #include "TiledRenderer.h"
 #include "ProgressiveRenderer.h"
+#include "CPURenderer.h"
 #include "GPUBVH.h"
 #include "Camera.h"
 
+// missing from the bundled glcorearb.h
+#ifndef GL_COMPUTE_WORK_GROUP_SIZE
+#define GL_COMPUTE_WORK_GROUP_SIZE 0x8267
+#endif
+
 Evaluators gEvaluators;
 extern enki::TaskScheduler g_TS;
 
@@ -59,13 +69,19 @@ static const EValuationFunction evaluationFunctions[] = {
     { "FreeImage", (void*)Image::Free },
     { "SetThumbnailImage", (void*)EvaluationAPI::SetThumbnailImage },
     { "Evaluate", (void*)EvaluationAPI::Evaluate},
+    { "EncodeEvaluation", (void*)EvaluationAPI::EncodeEvaluation},
     { "SetBlendingMode", (void*)EvaluationAPI::SetBlendingMode},
     { "EnableDepthBuffer", (void*)EvaluationAPI::EnableDepthBuffer},
     { "GetEvaluationSize", (void*)EvaluationAPI::GetEvaluationSize},
     { "SetEvaluationSize", (void*)EvaluationAPI::SetEvaluationSize },
     { "SetEvaluationCubeSize", (void*)EvaluationAPI::SetEvaluationCubeSize },
+    { "GenerateMipmaps", (void*)EvaluationAPI::GenerateMipmaps },
+    { "GenerateInputMipmaps", (void*)EvaluationAPI::GenerateInputMipmaps },
     { "AllocateComputeBuffer", (void*)EvaluationAPI::AllocateComputeBuffer },
-    { "CubemapFilter", (void*)Image::CubemapFilter},
+    { "CubemapFilter", (void*)EvaluationAPI::CubemapFilter},
+    { "ProjectSH", (void*)EvaluationAPI::ProjectSH},
+    { "SHIrradiance", (void*)EvaluationAPI::SHIrradiance},
+    { "GetJobToken", (void*)EvaluationAPI::GetJobToken},
     { "SetProcessing", (void*)EvaluationAPI::SetProcessing},
     { "Job", (void*)EvaluationAPI::Job },
     { "JobMain", (void*)EvaluationAPI::JobMain },
@@ -95,6 +111,44 @@ void LogPython(const std::string &str)
 
 PYBIND11_MAKE_OPAQUE(Image);
 
+// numpy arrays built with copy=False share the image pixels. Single face, single mip images are seen as
+// (height, width, channels) arrays, other layouts as flat bytes.
+static pybind11::buffer_info GetImageBuffer(Image& image)
+{
+    static const char* componentFormats[] = { "B", "B", "H", "e", "f", "B", "B", "B", "H", "e", "f", "B" };
+    const pybind11::ssize_t dataSize = image.GetBits() ? pybind11::ssize_t(image.mDataSize) : 0;
+    if (dataSize && image.mNumFaces == 1 && image.mNumMips == 1 && image.mFormat < TextureFormat::Count)
+    {
+        const pybind11::ssize_t channelCount = (image.mFormat < TextureFormat::RGBE) ? 3 : 4;
+        const pybind11::ssize_t componentSize = textureFormatSize[image.mFormat] / channelCount;
+        const pybind11::ssize_t lineSize = pybind11::ssize_t(image.mWidth) * channelCount * componentSize;
+        if (lineSize * image.mHeight <= dataSize)
+        {
+            return pybind11::buffer_info(image.GetBits(), componentSize, componentFormats[image.mFormat], 3
+                , { pybind11::ssize_t(image.mHeight), pybind11::ssize_t(image.mWidth), channelCount }
+                , { lineSize, channelCount * componentSize, componentSize });
+        }
+    }
+    return pybind11::buffer_info(image.GetBits(), 1, pybind11::format_descriptor<uint8_t>::format(), dataSize);
+}
+
+// views retain the pixels they were built on. Once the image is read, reallocated or freed, they keep the old pixels
+static getbufferproc gImageGetBuffer = nullptr;
+static releasebufferproc gImageReleaseBuffer = nullptr;
+static int GetImageView(PyObject *object, Py_buffer *view, int flags)
+{
+    if (gImageGetBuffer(object, view, flags))
+        return -1;
+    gImageBufferPool.Retain((unsigned char*)view->buf);
+    return 0;
+}
+
+static void ReleaseImageView(PyObject *object, Py_buffer *view)
+{
+    gImageBufferPool.Release((unsigned char*)view->buf);
+    gImageReleaseBuffer(object, view);
+}
+
 struct PyGraph {
     Material* mGraph;
 };
@@ -107,7 +161,34 @@ struct PyNode {
 
 PYBIND11_EMBEDDED_MODULE(Imogen, m) 
 {
-    pybind11::class_<Image>(m, "Image");
+    auto imageClass = pybind11::class_<Image>(m, "Image", pybind11::buffer_protocol());
+    imageClass.def(pybind11::init([]() {
+            Image *image = new Image;
+            image->mWidth = image->mHeight = 0;
+            image->mNumMips = image->mNumFaces = 1;
+            image->mFormat = TextureFormat::RGBA8;
+            return image;
+        }))
+        .def_property_readonly("width", [](const Image& image) { return image.mWidth; })
+        .def_property_readonly("height", [](const Image& image) { return image.mHeight; })
+        .def_property_readonly("format", [](const Image& image) { return int(image.mFormat); })
+        .def("Allocate", [](Image& image, int width, int height, int format) {
+            if (width <= 0 || height <= 0 || format < 0 || format >= TextureFormat::Count)
+                return int(EVAL_ERR);
+            image.mWidth = width;
+            image.mHeight = height;
+            image.mNumMips = image.mNumFaces = 1;
+            image.mFormat = uint8_t(format);
+            image.Allocate(size_t(width) * height * textureFormatSize[format]);
+            return int(EVAL_OK);
+        })
+        .def_buffer(GetImageBuffer);
+    PyBufferProcs *imageBufferProcs = ((PyTypeObject*)imageClass.ptr())->tp_as_buffer;
+    gImageGetBuffer = imageBufferProcs->bf_getbuffer;
+    gImageReleaseBuffer = imageBufferProcs->bf_releasebuffer;
+    imageBufferProcs->bf_getbuffer = GetImageView;
+    imageBufferProcs->bf_releasebuffer = ReleaseImageView;
+    pybind11::class_<EvaluationContext>(m, "EvaluationContext");
     auto graph = pybind11::class_<PyGraph>(m, "Graph");
     graph.def("GetEvaluationList", [](PyGraph& pyGraph) {
         auto d = pybind11::list();
@@ -274,25 +355,58 @@ PYBIND11_EMBEDDED_MODULE(Imogen, m)
         return std::string();
     });
     m.def("Log", LogPython );
-    m.def("ReadImage", Image::Read );
-    m.def("WriteImage", Image::Write );
-    m.def("GetEvaluationImage", EvaluationAPI::GetEvaluationImage );
-    m.def("SetEvaluationImage", EvaluationAPI::SetEvaluationImage );
-    m.def("SetEvaluationImageCube", EvaluationAPI::SetEvaluationImageCube );
+    // native work runs without the GIL so python jobs keep running on the other threads
+    typedef pybind11::call_guard<pybind11::gil_scoped_release> ReleaseGIL;
+    m.def("ReadImage", Image::Read, ReleaseGIL());
+    m.def("WriteImage", Image::Write, ReleaseGIL());
+    m.def("GetEvaluationImage", EvaluationAPI::GetEvaluationImage, ReleaseGIL());
+    m.def("SetEvaluationImage", EvaluationAPI::SetEvaluationImage, ReleaseGIL());
+    m.def("SetEvaluationImageCube", EvaluationAPI::SetEvaluationImageCube, ReleaseGIL());
     m.def("AllocateImage", EvaluationAPI::AllocateImage );
     m.def("FreeImage", Image::Free );
-    m.def("SetThumbnailImage", EvaluationAPI::SetThumbnailImage );
-    m.def("Evaluate", EvaluationAPI::Evaluate );
+    m.def("SetThumbnailImage", EvaluationAPI::SetThumbnailImage, ReleaseGIL());
+    m.def("Evaluate", EvaluationAPI::Evaluate, ReleaseGIL());
+    m.def("EncodeEvaluation", EvaluationAPI::EncodeEvaluation, ReleaseGIL());
     m.def("SetBlendingMode", EvaluationAPI::SetBlendingMode );
     m.def("GetEvaluationSize", EvaluationAPI::GetEvaluationSize );
     m.def("SetEvaluationSize", EvaluationAPI::SetEvaluationSize );
     m.def("SetEvaluationCubeSize", EvaluationAPI::SetEvaluationCubeSize );
-    m.def("CubemapFilter", Image::CubemapFilter );
+    m.def("GenerateMipmaps", EvaluationAPI::GenerateMipmaps );
+    m.def("GenerateInputMipmaps", EvaluationAPI::GenerateInputMipmaps );
+    m.def("CubemapFilter", EvaluationAPI::CubemapFilter, ReleaseGIL());
+    m.def("ProjectSH", [](Image *image) {
+        float coefficients[27];
+        auto d = pybind11::list();
+        int res;
+        {
+            pybind11::gil_scoped_release release;
+            res = EvaluationAPI::ProjectSH(image, coefficients);
+        }
+        if (res != EVAL_OK)
+            return d;
+        for (float coefficient : coefficients)
+            d.append(coefficient);
+        return d;
+        }
+        );
+    m.def("SHIrradiance", [](pybind11::list coefficients, int faceSize, Image *image) {
+        float values[27];
+        if (coefficients.size() != 27)
+            return int(EVAL_ERR);
+        for (size_t i = 0; i < 27; i++)
+            values[i] = coefficients[i].cast<float>();
+        pybind11::gil_scoped_release release;
+        return EvaluationAPI::SHIrradiance(values, faceSize, image);
+        }
+        );
+    m.def("SetSceneCacheBudget", EvaluationAPI::SetSceneCacheBudget );
+    m.def("GetSceneCacheMemoryUsage", EvaluationAPI::GetSceneCacheMemoryUsage );
+    m.def("SetUndoMemoryBudget", EvaluationAPI::SetUndoMemoryBudget );
+    m.def("GetUndoMemoryUsage", EvaluationAPI::GetUndoMemoryUsage );
+    m.def("GetJobToken", EvaluationAPI::GetJobToken );
     m.def("SetProcessing", EvaluationAPI::SetProcessing );
-    /*
-    m.def("Job", EvaluationStages::Job );
-    m.def("JobMain", EvaluationStages::JobMain );
-    */
+    m.def("Job", EvaluationAPI::PythonJob );
+    m.def("JobMain", EvaluationAPI::PythonJobMain );
     m.def("GetLibraryGraphs", []() {
         auto d = pybind11::list();
         for (auto& graph : library.mMaterials)
@@ -315,22 +429,6 @@ PYBIND11_EMBEDDED_MODULE(Imogen, m)
         return nullptr;
     }
     );
-    /*
-    m.def("accessor_api", []() {
-        auto d = pybind11::dict();
-
-        d["target"] = 10;
-
-        auto l = pybind11::list();
-        l.append(5);
-        l.append(-1);
-        l.append(-1);
-        d["inputs"] = l;
-
-        return d;
-    });
-    */
-    
     /*
     m.def("GetImage", []() {
         auto i = new Image;
@@ -353,6 +451,8 @@ std::string Evaluators::GetEvaluator(const std::string& filename)
 
 void Evaluators::SetEvaluators(const std::vector<EvaluatorFile>& evaluatorfilenames)
 {
+    // evaluators hold python modules
+    pybind11::gil_scoped_acquire acquire;
     ClearEvaluators();
 
     mEvaluatorPerNodeType.clear();
@@ -419,6 +519,7 @@ void Evaluators::SetEvaluators(const std::vector<EvaluatorFile>& evaluatorfilena
     TagTime("GLSL init");
 
     // GLSL compute
+    const bool computeShaderSupported = gl3wIsSupported(4, 3) != 0;
     for (auto& file : evaluatorfilenames)
     {
         if (file.mEvaluatorType != EVALUATOR_GLSLCOMPUTE)
@@ -439,7 +540,22 @@ void Evaluators::SetEvaluators(const std::vector<EvaluatorFile>& evaluatorfilena
         }
         else
         {
-            program = LoadShaderTransformFeedback(shader.mText, filename.c_str());
+            // files with a COMPUTE_SHADER section run as compute shaders, transform feedback is the fallback
+            shader.mComputeLocalSize = 0;
+            if (computeShaderSupported && shader.mText.find("COMPUTE_SHADER") != std::string::npos)
+            {
+                program = LoadShaderCompute(shader.mText, filename.c_str());
+                if (program)
+                {
+                    int localSize[3];
+                    glGetProgramiv(program, GL_COMPUTE_WORK_GROUP_SIZE, localSize);
+                    shader.mComputeLocalSize = localSize[0];
+                }
+            }
+            if (!program)
+            {
+                program = LoadShaderTransformFeedback(shader.mText, filename.c_str());
+            }
         }
 
         int parameterBlockIndex = glGetUniformBlockIndex(program, (nodeName + "Block").c_str());
@@ -451,7 +567,10 @@ void Evaluators::SetEvaluators(const std::vector<EvaluatorFile>& evaluatorfilena
             glUniformBlockBinding(program, parameterBlockIndex, 2);
         shader.mProgram = program;
         if (shader.mType != -1)
+        {
             mEvaluatorPerNodeType[shader.mType].mGLSLProgram = program;
+            mEvaluatorPerNodeType[shader.mType].mComputeLocalSize = shader.mComputeLocalSize;
+        }
     }
     TagTime("GLSL compute init");
     // C
@@ -554,6 +673,55 @@ void Evaluators::ClearEvaluators()
         if (program.mMem)
             free(program.mMem);
     }
+    for (auto& fused : mFusedPrograms)
+    {
+        if (fused.second)
+            glDeleteProgram(fused.second);
+    }
+    mFusedPrograms.clear();
+}
+
+unsigned int Evaluators::GetFusedProgram(const std::vector<FusedStep>& steps)
+{
+    std::string key;
+    for (auto& step : steps)
+    {
+        key += std::to_string(step.mNodeType);
+        for (int i = 0; i < 8; i++)
+            key += "," + std::to_string(step.mInputStep[i]) + "," + std::to_string(step.mInputSampler[i]);
+        key += ";";
+    }
+    auto iter = mFusedPrograms.find(key);
+    if (iter != mFusedPrograms.end())
+        return iter->second;
+
+    std::vector<std::string> nodeNames, nodeSources;
+    for (auto& step : steps)
+    {
+        const std::string& nodeName = gMetaNodes[step.mNodeType].mName;
+        auto scriptIter = mEvaluatorScripts.find(nodeName + ".glsl");
+        if (scriptIter == mEvaluatorScripts.end())
+            break;
+        nodeNames.push_back(nodeName);
+        nodeSources.push_back(scriptIter->second.mText);
+    }
+
+    const std::string shaderText = GenerateFusedShader(steps, nodeNames, nodeSources, mEvaluatorScripts["Shader.glsl"].mText);
+    unsigned int program = shaderText.empty() ? 0 : LoadShader(shaderText, "Fused");
+    if (program)
+    {
+        for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
+        {
+            int parameterBlockIndex = glGetUniformBlockIndex(program, GetFusedBlockName(nodeNames[stepIndex], stepIndex).c_str());
+            if (parameterBlockIndex != -1)
+                glUniformBlockBinding(program, parameterBlockIndex, FUSED_PARAMETERS_BINDING + int(stepIndex));
+        }
+        int parameterBlockIndex = glGetUniformBlockIndex(program, "EvaluationBlock");
+        if (parameterBlockIndex != -1)
+            glUniformBlockBinding(program, parameterBlockIndex, 2);
+    }
+    mFusedPrograms[key] = program;
+    return program;
 }
 
 int Evaluators::GetMask(size_t nodeType)
@@ -576,6 +744,7 @@ int Evaluators::GetMask(size_t nodeType)
         mask |= EvaluationGLSLCompute;
         iter->second.mType = int(nodeType);
         mEvaluatorPerNodeType[nodeType].mGLSLProgram = iter->second.mProgram;
+        mEvaluatorPerNodeType[nodeType].mComputeLocalSize = iter->second.mComputeLocalSize;
     }
     iter = mEvaluatorScripts.find(nodeName + ".c");
     if (iter != mEvaluatorScripts.end())
@@ -601,9 +770,20 @@ void Evaluators::InitPythonModules()
     mImogenModule.dec_ref();
 }
 
-void Evaluator::RunPython() const
+int Evaluator::RunPython(EvaluationContext *context, const EvaluationInfo& evaluationInfo) const
 {
-    mPyModule.attr("main")(gEvaluators.mImogenModule.attr("accessor_api")());
+    // nested evaluations (Evaluate, EncodeEvaluation) and C JobMain tasks get here without the GIL
+    pybind11::gil_scoped_acquire acquire;
+    auto d = pybind11::dict();
+    d["context"] = pybind11::cast(context, pybind11::return_value_policy::reference);
+    d["target"] = evaluationInfo.targetIndex;
+    auto inputs = pybind11::list();
+    for (int input : evaluationInfo.inputIndices)
+        inputs.append(input);
+    d["inputs"] = inputs;
+
+    pybind11::object res = mPyModule.attr("main")(d);
+    return res.is_none() ? int(EVAL_OK) : res.cast<int>();
 }
 
 namespace EvaluationAPI
@@ -699,7 +879,7 @@ namespace EvaluationAPI
         return EVAL_OK;
     }
 
-    int SetEvaluationCubeSize(EvaluationContext *evaluationContext, int target, int faceWidth)
+    int SetEvaluationCubeSize(EvaluationContext *evaluationContext, int target, int faceWidth, int mipmapCount)
     {
         if (target < 0 || target >= evaluationContext->mEvaluationStages.mStages.size())
             return EVAL_ERR;
@@ -707,29 +887,33 @@ namespace EvaluationAPI
         auto renderTarget = evaluationContext->GetRenderTarget(target);
         if (!renderTarget)
             return EVAL_ERR;
-        renderTarget->InitCube(faceWidth);
+        if (mipmapCount < 1 || (faceWidth >> (mipmapCount - 1)) < 1)
+            return EVAL_ERR;
+        renderTarget->InitCube(faceWidth, mipmapCount);
         return EVAL_OK;
     }
 
-
-    int SetEvaluationScene(EvaluationContext *evaluationContext, int target, void *scene)
-    {
-        evaluationContext->mEvaluationStages.mStages[target].scene = scene;
-        return EVAL_OK;
-    }
-
-    int GetEvaluationScene(EvaluationContext *evaluationContext, int target, void **scene)
+    int GenerateMipmaps(EvaluationContext *evaluationContext, int target)
     {
-        *scene = evaluationContext->mEvaluationStages.mStages[target].scene;
-        return EVAL_OK;
-    }
-
-    int GetEvaluationRenderer(EvaluationContext *evaluationContext, int target, void **renderer)
+        if (target < 0 || target >= evaluationContext->mEvaluationStages.mStages.size())
+            return EVAL_ERR;
+
+        auto renderTarget = evaluationContext->GetRenderTarget(target);
+        if (!renderTarget)
+            return EVAL_ERR;
+        renderTarget->GenerateMipmaps();
+        return EVAL_OK;
+    }
+
+    int GenerateInputMipmaps(EvaluationContext *evaluationContext, int target)
     {
-        *renderer = evaluationContext->mEvaluationStages.mStages[target].renderer;
-        return EVAL_OK;
-    }
+        if (target < 0 || target >= evaluationContext->mEvaluationStages.mStages.size())
+            return EVAL_ERR;
 
+        return evaluationContext->GenerateInputMipmaps(target) ? EVAL_OK : EVAL_ERR;
+    }
+
+
     int GetEvaluationImage(EvaluationContext *evaluationContext, int target, Image *image)
     {
         if (target == -1 || target >= evaluationContext->mEvaluationStages.mStages.size())
@@ -805,7 +989,7 @@ namespace EvaluationAPI
         }
         else
         {
-            tgt->InitCube(image->mWidth);
+            tgt->InitCube(image->mWidth, image->mNumMips);
             glBindTexture(GL_TEXTURE_CUBE_MAP, tgt->mGLTexID);
 
             for (int face = 0; face < image->mNumFaces; face++)
@@ -823,36 +1007,45 @@ namespace EvaluationAPI
                 TexParam(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_TEXTURE_CUBE_MAP);
 
         }
-        if (stage.mDecoder.get() != (FFMPEGCodec::Decoder*)image->mDecoder)
-            stage.mDecoder = std::shared_ptr<FFMPEGCodec::Decoder>((FFMPEGCodec::Decoder*)image->mDecoder);
+        const uintptr_t decoderHandle = uintptr_t(image->mDecoder);
+        if (!stage.mDecoder || stage.mDecoder->GetHandle() != decoderHandle)
+            stage.mDecoder = decoderHandle ? FFMPEGCodec::gDecoderPool.Lock(decoderHandle) : NULL;
         evaluationContext->SetTargetDirty(target, true);
         return EVAL_OK;
     }
 
-    int LoadScene(const char *filename, void **pscene)
+    static bool RunTiles(unsigned int tileCount, const std::function<void(unsigned int)>& tileFunction);
+
+    // parallel for of the path tracer library
+    static void ParallelForTiles(int count, const std::function<void(int)>& job)
+    {
+        RunTiles(count, [&job](unsigned int index) { job(int(index)); });
+    }
+
+    // bvhBuilder : 0 for SBVH, 1 for binned SAH
+    static GLSLPathTracer::Scene *LoadSceneAndBuildBVH(const std::string& filename, int bvhBuilder)
     {
-        // todo: make a real good cache system
-        static std::map<std::string, GLSLPathTracer::Scene *> cachedScenes;
-        std::string sFilename(filename);
-        auto iter = cachedScenes.find(sFilename);
-        if (iter != cachedScenes.end())
-        {
-            *pscene = iter->second;
-            return EVAL_OK;
-        }
-
-        GLSLPathTracer::Scene *scene = GLSLPathTracer::LoadScene(sFilename);
+        // the binary cache next to the scene skips parsing and BVH building when nothing changed
+        GLSLPathTracer::Scene *scene = GLSLPathTracer::LoadSceneCache(filename, bvhBuilder);
         if (!scene)
         {
-            Log("Unable to load scene\n");
-            return EVAL_ERR;
+            scene = GLSLPathTracer::LoadScene(filename, ParallelForTiles);
+            if (!scene)
+            {
+                Log("Unable to load scene\n");
+                return nullptr;
+            }
+
+            Log("Scene Loaded\n\n");
+
+            BVH::BuildParams params;
+            params.binned = bvhBuilder == 1;
+            params.parallelFor = ParallelForTiles;
+            scene->buildBVH(params);
+
+            if (!GLSLPathTracer::SaveSceneCache(scene, bvhBuilder))
+                Log("Scene cache not saved\n");
         }
-        cachedScenes.insert(std::make_pair(sFilename, scene));
-        *pscene = scene;
-
-        Log("Scene Loaded\n\n");
-
-        scene->buildBVH();
 
         // --------Print info on memory usage ------------- //
 
@@ -861,7 +1054,7 @@ namespace EvaluationAPI
         Log("Vertices: %d\n", scene->vertexData.size());
 
         long long scene_data_bytes =
-            sizeof(GLSLPathTracer::GPUBVHNode) * scene->gpuBVH->bvh->getNumNodes() +
+            sizeof(GLSLPathTracer::GPUBVHNode) * scene->gpuBVH->numNodes +
             sizeof(GLSLPathTracer::TriangleData) * scene->gpuBVH->bvhTriangleIndices.size() +
             sizeof(GLSLPathTracer::VertexData) * scene->vertexData.size() +
             sizeof(GLSLPathTracer::NormalTexData) * scene->normalTexData.size() +
@@ -880,21 +1073,371 @@ namespace EvaluationAPI
 
         Log("Total GPU Memory used: %d MB\n", (scene_data_bytes + tex_data_bytes) / 1048576);
 
+        return scene;
+    }
+
+    // memory of the buffers and textures uploaded by each GPU renderer of the scene
+    static size_t GetSceneVideoMemorySize(const GLSLPathTracer::Scene *scene)
+    {
+        const GLSLPathTracer::TexData& texData = scene->texData;
+        const HDRLoaderResult& hdr = scene->hdrLoaderRes;
+        size_t size = sizeof(GLSLPathTracer::NormalTexData) * scene->normalTexData.size() +
+            sizeof(GLSLPathTracer::VertexData) * scene->vertexData.size() +
+            sizeof(GLSLPathTracer::MaterialData) * scene->materialData.size() +
+            sizeof(GLSLPathTracer::LightData) * scene->lightData.size();
+        if (scene->gpuBVH)
+        {
+            size += sizeof(GLSLPathTracer::GPUBVHNode) * scene->gpuBVH->numNodes +
+                sizeof(GLSLPathTracer::TriIndexData) * scene->gpuBVH->bvhTriangleIndices.size();
+        }
+        // texture sizes are only set when there are textures
+        auto textureSize = [](int count, const glm::ivec2& size) { return (count > 0) ? size_t(size.x) * size_t(size.y) * 3 * count : 0; };
+        size += textureSize(texData.albedoTexCount, texData.albedoTextureSize) +
+            textureSize(texData.metallicRoughnessTexCount, texData.metallicRoughnessTextureSize) +
+            textureSize(texData.normalTexCount, texData.normalTextureSize);
+        if (scene->renderOptions.useEnvMap)
+        {
+            // colors, conditional and marginal distributions
+            size += size_t(hdr.width * hdr.height) * (sizeof(float) * 3 + sizeof(glm::vec2)) + size_t(hdr.height) * sizeof(glm::vec2);
+        }
+        return size;
+    }
+
+    // memory of the scene copy kept on the CPU : the uploaded arrays and the triangles used by the BVH build
+    static size_t GetSceneMemorySize(const GLSLPathTracer::Scene *scene)
+    {
+        return GetSceneVideoMemorySize(scene) + sizeof(GLSLPathTracer::TriangleData) * scene->triangleIndices.size();
+    }
+
+    struct SceneLoad;
+    struct SceneLoadTaskSet : enki::ITaskSet
+    {
+        SceneLoadTaskSet(SceneLoad *sceneLoad) : enki::ITaskSet()
+            , mSceneLoad(sceneLoad)
+        {
+        }
+        virtual void ExecuteRange(enki::TaskSetPartition range, uint32_t threadnum);
+        SceneLoad *mSceneLoad;
+    };
+
+    // future like object shared by every load of the same scene.
+    // Stages using the scene keep a reference in EvaluationStage::mScene. Nodes only see its handle.
+    struct SceneLoad
+    {
+        SceneLoad(const std::string& filename, int bvhBuilder) : mFilename(filename), mBVHBuilder(bvhBuilder), mScene(nullptr), mState(EVAL_DIRTY)
+            , mMemorySize(0), mVideoMemorySize(0), mGPURendererCount(0), mHandle(++mHandleCounter), mTask(this)
+        {
+        }
+        ~SceneLoad()
+        {
+            delete mScene;
+        }
+        void Run();
+        size_t GetMemorySize() const { return (mState == EVAL_OK) ? mMemorySize + mVideoMemorySize * mGPURendererCount : 0; }
+
+        std::string mFilename;
+        int mBVHBuilder;
+        GLSLPathTracer::Scene *mScene;
+        std::atomic<int> mState; // EVAL_DIRTY while loading
+        size_t mMemorySize; // valid when mState is EVAL_OK
+        size_t mVideoMemorySize; // per GPU renderer
+        std::atomic<int> mGPURendererCount;
+        uintptr_t mHandle; // never reused, resolved by ScenePool::Lock
+        SceneLoadTaskSet mTask; // runs the load, waited for by synchronous loads
+
+        static std::atomic<uintptr_t> mHandleCounter;
+    };
+    std::atomic<uintptr_t> SceneLoad::mHandleCounter(0);
+
+    // Process wide cache of loaded scenes, keyed by path and BVH builder.
+    // Scenes not referenced by any stage are deleted, least recently used first,
+    // when the memory of the loaded scenes and of their GPU renderers exceeds the budget.
+    // Nodes pass scenes as handles : a handle of a deleted scene resolves to nothing.
+    class ScenePool
+    {
+    public:
+        ScenePool() : mMaxMemory(1024 * 1024 * 1024) {}
+
+        // starts the load task when the scene isn't loaded or loading yet
+        void Acquire(const std::string& filename, int bvhBuilder, std::shared_ptr<SceneLoad>& sceneLoad);
+        std::shared_ptr<SceneLoad> Lock(uintptr_t handle);
+        void SetBudget(size_t maxMemory);
+        void CollectIdle();
+        size_t GetMemoryUsage();
+
+    private:
+        struct Entry
+        {
+            std::string mFilename;
+            int mBVHBuilder;
+            std::shared_ptr<SceneLoad> mSceneLoad;
+            std::chrono::steady_clock::time_point mLastUse;
+        };
+        std::mutex mMutex;
+        std::vector<Entry> mEntries;
+        std::map<uintptr_t, std::weak_ptr<SceneLoad> > mHandles;
+        size_t mMaxMemory;
+
+        void Collect();
+    };
+    static ScenePool gScenePool;
+
+    void ScenePool::Acquire(const std::string& filename, int bvhBuilder, std::shared_ptr<SceneLoad>& sceneLoad)
+    {
+        // the task is added under the lock : a scene seen loading always has a task to wait for
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto& entry : mEntries)
+        {
+            if (entry.mFilename != filename || entry.mBVHBuilder != bvhBuilder)
+                continue;
+            entry.mLastUse = std::chrono::steady_clock::now();
+            sceneLoad = entry.mSceneLoad;
+            // a failed load is retried, the file may have been fixed since
+            int expected = EVAL_ERR;
+            if (sceneLoad->mTask.GetIsComplete() && sceneLoad->mState.compare_exchange_strong(expected, EVAL_DIRTY))
+                g_TS.AddTaskSetToPipe(&sceneLoad->mTask);
+            return;
+        }
+        sceneLoad = std::make_shared<SceneLoad>(filename, bvhBuilder);
+        mEntries.push_back({ filename, bvhBuilder, sceneLoad, std::chrono::steady_clock::now() });
+        mHandles[sceneLoad->mHandle] = sceneLoad;
+        g_TS.AddTaskSetToPipe(&sceneLoad->mTask);
+    }
+
+    std::shared_ptr<SceneLoad> ScenePool::Lock(uintptr_t handle)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mHandles.find(handle);
+        return (iter != mHandles.end()) ? iter->second.lock() : nullptr;
+    }
+
+    void ScenePool::SetBudget(size_t maxMemory)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mMaxMemory = maxMemory;
+        Collect();
+    }
+
+    void ScenePool::CollectIdle()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Collect();
+    }
+
+    size_t ScenePool::GetMemoryUsage()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        size_t memory = 0;
+        for (auto& entry : mEntries)
+            memory += entry.mSceneLoad->GetMemorySize();
+        return memory;
+    }
+
+    void ScenePool::Collect()
+    {
+        // only scenes referenced by the pool alone and not loading anymore are idle.
+        // failed loads hold no memory but would pile up, a new Acquire retries them anyway
+        auto isIdle = [](const Entry& entry) { return entry.mSceneLoad.use_count() == 1 && entry.mSceneLoad->mTask.GetIsComplete(); };
+        mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+            return isIdle(entry) && entry.mSceneLoad->mState == EVAL_ERR;
+        }), mEntries.end());
+        while (true)
+        {
+            size_t memory = 0;
+            size_t idleIndex = mEntries.size();
+            for (size_t i = 0; i < mEntries.size(); i++)
+            {
+                Entry& entry = mEntries[i];
+                const SceneLoad *sceneLoad = entry.mSceneLoad.get();
+                memory += sceneLoad->GetMemorySize();
+                if (isIdle(entry) &&
+                    (idleIndex == mEntries.size() || entry.mLastUse < mEntries[idleIndex].mLastUse))
+                    idleIndex = i;
+            }
+            if (idleIndex == mEntries.size() || memory <= mMaxMemory)
+                break;
+            const Entry& entry = mEntries[idleIndex];
+            Log("Scene %s evicted, %d MB freed\n", entry.mFilename.c_str(), int(entry.mSceneLoad->GetMemorySize() / 1048576));
+            mEntries.erase(mEntries.begin() + idleIndex);
+        }
+        for (auto iter = mHandles.begin(); iter != mHandles.end();)
+        {
+            if (iter->second.expired())
+                iter = mHandles.erase(iter);
+            else
+                ++iter;
+        }
+    }
+
+    void SceneLoad::Run()
+    {
+        GLSLPathTracer::Scene *scene = LoadSceneAndBuildBVH(mFilename, mBVHBuilder);
+        if (scene)
+        {
+            mScene = scene;
+            mMemorySize = GetSceneMemorySize(scene);
+            mVideoMemorySize = GetSceneVideoMemorySize(scene);
+            Log("Scene %s uses %d MB, %d MB more on the GPU for each GPU renderer\n", mFilename.c_str(), int(mMemorySize / 1048576), int(mVideoMemorySize / 1048576));
+        }
+        // no pool call here : the task can run inline in Acquire, under the pool lock.
+        // The budget is applied when the scene is set on a stage.
+        mState = scene ? EVAL_OK : EVAL_ERR;
+    }
+
+    void SceneLoadTaskSet::ExecuteRange(enki::TaskSetPartition range, uint32_t threadnum)
+    {
+        // the pool keeps the scene load until its task is complete
+        mSceneLoad->Run();
+    }
+
+    void SetSceneCacheBudget(size_t maxMemory)
+    {
+        gScenePool.SetBudget(maxMemory);
+    }
+
+    size_t GetSceneCacheMemoryUsage()
+    {
+        return gScenePool.GetMemoryUsage();
+    }
+
+    void SetUndoMemoryBudget(size_t maxMemory)
+    {
+        gUndoRedoHandler.SetMemoryBudget(maxMemory);
+    }
+
+    size_t GetUndoMemoryUsage()
+    {
+        return gUndoRedoHandler.GetMemory();
+    }
+
+    int LoadSceneAsync(EvaluationContext *evaluationContext, const char *filename, int bvhBuilder, void **sceneHandle)
+    {
+        std::shared_ptr<SceneLoad> sceneLoad;
+        gScenePool.Acquire(filename, bvhBuilder, sceneLoad);
+        if (evaluationContext->IsSynchronous())
+            g_TS.WaitforTask(&sceneLoad->mTask);
+        *sceneHandle = (void*)sceneLoad->mHandle;
         return EVAL_OK;
+    }
+
+    static int GetSceneLoadState(const SceneLoad *sceneLoad, void **scene)
+    {
+        *scene = nullptr;
+        if (!sceneLoad)
+            return EVAL_ERR;
+        int state = sceneLoad->mState;
+        if (state == EVAL_OK)
+            *scene = sceneLoad->mScene;
+        return state;
+    }
+
+    size_t GetSceneLoadMemorySize(const SceneLoad *sceneLoad)
+    {
+        return sceneLoad->GetMemorySize();
+    }
+
+    int GetLoadedScene(void *sceneHandle, void **scene)
+    {
+        return GetSceneLoadState(gScenePool.Lock(uintptr_t(sceneHandle)).get(), scene);
+    }
+
+    int LoadScene(const char *filename, void **sceneHandle)
+    {
+        std::shared_ptr<SceneLoad> sceneLoad;
+        gScenePool.Acquire(filename, 0, sceneLoad);
+        // runs other jobs until the load is done, ours or started by another stage
+        g_TS.WaitforTask(&sceneLoad->mTask);
+        *sceneHandle = (void*)sceneLoad->mHandle;
+        return sceneLoad->mState;
+    }
+
+    int SetEvaluationScene(EvaluationContext *evaluationContext, int target, void *scene)
+    {
+        auto& stage = evaluationContext->mEvaluationStages.mStages[target];
+        const uintptr_t sceneHandle = uintptr_t(scene);
+        if (stage.mScene ? (stage.mScene->mHandle == sceneHandle) : !sceneHandle)
+            return EVAL_OK;
+        // the renderer GL buffers are built for the previous scene
+        stage.mRenderer.reset();
+        stage.mScene = sceneHandle ? gScenePool.Lock(sceneHandle) : nullptr;
+        gScenePool.CollectIdle();
+        Log("Loaded scenes use %d MB\n", int(gScenePool.GetMemoryUsage() / 1048576));
+        return (sceneHandle && !stage.mScene) ? EVAL_ERR : EVAL_OK;
+    }
+
+    int GetEvaluationScene(EvaluationContext *evaluationContext, int target, void **scene)
+    {
+        const auto& sceneLoad = evaluationContext->mEvaluationStages.mStages[target].mScene;
+        *scene = sceneLoad ? (void*)sceneLoad->mHandle : nullptr;
+        return EVAL_OK;
+    }
+
+    int GetEvaluationRenderer(EvaluationContext *evaluationContext, int target, void **renderer)
+    {
+        *renderer = evaluationContext->mEvaluationStages.mStages[target].mRenderer.get();
+        return EVAL_OK;
     }
 
+    // background passes of a CPU renderer, the main loop only uploads their result
+    struct RendererJobTaskSet : enki::ITaskSet
+    {
+        virtual void ExecuteRange(enki::TaskSetPartition range, uint32_t threadnum)
+        {
+            mJob();
+        }
+        std::function<void()> mJob;
+    };
+
+    static GLSLPathTracer::CPURenderer::AsyncJob MakeRendererAsyncJob()
+    {
+        std::shared_ptr<RendererJobTaskSet> task = std::make_shared<RendererJobTaskSet>();
+        GLSLPathTracer::CPURenderer::AsyncJob asyncJob;
+        asyncJob.start = [task](const std::function<void()>& job) {
+            task->mJob = job;
+            g_TS.AddTaskSetToPipe(task.get());
+        };
+        asyncJob.isDone = [task]() { return task->GetIsComplete(); };
+        asyncJob.wait = [task]() { g_TS.WaitforTask(task.get()); };
+        return asyncJob;
+    }
+
+    // mode : 0 Tiled, 1 Progressive, 2 CPU. Tiled uses the progressive renderer.
     int InitRenderer(EvaluationContext *evaluationContext, int target, int mode, void *scene)
     {
+        // the stage keeps its scene alive with SetEvaluationScene
         GLSLPathTracer::Scene *rdscene = (GLSLPathTracer::Scene *)scene;
-        evaluationContext->mEvaluationStages.mStages[target].scene = scene;
-
-        GLSLPathTracer::Renderer *currentRenderer = (GLSLPathTracer::Renderer*)evaluationContext->mEvaluationStages.mStages[target].renderer;
-        if (!currentRenderer)
+        auto& stage = evaluationContext->mEvaluationStages.mStages[target];
+        const GLSLPathTracer::RendererType type = (mode == 2) ? GLSLPathTracer::Renderer_CPU : GLSLPathTracer::Renderer_Progressive;
+        if (stage.mRenderer && stage.mRenderer->getType() != type)
+            stage.mRenderer.reset();
+        if (!stage.mRenderer)
         {
-            //auto renderer = new GLSLPathTracer::TiledRenderer(rdscene, "Stock/PathTracer/Tiled/");
-            auto renderer = new GLSLPathTracer::ProgressiveRenderer(rdscene, "Stock/PathTracer/Progressive/");
+            GLSLPathTracer::Renderer *renderer;
+            if (type == GLSLPathTracer::Renderer_CPU)
+            {
+                // presents with the progressive output shader
+                renderer = new GLSLPathTracer::CPURenderer(rdscene, "Stock/PathTracer/Progressive/", ParallelForTiles, MakeRendererAsyncJob());
+            }
+            else
+            {
+                //renderer = new GLSLPathTracer::TiledRenderer(rdscene, "Stock/PathTracer/Tiled/");
+                renderer = new GLSLPathTracer::ProgressiveRenderer(rdscene, "Stock/PathTracer/Progressive/");
+            }
             renderer->init();
-            evaluationContext->mEvaluationStages.mStages[target].renderer = renderer;
+            if (type == GLSLPathTracer::Renderer_CPU || !stage.mScene)
+            {
+                stage.mRenderer = std::shared_ptr<GLSLPathTracer::Renderer>(renderer);
+            }
+            else
+            {
+                // the GPU copy of the scene counts in the scene cache budget while the renderer lives
+                std::shared_ptr<SceneLoad> sceneLoad = stage.mScene;
+                sceneLoad->mGPURendererCount++;
+                stage.mRenderer = std::shared_ptr<GLSLPathTracer::Renderer>(renderer, [sceneLoad](GLSLPathTracer::Renderer *renderer) {
+                    sceneLoad->mGPURendererCount--;
+                    delete renderer;
+                });
+            }
         }
         return EVAL_OK;
     }
@@ -902,8 +1445,11 @@ namespace EvaluationAPI
     int UpdateRenderer(EvaluationContext *evaluationContext, int target)
     {
         auto& eval = evaluationContext->mEvaluationStages;
-        GLSLPathTracer::Renderer *renderer = (GLSLPathTracer::Renderer *)eval.mStages[target].renderer;
-        GLSLPathTracer::Scene *rdscene = (GLSLPathTracer::Scene *)eval.mStages[target].scene;
+        GLSLPathTracer::Renderer *renderer = eval.mStages[target].mRenderer.get();
+        void *scene;
+        if (!renderer || GetSceneLoadState(eval.mStages[target].mScene.get(), &scene) != EVAL_OK)
+            return EVAL_ERR;
+        GLSLPathTracer::Scene *rdscene = (GLSLPathTracer::Scene *)scene;
 
         Camera* camera = eval.GetCameraParameter(target);
         if (camera)
@@ -915,6 +1461,7 @@ namespace EvaluationAPI
             *rdscene->camera = newCam;
         }
 
+        renderer->setFrameBudget(eval.GetFloatParameter(target, "frameBudget", 8.f), eval.GetFloatParameter(target, "noiseThreshold", 0.01f));
         renderer->update(0.0166f);
         auto tgt = evaluationContext->GetRenderTarget(target);
         renderer->render();
@@ -1012,13 +1559,204 @@ namespace EvaluationAPI
         return EVAL_OK;
     }
 
+    // python jobs hold a callable, it is called and released with the GIL
+    static int RunPythonJob(pybind11::object& function)
+    {
+        pybind11::gil_scoped_acquire acquire;
+        int res = EVAL_ERR;
+        try
+        {
+            pybind11::object ret = function();
+            res = ret.is_none() ? int(EVAL_OK) : ret.cast<int>();
+        }
+        catch (std::exception& ex)
+        {
+            Log("%s\n", ex.what());
+        }
+        function = pybind11::object();
+        return res;
+    }
+
+    struct PythonTaskSet : enki::ITaskSet
+    {
+        PythonTaskSet(pybind11::object function) : enki::ITaskSet(), mFunction(std::move(function))
+        {
+        }
+        virtual void    ExecuteRange(enki::TaskSetPartition range, uint32_t threadnum)
+        {
+            RunPythonJob(mFunction);
+            delete this;
+        }
+        pybind11::object mFunction;
+    };
+
+    struct PythonMainTask : enki::IPinnedTask
+    {
+        PythonMainTask(pybind11::object function)
+            : enki::IPinnedTask(0) // set pinned thread to 0
+            , mFunction(std::move(function))
+        {
+        }
+        virtual void Execute()
+        {
+            RunPythonJob(mFunction);
+            delete this;
+        }
+        pybind11::object mFunction;
+    };
+
+    // Job runs on a worker : numpy and the image functions release the GIL, GL functions (Get/SetEvaluationImage...)
+    // must be called from a JobMain.
+    int PythonJob(EvaluationContext *evaluationContext, pybind11::function function)
+    {
+        if (evaluationContext->IsSynchronous())
+        {
+            return RunPythonJob(function);
+        }
+        g_TS.AddTaskSetToPipe(new PythonTaskSet(std::move(function)));
+        return EVAL_OK;
+    }
+
+    int PythonJobMain(EvaluationContext *evaluationContext, pybind11::function function)
+    {
+        if (evaluationContext->IsSynchronous())
+        {
+            return RunPythonJob(function);
+        }
+        g_TS.AddPinnedTask(new PythonMainTask(std::move(function)));
+        return EVAL_OK;
+    }
+
+    int GetJobToken(EvaluationContext *evaluationContext, int target)
+    {
+        return evaluationContext->StageGetJobToken(target);
+    }
+
+    struct JobProgressTask : enki::IPinnedTask
+    {
+        JobProgressTask(EvaluationContext *evaluationContext, int target, int token, float progress)
+            : enki::IPinnedTask(0) // set pinned thread to 0
+            , mEvaluationContext(evaluationContext)
+            , mTarget(target)
+            , mToken(token)
+            , mProgress(progress)
+        {
+        }
+        virtual void Execute()
+        {
+            if (!mEvaluationContext->StageJobIsCancelled(mTarget, mToken))
+                mEvaluationContext->StageSetProgress(mTarget, mProgress);
+            delete this;
+        }
+        EvaluationContext *mEvaluationContext;
+        int mTarget;
+        int mToken;
+        float mProgress;
+    };
+
+    struct FilterTilesTaskSet : enki::ITaskSet
+    {
+        FilterTilesTaskSet(EvaluationContext *evaluationContext, int target, int token, unsigned int tileCount, const std::function<void(unsigned int)>& filterTile)
+            : enki::ITaskSet(tileCount)
+            , mEvaluationContext(evaluationContext)
+            , mTarget(target)
+            , mToken(token)
+            , mFilterTile(filterTile)
+            , mCompletedTiles(0)
+            , mbCancelled(false)
+        {
+        }
+        virtual void ExecuteRange(enki::TaskSetPartition range, uint32_t threadnum)
+        {
+            for (uint32_t tile = range.start; tile < range.end; tile++)
+            {
+                if (mbCancelled || mEvaluationContext->StageJobIsCancelled(mTarget, mToken))
+                {
+                    mbCancelled = true;
+                    return;
+                }
+                mFilterTile(tile);
+                // progress is sent to the main thread by percent steps
+                unsigned int completed = ++mCompletedTiles;
+                if ((completed * 100) / m_SetSize != ((completed - 1) * 100) / m_SetSize)
+                    g_TS.AddPinnedTask(new JobProgressTask(mEvaluationContext, mTarget, mToken, float(completed) / float(m_SetSize)));
+            }
+        }
+        EvaluationContext *mEvaluationContext;
+        int mTarget;
+        int mToken;
+        const std::function<void(unsigned int)>& mFilterTile;
+        std::atomic<unsigned int> mCompletedTiles;
+        std::atomic_bool mbCancelled;
+    };
+
+    int CubemapFilter(EvaluationContext *evaluationContext, int target, int token, Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias)
+    {
+        return Image::CubemapFilter(image, faceSize, lightingModel, excludeBase, glossScale, glossBias
+            , [&](unsigned int tileCount, const std::function<void(unsigned int)>& filterTile) {
+            if (evaluationContext->IsSynchronous())
+            {
+                for (unsigned int tile = 0; tile < tileCount; tile++)
+                {
+                    if (evaluationContext->StageJobIsCancelled(target, token))
+                        return false;
+                    filterTile(tile);
+                    evaluationContext->StageSetProgress(target, float(tile + 1) / float(tileCount));
+                }
+                return true;
+            }
+            // called from a job : the waiting thread runs tiles too
+            g_TS.AddPinnedTask(new JobProgressTask(evaluationContext, target, token, 0.f));
+            FilterTilesTaskSet filterTask(evaluationContext, target, token, tileCount, filterTile);
+            g_TS.AddTaskSetToPipe(&filterTask);
+            g_TS.WaitforTask(&filterTask);
+            return !filterTask.mbCancelled;
+        });
+    }
+
+    struct TilesTaskSet : enki::ITaskSet
+    {
+        TilesTaskSet(unsigned int tileCount, const std::function<void(unsigned int)>& tileFunction)
+            : enki::ITaskSet(tileCount)
+            , mTileFunction(tileFunction)
+        {
+        }
+        virtual void ExecuteRange(enki::TaskSetPartition range, uint32_t threadnum)
+        {
+            for (uint32_t tile = range.start; tile < range.end; tile++)
+                mTileFunction(tile);
+        }
+        const std::function<void(unsigned int)>& mTileFunction;
+    };
+
+    // short work : the calling thread waits and runs tiles with the workers
+    static bool RunTiles(unsigned int tileCount, const std::function<void(unsigned int)>& tileFunction)
+    {
+        TilesTaskSet tilesTask(tileCount, tileFunction);
+        g_TS.AddTaskSetToPipe(&tilesTask);
+        g_TS.WaitforTask(&tilesTask);
+        return true;
+    }
+
+    int ProjectSH(Image *image, float *coefficients)
+    {
+        return Image::ProjectSH(image, coefficients, RunTiles);
+    }
+
+    int SHIrradiance(const float *coefficients, int faceSize, Image *image)
+    {
+        return Image::SHIrradiance(coefficients, faceSize, image, RunTiles);
+    }
+
     int Read(EvaluationContext *evaluationContext, const char *filename, Image *image)
     {
         if (Image::Read(filename, image) == EVAL_OK)
             return EVAL_OK;
         // try to load movie
         auto decoder = evaluationContext->mEvaluationStages.FindDecoder(filename);
-        *image = Image::DecodeImage(decoder, gEvaluationTime);
+        if (!decoder)
+            return EVAL_ERR;
+        *image = Image::DecodeImage(decoder.get(), gEvaluationTime);
         return EVAL_OK;
     }
 
@@ -1045,4 +1783,29 @@ namespace EvaluationAPI
         GetEvaluationImage(&context, target, image);
         return EVAL_OK;
     }
+
+    int EncodeEvaluation(EvaluationContext *evaluationContext, int target, int width, int height, const char *filename)
+    {
+        EvaluationContext context(evaluationContext->mEvaluationStages, true, width, height);
+        while (context.RunBackward(target))
+        {
+            // processing... maybe good on next run
+        }
+        auto renderTarget = context.GetRenderTarget(target);
+        if (!renderTarget)
+            return EVAL_ERR;
+        FFMPEGCodec::Encoder *encoder = evaluationContext->GetEncoder(std::string(filename), renderTarget->mImage.mWidth, renderTarget->mImage.mHeight);
+
+        // color conversion on the GPU, encoding on the encoder thread.
+        // The stream keeps the size of its first frame, frames of another size are resampled
+        const int encodedWidth = encoder->GetWidth();
+        const int encodedHeight = encoder->GetHeight();
+        if (!encodedWidth || !encodedHeight)
+            return EVAL_ERR;
+        std::vector<unsigned char> yuv(encodedWidth * encodedHeight * 3 / 2);
+        if (!context.ReadbackYUV420(target, encodedWidth, encodedHeight, yuv.data()))
+            return EVAL_ERR;
+        encoder->AddFrameYUV420(yuv.data(), encodedWidth, encodedHeight);
+        return EVAL_OK;
+    }
 }
\ No newline at end of file
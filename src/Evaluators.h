@@ -28,6 +28,7 @@
 #include <map>
 #include <string>
 #include "Imogen.h"
+#include "FusedShader.h"
 #include "pybind11/embed.h"
 
 
@@ -39,15 +40,21 @@ enum EvaluationMask
     EvaluationGLSLCompute = 1 << 3,
 };
 
+struct EvaluationContext;
+struct EvaluationInfo;
+
 struct Evaluator
 {
-    Evaluator() : mGLSLProgram(0), mCFunction(0), mMem(0) {}
+    Evaluator() : mGLSLProgram(0), mComputeLocalSize(0), mCFunction(0), mMem(0) {}
     unsigned int mGLSLProgram;
+    unsigned int mComputeLocalSize; // workgroup size of a compute shader program, 0 for transform feedback
     int(*mCFunction)(void *parameters, void *evaluationInfo, void *context);
     void *mMem;
     pybind11::module mPyModule;
 
-    void RunPython() const;
+    // calls main(evaluation) of the module on the calling thread, the main thread for graph evaluations, with the GIL.
+    // evaluation is a dict with context, target and inputs. Long work goes to Job, GL work to JobMain
+    int RunPython(EvaluationContext *context, const EvaluationInfo& evaluationInfo) const;
 
 #ifdef _DEBUG
     std::string mName;
@@ -61,6 +68,9 @@ struct Evaluators
     std::string GetEvaluator(const std::string& filename);
     int GetMask(size_t nodeType);
     void ClearEvaluators();
+    // program computing the steps in order and writing the last one, see GenerateFusedShader. Cached.
+    // 0 if a node doesn't only sample its computed inputs at vUV or it doesn't compile.
+    unsigned int GetFusedProgram(const std::vector<FusedStep>& steps);
 
     const Evaluator& GetEvaluator(size_t nodeType) const { return mEvaluatorPerNodeType[nodeType]; }
 
@@ -71,10 +81,11 @@ protected:
 
     struct EvaluatorScript
     {
-        EvaluatorScript() : mProgram(0), mCFunction(0), mMem(0), mType(-1) {}
-        EvaluatorScript(const std::string & text) : mText(text), mProgram(0), mCFunction(0), mMem(0), mType(-1) {}
+        EvaluatorScript() : mProgram(0), mComputeLocalSize(0), mCFunction(0), mMem(0), mType(-1) {}
+        EvaluatorScript(const std::string & text) : mText(text), mProgram(0), mComputeLocalSize(0), mCFunction(0), mMem(0), mType(-1) {}
         std::string mText;
         unsigned int mProgram;
+        unsigned int mComputeLocalSize;
         int(*mCFunction)(void *parameters, void *evaluationInfo, void *context);
         void *mMem;
         int mType;
@@ -84,6 +95,7 @@ protected:
 
     std::map<std::string, EvaluatorScript> mEvaluatorScripts;
     std::vector<Evaluator> mEvaluatorPerNodeType;
+    std::map<std::string, unsigned int> mFusedPrograms;
     
 };
 
@@ -94,6 +106,8 @@ struct EvaluationStages;
 
 namespace EvaluationAPI
 {
+    struct SceneLoad;
+
     // API
     int GetEvaluationImage(EvaluationContext *evaluationContext, int target, Image *image);
     int SetEvaluationImage(EvaluationContext *evaluationContext, int target, Image *image);
@@ -107,13 +121,34 @@ namespace EvaluationAPI
     //int SetNodeImage(int target, Image *image);
     int GetEvaluationSize(EvaluationContext *evaluationContext, int target, int *imageWidth, int *imageHeight);
     int SetEvaluationSize(EvaluationContext *evaluationContext, int target, int imageWidth, int imageHeight);
-    int SetEvaluationCubeSize(EvaluationContext *evaluationContext, int target, int faceWidth);
+    int SetEvaluationCubeSize(EvaluationContext *evaluationContext, int target, int faceWidth, int mipmapCount);
+    int GenerateMipmaps(EvaluationContext *evaluationContext, int target);
+    int GenerateInputMipmaps(EvaluationContext *evaluationContext, int target);
     int Job(EvaluationContext *evaluationContext, int(*jobFunction)(void*), void *ptr, unsigned int size);
     int JobMain(EvaluationContext *evaluationContext, int(*jobMainFunction)(void*), void *ptr, unsigned int size);
+    int PythonJob(EvaluationContext *evaluationContext, pybind11::function function);
+    int PythonJobMain(EvaluationContext *evaluationContext, pybind11::function function);
     void SetProcessing(EvaluationContext *context, int target, int processing);
     int AllocateComputeBuffer(EvaluationContext *context, int target, int elementCount, int elementSize);
+    int GetJobToken(EvaluationContext *evaluationContext, int target);
+    // returns EVAL_DIRTY when cancelled by a new evaluation of the target
+    int CubemapFilter(EvaluationContext *evaluationContext, int target, int token, Image *image, int faceSize, int lightingModel, int excludeBase, int glossScale, int glossBias);
+    // L2 spherical harmonics, 9 RGB coefficients
+    int ProjectSH(Image *image, float *coefficients);
+    int SHIrradiance(const float *coefficients, int faceSize, Image *image);
 
-    int LoadScene(const char *filename, void **scene);
+    // scenes loaded for stages are kept in a shared cache. Those no longer used by any stage are
+    // deleted, least recently used first, when the cache memory exceeds maxMemory bytes.
+    void SetSceneCacheBudget(size_t maxMemory);
+    size_t GetSceneCacheMemoryUsage();
+    // undo history is kept within maxMemory bytes, oldest undos are dropped first
+    void SetUndoMemoryBudget(size_t maxMemory);
+    size_t GetUndoMemoryUsage();
+    // loaded scene and its GPU renderers, 0 while loading
+    size_t GetSceneLoadMemorySize(const SceneLoad *sceneLoad);
+    int LoadScene(const char *filename, void **sceneHandle);
+    int LoadSceneAsync(EvaluationContext *evaluationContext, const char *filename, int bvhBuilder, void **sceneHandle);
+    int GetLoadedScene(void *sceneHandle, void **scene);
     int SetEvaluationScene(EvaluationContext *evaluationContext, int target, void *scene);
     int GetEvaluationScene(EvaluationContext *evaluationContext, int target, void **scene);
     int GetEvaluationRenderer(EvaluationContext *evaluationContext, int target, void **renderer);
@@ -123,4 +158,5 @@ namespace EvaluationAPI
     int Read(EvaluationContext *evaluationContext, const char *filename, Image *image);
     int Write(EvaluationContext *evaluationContext, const char *filename, Image *image, int format, int quality);
     int Evaluate(EvaluationContext *evaluationContext, int target, int width, int height, Image *image);
+    int EncodeEvaluation(EvaluationContext *evaluationContext, int target, int width, int height, const char *filename);
 }
\ No newline at end of file
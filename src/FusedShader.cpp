@@ -0,0 +1,153 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "FusedShader.h"
+#include "Utils.h"
+
+static const char* renamedSuffixes[] = { "", "Block", "Param" };
+
+static std::string GetStepSuffix(size_t stepIndex)
+{
+    return "_F" + std::to_string(stepIndex);
+}
+
+std::string GetFusedBlockName(const std::string& nodeName, size_t stepIndex)
+{
+    return nodeName + "Block" + GetStepSuffix(stepIndex);
+}
+
+// [begin, end) of the declaration whose first line contains 'name', up to the end of its braces.
+// With 'declarator', up to the following ';' too.
+static bool FindDeclaration(const std::string& source, const std::string& name, bool declarator, size_t& begin, size_t& end)
+{
+    size_t position = source.find(name);
+    if (position == std::string::npos)
+        return false;
+    begin = source.rfind('\n', position);
+    begin = (begin == std::string::npos) ? 0 : begin + 1;
+    end = source.find('{', position);
+    if (end == std::string::npos)
+        return false;
+    int depth = 0;
+    for (; end < source.size(); end++)
+    {
+        if (source[end] == '{')
+            depth++;
+        else if (source[end] == '}' && !--depth)
+            break;
+    }
+    if (end == source.size())
+        return false;
+    end++;
+    if (declarator)
+    {
+        end = source.find(';', end);
+        if (end == std::string::npos)
+            return false;
+        end++;
+    }
+    return true;
+}
+
+// parameter block and function of the node, and the rest of the source: helpers and defines
+static bool SplitNodeSource(const std::string& source, const std::string& nodeName, std::string& declarations, std::string& rest)
+{
+    size_t functionBegin, functionEnd;
+    if (!FindDeclaration(source, " " + nodeName + "()", false, functionBegin, functionEnd))
+        return false;
+    size_t blockBegin, blockEnd;
+    if (!FindDeclaration(source, "uniform " + nodeName + "Block", true, blockBegin, blockEnd))
+        blockBegin = blockEnd = functionBegin;
+    if (blockEnd > functionBegin)
+        return false;
+    rest = source.substr(0, blockBegin) + source.substr(blockEnd, functionBegin - blockEnd) + source.substr(functionEnd);
+    declarations = source.substr(blockBegin, blockEnd - blockBegin) + "\n" + source.substr(functionBegin, functionEnd - functionBegin) + "\n";
+    return true;
+}
+
+std::string GenerateFusedShader(const std::vector<FusedStep>& steps, const std::vector<std::string>& nodeNames, const std::vector<std::string>& nodeSources, const std::string& shaderTemplate)
+{
+    if (steps.empty() || steps.size() > FUSED_MAX_STEPS || nodeNames.size() != steps.size() || nodeSources.size() != steps.size())
+        return std::string();
+
+    // each step includes its node source with the function and parameter block renamed with the step index
+    std::string declarations, nodes, body;
+    for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
+    {
+        const FusedStep& step = steps[stepIndex];
+        const std::string& nodeName = nodeNames[stepIndex];
+        std::string source = nodeSources[stepIndex];
+        if (source.find("EvaluationParam") != std::string::npos || source.find("CubeSampler") != std::string::npos)
+            return std::string();
+
+        // computed and disconnected inputs become values. Bound inputs are renamed to their unit in 2 steps
+        // so a sampler is never renamed twice.
+        for (int i = 0; i < 8; i++)
+        {
+            const std::string sampler = "Sampler" + std::to_string(i);
+            if (step.mInputStep[i] == -1 && step.mInputSampler[i] != -1)
+            {
+                source = ReplaceAll(source, sampler, "FusedSampler_" + std::to_string(i));
+                continue;
+            }
+            const std::string value = (step.mInputStep[i] != -1) ? "FusedValue" + std::to_string(step.mInputStep[i]) : "vec4(0.0, 0.0, 0.0, 1.0)";
+            source = ReplaceAll(source, "texture(" + sampler + ", vUV)", value);
+            if (source.find(sampler) != std::string::npos)
+                return std::string();
+        }
+        for (int i = 0; i < 8; i++)
+        {
+            if (step.mInputStep[i] == -1 && step.mInputSampler[i] != -1)
+                source = ReplaceAll(source, "FusedSampler_" + std::to_string(i), "Sampler" + std::to_string(step.mInputSampler[i]));
+        }
+
+        bool typeIncluded = false;
+        for (size_t previous = 0; previous < stepIndex; previous++)
+            typeIncluded |= nodeNames[previous] == nodeName;
+        // the rest of the source is only included by the first step of the type, it must not read inputs
+        if (typeIncluded)
+        {
+            std::string nodeDeclarations, rest;
+            if (!SplitNodeSource(nodeSources[stepIndex], nodeName, nodeDeclarations, rest) || rest.find("Sampler") != std::string::npos)
+                return std::string();
+            if (!SplitNodeSource(std::string(source), nodeName, source, rest))
+                return std::string();
+        }
+
+        const std::string suffix = GetStepSuffix(stepIndex);
+        declarations += "vec4 FusedValue" + std::to_string(stepIndex) + ";\n";
+        for (auto renamed : renamedSuffixes)
+            nodes += std::string("#define ") + nodeName + renamed + " " + nodeName + renamed + suffix + "\n";
+        nodes += source + "\n";
+        for (auto renamed : renamedSuffixes)
+            nodes += std::string("#undef ") + nodeName + renamed + "\n";
+        // clamped like a value read back from an RGBA8 target
+        body += "    FusedValue" + std::to_string(stepIndex) + " = clamp(vec4(" + nodeName + suffix + "()), 0.0, 1.0);\n";
+    }
+
+    std::string fused = declarations + nodes + "vec4 Fused()\n{\n" + body + "    return FusedValue" + std::to_string(steps.size() - 1) + ";\n}\n";
+    std::string shaderText = ReplaceAll(shaderTemplate, "__NODE__", fused);
+    return ReplaceAll(shaderText, "__FUNCTION__", "Fused()");
+}
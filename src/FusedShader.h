@@ -0,0 +1,47 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+#include <string>
+#include <vector>
+
+// Pointwise stages evaluated in a single pass. A step is 1 stage, its inputs are either the result of
+// a previous step or a texture bound on a sampler unit.
+struct FusedStep
+{
+    size_t mNodeType;
+    int mInputStep[8]; // -1 when the input is not computed in the pass
+    int mInputSampler[8]; // -1 when the input is not connected
+};
+// parameters of step N are bound to uniform block binding FUSED_PARAMETERS_BINDING + N
+static const int FUSED_PARAMETERS_BINDING = 3;
+static const size_t FUSED_MAX_STEPS = 8;
+
+// Shader computing the steps in order and returning the last one, made of the node sources put in the
+// Shader.glsl template. nodeNames and nodeSources are given per step. Every step has its own function and
+// parameter block, named with GetFusedBlockName. Helpers of a node used by several steps are shared.
+// Empty if a node doesn't only sample its computed inputs at vUV.
+std::string GenerateFusedShader(const std::vector<FusedStep>& steps, const std::vector<std::string>& nodeNames, const std::vector<std::string>& nodeSources, const std::string& shaderTemplate);
+std::string GetFusedBlockName(const std::string& nodeName, size_t stepIndex);
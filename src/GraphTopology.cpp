@@ -0,0 +1,210 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "GraphTopology.h"
+#include <algorithm>
+
+void GraphTopology::Clear()
+{
+    mFanIn.clear();
+    mFanOut.clear();
+    mOrder.clear();
+    mPosition.clear();
+    mVisitMark.clear();
+}
+
+void GraphTopology::AddNode()
+{
+    mPosition.push_back(mOrder.size());
+    mOrder.push_back(mFanIn.size());
+    mFanIn.push_back(std::vector<size_t>());
+    mFanOut.push_back(std::vector<size_t>());
+}
+
+void GraphTopology::InsertNode(size_t index)
+{
+    auto shift = [index](size_t& node) { if (node >= index) node++; };
+    for (auto& nodes : mFanIn)
+        std::for_each(nodes.begin(), nodes.end(), shift);
+    for (auto& nodes : mFanOut)
+        std::for_each(nodes.begin(), nodes.end(), shift);
+    std::for_each(mOrder.begin(), mOrder.end(), shift);
+
+    mFanIn.insert(mFanIn.begin() + index, std::vector<size_t>());
+    mFanOut.insert(mFanOut.begin() + index, std::vector<size_t>());
+    // no edge yet : any place in the order is valid
+    mOrder.push_back(index);
+    UpdatePositions();
+}
+
+void GraphTopology::DeleteNode(size_t index)
+{
+    for (auto target : mFanOut[index])
+    {
+        auto& fanIn = mFanIn[target];
+        fanIn.erase(std::remove(fanIn.begin(), fanIn.end(), index), fanIn.end());
+    }
+    for (auto source : mFanIn[index])
+    {
+        auto& fanOut = mFanOut[source];
+        fanOut.erase(std::remove(fanOut.begin(), fanOut.end(), index), fanOut.end());
+    }
+    mFanIn.erase(mFanIn.begin() + index);
+    mFanOut.erase(mFanOut.begin() + index);
+    mOrder.erase(mOrder.begin() + mPosition[index]);
+
+    auto shift = [index](size_t& node) { if (node > index) node--; };
+    for (auto& nodes : mFanIn)
+        std::for_each(nodes.begin(), nodes.end(), shift);
+    for (auto& nodes : mFanOut)
+        std::for_each(nodes.begin(), nodes.end(), shift);
+    std::for_each(mOrder.begin(), mOrder.end(), shift);
+    UpdatePositions();
+}
+
+bool GraphTopology::AddEdge(size_t source, size_t target)
+{
+    if (source == target)
+        return false;
+    const size_t lowerBound = mPosition[target];
+    const size_t upperBound = mPosition[source];
+    if (lowerBound < upperBound)
+    {
+        // reorder the affected region : nodes reachable from target that are before source,
+        // and nodes reaching source that are after target.
+        std::vector<size_t> forward, backward;
+        NewVisit();
+        if (VisitForward(target, upperBound, source, forward))
+            return false;
+        NewVisit();
+        VisitBackward(source, lowerBound, backward);
+
+        auto byPosition = [&](size_t a, size_t b) { return mPosition[a] < mPosition[b]; };
+        std::sort(forward.begin(), forward.end(), byPosition);
+        std::sort(backward.begin(), backward.end(), byPosition);
+
+        std::vector<size_t> positions;
+        positions.reserve(forward.size() + backward.size());
+        for (auto node : backward)
+            positions.push_back(mPosition[node]);
+        for (auto node : forward)
+            positions.push_back(mPosition[node]);
+        std::sort(positions.begin(), positions.end());
+
+        // backward nodes keep their relative order and go first
+        backward.insert(backward.end(), forward.begin(), forward.end());
+        for (size_t i = 0; i < backward.size(); i++)
+        {
+            mOrder[positions[i]] = backward[i];
+            mPosition[backward[i]] = positions[i];
+        }
+    }
+    mFanOut[source].push_back(target);
+    mFanIn[target].push_back(source);
+    return true;
+}
+
+void GraphTopology::DelEdge(size_t source, size_t target)
+{
+    // the order stays valid when an edge is removed
+    auto& fanOut = mFanOut[source];
+    auto iterOut = std::find(fanOut.begin(), fanOut.end(), target);
+    if (iterOut == fanOut.end())
+        return;
+    fanOut.erase(iterOut);
+    auto& fanIn = mFanIn[target];
+    fanIn.erase(std::find(fanIn.begin(), fanIn.end(), source));
+}
+
+bool GraphTopology::IsReachable(size_t from, size_t to) const
+{
+    if (from == to)
+        return true;
+    // nothing after 'to' in the order can reach it
+    if (mPosition[from] > mPosition[to])
+        return false;
+    std::vector<size_t> visited;
+    NewVisit();
+    return VisitForward(from, mPosition[to], to, visited);
+}
+
+void GraphTopology::NewVisit() const
+{
+    mVisitMark.resize(mFanIn.size(), 0);
+    if (!++mVisitGeneration)
+    {
+        std::fill(mVisitMark.begin(), mVisitMark.end(), 0);
+        mVisitGeneration = 1;
+    }
+}
+
+bool GraphTopology::VisitForward(size_t node, size_t upperBound, size_t stopNode, std::vector<size_t>& visited) const
+{
+    // iterative : graphs can be deep
+    std::vector<size_t> stack(1, node);
+    mVisitMark[node] = mVisitGeneration;
+    while (!stack.empty())
+    {
+        size_t current = stack.back();
+        stack.pop_back();
+        visited.push_back(current);
+        for (auto next : mFanOut[current])
+        {
+            if (next == stopNode)
+                return true;
+            if (mVisitMark[next] == mVisitGeneration || mPosition[next] > upperBound)
+                continue;
+            mVisitMark[next] = mVisitGeneration;
+            stack.push_back(next);
+        }
+    }
+    return false;
+}
+
+void GraphTopology::VisitBackward(size_t node, size_t lowerBound, std::vector<size_t>& visited) const
+{
+    std::vector<size_t> stack(1, node);
+    mVisitMark[node] = mVisitGeneration;
+    while (!stack.empty())
+    {
+        size_t current = stack.back();
+        stack.pop_back();
+        visited.push_back(current);
+        for (auto previous : mFanIn[current])
+        {
+            if (mVisitMark[previous] == mVisitGeneration || mPosition[previous] < lowerBound)
+                continue;
+            mVisitMark[previous] = mVisitGeneration;
+            stack.push_back(previous);
+        }
+    }
+}
+
+void GraphTopology::UpdatePositions()
+{
+    mPosition.resize(mOrder.size());
+    for (size_t i = 0; i < mOrder.size(); i++)
+        mPosition[mOrder[i]] = i;
+}
@@ -0,0 +1,73 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+#include <vector>
+#include <stddef.h>
+
+// Incremental topology of the stage graph.
+// An edge goes from a source stage to the stage using it as an input. One edge per connected slot.
+// The topological order (sources first) is maintained on edge insertion with the Pearce-Kelly
+// algorithm: only the nodes between the 2 ends of the new edge are visited and reordered.
+struct GraphTopology
+{
+    GraphTopology() : mVisitGeneration(0) {}
+
+    void Clear();
+    size_t GetNodeCount() const { return mFanIn.size(); }
+
+    // new node without edges, at the end of the order
+    void AddNode();
+    // shifts indices >= index. Used when a deleted stage is restored.
+    void InsertNode(size_t index);
+    // removes the node edges and shifts indices > index
+    void DeleteNode(size_t index);
+
+    // returns false and leaves the graph unchanged if the edge would create a cycle
+    bool AddEdge(size_t source, size_t target);
+    void DelEdge(size_t source, size_t target);
+
+    // true if there is a path from 'from' to 'to'
+    bool IsReachable(size_t from, size_t to) const;
+
+    const std::vector<size_t>& GetOrder() const { return mOrder; }
+    const std::vector<size_t>& GetFanIn(size_t node) const { return mFanIn[node]; }
+    const std::vector<size_t>& GetFanOut(size_t node) const { return mFanOut[node]; }
+
+protected:
+    std::vector<std::vector<size_t> > mFanIn;
+    std::vector<std::vector<size_t> > mFanOut;
+    std::vector<size_t> mOrder; // node indices, sources first
+    std::vector<size_t> mPosition; // position of a node in mOrder
+
+    // visited set without clearing : a node is visited when its mark equals the generation
+    mutable std::vector<unsigned int> mVisitMark;
+    mutable unsigned int mVisitGeneration;
+
+    void NewVisit() const;
+    bool VisitForward(size_t node, size_t upperBound, size_t stopNode, std::vector<size_t>& visited) const;
+    void VisitBackward(size_t node, size_t lowerBound, std::vector<size_t>& visited) const;
+    void UpdatePositions();
+};
@@ -682,7 +682,6 @@ void Imogen::UpdateNewlySelectedGraph()
             MaterialNodeRug& rug = material.mMaterialRugs[i];
             NodeGraphAddRug(rug.mPosX, rug.mPosY, rug.mSizeX, rug.mSizeY, rug.mColor, rug.mComment);
         }
-        NodeGraphUpdateEvaluationOrder(mNodeGraphControler);
         NodeGraphUpdateScrolling();
         gEvaluationTime = 0;
         gbIsPlaying = false;
@@ -1245,6 +1244,7 @@ void Imogen::ShowAppMainMenuBar()
         {
             if (ImGui::MenuItem(plugin.mName.c_str())) 
             {
+                pybind11::gil_scoped_acquire acquire;
                 try
                 {
                     pybind11::exec(plugin.mPythonCommand);
@@ -1271,10 +1271,24 @@ void Imogen::ShowAppMainMenuBar()
 
             ImGui::EndMenu();
         }
+        if (ImGui::BeginMenu("Memory"))
+        {
+            if (ImGui::SliderInt("Scene cache (MB)", &mSceneCacheBudget, 64, 16384))
+                EvaluationAPI::SetSceneCacheBudget(size_t(mSceneCacheBudget) * 1048576);
+            ImGui::Text("Loaded scenes use %d MB", int(EvaluationAPI::GetSceneCacheMemoryUsage() / 1048576));
+            if (ImGui::SliderInt("Undo history (MB)", &mUndoMemoryBudget, 1, 4096))
+                EvaluationAPI::SetUndoMemoryBudget(size_t(mUndoMemoryBudget) * 1048576);
+            ImGui::Text("Undo history uses %d MB", int(EvaluationAPI::GetUndoMemoryUsage() / 1048576));
+            ImGui::EndMenu();
+        }
         if (ImGui::MenuItem("Layout Nodes", "CTRL + L"))
         {
             NodeGraphLayout();
         }
+        if (ImGui::MenuItem("Layout Edited Nodes", "CTRL + SHIFT + L"))
+        {
+            NodeGraphLayout(true);
+        }
         /*if (ImGui::MenuItem("Windows"))
         {
 
@@ -1734,6 +1748,16 @@ void Imogen::ReadLine(ImGuiContext* ctx, ImGuiSettingsHandler* handler, void* en
         {
             userdata->imogen->mLibraryViewMode = active;
         }
+        else if (sscanf(line_start, "SceneCacheBudget=%d", &active) == 1)
+        {
+            userdata->imogen->mSceneCacheBudget = active;
+            EvaluationAPI::SetSceneCacheBudget(size_t(active) * 1048576);
+        }
+        else if (sscanf(line_start, "UndoMemoryBudget=%d", &active) == 1)
+        {
+            userdata->imogen->mUndoMemoryBudget = active;
+            EvaluationAPI::SetUndoMemoryBudget(size_t(active) * 1048576);
+        }
     }
 }
 
@@ -1747,6 +1771,8 @@ void Imogen::WriteAll(ImGuiContext* ctx, ImGuiSettingsHandler* handler, ImGuiTex
     buf->appendf("ShowLog=%d\n", instance->mbShowLog ? 1 : 0);
     buf->appendf("ShowParameters=%d\n", instance->mbShowParameters ? 1 : 0);
     buf->appendf("LibraryViewMode=%d\n", instance->mLibraryViewMode);
+    buf->appendf("SceneCacheBudget=%d\n", instance->mSceneCacheBudget);
+    buf->appendf("UndoMemoryBudget=%d\n", instance->mUndoMemoryBudget);
 }
 
 Imogen::Imogen(NodeGraphControler *nodeGraphControler) :
@@ -29,6 +29,7 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <algorithm>
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "Library.h"
@@ -63,6 +64,9 @@ struct RegisteredPlugin
 };
 extern std::vector<RegisteredPlugin> mRegisteredPlugins;
 
+// oldest undos are dropped when the history is bigger
+static const size_t DefaultUndoMemoryBudget = 64 * 1024 * 1024;
+
 struct Imogen
 {
     Imogen(NodeGraphControler *nodeGraphControler);
@@ -107,6 +111,8 @@ protected:
     bool mbShowLog = false;
     bool mbShowParameters = false;
     int mLibraryViewMode = 1;
+    int mSceneCacheBudget = 1024; // MB
+    int mUndoMemoryBudget = int(DefaultUndoMemoryBudget / 1048576); // MB
 
     static Imogen *instance;
 };
@@ -141,14 +147,24 @@ struct UndoRedo
     }
     void Discard() { mbDiscarded = true; }
     bool IsDiscarded() const { return mbDiscarded; }
+    virtual size_t GetMemorySize() const
+    {
+        size_t size = sizeof(UndoRedo);
+        for (auto& undoRedo : mSubUndoRedo)
+            size += undoRedo->GetMemorySize();
+        return size;
+    }
 protected:
     std::vector<std::shared_ptr<UndoRedo> > mSubUndoRedo;
     bool mbDiscarded;
 };
 
+template<typename T> struct URChange;
+
 struct UndoRedoHandler
 {
-    UndoRedoHandler() : mbProcessing(false), mCurrent(NULL) {}
+    UndoRedoHandler() : mbProcessing(false), mCurrent(NULL), mMemory(0), mMemoryBudget(DefaultUndoMemoryBudget), 
+        mInteraction(0), mLastUndoInteraction(-1), mbInteracting(false) {}
     ~UndoRedoHandler()
     {
         Clear();
@@ -162,6 +178,7 @@ struct UndoRedoHandler
         mUndos.back()->Undo();
         mRedos.push_back(mUndos.back());
         mUndos.pop_back();
+        mLastUndoInteraction = -1;
         mbProcessing = false;
     }
 
@@ -173,6 +190,7 @@ struct UndoRedoHandler
         mRedos.back()->Redo();
         mUndos.push_back(mRedos.back());
         mRedos.pop_back();
+        mLastUndoInteraction = -1;
         mbProcessing = false;
     }
 
@@ -181,11 +199,20 @@ struct UndoRedoHandler
         if (undoRedo.IsDiscarded())
             return;
         if (mCurrent && &undoRedo != mCurrent)
+        {
             mCurrent->AddSubUndoRedo(undoRedo);
-        else
+        }
+        else if (!Coalesce(undoRedo))
+        {
             mUndos.push_back(std::make_shared<T>(undoRedo));
+            mMemory += mUndos.back()->GetMemorySize();
+            mLastUndoInteraction = mbInteracting ? mInteraction : -1;
+        }
         mbProcessing = true;
+        for (auto& redo : mRedos)
+            mMemory -= redo->GetMemorySize();
         mRedos.clear();
+        TrimHistory();
         mbProcessing = false;
     }
 
@@ -194,15 +221,70 @@ struct UndoRedoHandler
         mbProcessing = true;
         mUndos.clear();
         mRedos.clear();
+        mMemory = 0;
+        mLastUndoInteraction = -1;
         mbProcessing = false;
     }
 
+    // called every frame. Changes made while the mouse is down or an item is active belong to the same interaction
+    // and changes of the same element in an interaction make a single undo
+    void SetInteracting(bool interacting)
+    {
+        if (interacting && !mbInteracting)
+            mInteraction++;
+        mbInteracting = interacting;
+    }
+
+    void SetMemoryBudget(size_t memoryBudget)
+    {
+        mMemoryBudget = memoryBudget;
+        mbProcessing = true;
+        TrimHistory();
+        mbProcessing = false;
+    }
+    size_t GetMemory() const { return mMemory; }
+
     bool mbProcessing;
     UndoRedo* mCurrent;
     //private:
 
     std::vector<std::shared_ptr<UndoRedo> > mUndos;
     std::vector<std::shared_ptr<UndoRedo> > mRedos;
+
+protected:
+    size_t mMemory; // undos and redos
+    size_t mMemoryBudget;
+    int mInteraction;
+    int mLastUndoInteraction; // interaction of the last undo, -1 when it can't be coalesced
+    bool mbInteracting;
+
+    // only changes of the same element coalesce
+    template <typename T> bool Coalesce(const T&) { return false; }
+    template <typename U> bool Coalesce(const URChange<U>& undoRedo)
+    {
+        if (!mbInteracting || mUndos.empty() || mLastUndoInteraction != mInteraction)
+            return false;
+        auto last = std::dynamic_pointer_cast<URChange<U> >(mUndos.back());
+        if (!last)
+            return false;
+        const size_t memory = last->GetMemorySize();
+        if (!last->Coalesce(undoRedo))
+            return false;
+        mMemory = mMemory - memory + last->GetMemorySize();
+        return true;
+    }
+
+    // the last undo is kept whatever its size
+    void TrimHistory()
+    {
+        size_t dropCount = 0;
+        while (mMemory > mMemoryBudget && dropCount + 1 < mUndos.size())
+        {
+            mMemory -= mUndos[dropCount]->GetMemorySize();
+            dropCount++;
+        }
+        mUndos.erase(mUndos.begin(), mUndos.begin() + dropCount);
+    }
 };
 
 extern UndoRedoHandler gUndoRedoHandler;
@@ -223,6 +305,89 @@ inline UndoRedo::~UndoRedo()
     }
 }
 
+// heap memory kept by an undo copy of an element. Types owning memory overload it next to their declaration
+template<typename T> size_t GetOwnedMemorySize(const T& element) { return 0; }
+template<typename U> size_t GetOwnedMemorySize(const std::vector<U>& elements)
+{
+    size_t size = elements.capacity() * sizeof(U);
+    for (auto& element : elements)
+        size += GetOwnedMemorySize(element);
+    return size;
+}
+
+// element state before and after a change. Full copies
+template<typename T> struct URState
+{
+    void Begin(const T& element) { mPreDo = element; }
+    bool End(const T& element)
+    {
+        if (!(element != mPreDo))
+            return false;
+        mPostDo = element;
+        return true;
+    }
+    void Undo(T& element) const { element = mPreDo; }
+    void Redo(T& element) const { element = mPostDo; }
+    void Merge(const URState& next, const T& element) { mPostDo = next.mPostDo; }
+    size_t GetMemorySize() const { return sizeof(URState) + GetOwnedMemorySize(mPreDo) + GetOwnedMemorySize(mPostDo); }
+
+    T mPreDo;
+    T mPostDo;
+};
+
+// vectors only keep the range of elements that differs
+template<typename U> struct URState<std::vector<U> >
+{
+    typedef std::vector<U> Elements;
+    URState() : mOffset(0) {}
+    void Begin(const Elements& element) { mPreDo = element; }
+    bool End(const Elements& element)
+    {
+        Elements preDo;
+        preDo.swap(mPreDo);
+        const bool changed = element != preDo;
+        if (changed)
+            SetDelta(preDo, element);
+        return changed;
+    }
+    void Undo(Elements& element) const { Replace(element, mPostDo.size(), mPreDo); }
+    void Redo(Elements& element) const { Replace(element, mPreDo.size(), mPostDo); }
+    void Merge(const URState& next, const Elements& element)
+    {
+        Elements original = element;
+        next.Undo(original);
+        Undo(original);
+        SetDelta(original, element);
+    }
+    size_t GetMemorySize() const { return sizeof(URState) + GetOwnedMemorySize(mPreDo) + GetOwnedMemorySize(mPostDo); }
+
+    void SetDelta(const Elements& before, const Elements& after)
+    {
+        const size_t common = std::min(before.size(), after.size());
+        size_t prefix = 0;
+        while (prefix < common && !(before[prefix] != after[prefix]))
+            prefix++;
+        size_t suffix = 0;
+        while (suffix < common - prefix && !(before[before.size() - 1 - suffix] != after[after.size() - 1 - suffix]))
+            suffix++;
+        mOffset = prefix;
+        Elements pre(before.begin() + prefix, before.end() - suffix);
+        Elements post(after.begin() + prefix, after.end() - suffix);
+        mPreDo.swap(pre);
+        mPostDo.swap(post);
+    }
+    void Replace(Elements& element, size_t count, const Elements& elements) const
+    {
+        element.erase(element.begin() + mOffset, element.begin() + mOffset + count);
+        element.insert(element.begin() + mOffset, elements.begin(), elements.end());
+    }
+
+    // whole vector while the change is in progress, then the elements from mOffset that differ
+    Elements mPreDo;
+    Elements mPostDo;
+    size_t mOffset;
+};
+
 template<typename T> struct URChange : public UndoRedo
 {
     URChange(int index, std::function<T*(int index)> GetElements, std::function<void(int index)> Changed = [](int index) {}) : GetElements(GetElements), mIndex(index), Changed(Changed)
@@ -230,16 +395,15 @@ template<typename T> struct URChange : public UndoRedo
         if (gUndoRedoHandler.mbProcessing)
             return;
 
-        mPreDo = *GetElements(mIndex);
+        mState.Begin(*GetElements(mIndex));
     }
     virtual ~URChange()
     {
         if (gUndoRedoHandler.mbProcessing || mbDiscarded)
             return;
 
-        if (*GetElements(mIndex) != mPreDo)
+        if (mState.End(*GetElements(mIndex)))
         {
-            mPostDo = *GetElements(mIndex);
             gUndoRedoHandler.AddUndo(*this);
         }
         else
@@ -249,19 +413,29 @@ template<typename T> struct URChange : public UndoRedo
     }
     virtual void Undo()
     {
-        *GetElements(mIndex) = mPreDo;
+        mState.Undo(*GetElements(mIndex));
         Changed(mIndex);
         UndoRedo::Undo();
     }
     virtual void Redo()
     {
         UndoRedo::Redo();
-        *GetElements(mIndex) = mPostDo;
+        mState.Redo(*GetElements(mIndex));
         Changed(mIndex);
     }
+    bool Coalesce(const URChange& next)
+    {
+        if (next.mIndex != mIndex || next.GetElements(next.mIndex) != GetElements(mIndex) || !mSubUndoRedo.empty() || !next.mSubUndoRedo.empty())
+            return false;
+        mState.Merge(next.mState, *GetElements(mIndex));
+        return true;
+    }
+    virtual size_t GetMemorySize() const
+    {
+        return UndoRedo::GetMemorySize() + mState.GetMemorySize();
+    }
 
-    T mPreDo;
-    T mPostDo;
+    URState<T> mState;
     int mIndex;
 
     std::function<T*(int index)> GetElements;
@@ -323,6 +497,10 @@ template<typename T> struct URDel : public UndoRedo
         OnDelete(mIndex);
         GetElements()->erase(GetElements()->begin() + mIndex);
     }
+    virtual size_t GetMemorySize() const
+    {
+        return UndoRedo::GetMemorySize() + sizeof(T) + GetOwnedMemorySize(mDeletedElement);
+    }
 
     T mDeletedElement;
     int mIndex;
@@ -359,6 +537,10 @@ template<typename T> struct URAdd : public UndoRedo
         GetElements()->insert(GetElements()->begin() + mIndex, mAddedElement);
         OnNew(mIndex);
     }
+    virtual size_t GetMemorySize() const
+    {
+        return UndoRedo::GetMemorySize() + sizeof(T) + GetOwnedMemorySize(mAddedElement);
+    }
 
     T mAddedElement;
     int mIndex;
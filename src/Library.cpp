@@ -702,6 +702,8 @@ void SaveMetaNodes(const char* filename)
             nodeValue.AddMember("hasUI", rapidjson::Value().SetBool(node.mbHasUI), allocator);
         if (node.mbSaveTexture)
             nodeValue.AddMember("saveTexture", rapidjson::Value().SetBool(node.mbSaveTexture), allocator);
+        if (node.mbPointwise)
+            nodeValue.AddMember("pointwise", rapidjson::Value().SetBool(node.mbPointwise), allocator);
 
         nodelist.PushBack(nodeValue, allocator);
     }
@@ -765,6 +767,10 @@ std::vector<MetaNode> ReadMetaNodes(const char *filename)
             curNode.mbSaveTexture = node["saveTexture"].GetBool();
         else
             curNode.mbSaveTexture = false;
+        if (node.HasMember("pointwise"))
+            curNode.mbPointwise = node["pointwise"].GetBool();
+        else
+            curNode.mbPointwise = false;
             
         if (!node.HasMember("color"))
         {
@@ -980,16 +986,18 @@ AnimationBase::AnimationPointer AnimationBase::GetPointer(int32_t frame, bool bS
         int32_t last = int32_t(mFrames.size() - (bSetting ? 0 : 1));
         return {last, mFrames.back(), last, mFrames.back(), 0.f };
     }
-    for (int i = 0; i < int(mFrames.size()) - 1; i++)
+    // the segment is the first one ending at or after frame, like a scan from the first key would find
+    const int lastSegment = int(mFrames.size()) - 2;
+    int i = mCursor;
+    if (i > lastSegment || mFrames[i] >= frame || mFrames[i + 1] < frame)
     {
-        if (mFrames[i] <= frame && mFrames[i + 1] >= frame)
-        {
-            float ratio = float(frame - mFrames[i]) / float(mFrames[i+1] - mFrames[i]);
-            return { i, mFrames[i], i + 1, mFrames[i+1], ratio };
-        }
+        i++;
+        if (i > lastSegment || mFrames[i] >= frame || mFrames[i + 1] < frame)
+            i = int(std::lower_bound(mFrames.begin(), mFrames.end(), frame) - mFrames.begin()) - 1;
+        mCursor = i;
     }
-    assert(0);
-    return { bSetting? -1:0, 0, 0, 0, 0.f };
+    float ratio = float(frame - mFrames[i]) / float(mFrames[i+1] - mFrames[i]);
+    return { i, mFrames[i], i + 1, mFrames[i+1], ratio };
 }
 
 AnimTrack& AnimTrack::operator = (const AnimTrack& other)
@@ -31,6 +31,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <algorithm>
 #include "Utils.h"
 #include <assert.h>
 
@@ -153,23 +154,34 @@ struct MaterialConnection
     uint8_t mOutputSlot;
 };
 
+// per frame values of a track are baked when they fit in this size
+static const size_t MaxBakedAnimationBytes = 16384;
+
 struct AnimationBase 
 {
-    AnimationBase() {}
-    AnimationBase(const AnimationBase&& animation)
+    AnimationBase() : mCursor(0), mbBakeDirty(true) {}
+    AnimationBase(const AnimationBase&& animation) : mCursor(0), mbBakeDirty(true)
     {
         mFrames = animation.mFrames;
     }
-    AnimationBase(const AnimationBase& animation)
+    AnimationBase(const AnimationBase& animation) : mCursor(0), mbBakeDirty(true)
     {
         mFrames = animation.mFrames;
     }
     std::vector<int32_t> mFrames;
 
+    // to call when keys are edited without Allocate, SetValue, SetFloatValue or Copy
+    void KeysChanged()
+    {
+        mCursor = 0;
+        mbBakeDirty = true;
+    }
+
     virtual void Allocate(size_t elementCount) { assert(0); }
     virtual void* GetData() { assert(0); return nullptr; }
     virtual const void* GetDataConst() const { assert(0); return nullptr; }
     virtual size_t GetValuesByteLength() const { assert(0); return 0; }
+    virtual size_t GetMemorySize() const { return sizeof(AnimationBase) + mFrames.capacity() * sizeof(int32_t); }
     virtual void GetValue(uint32_t frame, void *destination) { assert(0); }
     virtual void SetValue(uint32_t frame, void *source) { assert(0); }
     virtual float GetFloatValue(uint32_t index, int componentIndex) { assert(0); return 0.f; }
@@ -177,6 +189,7 @@ struct AnimationBase
     virtual void Copy(AnimationBase *source)
     {
         mFrames = source->mFrames;
+        KeysChanged();
     }
     struct AnimationPointer
     {
@@ -186,6 +199,7 @@ struct AnimationBase
         int mNextFrame;
         float mRatio;
     };
+    // the segment of the previous call and the next one are tested first, binary search otherwise
     AnimationPointer GetPointer(int32_t frame, bool bSetting) const;
     bool operator != (const AnimationBase& other) const
     {
@@ -200,6 +214,10 @@ struct AnimationBase
             return true;
         return false;
     }
+
+protected:
+    mutable int mCursor; // previous key index returned by GetPointer
+    bool mbBakeDirty;
 };
 
 template<typename T> struct Animation : public AnimationBase
@@ -219,11 +237,13 @@ template<typename T> struct Animation : public AnimationBase
     { 
         mFrames.resize(elementCount); 
         mValues.resize(elementCount);
+        KeysChanged();
     }
     virtual void* GetData() { return mValues.data(); }
     virtual const void* GetDataConst() const { return mValues.data(); }
 
     virtual size_t GetValuesByteLength() const { return mValues.size() * sizeof(T); }
+    virtual size_t GetMemorySize() const { return sizeof(Animation) + mFrames.capacity() * sizeof(int32_t) + (mValues.capacity() + mBakedValues.capacity()) * sizeof(T); }
     virtual float GetFloatValue(uint32_t index, int componentIndex)
     {
         unsigned char*ptr = (unsigned char*)GetData();
@@ -236,19 +256,31 @@ template<typename T> struct Animation : public AnimationBase
         unsigned char*ptr = (unsigned char*)GetData();
         T& v = ((T*)ptr)[index];
         SetComponent(componentIndex, v, value);
+        KeysChanged();
     }
 
     virtual void GetValue(uint32_t frame, void *destination) 
     {
         if (mValues.empty())
             return;
-        AnimationPointer pointer = GetPointer(frame, false);
         T *dest = (T*)destination;
+        if (mbBakeDirty)
+            Bake();
+        if (!mBakedValues.empty())
+        {
+            // values are constant before the first key and after the last one
+            int64_t bakedIndex = int64_t(frame) - mFrames.front();
+            bakedIndex = std::min(std::max(bakedIndex, int64_t(0)), int64_t(mBakedValues.size() - 1));
+            *dest = mBakedValues[size_t(bakedIndex)];
+            return;
+        }
+        AnimationPointer pointer = GetPointer(frame, false);
         *dest = Lerp(mValues[pointer.mPreviousIndex], mValues[pointer.mNextIndex], pointer.mRatio);
     }
 
     virtual void SetValue(uint32_t frame, void *source) 
     {
+        KeysChanged();
         auto pointer = GetPointer(frame, true);
         T value = *(T*)source;
         if (frame == pointer.mPreviousFrame && !mValues.empty())
@@ -280,6 +312,25 @@ template<typename T> struct Animation : public AnimationBase
     }
 
 protected:
+    std::vector<T> mBakedValues; // 1 value per frame from the first key to the last one
+
+    void Bake()
+    {
+        mbBakeDirty = false;
+        mBakedValues.clear();
+        if (mFrames.empty() || mFrames.size() != mValues.size())
+            return;
+        const int64_t frameCount = int64_t(mFrames.back()) - mFrames.front() + 1;
+        if (frameCount <= 0 || frameCount * sizeof(T) > MaxBakedAnimationBytes)
+            return;
+        mBakedValues.resize(size_t(frameCount));
+        for (int32_t i = 0; i < int32_t(frameCount); i++)
+        {
+            AnimationPointer pointer = GetPointer(mFrames.front() + i, false);
+            mBakedValues[i] = Lerp(mValues[pointer.mPreviousIndex], mValues[pointer.mNextIndex], pointer.mRatio);
+        }
+    }
+
     template<typename T> float GetComponent(int componentIndex, T& v)
     {
         return float(v[componentIndex]);
@@ -340,6 +391,8 @@ struct AnimTrack
     }
 };
 
+inline size_t GetOwnedMemorySize(const AnimTrack& track) { return track.mAnimation ? track.mAnimation->GetMemorySize() : 0; }
+
 struct Material
 {
     std::string mName;
@@ -486,6 +539,8 @@ struct MetaNode
 
     bool mbHasUI;
     bool mbSaveTexture;
+    // GLSL output only depends on the inputs sampled at vUV. Chains of such nodes are evaluated in 1 pass.
+    bool mbPointwise;
 
     bool operator == (const MetaNode& other) const
     {
@@ -505,6 +560,8 @@ struct MetaNode
             return false;
         if (mbSaveTexture != other.mbSaveTexture)
             return false;
+        if (mbPointwise != other.mbPointwise)
+            return false;
         return true;
     }
 };
@@ -29,6 +29,7 @@
 #include "NodeGraph.h"
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
 #include <assert.h>
 #include "EvaluationStages.h"
 #include "imgui_stdlib.h"
@@ -36,6 +37,8 @@
 #include <array>
 #include "imgui_markdown/imgui_markdown.h"
 #include "UI.h"
+#include "NodeGraphLayout.h"
+#include <chrono>
 
 void AddExtractedView(size_t nodeIndex);
 extern ImGui::MarkdownConfig mdConfig;
@@ -50,67 +53,12 @@ Node::Node(int type, const ImVec2& pos)
     InputsCount = gMetaNodes[type].mInputs.size();
     OutputsCount = gMetaNodes[type].mOutputs.size();
     mbSelected = false;
-}
-
-struct NodeOrder
-{
-    size_t mNodeIndex;
-    size_t mNodePriority;
-    bool operator < (const NodeOrder& other) const
-    {
-        return other.mNodePriority < mNodePriority; // reverse order compared to priority value: lower last
-    }
-};
-
-size_t PickBestNode(const std::vector<NodeOrder>& orders)
-{
-    for (auto& order : orders)
-    {
-        if (order.mNodePriority == 0)
-            return order.mNodeIndex;
-    }
-    // issue!
-    assert(0);
-    return -1;
-}
-
-void RecurseSetPriority(std::vector<NodeOrder>& orders, const std::vector<NodeLink> &links, size_t currentIndex, size_t currentPriority, size_t& undeterminedNodeCount)
-{
-    if (!orders[currentIndex].mNodePriority)
-        undeterminedNodeCount--;
-
-    orders[currentIndex].mNodePriority = std::max(orders[currentIndex].mNodePriority, currentPriority+1);
-    for (auto & link : links)
-    {
-        if (link.OutputIdx == currentIndex)
-        {
-            RecurseSetPriority(orders, links, link.InputIdx, currentPriority + 1, undeterminedNodeCount);
-        }
-    }
-}
-
-std::vector<NodeOrder> ComputeEvaluationOrder(const std::vector<NodeLink> &links, size_t nodeCount)
-{
-    std::vector<NodeOrder> orders(nodeCount);
-    for (size_t i = 0; i < nodeCount; i++)
-    {
-        orders[i].mNodeIndex = i;
-        orders[i].mNodePriority = 0;
-    }
-    size_t undeterminedNodeCount = nodeCount;
-    while (undeterminedNodeCount)
-    {
-        size_t currentIndex = PickBestNode(orders);
-        RecurseSetPriority(orders, links, currentIndex, orders[currentIndex].mNodePriority, undeterminedNodeCount);
-    };
-    //
-    return orders;
+    mbLayoutDirty = false;
 }
 
 const float NODE_SLOT_RADIUS = 8.0f;
 const ImVec2 NODE_WINDOW_PADDING(8.0f, 8.0f);
 
-static std::vector<NodeOrder> mOrders;
 static std::vector<Node> nodes;
 static std::vector<Node> mNodesClipboard;
 static std::vector<NodeLink> links;
@@ -136,6 +84,198 @@ enum NodeOperation
 };
 NodeOperation nodeOperation = NO_None;
 
+// Uniform grid over graph space bounds. Items spanning too many cells are kept apart and always tested.
+class SpatialGrid
+{
+public:
+    SpatialGrid() : mQueryStamp(0) {}
+
+    void Clear()
+    {
+        mCells.clear();
+        mItems.clear();
+        mLargeItems.clear();
+    }
+
+    // insert or move
+    void Set(int id, const ImRect& rect)
+    {
+        if (id >= int(mItems.size()))
+            mItems.resize(id + 1);
+        Item& item = mItems[id];
+        int minX = CellCoord(rect.Min.x), minY = CellCoord(rect.Min.y);
+        int maxX = CellCoord(rect.Max.x), maxY = CellCoord(rect.Max.y);
+        if (item.mValid && minX == item.mMinX && minY == item.mMinY && maxX == item.mMaxX && maxY == item.mMaxY)
+        {
+            item.mRect = rect;
+            return;
+        }
+        if (item.mValid)
+            Remove(id);
+        item.mRect = rect;
+        item.mMinX = minX;
+        item.mMinY = minY;
+        item.mMaxX = maxX;
+        item.mMaxY = maxY;
+        item.mValid = true;
+        if (IsLarge(item))
+        {
+            mLargeItems.push_back(id);
+            return;
+        }
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+                mCells[CellKey(x, y)].push_back(id);
+        }
+    }
+
+    // ids of the items overlapping rect, sorted
+    void Query(const ImRect& rect, std::vector<int>& result)
+    {
+        result.clear();
+        mQueryStamp++;
+        auto test = [&](int id) {
+            Item& item = mItems[id];
+            if (item.mStamp == mQueryStamp || !rect.Overlaps(item.mRect))
+                return;
+            item.mStamp = mQueryStamp;
+            result.push_back(id);
+        };
+        const int minX = CellCoord(rect.Min.x), minY = CellCoord(rect.Min.y);
+        const int maxX = CellCoord(rect.Max.x), maxY = CellCoord(rect.Max.y);
+        for (int y = minY; y <= maxY; y++)
+        {
+            for (int x = minX; x <= maxX; x++)
+            {
+                auto iter = mCells.find(CellKey(x, y));
+                if (iter == mCells.end())
+                    continue;
+                for (int id : iter->second)
+                    test(id);
+            }
+        }
+        for (int id : mLargeItems)
+            test(id);
+        std::sort(result.begin(), result.end());
+    }
+
+private:
+    struct Item
+    {
+        Item() : mStamp(0), mValid(false) {}
+        ImRect mRect;
+        int mMinX, mMinY, mMaxX, mMaxY;
+        unsigned int mStamp;
+        bool mValid;
+    };
+
+    static const int MaxItemCells = 64;
+
+    static int CellCoord(float v) { return int(floorf(v * (1.f / 512.f))); }
+    static uint64_t CellKey(int x, int y) { return (uint64_t(uint32_t(x)) << 32) | uint32_t(y); }
+    static bool IsLarge(const Item& item) { return (item.mMaxX - item.mMinX + 1) * (item.mMaxY - item.mMinY + 1) > MaxItemCells; }
+
+    void Remove(int id)
+    {
+        const Item& item = mItems[id];
+        if (IsLarge(item))
+        {
+            mLargeItems.erase(std::find(mLargeItems.begin(), mLargeItems.end(), id));
+            return;
+        }
+        for (int y = item.mMinY; y <= item.mMaxY; y++)
+        {
+            for (int x = item.mMinX; x <= item.mMaxX; x++)
+            {
+                auto& cell = mCells[CellKey(x, y)];
+                auto iter = std::find(cell.begin(), cell.end(), id);
+                *iter = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
+
+    std::unordered_map<uint64_t, std::vector<int> > mCells;
+    std::vector<Item> mItems;
+    std::vector<int> mLargeItems;
+    unsigned int mQueryStamp;
+};
+
+// Node and link bounds used for culling and picking. Nodes are indexed with their unzoomed size,
+// queries are enlarged to cover the zoom independent padding and the link elbows.
+static SpatialGrid nodeGrid;
+static SpatialGrid linkGrid;
+static std::vector<ImVec2> indexedNodePositions;
+static std::vector<NodeLink> indexedLinks;
+static std::vector<std::vector<int> > indexedNodeLinks; // links connected to a node
+static std::vector<int> visibleNodes;
+static std::vector<int> visibleLinks;
+const ImVec2 NODE_INDEX_SIZE(100.f, 100.f);
+
+static ImRect NodeIndexRect(const Node& node)
+{
+    return ImRect(node.Pos, node.Pos + NODE_INDEX_SIZE);
+}
+
+static ImRect LinkIndexRect(const NodeLink& link)
+{
+    ImRect rect = NodeIndexRect(nodes[link.InputIdx]);
+    rect.Add(NodeIndexRect(nodes[link.OutputIdx]));
+    return rect;
+}
+
+// Called once per frame. Moved nodes and their links are updated in place, other edits of the arrays rebuild the index.
+static void UpdateSpatialIndex()
+{
+    const bool rebuild = indexedNodePositions.size() != nodes.size() || indexedLinks.size() != links.size() || !std::equal(links.begin(), links.end(), indexedLinks.begin());
+    if (rebuild)
+    {
+        nodeGrid.Clear();
+        linkGrid.Clear();
+        indexedNodePositions.resize(nodes.size());
+        indexedNodeLinks.assign(nodes.size(), std::vector<int>());
+        indexedLinks = links;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            indexedNodePositions[i] = nodes[i].Pos;
+            nodeGrid.Set(int(i), NodeIndexRect(nodes[i]));
+        }
+        for (size_t i = 0; i < links.size(); i++)
+        {
+            indexedNodeLinks[links[i].InputIdx].push_back(int(i));
+            indexedNodeLinks[links[i].OutputIdx].push_back(int(i));
+            linkGrid.Set(int(i), LinkIndexRect(links[i]));
+        }
+        return;
+    }
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        if (!(nodes[i].Pos != indexedNodePositions[i]))
+            continue;
+        indexedNodePositions[i] = nodes[i].Pos;
+        nodeGrid.Set(int(i), NodeIndexRect(nodes[i]));
+        for (int linkIndex : indexedNodeLinks[i])
+            linkGrid.Set(linkIndex, LinkIndexRect(links[linkIndex]));
+    }
+}
+
+// screen rectangle to graph space, with a margin in pixels
+static ImRect ScreenToGraphRect(const ImRect& rect, const ImVec2 offset, const float factor, float margin)
+{
+    const ImVec2 marginVec(margin, margin);
+    return ImRect((rect.Min - offset - marginVec) / factor, (rect.Max - offset + marginVec) / factor);
+}
+
+static void ClearSpatialIndex()
+{
+    nodeGrid.Clear();
+    linkGrid.Clear();
+    indexedNodePositions.clear();
+    indexedLinks.clear();
+    indexedNodeLinks.clear();
+}
+
 void HandleZoomScroll(ImRect regionRect)
 {
     ImGuiIO& io = ImGui::GetIO();
@@ -164,6 +304,7 @@ void NodeGraphClear()
     nodes.clear();
     links.clear();
     rugs.clear();
+    ClearSpatialIndex();
     editRug = NULL;
     nodeOperation = NO_None;
     factor = 1.0f;
@@ -361,32 +502,6 @@ bool EditRug(NodeRug *rug, ImDrawList* drawList, ImVec2 offset, float factor)
     return false;
 }
 
-bool RecurseIsLinked(int from, int to)
-{
-    for (auto& link : links)
-    {
-        if (link.InputIdx == from)
-        {
-            if (link.OutputIdx == to)
-                return true;
-
-            if (RecurseIsLinked(link.OutputIdx, to))
-                return true;
-        }
-    }
-    return false;
-}
-
-void NodeGraphUpdateEvaluationOrder(NodeGraphControlerBase *controler)
-{
-    mOrders = ComputeEvaluationOrder(links, nodes.size());
-    std::sort(mOrders.begin(), mOrders.end());
-    std::vector<size_t> nodeOrderList(mOrders.size());
-    for (size_t i = 0; i < mOrders.size(); i++)
-        nodeOrderList[i] = mOrders[i].mNodeIndex;
-    controler->UpdateEvaluationList(nodeOrderList);
-}
-
 void NodeGraphAddNode(NodeGraphControlerBase *controler, int type, const std::vector<unsigned char>& parameters, int posx, int posy, int frameStart, int frameEnd)
 {
     size_t index = nodes.size();
@@ -404,8 +519,8 @@ void NodeGraphAddLink(NodeGraphControlerBase *controler, int InputIdx, int Input
     nl.InputSlot = InputSlot;
     nl.OutputIdx = OutputIdx;
     nl.OutputSlot = OutputSlot;
-    links.push_back(nl);
-    controler->AddLink(nl.InputIdx, nl.InputSlot, nl.OutputIdx, nl.OutputSlot);
+    if (controler->AddLink(nl.InputIdx, nl.InputSlot, nl.OutputIdx, nl.OutputSlot))
+        links.push_back(nl);
 }
 
 ImVec2 NodeGraphGetNodePos(size_t index)
@@ -438,6 +553,13 @@ void NodeGraphAddRug(int32_t posX, int32_t posY, int32_t sizeX, int32_t sizeY, u
     rugs.push_back({ ImVec2(float(posX), float(posY)), ImVec2(float(sizeX), float(sizeY)), color, comment });
 }
 
+// the nodes at both ends of a link need a new layout
+static void SetLayoutDirty(const NodeLink& link)
+{
+    nodes[link.InputIdx].mbLayoutDirty = true;
+    nodes[link.OutputIdx].mbLayoutDirty = true;
+}
+
 static void DeleteSelectedNodes(NodeGraphControlerBase *controler)
 {
     URDummy urDummy;
@@ -455,7 +577,6 @@ static void DeleteSelectedNodes(NodeGraphControlerBase *controler)
                 if (links[id].OutputIdx > index)
                     links[id].OutputIdx--;
             }
-            NodeGraphUpdateEvaluationOrder(controler);
             controler->mSelectedNodeIndex = -1;
         }
             , [controler](int index) {
@@ -468,7 +589,6 @@ static void DeleteSelectedNodes(NodeGraphControlerBase *controler)
                     links[id].OutputIdx++;
             }
 
-            NodeGraphUpdateEvaluationOrder(controler);
             controler->mSelectedNodeIndex = -1;
         }
         );
@@ -496,6 +616,7 @@ static void DeleteSelectedNodes(NodeGraphControlerBase *controler)
                     controler->AddLink(link.InputIdx, link.InputSlot, link.OutputIdx, link.OutputSlot);
                 });
 
+                SetLayoutDirty(link);
                 links.erase(links.begin() + i);
             }
             else
@@ -515,7 +636,6 @@ static void DeleteSelectedNodes(NodeGraphControlerBase *controler)
 
         // delete links
         nodes.erase(nodes.begin() + selection);
-        NodeGraphUpdateEvaluationOrder(controler);
 
         // inform delegate
         controler->UserDeleteNode(selection);
@@ -554,12 +674,12 @@ static void ContextMenu(ImVec2 offset, int nodeHovered, NodeGraphControlerBase *
             {
                 auto addDelNodeLambda = [controler](int)
                 {
-                    NodeGraphUpdateEvaluationOrder(controler);
                     controler->mSelectedNodeIndex = -1;
                 };
                 URAdd<Node> undoRedoAddRug(int(nodes.size()), []() {return &nodes; }, addDelNodeLambda, addDelNodeLambda);
 
                 nodes.push_back(Node(i, scene_pos));
+                nodes.back().mbLayoutDirty = true;
                 controler->UserAddNode(i);
                 addDelNodeLambda(0);
             };
@@ -671,15 +791,17 @@ static void ContextMenu(ImVec2 offset, int nodeHovered, NodeGraphControlerBase *
             nodes.push_back(clipboardNode);
             nodes.back().Pos += (io.MousePos/factor - offset) - min;
             nodes.back().mbSelected = true;
+            nodes.back().mbLayoutDirty = true;
         }
         controler->PasteNodes();
-        NodeGraphUpdateEvaluationOrder(controler);
     }
 }
 
 static void DisplayLinks(ImDrawList* drawList, const ImVec2 offset, const float factor, const ImRect regionRect, int hoveredNode)
 {
-    for (int link_idx = 0; link_idx < links.size(); link_idx++)
+    // padding, line width and elbows of the links going backward stick out of the indexed bounds
+    linkGrid.Query(ScreenToGraphRect(regionRect, offset, factor, NODE_WINDOW_PADDING.x * 2.f + 16.f + 24.f * factor), visibleLinks);
+    for (int link_idx : visibleLinks)
     {
         NodeLink* link = &links[link_idx];
         Node* node_inp = &nodes[link->InputIdx];
@@ -816,7 +938,8 @@ static void HandleQuadSelection(ImDrawList* drawList, const ImVec2 offset, const
         drawList->AddRect(bmin, bmax, 0xFFFF2020, 1.f);
         if (!io.MouseDown[0])
         {
-            if (!io.KeyCtrl && !io.KeyShift)
+            // without shift, nodes outside the rectangle end up unselected
+            if (!io.KeyShift)
             {
                 for (int nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++)
                 {
@@ -827,28 +950,16 @@ static void HandleQuadSelection(ImDrawList* drawList, const ImVec2 offset, const
 
             nodeOperation = NO_None;
             ImRect selectionRect(bmin, bmax);
-            for (int nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++)
+            std::vector<int> overlappingNodes;
+            nodeGrid.Query(ScreenToGraphRect(selectionRect, offset, factor, NODE_WINDOW_PADDING.x * 2.f), overlappingNodes);
+            for (int nodeIndex : overlappingNodes)
             {
                 Node* node = &nodes[nodeIndex];
                 ImVec2 node_rect_min = offset + node->Pos * factor;
                 ImVec2 node_rect_max = node_rect_min + node->Size;
                 if (selectionRect.Overlaps(ImRect(node_rect_min, node_rect_max)))
                 {
-                    if (io.KeyCtrl)
-                    {
-                        node->mbSelected = false;
-                    }
-                    else
-                    {
-                        node->mbSelected = true;
-                    }
-                }
-                else
-                {
-                    if (!io.KeyShift)
-                    {
-                        node->mbSelected = false;
-                    }
+                    node->mbSelected = !io.KeyCtrl;
                 }
             }
         }
@@ -870,13 +981,11 @@ void HandleConnections(ImDrawList* drawList, int nodeIndex, const ImVec2 offset,
     {
         NodeLink& link = links[index];
         controler->DelLink(link.OutputIdx, link.OutputSlot);
-        NodeGraphUpdateEvaluationOrder(controler);
     };
     auto addLink = [controler](int index)
     {
         NodeLink& link = links[index];
         controler->AddLink(link.InputIdx, link.InputSlot, link.OutputIdx, link.OutputSlot);
-        NodeGraphUpdateEvaluationOrder(controler);
     };
 
     size_t metaNodeCount = gMetaNodes.size();
@@ -941,7 +1050,7 @@ void HandleConnections(ImDrawList* drawList, int nodeIndex, const ImVec2 offset,
                     else
                         nl = NodeLink(editingNodeIndex, editingSlotIndex, nodeIndex, closestConn);
 
-                    if (RecurseIsLinked(nl.OutputIdx, nl.InputIdx))
+                    if (controler->IsLinked(nl.OutputIdx, nl.InputIdx))
                     {
                         Log("Acyclic graph. Loop is not allowed.\n");
                         break;
@@ -964,8 +1073,8 @@ void HandleConnections(ImDrawList* drawList, int nodeIndex, const ImVec2 offset,
                         {
                             URDel<NodeLink> undoRedoDel(linkIndex, []() { return &links; }, deleteLink, addLink);
                             controler->DelLink(link.OutputIdx, link.OutputSlot);
+                            SetLayoutDirty(link);
                             links.erase(links.begin() + linkIndex);
-                            NodeGraphUpdateEvaluationOrder(controler);
                             break;
                         }
                     }
@@ -974,9 +1083,15 @@ void HandleConnections(ImDrawList* drawList, int nodeIndex, const ImVec2 offset,
                     {
                         URAdd<NodeLink> undoRedoAdd(int(links.size()), []() { return &links; }, deleteLink, addLink);
 
-                        links.push_back(nl);
-                        controler->AddLink(nl.InputIdx, nl.InputSlot, nl.OutputIdx, nl.OutputSlot);
-                        NodeGraphUpdateEvaluationOrder(controler);
+                        if (controler->AddLink(nl.InputIdx, nl.InputSlot, nl.OutputIdx, nl.OutputSlot))
+                        {
+                            links.push_back(nl);
+                            SetLayoutDirty(nl);
+                        }
+                        else
+                        {
+                            undoRedoAdd.Discard();
+                        }
                     }
                 }
             }
@@ -997,8 +1112,8 @@ void HandleConnections(ImDrawList* drawList, int nodeIndex, const ImVec2 offset,
                         {
                             URDel<NodeLink> undoRedoDel(linkIndex, []() { return &links; }, deleteLink, addLink);
                             controler->DelLink(link.OutputIdx, link.OutputSlot);
+                            SetLayoutDirty(link);
                             links.erase(links.begin() + linkIndex);
-                            NodeGraphUpdateEvaluationOrder(controler);
                             break;
                         }
                     }
@@ -1216,6 +1331,8 @@ void NodeGraph(NodeGraphControlerBase *controler, bool enabled)
         goto nodeGraphExit;
 
     static int hoveredNode = -1;
+    UpdateSpatialIndex();
+
     // Display links
     drawList->ChannelsSplit(3);
     drawList->ChannelsSetCurrent(1); // Background
@@ -1232,9 +1349,10 @@ void NodeGraph(NodeGraphControlerBase *controler, bool enabled)
     // Display nodes
     drawList->PushClipRect(regionRect.Min, regionRect.Max, true);
     hoveredNode = -1;
+    nodeGrid.Query(ScreenToGraphRect(regionRect, offset, factor, NODE_WINDOW_PADDING.x * 2.f), visibleNodes);
     for (int i = 0; i < 2; i++)
     {
-        for (int nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++)
+        for (int nodeIndex : visibleNodes)
         {
             Node* node = &nodes[nodeIndex];
             if (node->mbSelected != (i != 0))
@@ -1335,103 +1453,41 @@ nodeGraphExit:;
 }
 
 
-struct NodePosition
-{
-    int mLayer;
-    int mStackIndex;
-};
-
-void RecurseNodeGraphLayout(std::vector<NodePosition>& positions, std::map<int, int> &stacks, const std::vector<NodeLink> &links, size_t currentIndex, int currentLayer)
+void NodeGraphLayout(bool incremental)
 {
-    if (positions[currentIndex].mLayer == -1)
+    std::vector<ImVec2> positions(nodes.size());
+    std::vector<bool> relayout;
+    for (size_t i = 0; i < nodes.size(); i++)
     {
-        positions[currentIndex].mLayer = currentLayer;
-        int layer = positions[currentIndex].mLayer = currentLayer;
-        if (stacks.find(layer) != stacks.end())
-            stacks[layer] ++;
-        else
-            stacks[layer] = 0;
-        positions[currentIndex].mStackIndex = stacks[currentLayer];
+        positions[i] = nodes[i].Pos;
     }
-    else
+    if (incremental)
     {
-        //already hooked node
-        if (currentLayer > positions[currentIndex].mLayer)
+        relayout.resize(nodes.size());
+        for (size_t i = 0; i < nodes.size(); i++)
         {
-            // remove stack at current pos
-            int currentStack = positions[currentIndex].mStackIndex;
-            for (auto & pos : positions)
-            {
-                if (pos.mLayer == positions[currentIndex].mLayer && pos.mStackIndex > currentStack)
-                {
-                    pos.mStackIndex--;
-                    stacks[pos.mLayer]--;
-                }
-            }
-            // apply new one
-            int layer = positions[currentIndex].mLayer = currentLayer;
-            if (stacks.find(layer) != stacks.end())
-                stacks[layer] ++;
-            else
-                stacks[layer] = 0;
-            positions[currentIndex].mStackIndex = stacks[currentLayer];
-
+            relayout[i] = nodes[i].mbLayoutDirty;
         }
+        if (std::find(relayout.begin(), relayout.end(), true) == relayout.end())
+            return;
     }
 
-    for (auto & link : links)
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::vector<ImVec2> newPositions = ComputeLayeredLayout(positions, links, relayout, LayeredLayoutSettings());
+    float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+    Log("Layout of %d nodes and %d links in %5.2f ms\n", int(nodes.size()), int(links.size()), elapsed);
+
+    // one undo step for the moved nodes
+    URDummy dummy;
+    std::vector<URChange<Node>*> undos;
+    for (size_t i = 0; i < nodes.size(); i++)
     {
-        if (link.OutputIdx == currentIndex)
+        if (newPositions[i] != nodes[i].Pos || nodes[i].mbLayoutDirty)
         {
-            RecurseNodeGraphLayout(positions, stacks, links, link.InputIdx, currentLayer + 1);
+            undos.push_back(new URChange<Node>(int(i), [](int index) {return &nodes[index]; }, [](int) {}));
+            nodes[i].Pos = newPositions[i];
         }
-    }
-}
-
-void NodeGraphLayout()
-{
-    URDummy dummy;
-    std::vector<size_t> nodeOrderList(mOrders.size());
-
-    // get stack/layer pos
-    std::vector<NodePosition> nodePositions(nodes.size(), { -1,-1 });
-    std::map<int, int> stacks;
-    ImRect sourceRect, destRect;
-    std::vector<URChange<Node>*> undos(nodes.size());
-
-    // compute source bounds
-    for (unsigned int i = 0; i < nodes.size(); i++)
-    {
-        const Node& node = nodes[i];
-        sourceRect.Add(ImRect(node.Pos, node.Pos + node.Size));
-        undos[i] = new URChange<Node>(i, [](int index) {return &nodes[index]; }, [](int) {});
-    }
-    
-    for (unsigned int i = 0; i < nodes.size(); i++)
-    {
-        size_t nodeIndex = mOrders[nodes.size() - i - 1].mNodeIndex;
-        RecurseNodeGraphLayout(nodePositions, stacks, links, nodeIndex, 0);
-    }
-
-    // set x,y position from layer/stack
-    for (unsigned int i = 0; i < nodes.size(); i++)
-    {
-        size_t nodeIndex = mOrders[i].mNodeIndex;
-        auto& layout = nodePositions[nodeIndex];
-        nodes[nodeIndex].Pos = ImVec2(-layout.mLayer * 180.f, layout.mStackIndex * 140.f);
-    }
-
-    //new bounds
-    for (auto& node : nodes)
-    {
-        destRect.Add(ImRect(node.Pos, node.Pos + node.Size));
-    }
-
-    // move all nodes
-    ImVec2 offset = sourceRect.GetCenter() - destRect.GetCenter();
-    for (auto& node : nodes)
-    {
-        node.Pos += offset;
+        nodes[i].mbLayoutDirty = false;
     }
 
     // finish undo
@@ -38,8 +38,10 @@ struct NodeGraphControlerBase
     int mCategoriesCount;
     const char ** mCategories;
 
-    virtual void UpdateEvaluationList(const std::vector<size_t> nodeOrderList) = 0;
-    virtual void AddLink(int InputIdx, int InputSlot, int OutputIdx, int OutputSlot) = 0;
+    // true if 'to' uses the output of 'from', directly or not
+    virtual bool IsLinked(int from, int to) = 0;
+    // returns false if the link is rejected (it would create a loop). The previous link of the slot is kept.
+    virtual bool AddLink(int InputIdx, int InputSlot, int OutputIdx, int OutputSlot) = 0;
     virtual void DelLink(int index, int slot) = 0;
     virtual unsigned int GetNodeTexture(size_t index) = 0;
     // A new node has been added in the graph. Do a push_back on your node array
@@ -73,7 +75,8 @@ struct Node
     ImVec2  Pos, Size;
     size_t InputsCount, OutputsCount;
     bool mbSelected;
-    Node() : mbSelected(false) {}
+    bool mbLayoutDirty; // added or linked/unlinked by the user since the last layout
+    Node() : mbSelected(false), mbLayoutDirty(false) {}
     Node(int type, const ImVec2& pos);
 
     ImVec2 GetInputSlotPos(int slot_no, float factor) const { return ImVec2(Pos.x*factor, Pos.y*factor + Size.y * ((float)slot_no + 1) / ((float)InputsCount + 1)); }
@@ -142,6 +145,9 @@ struct NodeRug
     }
 };
 
+// memory kept by undo copies, see URState
+inline size_t GetOwnedMemorySize(const NodeRug& rug) { return rug.mText.capacity(); }
+
 void NodeGraph(NodeGraphControlerBase *delegate, bool enabled);
 void NodeGraphClear(); // delegate is not called
 const std::vector<NodeLink>& NodeGraphGetLinks();
@@ -151,7 +157,7 @@ ImVec2 NodeGraphGetNodePos(size_t index);
 void NodeGraphAddNode(NodeGraphControlerBase *delegate, int type, const std::vector<unsigned char>& parameters, int posx, int posy, int frameStart, int frameEnd);
 void NodeGraphAddRug(int32_t posX, int32_t posY, int32_t sizeX, int32_t sizeY, uint32_t color, const std::string comment);
 void NodeGraphAddLink(NodeGraphControlerBase *delegate, int InputIdx, int InputSlot, int OutputIdx, int OutputSlot);
-void NodeGraphUpdateEvaluationOrder(NodeGraphControlerBase *delegate);
 void NodeGraphUpdateScrolling();
 void NodeGraphSelectNode(int selectedNodeIndex);
-void NodeGraphLayout();
\ No newline at end of file
+// layered layout of the graph. Incremental only moves the nodes edited since the last layout, next to the nodes they link to.
+void NodeGraphLayout(bool incremental = false);
\ No newline at end of file
@@ -61,9 +61,10 @@ void NodeGraphControler::SetParamBlock(size_t index, const std::vector<unsigned
 {
     auto& stage = mEvaluationStages.mStages[index];
     stage.mParameters = parameters;
-    mEvaluationStages.SetEvaluationParameters(index, parameters);
-    mEvaluationStages.SetEvaluationSampler(index, stage.mInputSamplers);
-    mEditingContext.SetTargetDirty(index);
+    bool parametersChanged = mEvaluationStages.SetEvaluationParameters(index, parameters);
+    bool samplersChanged = mEvaluationStages.SetEvaluationSampler(index, stage.mInputSamplers);
+    if (parametersChanged || samplersChanged)
+        mEditingContext.SetTargetDirty(index);
 }
 
 void NodeGraphControler::NodeIsAdded(int index)
@@ -313,8 +314,8 @@ bool NodeGraphControler::EditSingleParameter(unsigned int nodeIndex, unsigned in
 void NodeGraphControler::UpdateDirtyParameter(int index)
 {
     auto &stage = mEvaluationStages.mStages[index];
-    mEvaluationStages.SetEvaluationParameters(index, stage.mParameters);
-    mEditingContext.SetTargetDirty(index);
+    if (mEvaluationStages.SetEvaluationParameters(index, stage.mParameters))
+        mEditingContext.SetTargetDirty(index);
 }
 
 void NodeGraphControler::PinnedEdit()
@@ -362,8 +363,8 @@ void NodeGraphControler::EditNodeParameters()
             , [&](int index) { return &stage.mInputSamplers; }
             , [&](int index) { 
                 auto& node = mEvaluationStages.mStages[index]; 
-                mEvaluationStages.SetEvaluationSampler(index, stage.mInputSamplers);
-                mEditingContext.SetTargetDirty(index);
+                if (mEvaluationStages.SetEvaluationSampler(index, stage.mInputSamplers))
+                    mEditingContext.SetTargetDirty(index);
         });
             
         for (size_t i = 0; i < stage.mInputSamplers.size();i++)
@@ -381,9 +382,8 @@ void NodeGraphControler::EditNodeParameters()
             ImGui::PopID();
             ImGui::PopItemWidth();
         }
-        if (samplerDirty)
+        if (samplerDirty && mEvaluationStages.SetEvaluationSampler(index, stage.mInputSamplers))
         {
-            mEvaluationStages.SetEvaluationSampler(index, stage.mInputSamplers);
             mEditingContext.SetTargetDirty(index);
         }
         else
@@ -613,8 +613,9 @@ void NodeGraphControler::SetMouse(float rx, float ry, float dx, float dy, bool l
     if (metaNode.mbHasUI || parametersUseMouse)
     {
         mEvaluationStages.SetMouse(mSelectedNodeIndex, rx, ry, lButDown, rButDown);
-        mEvaluationStages.SetEvaluationParameters(mSelectedNodeIndex, mEvaluationStages.mStages[mSelectedNodeIndex].mParameters);
-        mEditingContext.SetTargetDirty(mSelectedNodeIndex);
+        // nodes with UI read the mouse state and are always evaluated
+        if (mEvaluationStages.SetEvaluationParameters(mSelectedNodeIndex, mEvaluationStages.mStages[mSelectedNodeIndex].mParameters) || metaNode.mbHasUI)
+            mEditingContext.SetTargetDirty(mSelectedNodeIndex);
     }
 }
 
@@ -40,7 +40,13 @@ struct NodeGraphControler : public NodeGraphControlerBase
 
     virtual void AddSingleNode(size_t type);
     virtual void UserAddNode(size_t type);
-    virtual void AddLink(int InputIdx, int InputSlot, int OutputIdx, int OutputSlot) { mEvaluationStages.AddEvaluationInput(OutputIdx, OutputSlot, InputIdx); mEditingContext.SetTargetDirty(OutputIdx); }
+    virtual bool AddLink(int InputIdx, int InputSlot, int OutputIdx, int OutputSlot)
+    {
+        if (!mEvaluationStages.AddEvaluationInput(OutputIdx, OutputSlot, InputIdx))
+            return false;
+        mEditingContext.SetTargetDirty(OutputIdx);
+        return true;
+    }
     virtual void DelLink(int index, int slot) { mEvaluationStages.DelEvaluationInput(index, slot); mEditingContext.SetTargetDirty(index); }
     virtual void UserDeleteNode(size_t index);
     virtual void SetParamBlock(size_t index, const std::vector<unsigned char>& parameters);
@@ -62,7 +68,7 @@ struct NodeGraphControler : public NodeGraphControlerBase
     virtual bool NodeIsCubemap(size_t nodeIndex);
     virtual bool NodeIs2D(size_t nodeIndex);
     virtual bool NodeIsCompute(size_t nodeIndex);
-    virtual void UpdateEvaluationList(const std::vector<size_t> nodeOrderList) { mEvaluationStages.SetEvaluationOrder(nodeOrderList);    }
+    virtual bool IsLinked(int from, int to) { return mEvaluationStages.IsReachable(from, to); }
     virtual ImVec2 GetEvaluationSize(size_t nodeIndex);
     virtual void DrawNodeImage(ImDrawList *drawList, const ImRect &rc, const ImVec2 marge, const size_t nodeIndex);
 
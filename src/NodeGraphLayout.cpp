@@ -0,0 +1,375 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "NodeGraphLayout.h"
+#include <algorithm>
+
+// Layered graph of one component. Vertices are the component nodes followed by the dummy vertices
+// that split the links spanning a few layers. Longer links stay direct edges so the vertex count remains
+// linear in the link count; their ends are still pulled toward each other by the barycenters.
+struct LayeredGraph
+{
+    std::vector<int> mLayer;
+    std::vector<bool> mDummy;
+    std::vector<std::vector<int> > mUp; // neighbours in upper layers, towards the sources
+    std::vector<std::vector<int> > mDown; // neighbours in lower layers, towards the sinks
+    std::vector<std::vector<int> > mLayers; // vertices of each layer, in order
+    std::vector<int> mOrder; // position of a vertex in its layer
+    std::vector<float> mY;
+
+    // scratch
+    std::vector<float> mKey, mOffset, mBlockSum;
+    std::vector<int> mBlockCount;
+
+    int AddVertex(int layer, bool dummy)
+    {
+        int vertex = int(mLayer.size());
+        mLayer.push_back(layer);
+        mDummy.push_back(dummy);
+        mUp.push_back(std::vector<int>());
+        mDown.push_back(std::vector<int>());
+        if (layer >= int(mLayers.size()))
+            mLayers.resize(layer + 1);
+        mLayers[layer].push_back(vertex);
+        return vertex;
+    }
+
+    void AddEdge(int lower, int upper)
+    {
+        mUp[lower].push_back(upper);
+        mDown[upper].push_back(lower);
+    }
+
+    void UpdateOrder(int layer)
+    {
+        const auto& vertices = mLayers[layer];
+        for (size_t i = 0; i < vertices.size(); i++)
+            mOrder[vertices[i]] = int(i);
+    }
+
+    // sort a layer by the barycenter of its neighbours positions in the adjacent layer
+    void SortByBarycenter(int layer, const std::vector<std::vector<int> >& neighbours)
+    {
+        auto& vertices = mLayers[layer];
+        for (auto vertex : vertices)
+        {
+            const auto& adjacent = neighbours[vertex];
+            if (adjacent.empty())
+            {
+                mKey[vertex] = float(mOrder[vertex]);
+                continue;
+            }
+            float sum = 0.f;
+            for (auto other : adjacent)
+                sum += float(mOrder[other]);
+            mKey[vertex] = sum / float(adjacent.size());
+        }
+        std::stable_sort(vertices.begin(), vertices.end(), [&](int a, int b) { return mKey[a] < mKey[b]; });
+        UpdateOrder(layer);
+    }
+
+    float GetGap(int a, int b, const LayeredLayoutSettings& settings) const
+    {
+        float sizeA = mDummy[a] ? settings.mDummySpacing : settings.mNodeSpacing;
+        float sizeB = mDummy[b] ? settings.mDummySpacing : settings.mNodeSpacing;
+        return (sizeA + sizeB) * 0.5f;
+    }
+
+    // move a layer vertices toward the barycenter of their neighbours y. The result is the least squares
+    // placement that keeps the layer order and the minimum gaps, found by pooling adjacent violators.
+    void PlaceByBarycenter(int layer, const std::vector<std::vector<int> >& neighbours, const LayeredLayoutSettings& settings)
+    {
+        const auto& vertices = mLayers[layer];
+        if (vertices.empty())
+            return;
+        mOffset.resize(vertices.size());
+        mBlockSum.clear();
+        mBlockCount.clear();
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            int vertex = vertices[i];
+            mOffset[i] = i ? mOffset[i - 1] + GetGap(vertices[i - 1], vertex, settings) : 0.f;
+
+            float target = mY[vertex];
+            const auto& adjacent = neighbours[vertex];
+            if (!adjacent.empty())
+            {
+                target = 0.f;
+                for (auto other : adjacent)
+                    target += mY[other];
+                target /= float(adjacent.size());
+            }
+
+            // y - offset must be non decreasing along the layer
+            mBlockSum.push_back(target - mOffset[i]);
+            mBlockCount.push_back(1);
+            while (mBlockSum.size() > 1)
+            {
+                size_t last = mBlockSum.size() - 1;
+                if (mBlockSum[last - 1] * mBlockCount[last] <= mBlockSum[last] * mBlockCount[last - 1])
+                    break;
+                mBlockSum[last - 1] += mBlockSum[last];
+                mBlockCount[last - 1] += mBlockCount[last];
+                mBlockSum.pop_back();
+                mBlockCount.pop_back();
+            }
+        }
+        size_t i = 0;
+        for (size_t block = 0; block < mBlockSum.size(); block++)
+        {
+            float value = mBlockSum[block] / float(mBlockCount[block]);
+            for (int j = 0; j < mBlockCount[block]; j++, i++)
+                mY[vertices[i]] = value + mOffset[i];
+        }
+    }
+};
+
+static int FindRoot(std::vector<int>& parents, int index)
+{
+    while (parents[index] != index)
+    {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+// layout relative to the sinks layer at x = 0 and the layers centered on y = 0
+static void LayoutComponent(const std::vector<int>& component, const std::vector<std::vector<int> >& inputs, const std::vector<std::vector<int> >& outputs,
+    std::vector<int>& localIndex, const LayeredLayoutSettings& settings, std::vector<ImVec2>& componentPositions)
+{
+    const int count = int(component.size());
+    for (int i = 0; i < count; i++)
+        localIndex[component[i]] = i;
+
+    // longest path layering, sinks first
+    std::vector<int> layers(count, 0);
+    std::vector<int> pendingOutputs(count);
+    std::vector<int> order;
+    order.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        pendingOutputs[i] = int(outputs[component[i]].size());
+        if (!pendingOutputs[i])
+            order.push_back(i);
+    }
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        int vertex = order[i];
+        for (auto input : inputs[component[vertex]])
+        {
+            int inputVertex = localIndex[input];
+            layers[inputVertex] = std::max(layers[inputVertex], layers[vertex] + 1);
+            if (!--pendingOutputs[inputVertex])
+                order.push_back(inputVertex);
+        }
+    }
+    // nodes on a cycle are never reached. Their links going against the layers are ignored.
+    for (int i = 0; i < count && int(order.size()) < count; i++)
+    {
+        if (pendingOutputs[i] > 0)
+            order.push_back(i);
+    }
+
+    // layered graph. Nodes are added in layering order, it's the initial order in each layer.
+    LayeredGraph graph;
+    std::vector<int> vertexOfNode(count);
+    for (auto node : order)
+        vertexOfNode[node] = graph.AddVertex(layers[node], false);
+    for (auto node : order)
+    {
+        int vertex = vertexOfNode[node];
+        for (auto input : inputs[component[node]])
+        {
+            int inputVertex = vertexOfNode[localIndex[input]];
+            int inputLayer = graph.mLayer[inputVertex];
+            if (inputLayer <= graph.mLayer[vertex])
+                continue;
+            int previous = vertex;
+            for (int layer = graph.mLayer[vertex] + 1; layer < inputLayer && inputLayer - graph.mLayer[vertex] <= settings.mMaxDummySpan; layer++)
+            {
+                int dummy = graph.AddVertex(layer, true);
+                graph.AddEdge(previous, dummy);
+                previous = dummy;
+            }
+            graph.AddEdge(previous, inputVertex);
+        }
+    }
+
+    const int vertexCount = int(graph.mLayer.size());
+    const int layerCount = int(graph.mLayers.size());
+    graph.mOrder.resize(vertexCount);
+    graph.mKey.resize(vertexCount);
+    for (int layer = 0; layer < layerCount; layer++)
+        graph.UpdateOrder(layer);
+
+    // crossing reduction
+    for (int sweep = 0; sweep < settings.mCrossingSweeps; sweep++)
+    {
+        for (int layer = 1; layer < layerCount; layer++)
+            graph.SortByBarycenter(layer, graph.mDown);
+        for (int layer = layerCount - 2; layer >= 0; layer--)
+            graph.SortByBarycenter(layer, graph.mUp);
+    }
+
+    // coordinate assignment, starting from packed layers
+    graph.mY.resize(vertexCount);
+    for (int layer = 0; layer < layerCount; layer++)
+    {
+        const auto& vertices = graph.mLayers[layer];
+        float y = 0.f;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            if (i)
+                y += graph.GetGap(vertices[i - 1], vertices[i], settings);
+            graph.mY[vertices[i]] = y;
+        }
+        for (auto vertex : vertices)
+            graph.mY[vertex] -= y * 0.5f;
+    }
+    for (int sweep = 0; sweep < settings.mCoordinateSweeps; sweep++)
+    {
+        for (int layer = 1; layer < layerCount; layer++)
+            graph.PlaceByBarycenter(layer, graph.mDown, settings);
+        for (int layer = layerCount - 2; layer >= 0; layer--)
+            graph.PlaceByBarycenter(layer, graph.mUp, settings);
+    }
+
+    componentPositions.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        int vertex = vertexOfNode[i];
+        componentPositions[i] = ImVec2(-graph.mLayer[vertex] * settings.mLayerSpacing, graph.mY[vertex]);
+    }
+}
+
+std::vector<ImVec2> ComputeLayeredLayout(const std::vector<ImVec2>& positions, const std::vector<NodeLink>& links, const std::vector<bool>& relayout, const LayeredLayoutSettings& settings)
+{
+    const int nodeCount = int(positions.size());
+    const bool incremental = !relayout.empty();
+    std::vector<ImVec2> result = positions;
+    auto isLaidOut = [&](int node) { return !incremental || relayout[node]; };
+
+    // adjacency and weakly connected components of the nodes laid out. A link between a flagged node
+    // and a node that doesn't move anchors the flagged node one layer away from it.
+    std::vector<std::vector<int> > inputs(nodeCount), outputs(nodeCount);
+    std::vector<int> parents(nodeCount);
+    std::vector<ImVec2> anchorSum;
+    std::vector<int> anchorCount;
+    if (incremental)
+    {
+        anchorSum.resize(nodeCount, ImVec2(0.f, 0.f));
+        anchorCount.resize(nodeCount, 0);
+    }
+    for (int i = 0; i < nodeCount; i++)
+        parents[i] = i;
+    for (auto& link : links)
+    {
+        if (link.InputIdx < 0 || link.InputIdx >= nodeCount || link.OutputIdx < 0 || link.OutputIdx >= nodeCount || link.InputIdx == link.OutputIdx)
+            continue;
+        bool inputLaidOut = isLaidOut(link.InputIdx);
+        bool outputLaidOut = isLaidOut(link.OutputIdx);
+        if (inputLaidOut && outputLaidOut)
+        {
+            inputs[link.OutputIdx].push_back(link.InputIdx);
+            outputs[link.InputIdx].push_back(link.OutputIdx);
+            parents[FindRoot(parents, link.InputIdx)] = FindRoot(parents, link.OutputIdx);
+        }
+        else if (inputLaidOut)
+        {
+            anchorSum[link.InputIdx] += positions[link.OutputIdx] - ImVec2(settings.mLayerSpacing, 0.f);
+            anchorCount[link.InputIdx]++;
+        }
+        else if (outputLaidOut)
+        {
+            anchorSum[link.OutputIdx] += positions[link.InputIdx] + ImVec2(settings.mLayerSpacing, 0.f);
+            anchorCount[link.OutputIdx]++;
+        }
+    }
+    std::vector<int> componentOfRoot(nodeCount, -1);
+    std::vector<std::vector<int> > components;
+    for (int i = 0; i < nodeCount; i++)
+    {
+        if (!isLaidOut(i))
+            continue;
+        int root = FindRoot(parents, i);
+        if (componentOfRoot[root] == -1)
+        {
+            componentOfRoot[root] = int(components.size());
+            components.push_back(std::vector<int>());
+        }
+        components[componentOfRoot[root]].push_back(i);
+    }
+
+    std::vector<int> localIndex(nodeCount);
+    std::vector<ImVec2> componentPositions;
+    float stackY = 0.f;
+    for (auto& component : components)
+    {
+        LayoutComponent(component, inputs, outputs, localIndex, settings, componentPositions);
+
+        ImRect sourceRect, destRect;
+        for (size_t i = 0; i < component.size(); i++)
+        {
+            sourceRect.Add(positions[component[i]]);
+            destRect.Add(componentPositions[i]);
+        }
+        ImVec2 offset;
+        if (incremental)
+        {
+            // least squares fit of the anchors. Centered where it was when nothing else is linked.
+            ImVec2 sum(0.f, 0.f);
+            int count = 0;
+            for (size_t i = 0; i < component.size(); i++)
+            {
+                int node = component[i];
+                sum += anchorSum[node] - componentPositions[i] * float(anchorCount[node]);
+                count += anchorCount[node];
+            }
+            offset = count ? sum / float(count) : sourceRect.GetCenter() - destRect.GetCenter();
+        }
+        else
+        {
+            offset = ImVec2(0.f, stackY - destRect.Min.y);
+            stackY += destRect.GetHeight() + settings.mNodeSpacing;
+        }
+        for (size_t i = 0; i < component.size(); i++)
+            result[component[i]] = componentPositions[i] + offset;
+    }
+
+    if (!incremental && nodeCount)
+    {
+        ImRect sourceRect, destRect;
+        for (int i = 0; i < nodeCount; i++)
+        {
+            sourceRect.Add(positions[i]);
+            destRect.Add(result[i]);
+        }
+        ImVec2 offset = sourceRect.GetCenter() - destRect.GetCenter();
+        for (auto& position : result)
+            position += offset;
+    }
+    return result;
+}
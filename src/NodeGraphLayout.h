@@ -0,0 +1,52 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#pragma once
+#include <vector>
+#include <string>
+#include "NodeGraph.h"
+
+struct LayeredLayoutSettings
+{
+    LayeredLayoutSettings() : mLayerSpacing(180.f), mNodeSpacing(140.f), mDummySpacing(40.f), mMaxDummySpan(8), mCrossingSweeps(4), mCoordinateSweeps(4) {}
+
+    float mLayerSpacing; // horizontal distance between 2 layers
+    float mNodeSpacing; // vertical distance between 2 nodes of a layer
+    float mDummySpacing; // vertical room of an edge crossing a layer
+    int mMaxDummySpan; // links spanning more layers are not split by dummy vertices
+    int mCrossingSweeps;
+    int mCoordinateSweeps;
+};
+
+// Sugiyama layered layout. Pure function of the graph: returns the new position of every node.
+// Links go from NodeLink::InputIdx (source) to NodeLink::OutputIdx. Sinks are in the rightmost layer.
+// Steps, linear in nodes + links except for the per layer sorts:
+// longest path layering, barycentric crossing reduction sweeps, coordinate assignment by projecting
+// the neighbours barycenters on the layer order.
+// Each weakly connected component is laid out on its own. When 'relayout' is empty, every component is
+// laid out and they are stacked vertically, centered on the previous bounds. Otherwise only the flagged nodes
+// move: the subgraph they make is laid out, and each of its pieces is placed one layer away from the
+// unflagged nodes it links to. Pieces without such links are centered where they were.
+std::vector<ImVec2> ComputeLayeredLayout(const std::vector<ImVec2>& positions, const std::vector<NodeLink>& links, const std::vector<bool>& relayout, const LayeredLayoutSettings& settings);
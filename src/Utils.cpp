@@ -223,6 +223,54 @@ unsigned int LoadShaderTransformFeedback(const std::string &shaderString, const
     return programHandle;
 }
 
+unsigned int LoadShaderCompute(const std::string &shaderString, const char *filename)
+{
+    GLuint csHandle = glCreateShader(GL_COMPUTE_SHADER);
+
+    const char *src[2] = { "#version 430\n#define COMPUTE_SHADER\n#define COMPUTE_LOCAL_SIZE 64\n", shaderString.c_str() };
+    int size[2];
+    for (int j = 0; j < 2; j++)
+        size[j] = int(strlen(src[j]));
+
+    glShaderSource(csHandle, 2, src, size);
+    glCompileShader(csHandle);
+
+    GLint compiled;
+    glGetShaderiv(csHandle, GL_COMPILE_STATUS, &compiled);
+    if (compiled == 0)
+    {
+        GLint info_len = 0;
+        glGetShaderiv(csHandle, GL_INFO_LOG_LENGTH, &info_len);
+        if (info_len > 1)
+        {
+            char info_log[2048];
+            glGetShaderInfoLog(csHandle, sizeof(info_log), NULL, info_log);
+            Log("Error compiling Compute shader %s\n", filename);
+            Log(info_log);
+        }
+        glDeleteShader(csHandle);
+        return 0;
+    }
+
+    GLuint programHandle = glCreateProgram();
+    glAttachShader(programHandle, csHandle);
+    glLinkProgram(programHandle);
+    glDeleteShader(csHandle);
+
+    GLint linked;
+    glGetProgramiv(programHandle, GL_LINK_STATUS, &linked);
+    if (linked == 0)
+    {
+        char info_log[2048];
+        glGetProgramInfoLog(programHandle, sizeof(info_log), NULL, info_log);
+        Log("Error linking Compute shader %s\n", filename);
+        Log(info_log);
+        glDeleteProgram(programHandle);
+        return 0;
+    }
+    return programHandle;
+}
+
 
 std::vector<LogOutput> outputs;
 void AddLogOutput(LogOutput output)
@@ -27,6 +27,7 @@
 #include <string>
 #include <float.h>
 #include <vector>
+#include <utility>
 
 void TagTime(const char *tagInfo);
 
@@ -58,6 +59,8 @@ std::string ReplaceAll(std::string str, const std::string& from, const std::stri
 
 unsigned int LoadShader(const std::string &shaderString, const char *fileName);
 unsigned int LoadShaderTransformFeedback(const std::string &shaderString, const char *fileName);
+// COMPUTE_SHADER is defined, COMPUTE_LOCAL_SIZE is the default workgroup size
+unsigned int LoadShaderCompute(const std::string &shaderString, const char *fileName);
 
 
 typedef void(*LogOutput)(const char *szText);
@@ -596,9 +599,9 @@ std::string GetGroup(const std::string &name);
 
 template<typename T> void Swap(T& a, T&b) 
 { 
-    T temp = a;
-    a = b;
-    b = temp;
+    T temp = std::move(a);
+    a = std::move(b);
+    b = std::move(temp);
 }
 
 template<typename T> T min(const T& a, const T& b) { return (a < b) ? a : b; }
@@ -142,6 +142,8 @@ int main(int, char**)
         sys.stderr = catchImogenIO
         print("Python stdout, stderr catched.\n"))");
     pybind11::module::import("Plugins");
+    // python jobs run on the workers : the GIL is only taken around python calls (RunPython, python jobs, plugins)
+    PyThreadState *mainThreadState = PyEval_SaveThread();
 
     TagTime("Python interpreter Init");
     LoadMetaNodes();
@@ -291,7 +293,7 @@ int main(int, char**)
                 done = true;
         }
         if (io.KeyCtrl && ImGui::IsKeyPressed(SDL_SCANCODE_L))
-            NodeGraphLayout();
+            NodeGraphLayout(io.KeyShift);
         // undo/redo
         if (io.KeyCtrl && ImGui::IsKeyPressedMap(ImGuiKey_Z))
             gUndoRedoHandler.Undo();
@@ -304,6 +306,7 @@ int main(int, char**)
         ImGui_ImplSDL2_NewFrame(window);
         ImGui::NewFrame();
         InitCallbackRects();
+        gUndoRedoHandler.SetInteracting(io.MouseDown[0] || io.MouseDown[1] || ImGui::IsAnyItemActive());
 
         if (gbIsPlaying)
         {
@@ -334,9 +337,11 @@ int main(int, char**)
         SDL_GL_MakeCurrent(window, gl_context);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         g_TS.RunPinnedTasks();
+        FFMPEGCodec::gDecoderPool.CollectIdle();
         SDL_GL_SwapWindow(window);
     }
     delete builder;
+    FFMPEGCodec::gDecoderPool.Clear();
 
     clDestroy(clContext);
     // Unload opencl lib.
@@ -359,7 +364,8 @@ int main(int, char**)
     SDL_DestroyWindow(window);
     SDL_Quit();
 
-    pybind11::finalize_interpreter();
     g_TS.WaitforAllAndShutdown();
+    PyEval_RestoreThread(mainThreadState);
+    pybind11::finalize_interpreter();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Dual filter mode of the Blur node against its 15 tap directional blur, along the blur axis.
+// Both filters of bin/Nodes/GLSL/Blur.glsl are ported with the bilinear clamp sampling of the node inputs and the
+// pass sizes of EvaluationContext::EvaluatePyramid. The input is a vertical line, smoothed enough that the spaced
+// taps of the directional blur don't show, so the horizontal profiles of both outputs are compared.
+// For each level count, the directional blur strength is set for the sigma documented in Blur.glsl.
+// The measured dual filter sigma has to be within 10% of it and the profiles within the tolerance.
+
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+static const int ImageWidth = 512;
+static const int ImageHeight = 64; // 6 levels fit
+static const float LineSigma = 3.f; // pixels
+static const double Tolerance = 0.1; // relative L2 difference of the profiles
+static const double SigmaTolerance = 0.1;
+static const float DocumentedSigma[] = { 1.3f, 2.9f, 5.9f, 12.f, 24.f }; // 1 to 5 levels
+
+static const float BlurWeights[15] = { 0.023089f, 0.034587f, 0.048689f, 0.064408f, 0.080066f, 0.093531f, 0.102673f, 0.105915f,
+    0.102673f, 0.093531f, 0.080066f, 0.064408f, 0.048689f, 0.034587f, 0.023089f };
+
+struct Image
+{
+    int mWidth, mHeight;
+    std::vector<float> mPixels;
+
+    Image(int width, int height) : mWidth(width), mHeight(height), mPixels(width * height, 0.f) {}
+
+    // GL_LINEAR, GL_CLAMP_TO_EDGE
+    float Sample(float u, float v) const
+    {
+        const float x = u * float(mWidth) - 0.5f, y = v * float(mHeight) - 0.5f;
+        const int x0 = int(floorf(x)), y0 = int(floorf(y));
+        const float fx = x - float(x0), fy = y - float(y0);
+        auto texel = [&](int tx, int ty) {
+            tx = std::min(std::max(tx, 0), mWidth - 1);
+            ty = std::min(std::max(ty, 0), mHeight - 1);
+            return mPixels[ty * mWidth + tx];
+        };
+        const float top = texel(x0, y0) * (1.f - fx) + texel(x0 + 1, y0) * fx;
+        const float bottom = texel(x0, y0 + 1) * (1.f - fx) + texel(x0 + 1, y0 + 1) * fx;
+        return top * (1.f - fy) + bottom * fy;
+    }
+};
+
+// one pass of DualFilterBlur() rendered to a destination of that size
+static Image DualFilterPass(const Image& source, int width, int height, bool downsample)
+{
+    Image destination(width, height);
+    const float halfPixelX = 0.5f / float(width), halfPixelY = 0.5f / float(height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const float u = (float(x) + 0.5f) / float(width), v = (float(y) + 0.5f) / float(height);
+            float sum;
+            if (downsample)
+            {
+                sum = source.Sample(u, v) * 4.f;
+                sum += source.Sample(u - halfPixelX, v - halfPixelY);
+                sum += source.Sample(u + halfPixelX, v + halfPixelY);
+                sum += source.Sample(u + halfPixelX, v - halfPixelY);
+                sum += source.Sample(u - halfPixelX, v + halfPixelY);
+                sum /= 8.f;
+            }
+            else
+            {
+                sum = source.Sample(u - halfPixelX * 2.f, v);
+                sum += source.Sample(u - halfPixelX, v + halfPixelY) * 2.f;
+                sum += source.Sample(u, v + halfPixelY * 2.f);
+                sum += source.Sample(u + halfPixelX, v + halfPixelY) * 2.f;
+                sum += source.Sample(u + halfPixelX * 2.f, v);
+                sum += source.Sample(u + halfPixelX, v - halfPixelY) * 2.f;
+                sum += source.Sample(u, v - halfPixelY * 2.f);
+                sum += source.Sample(u - halfPixelX, v - halfPixelY) * 2.f;
+                sum /= 12.f;
+            }
+            destination.mPixels[y * width + x] = sum;
+        }
+    }
+    return destination;
+}
+
+// level n of the pyramid is 2^(n+1) times smaller than the target
+static Image DualFilterBlur(const Image& source, int levels)
+{
+    std::vector<Image> pyramid;
+    for (int level = 0; level < levels; level++)
+    {
+        const Image& levelSource = level ? pyramid.back() : source;
+        pyramid.push_back(DualFilterPass(levelSource, std::max(source.mWidth >> (level + 1), 1), std::max(source.mHeight >> (level + 1), 1), true));
+    }
+    for (int level = levels - 1; level > 0; level--)
+        pyramid[level - 1] = DualFilterPass(pyramid[level], pyramid[level - 1].mWidth, pyramid[level - 1].mHeight, false);
+    return DualFilterPass(pyramid[0], source.mWidth, source.mHeight, false);
+}
+
+// 15 tap blur at angle 0, strength in UV units
+static Image DirectionalBlur(const Image& source, float strength)
+{
+    Image destination(source.mWidth, source.mHeight);
+    for (int y = 0; y < source.mHeight; y++)
+    {
+        for (int x = 0; x < source.mWidth; x++)
+        {
+            const float u = (float(x) + 0.5f) / float(source.mWidth), v = (float(y) + 0.5f) / float(source.mHeight);
+            float sum = 0.f;
+            for (int i = 0; i < 15; i++)
+                sum += source.Sample(u + strength * float(i - 7), v) * BlurWeights[i];
+            destination.mPixels[y * source.mWidth + x] = sum;
+        }
+    }
+    return destination;
+}
+
+static std::vector<double> Profile(const Image& image)
+{
+    const int y = image.mHeight / 2;
+    return std::vector<double>(image.mPixels.begin() + y * image.mWidth, image.mPixels.begin() + (y + 1) * image.mWidth);
+}
+
+// standard deviation of a profile, in pixels
+static double ProfileSigma(const std::vector<double>& profile)
+{
+    double sum = 0., first = 0., second = 0.;
+    for (size_t x = 0; x < profile.size(); x++)
+    {
+        sum += profile[x];
+        first += profile[x] * double(x);
+        second += profile[x] * double(x) * double(x);
+    }
+    const double mean = first / sum;
+    return sqrt(second / sum - mean * mean);
+}
+
+int main()
+{
+    Image line(ImageWidth, ImageHeight);
+    for (int y = 0; y < ImageHeight; y++)
+    {
+        for (int x = 0; x < ImageWidth; x++)
+        {
+            const float offset = float(x) + 0.5f - float(ImageWidth) * 0.5f;
+            line.mPixels[y * ImageWidth + x] = expf(-offset * offset / (2.f * LineSigma * LineSigma));
+        }
+    }
+    const double lineSigma = ProfileSigma(Profile(line));
+
+    // sigma of the taps, in steps of strength
+    double tapSigma = 0.;
+    for (int i = 0; i < 15; i++)
+        tapSigma += BlurWeights[i] * double(i - 7) * double(i - 7);
+    tapSigma = sqrt(tapSigma);
+
+    bool success = true;
+    for (int levels = 1; levels <= int(sizeof(DocumentedSigma) / sizeof(float)); levels++)
+    {
+        const std::vector<double> dualFilter = Profile(DualFilterBlur(line, levels));
+        const double sigma = sqrt(std::max(ProfileSigma(dualFilter) * ProfileSigma(dualFilter) - lineSigma * lineSigma, 0.));
+
+        const float documentedSigma = DocumentedSigma[levels - 1];
+        const float strength = float(documentedSigma / tapSigma) / float(ImageWidth);
+        const std::vector<double> directional = Profile(DirectionalBlur(line, strength));
+
+        double differenceSum = 0., referenceSum = 0.;
+        for (size_t x = 0; x < directional.size(); x++)
+        {
+            differenceSum += (dualFilter[x] - directional[x]) * (dualFilter[x] - directional[x]);
+            referenceSum += directional[x] * directional[x];
+        }
+        const double difference = sqrt(differenceSum / referenceSum);
+        const bool passed = difference <= Tolerance && fabs(sigma - documentedSigma) <= documentedSigma * SigmaTolerance;
+        success &= passed;
+        printf("%d levels : sigma %.2f px (documented %.1f), strength %.5f, relative L2 difference %.4f %s\n",
+            levels, sigma, documentedSigma, strength, difference, passed ? "ok" : "FAILED");
+    }
+    return success ? 0 : 1;
+}
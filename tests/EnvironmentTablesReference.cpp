@@ -0,0 +1,212 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Environment map importance tables of HDRLoader against the serial implementation they replaced.
+// The parallel build keeps the sequential sums and the lookup walk returns the binary search indices,
+// so the tables must be bit identical. Black rows give 0 / 0 pdfs, they have to match as well.
+// Also prints the load times, serial and on all hardware threads, and the time of the previous tables alone.
+
+#include "hdrloader.h"
+#include "ParallelForThreads.h"
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstring>
+
+static const char *ImageFilename = "EnvironmentTablesReference.hdr";
+
+// defined by hdrloader.cpp, the weight both versions use
+float Luminance(const glm::vec3 &c);
+
+struct Tables
+{
+    std::vector<glm::vec2> marginal;
+    std::vector<glm::vec2> conditional;
+};
+
+static int LowerBound(const float* array, int lower, int upper, const float value)
+{
+    while (lower < upper)
+    {
+        int mid = lower + (upper - lower) / 2;
+        if (array[mid] < value)
+            lower = mid + 1;
+        else
+            upper = mid;
+    }
+    return lower;
+}
+
+// HDRLoader::buildDistributions before the rows were built in parallel
+static Tables ReferenceTables(const float *cols, int width, int height)
+{
+    std::vector<float> pdf2D(width * height), cdf2D(width * height), pdf1D(height), cdf1D(height);
+    Tables tables;
+    tables.marginal.resize(height);
+    tables.conditional.resize(width * height);
+
+    float colWeightSum = 0.0f;
+    for (int j = 0; j < height; j++)
+    {
+        float rowWeightSum = 0.0f;
+        for (int i = 0; i < width; ++i)
+        {
+            float weight = Luminance(glm::vec3(cols[j*width * 3 + i * 3 + 0], cols[j*width * 3 + i * 3 + 1], cols[j*width * 3 + i * 3 + 2]));
+            rowWeightSum += weight;
+            pdf2D[j*width + i] = weight;
+            cdf2D[j*width + i] = rowWeightSum;
+        }
+        for (int i = 0; i < width; i++)
+        {
+            pdf2D[j*width + i] /= rowWeightSum;
+            cdf2D[j*width + i] /= rowWeightSum;
+        }
+        colWeightSum += rowWeightSum;
+        pdf1D[j] = rowWeightSum;
+        cdf1D[j] = colWeightSum;
+    }
+
+    for (int j = 0; j < height; j++)
+    {
+        cdf1D[j] /= colWeightSum;
+        pdf1D[j] /= colWeightSum;
+    }
+
+    for (int i = 0; i < height; i++)
+    {
+        float invHeight = (float)i / height;
+        int row = LowerBound(cdf1D.data(), 0, height, invHeight);
+        tables.marginal[i].x = row / (float)height;
+        tables.marginal[i].y = pdf1D[i];
+    }
+
+    for (int j = 0; j < height; j++)
+    {
+        for (int i = 0; i < width; i++)
+        {
+            float invWidth = (float)i / width;
+            int col = LowerBound(cdf2D.data(), j*width, (j + 1)*width, invWidth) - j * width;
+            tables.conditional[j*width + i].x = col / (float)width;
+            tables.conditional[j*width + i].y = pdf2D[j*width + i];
+        }
+    }
+    return tables;
+}
+
+// flat RGBE scanlines. No pixel starts a run and the first one doesn't look like an RLE header
+static bool WriteImage(int width, int height, float blackRatio, unsigned int seed)
+{
+    FILE *file = fopen(ImageFilename, "wb");
+    if (!file)
+        return false;
+    fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> component(3, 255);
+    std::uniform_int_distribution<int> exponent(120, 136);
+    std::uniform_real_distribution<float> black(0.f, 1.f);
+    std::vector<unsigned char> scanline(width * 4);
+    for (int y = 0; y < height; y++)
+    {
+        bool blackRow = black(random) < blackRatio;
+        for (int x = 0; x < width; x++)
+        {
+            bool blackPixel = blackRow || black(random) < blackRatio;
+            unsigned char *rgbe = &scanline[x * 4];
+            rgbe[0] = blackPixel ? 0 : (unsigned char)component(random);
+            rgbe[1] = blackPixel ? 0 : (unsigned char)component(random);
+            rgbe[2] = blackPixel ? 0 : (unsigned char)component(random);
+            rgbe[3] = blackPixel ? 0 : (unsigned char)exponent(random);
+        }
+        fwrite(scanline.data(), scanline.size(), 1, file);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool SameTables(const HDRLoaderResult& result, const Tables& tables)
+{
+    return !memcmp(result.marginalDistData, tables.marginal.data(), tables.marginal.size() * sizeof(glm::vec2))
+        && !memcmp(result.conditionalDistData, tables.conditional.data(), tables.conditional.size() * sizeof(glm::vec2));
+}
+
+static void Free(HDRLoaderResult& result)
+{
+    delete[] result.cols;
+    delete[] result.marginalDistData;
+    delete[] result.conditionalDistData;
+}
+
+static double LoadTime(HDRLoaderResult& result, const ParallelFor& parallelFor)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    bool loaded = HDRLoader::load(ImageFilename, result, parallelFor);
+    auto end = std::chrono::high_resolution_clock::now();
+    return loaded ? std::chrono::duration<double, std::milli>(end - start).count() : -1.0;
+}
+
+int main()
+{
+    struct Case
+    {
+        int width, height;
+        float blackRatio;
+    };
+    // odd sizes leave a partial job of rows. The last one is the timed one
+    const Case cases[] = { { 64, 32, 0.f }, { 100, 37, 0.2f }, { 333, 170, 0.5f }, { 4096, 2048, 0.f } };
+
+    bool success = true;
+    for (const Case& c : cases)
+    {
+        if (!WriteImage(c.width, c.height, c.blackRatio, c.width * 31 + c.height))
+        {
+            printf("Unable to write %s\n", ImageFilename);
+            return 1;
+        }
+
+        HDRLoaderResult serial, parallel;
+        double serialTime = LoadTime(serial, ParallelFor());
+        double parallelTime = LoadTime(parallel, ParallelForThreads);
+        if (serialTime < 0.0 || parallelTime < 0.0 || serial.width != c.width || serial.height != c.height)
+        {
+            printf("Unable to load %s\n", ImageFilename);
+            return 1;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        Tables reference = ReferenceTables(serial.cols, c.width, c.height);
+        double referenceTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        bool serialSame = SameTables(serial, reference);
+        bool parallelSame = SameTables(parallel, reference);
+        printf("%4d x %4d, %2d%% black : serial %s (load %.1f ms), threads %s (load %.1f ms), previous tables %.1f ms\n", c.width, c.height, int(c.blackRatio * 100.f),
+            serialSame ? "identical" : "DIFFERENT", serialTime, parallelSame ? "identical" : "DIFFERENT", parallelTime, referenceTime);
+        success &= serialSame && parallelSame;
+        Free(serial);
+        Free(parallel);
+    }
+    remove(ImageFilename);
+    return success ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Pointwise GLSL nodes of bin/Nodes evaluated one pass per node, like the editor does without fusion,
+// against the single pass program of GenerateFusedShader. The chain has several instances of the same node,
+// with their own parameters, and a node with helper functions used twice.
+// Separate passes round every step to RGBA8, the fused pass only clamps: the results differ by a few levels.
+// Prints the time of both. Runs from bin/. Returns 77, skipped for ctest, when no GL 4.3 context can be created.
+
+#include <GL/gl3w.h>
+#include <SDL.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "FusedShader.h"
+
+static const char *NodesDirectory = "Nodes/GLSL/";
+static const int ImageSize = 1024;
+static const int Iterations = 20;
+static const int Tolerance = 6; // max difference, in RGBA8 levels
+
+// implemented by Utils.cpp in the application
+std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+{
+    size_t start_pos = 0;
+    while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
+        str.replace(start_pos, from.length(), to);
+        start_pos += to.length();
+    }
+    return str;
+}
+
+static std::string ReadSource(const std::string& filename)
+{
+    std::ifstream file(NodesDirectory + filename);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// same stages as LoadShader
+static GLuint LoadProgram(const std::string& source)
+{
+    const char *prefixes[] = { "\n#version 430 core\n#define VERTEX_SHADER\n", "\n#version 430 core\n#define FRAGMENT_SHADER\n" };
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    GLuint program = glCreateProgram();
+    for (int i = 0; i < 2; i++)
+    {
+        GLuint shader = glCreateShader(types[i]);
+        const char *strings[] = { prefixes[i], source.c_str() };
+        glShaderSource(shader, 2, strings, NULL);
+        glCompileShader(shader);
+        GLint compiled;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled)
+        {
+            char log[4096];
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            printf("%s\n", log);
+            return 0;
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glBindAttribLocation(program, 0, "inUV");
+    glLinkProgram(program);
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked ? program : 0;
+}
+
+static GLuint CreateTarget(const std::vector<unsigned char>& pixels, GLuint& fbo)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ImageSize, ImageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.empty() ? NULL : pixels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    return texture;
+}
+
+struct Step
+{
+    const char *mNodeName;
+    std::vector<float> mParameters; // std140 block, ints are written as their float bits
+    FusedStep mFused;
+};
+
+static Step MakeStep(const char *nodeName, std::vector<float> parameters, int previousStep, int secondSampler)
+{
+    Step step;
+    step.mNodeName = nodeName;
+    step.mParameters = parameters;
+    step.mFused.mNodeType = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        step.mFused.mInputStep[i] = -1;
+        step.mFused.mInputSampler[i] = -1;
+    }
+    // input 0 is the previous step, or source 0 for the first one. Input 1 is a source when given
+    if (previousStep >= 0)
+        step.mFused.mInputStep[0] = previousStep;
+    else
+        step.mFused.mInputSampler[0] = 0;
+    step.mFused.mInputSampler[1] = secondSampler;
+    return step;
+}
+
+static float IntBits(int value)
+{
+    float bits;
+    memcpy(&bits, &value, sizeof(float));
+    return bits;
+}
+
+int main()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+        return 77;
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_Window *window = SDL_CreateWindow("", 0, 0, 16, 16, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext context = window ? SDL_GL_CreateContext(window) : NULL;
+    if (!context || gl3wInit() != 0 || !gl3wIsSupported(4, 3))
+    {
+        printf("No GL 4.3 context, skipped\n");
+        return 77;
+    }
+
+    const std::string shaderTemplate = ReadSource("Shader.glsl");
+    if (shaderTemplate.empty())
+    {
+        printf("Unable to read %sShader.glsl, run from bin/\n", NodesDirectory);
+        return 1;
+    }
+
+    // the sources are normal maps, so the normal blendings never normalize a vector close to 0
+    const std::vector<Step> steps = {
+        MakeStep("NormalMapBlending", { IntBits(3) }, -1, 1),
+        MakeStep("NormalMapBlending", { IntBits(2) }, 0, 0),
+        MakeStep("Invert", {}, 1, -1),
+        MakeStep("MADD", { 0.8f, 0.7f, 0.9f, 0.f, 0.1f, 0.05f, 0.f, 1.f }, 2, -1),
+        MakeStep("Blend", { 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, IntBits(4), 0.f, 0.f, 0.f }, 3, 1),
+        MakeStep("Blend", { 1.f, 0.9f, 1.f, 1.f, 1.2f, 1.f, 1.f, 1.f, IntBits(1), 0.f, 0.f, 0.f }, 4, 0),
+        MakeStep("SmoothStep", { 0.05f, 0.8f }, 5, -1),
+        MakeStep("MADD", { 1.f, 1.f, 1.f, 1.f, 0.f, 0.f, 0.f, 0.f }, 6, -1),
+    };
+
+    float triangle[] = { 0.f, 0.f, 2.f, 0.f, 0.f, 2.f };
+    GLuint vertexBuffer, vertexArray;
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> level(0, 255), normalZ(192, 255);
+    GLuint sources[2], sourceFramebuffers[2];
+    for (auto& source : sources)
+    {
+        std::vector<unsigned char> pixels(ImageSize * ImageSize * 4);
+        for (size_t i = 0; i < pixels.size(); i++)
+            pixels[i] = (unsigned char)(((i & 3) == 2) ? normalZ(random) : level(random));
+        source = CreateTarget(pixels, sourceFramebuffers[&source - sources]);
+    }
+
+    // one program, target and parameter buffer per step
+    std::vector<FusedStep> fusedSteps;
+    std::vector<std::string> nodeNames, nodeSources;
+    std::vector<GLuint> programs, targets(steps.size()), framebuffers(steps.size()), parameterBuffers(steps.size());
+    for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
+    {
+        const Step& step = steps[stepIndex];
+        nodeNames.push_back(step.mNodeName);
+        nodeSources.push_back(ReadSource(std::string(step.mNodeName) + ".glsl"));
+        fusedSteps.push_back(step.mFused);
+
+        std::string shaderText = ReplaceAll(shaderTemplate, "__NODE__", nodeSources.back());
+        shaderText = ReplaceAll(shaderText, "__FUNCTION__", nodeNames.back() + "()");
+        programs.push_back(LoadProgram(shaderText));
+        if (!programs.back())
+        {
+            printf("Unable to compile %s\n", step.mNodeName);
+            return 1;
+        }
+        GLuint blockIndex = glGetUniformBlockIndex(programs.back(), (nodeNames.back() + "Block").c_str());
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(programs.back(), blockIndex, FUSED_PARAMETERS_BINDING);
+
+        targets[stepIndex] = CreateTarget(std::vector<unsigned char>(), framebuffers[stepIndex]);
+        glGenBuffers(1, &parameterBuffers[stepIndex]);
+        glBindBuffer(GL_UNIFORM_BUFFER, parameterBuffers[stepIndex]);
+        std::vector<float> parameters = step.mParameters;
+        parameters.resize(std::max(parameters.size(), size_t(4)), 0.f);
+        glBufferData(GL_UNIFORM_BUFFER, parameters.size() * sizeof(float), parameters.data(), GL_STATIC_DRAW);
+    }
+
+    const std::string fusedText = GenerateFusedShader(fusedSteps, nodeNames, nodeSources, shaderTemplate);
+    GLuint fusedProgram = fusedText.empty() ? 0 : LoadProgram(fusedText);
+    if (!fusedProgram)
+    {
+        printf("Unable to generate or compile the fused program\n");
+        return 1;
+    }
+    for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(fusedProgram, GetFusedBlockName(nodeNames[stepIndex], stepIndex).c_str());
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(fusedProgram, blockIndex, FUSED_PARAMETERS_BINDING + GLuint(stepIndex));
+    }
+    glViewport(0, 0, ImageSize, ImageSize);
+
+    auto renderSeparate = [&]()
+    {
+        for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
+        {
+            const FusedStep& step = steps[stepIndex].mFused;
+            glUseProgram(programs[stepIndex]);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[stepIndex]);
+            glBindBufferBase(GL_UNIFORM_BUFFER, FUSED_PARAMETERS_BINDING, parameterBuffers[stepIndex]);
+            for (int i = 0; i < 2; i++)
+            {
+                glActiveTexture(GL_TEXTURE0 + i);
+                glBindTexture(GL_TEXTURE_2D, (step.mInputStep[i] != -1) ? targets[step.mInputStep[i]] : (step.mInputSampler[i] != -1) ? sources[step.mInputSampler[i]] : 0);
+                glUniform1i(glGetUniformLocation(programs[stepIndex], ("Sampler" + std::to_string(i)).c_str()), i);
+            }
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    };
+    auto renderFused = [&]()
+    {
+        glUseProgram(fusedProgram);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers.back());
+        for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
+            glBindBufferBase(GL_UNIFORM_BUFFER, FUSED_PARAMETERS_BINDING + GLuint(stepIndex), parameterBuffers[stepIndex]);
+        for (int unit = 0; unit < 2; unit++)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, sources[unit]);
+            glUniform1i(glGetUniformLocation(fusedProgram, ("Sampler" + std::to_string(unit)).c_str()), unit);
+        }
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    };
+    auto timeRender = [&](const std::function<void()>& render, std::vector<unsigned char>& pixels)
+    {
+        render();
+        glFinish();
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < Iterations; i++)
+            render();
+        glFinish();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / Iterations;
+        pixels.resize(ImageSize * ImageSize * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers.back());
+        glReadPixels(0, 0, ImageSize, ImageSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        return elapsed;
+    };
+
+    std::vector<unsigned char> separatePixels, fusedPixels;
+    const double separateTime = timeRender(renderSeparate, separatePixels);
+    const double fusedTime = timeRender(renderFused, fusedPixels);
+
+    int maxDifference = 0;
+    double sumDifference = 0.0;
+    for (size_t i = 0; i < separatePixels.size(); i++)
+    {
+        int difference = abs(int(separatePixels[i]) - int(fusedPixels[i]));
+        maxDifference = std::max(maxDifference, difference);
+        sumDifference += difference;
+    }
+    bool success = glGetError() == GL_NO_ERROR && maxDifference <= Tolerance;
+    printf("%d steps at %dx%d : separate passes %.2f ms, fused pass %.2f ms. Difference max %d, mean %.3f levels : %s\n",
+        int(steps.size()), ImageSize, ImageSize, separateTime, fusedTime, maxDifference, sumDifference / separatePixels.size(), success ? "ok" : "FAILED");
+
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return success ? 0 : 1;
+}
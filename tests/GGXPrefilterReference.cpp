@@ -0,0 +1,430 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// GGXPrefilter node against the cmft radiance filter.
+// bin/Nodes/GLSL/GGXPrefilter.glsl is compiled like the editor does and rendered in every face and mip of a cube
+// target. Its source is a mip chained copy of the input, built like EvaluationContext::GenerateInputMipmaps.
+// The mips are read back and compared with cmft filtering the same RGBA8 environment.
+// cmft has no GGX lobe. It is compared with the cosine weighted Blinn lobe of the closest width : a GGX alpha
+// has the Blinn power 2 / alpha^2 - 2, rounded to the power of 2 cmft gloss bias gives. The last mip, roughness 1,
+// has no Blinn equivalent and isn't compared. Mip 0 is the input and is compared with the cmft source.
+// The lobe shapes keep a 0.05-0.1 difference. Roughnesses 15% lower or 40% higher than the node mapping go above 0.15.
+// Runs from bin/. Returns 77, skipped for ctest, when no GL 4.3 context can be created.
+
+#include <GL/gl3w.h>
+#include <SDL.h>
+// cmft image loading links against stb_image, implemented by Bitmap.cpp in the application
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "cmft/image.h"
+#include "cmft/cubemapfilter.h"
+#include "cmft/cubemaputils.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+static const char *NodesDirectory = "Nodes/GLSL/";
+static const int SourceFaceSize = 128;
+static const int NodeFaceSize = 2; // 32 << 2 : 128 faces, 5 mips down to 8x8
+static const int SampleCount = 256; // node default is 64, more samples keep the noise out of the lobe difference
+static const double Tolerance = 0.13; // relative RMS difference
+static const double InputTolerance = 0.01; // mip 0, relative RMS difference
+
+// same layout as EvaluationInfo and the EvaluationBlock of Shader.glsl
+struct EvaluationBlock
+{
+    float viewRot[16];
+    float viewProjection[16];
+    float viewInverse[16];
+    float viewport[4];
+
+    int targetIndex;
+    int forcedDirty;
+    int uiPass;
+    int passNumber;
+    float mouse[4];
+    int inputIndices[8];
+    float pad2[4];
+
+    int mFrame;
+    int mLocalFrame;
+    int mipmapNumber;
+    int mipmapCount;
+};
+
+// face rotations of EvaluationContext.cpp
+static const float rotMatrices[6][16] = {
+    { 0,0,-1,0, 0,1,0,0, 1,0,0,0, 0,0,0,1 },
+    { 0,0,1,0, 0,1,0,0, -1,0,0,0, 0,0,0,1 },
+    { 1,0,0,0, 0,0,1,0, 0,-1,0,0, 0,0,0,1 },
+    { 1,0,0,0, 0,0,-1,0, 0,1,0,0, 0,0,0,1 },
+    { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 },
+    { -1,0,0,0, 0,1,0,0, 0,0,-1,0, 0,0,0,1 }
+};
+
+// implemented by Utils.cpp in the application
+std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+{
+    size_t start_pos = 0;
+    while ((start_pos = str.find(from, start_pos)) != std::string::npos) {
+        str.replace(start_pos, from.length(), to);
+        start_pos += to.length();
+    }
+    return str;
+}
+
+static std::string ReadSource(const std::string& filename)
+{
+    std::ifstream file(NodesDirectory + filename);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// same stages as LoadShader
+static GLuint LoadProgram(const std::string& source)
+{
+    const char *prefixes[] = { "\n#version 430 core\n#define VERTEX_SHADER\n", "\n#version 430 core\n#define FRAGMENT_SHADER\n" };
+    const GLenum types[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    GLuint program = glCreateProgram();
+    for (int i = 0; i < 2; i++)
+    {
+        GLuint shader = glCreateShader(types[i]);
+        const char *strings[] = { prefixes[i], source.c_str() };
+        glShaderSource(shader, 2, strings, NULL);
+        glCompileShader(shader);
+        GLint compiled;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled)
+        {
+            char log[4096];
+            glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+            printf("%s\n", log);
+            return 0;
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glBindAttribLocation(program, 0, "inUV");
+    glLinkProgram(program);
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked ? program : 0;
+}
+
+// direction of a texel center in a GL cube face, u and v in [0, 1]
+static void CubeDirection(int face, float u, float v, float dir[3])
+{
+    const float sc = u * 2.f - 1.f, tc = v * 2.f - 1.f;
+    const float directions[6][3] = {
+        { 1.f, -tc, -sc },
+        { -1.f, -tc, sc },
+        { sc, 1.f, tc },
+        { sc, -1.f, -tc },
+        { sc, -tc, 1.f },
+        { -sc, -tc, -1.f }
+    };
+    const float length = sqrtf(directions[face][0] * directions[face][0] + directions[face][1] * directions[face][1] + directions[face][2] * directions[face][2]);
+    for (int c = 0; c < 3; c++)
+        dir[c] = directions[face][c] / length;
+}
+
+// dark sky, two suns and a colored patch : sharp features on a dim background, in the RGBA8 range of the targets
+static void EnvironmentRadiance(const float dir[3], unsigned char texel[4])
+{
+    const float height = 0.5f + 0.5f * dir[1];
+    float color[3] = { 0.02f + 0.04f * height, 0.02f + 0.06f * height, 0.03f + 0.1f * height };
+    const float suns[2][4] = { { 0.5f, 0.6f, 0.4f, 0.97f }, { -0.2f, 0.1f, -0.9f, 0.995f } }; // direction, cosine of the radius
+    for (const auto& sun : suns)
+    {
+        const float length = sqrtf(sun[0] * sun[0] + sun[1] * sun[1] + sun[2] * sun[2]);
+        if ((dir[0] * sun[0] + dir[1] * sun[1] + dir[2] * sun[2]) / length > sun[3])
+        {
+            color[0] = 1.f;
+            color[1] = 0.95f;
+            color[2] = 0.8f;
+        }
+    }
+    if (dir[0] < -0.3f && fabsf(dir[1]) < 0.4f)
+    {
+        color[0] += 0.6f;
+        color[1] += 0.05f;
+    }
+    for (int c = 0; c < 3; c++)
+        texel[c] = (unsigned char)(std::min(color[c], 1.f) * 255.f + 0.5f);
+    texel[3] = 255;
+}
+
+// nearest texel of a cmft RGBA32F cube in a direction
+static const float *CubeTexel(const cmft::Image& image, const float dir[3])
+{
+    float u, v;
+    uint8_t face;
+    cmft::vecToTexelCoord(u, v, face, dir);
+    const int x = std::min(int(u * float(image.m_width)), int(image.m_width) - 1);
+    const int y = std::min(int(v * float(image.m_width)), int(image.m_width) - 1);
+    return (const float *)image.m_data + ((face * image.m_width + y) * image.m_width + x) * 4;
+}
+
+// relative RMS difference of a read back face set with a cmft cube
+static double Difference(const std::vector<unsigned char>& faces, int faceSize, const cmft::Image& reference)
+{
+    double differenceSum = 0., referenceSum = 0.;
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < faceSize; y++)
+        {
+            for (int x = 0; x < faceSize; x++)
+            {
+                float dir[3];
+                CubeDirection(face, (float(x) + 0.5f) / float(faceSize), (float(y) + 0.5f) / float(faceSize), dir);
+                const float *expected = CubeTexel(reference, dir);
+                const unsigned char *texel = &faces[((face * faceSize + y) * faceSize + x) * 4];
+                for (int c = 0; c < 3; c++)
+                {
+                    const double difference = double(texel[c]) / 255. - expected[c];
+                    differenceSum += difference * difference;
+                    referenceSum += double(expected[c]) * expected[c];
+                }
+            }
+        }
+    }
+    return sqrt(differenceSum / referenceSum);
+}
+
+int main()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+        return 77;
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_Window *window = SDL_CreateWindow("", 0, 0, 16, 16, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext context = window ? SDL_GL_CreateContext(window) : NULL;
+    if (!context || gl3wInit() != 0 || !gl3wIsSupported(4, 3))
+    {
+        printf("No GL 4.3 context, skipped\n");
+        return 77;
+    }
+
+    const std::string shaderTemplate = ReadSource("Shader.glsl");
+    const std::string nodeSource = ReadSource("GGXPrefilter.glsl");
+    if (shaderTemplate.empty() || nodeSource.empty())
+    {
+        printf("Unable to read %sShader.glsl or GGXPrefilter.glsl, run from bin/\n", NodesDirectory);
+        return 1;
+    }
+    std::string shaderText = ReplaceAll(shaderTemplate, "__NODE__", nodeSource);
+    shaderText = ReplaceAll(shaderText, "__FUNCTION__", "GGXPrefilter()");
+    const GLuint program = LoadProgram(shaderText);
+    if (!program)
+    {
+        printf("Unable to compile GGXPrefilter\n");
+        return 1;
+    }
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "GGXPrefilterBlock"), 1);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "EvaluationBlock"), 2);
+
+    // input stage target : one mip, like InitCube(width)
+    std::vector<unsigned char> sourcePixels(6 * SourceFaceSize * SourceFaceSize * 4);
+    for (int face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < SourceFaceSize; y++)
+        {
+            for (int x = 0; x < SourceFaceSize; x++)
+            {
+                float dir[3];
+                CubeDirection(face, (float(x) + 0.5f) / float(SourceFaceSize), (float(y) + 0.5f) / float(SourceFaceSize), dir);
+                EnvironmentRadiance(dir, &sourcePixels[((face * SourceFaceSize + y) * SourceFaceSize + x) * 4]);
+            }
+        }
+    }
+    GLuint input;
+    glGenTextures(1, &input);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, input);
+    for (int face = 0; face < 6; face++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, SourceFaceSize, SourceFaceSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, &sourcePixels[face * SourceFaceSize * SourceFaceSize * 4]);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+
+    // mip chained copy sampled by the node
+    int sourceMipmapCount = 1;
+    while ((SourceFaceSize >> sourceMipmapCount) > 0)
+        sourceMipmapCount++;
+    GLuint sourceCopy;
+    glGenTextures(1, &sourceCopy);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, sourceCopy);
+    for (int mip = 0; mip < sourceMipmapCount; mip++)
+    {
+        for (int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGBA8, SourceFaceSize >> mip, SourceFaceSize >> mip, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    GLuint framebuffers[2];
+    glGenFramebuffers(2, framebuffers);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+    for (int face = 0; face < 6; face++)
+    {
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, input, 0);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, sourceCopy, 0);
+        glBlitFramebuffer(0, 0, SourceFaceSize, SourceFaceSize, 0, 0, SourceFaceSize, SourceFaceSize, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_CUBE_MAP, sourceCopy);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, sourceMipmapCount - 1);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    // default input sampler of BindTextures
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // node target, sizes of GGXPrefilter.c
+    const int faceSize = 32 << NodeFaceSize;
+    int mipmapCount = 1;
+    while ((faceSize >> (mipmapCount + 3)) > 0)
+        mipmapCount++;
+    GLuint target;
+    glGenTextures(1, &target);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, target);
+    for (int mip = 0; mip < mipmapCount; mip++)
+    {
+        for (int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGBA8, faceSize >> mip, faceSize >> mip, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipmapCount - 1);
+
+    float triangle[] = { 0.f, 0.f, 2.f, 0.f, 0.f, 2.f };
+    GLuint vertexBuffer, vertexArray;
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(triangle), triangle, GL_STATIC_DRAW);
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    const int parameters[4] = { NodeFaceSize, SampleCount, 0, 0 };
+    GLuint parameterBuffer, evaluationBuffer;
+    glGenBuffers(1, &parameterBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, parameterBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(parameters), parameters, GL_STATIC_DRAW);
+    glGenBuffers(1, &evaluationBuffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 1, parameterBuffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 2, evaluationBuffer);
+
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, sourceCopy);
+    glUniform1i(glGetUniformLocation(program, "CubeSampler0"), 0);
+
+    // every face and mip, like EvaluateGLSL
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+    for (int mip = 0; mip < mipmapCount; mip++)
+    {
+        for (int face = 0; face < 6; face++)
+        {
+            EvaluationBlock evaluation;
+            memset(&evaluation, 0, sizeof(evaluation));
+            memcpy(evaluation.viewRot, rotMatrices[face], sizeof(evaluation.viewRot));
+            evaluation.viewport[0] = evaluation.viewport[1] = float(faceSize >> mip);
+            evaluation.mipmapNumber = mip;
+            evaluation.mipmapCount = mipmapCount;
+            glBindBuffer(GL_UNIFORM_BUFFER, evaluationBuffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(evaluation), &evaluation, GL_DYNAMIC_DRAW);
+
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target, mip);
+            glViewport(0, 0, faceSize >> mip, faceSize >> mip);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+
+    // cmft source : the same RGBA8 environment in the cmft cube layout
+    cmft::Image source;
+    cmft::imageCreate(source, SourceFaceSize, SourceFaceSize, 0, 1, 6, cmft::TextureFormat::RGBA32F);
+    for (uint8_t face = 0; face < 6; face++)
+    {
+        for (int y = 0; y < SourceFaceSize; y++)
+        {
+            for (int x = 0; x < SourceFaceSize; x++)
+            {
+                float dir[3];
+                cmft::texelCoordToVec(dir, (float(x) + 0.5f) / float(SourceFaceSize) * 2.f - 1.f, (float(y) + 0.5f) / float(SourceFaceSize) * 2.f - 1.f, face);
+                unsigned char texel[4];
+                EnvironmentRadiance(dir, texel);
+                float *destination = (float *)source.m_data + ((face * SourceFaceSize + y) * SourceFaceSize + x) * 4;
+                for (int c = 0; c < 4; c++)
+                    destination[c] = float(texel[c]) / 255.f;
+            }
+        }
+    }
+
+    bool success = glGetError() == GL_NO_ERROR;
+    for (int mip = 0; mip < mipmapCount - 1; mip++)
+    {
+        const int mipSize = faceSize >> mip;
+        std::vector<unsigned char> faces(6 * mipSize * mipSize * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+        for (int face = 0; face < 6; face++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, target, mip);
+            glReadPixels(0, 0, mipSize, mipSize, GL_RGBA, GL_UNSIGNED_BYTE, &faces[face * mipSize * mipSize * 4]);
+        }
+
+        if (!mip)
+        {
+            const double error = Difference(faces, mipSize, source);
+            const bool passed = error <= InputTolerance;
+            success &= passed;
+            printf("mip 0, input : relative RMS difference %.4f %s\n", error, passed ? "ok" : "FAILED");
+            continue;
+        }
+
+        const float roughness = float(mip) / float(mipmapCount - 1);
+        const float alpha = roughness * roughness;
+        const float blinnPower = 2.f / (alpha * alpha) - 2.f;
+        const uint8_t glossBias = uint8_t(std::max(floorf(log2f(blinnPower) + 0.5f), 0.f));
+
+        // 1 mip : cmft filters it with the Blinn power 2^glossBias
+        cmft::RadianceFilterTiles* tiles = cmft::radianceFilterTilesCreate(source, mipSize, cmft::LightingModel::BlinnBrdf, false, 1, 0, glossBias);
+        for (uint32_t tile = 0; tile < cmft::radianceFilterTilesCount(tiles); tile++)
+            cmft::radianceFilterTile(tiles, tile);
+        cmft::Image reference;
+        cmft::radianceFilterTilesFinish(reference, tiles);
+
+        const double error = Difference(faces, mipSize, reference);
+        cmft::imageUnload(reference);
+        const bool passed = error <= Tolerance;
+        success &= passed;
+        printf("mip %d, roughness %.3f (Blinn power %.1f, cmft %d) : relative RMS difference %.4f %s\n", mip, roughness, blinnPower, 1 << glossBias, error, passed ? "ok" : "FAILED");
+    }
+    cmft::imageUnload(source);
+
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return success ? 0 : 1;
+}
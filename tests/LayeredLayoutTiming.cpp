@@ -0,0 +1,208 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// ComputeLayeredLayout on synthetic 10k node graphs, with timings.
+// Full layouts: every position is finite, links go left to right when the graph has no cycle,
+// and nodes of a layer never overlap. Incremental layouts: only the flagged nodes move, and
+// a flagged node linked to one that doesn't move is placed one layer away from it.
+
+#include "NodeGraphLayout.h"
+#include <vector>
+#include <map>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+static const int NodeCount = 10000;
+static const float Epsilon = 0.1f; // float rounding on stacked components, 100k units away from the origin
+
+struct Graph
+{
+    const char *mName;
+    bool mAcyclic;
+    std::vector<ImVec2> mPositions;
+    std::vector<NodeLink> mLinks;
+};
+
+// links go from lower to higher indices within 'window', so the graph has no cycle unless 'backLinks' is set
+static Graph MakeGraph(const char *name, int linksPerNode, int window, int componentSize, int backLinks, unsigned int seed)
+{
+    Graph graph;
+    graph.mName = name;
+    graph.mAcyclic = !backLinks;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> coordinate(-5000.f, 5000.f);
+    for (int i = 0; i < NodeCount; i++)
+        graph.mPositions.push_back(ImVec2(coordinate(random), coordinate(random)));
+    for (int i = 1; i < NodeCount; i++)
+    {
+        int componentStart = i - i % componentSize;
+        int first = std::max(componentStart, i - window);
+        if (first == i)
+            continue;
+        std::uniform_int_distribution<int> input(first, i - 1);
+        for (int j = 0; j < linksPerNode; j++)
+            graph.mLinks.push_back(NodeLink(input(random), j, i, 0));
+    }
+    std::uniform_int_distribution<int> node(0, NodeCount - 1);
+    for (int i = 0; i < backLinks; i++)
+    {
+        int from = node(random);
+        int to = from - from % componentSize;
+        if (from != to)
+            graph.mLinks.push_back(NodeLink(from, 0, to, 1));
+    }
+    return graph;
+}
+
+static double Layout(const Graph& graph, const std::vector<bool>& relayout, std::vector<ImVec2>& result)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    result = ComputeLayeredLayout(graph.mPositions, graph.mLinks, relayout, LayeredLayoutSettings());
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static bool CheckFullLayout(const Graph& graph, const std::vector<ImVec2>& result)
+{
+    LayeredLayoutSettings settings;
+    for (auto& position : result)
+    {
+        if (!std::isfinite(position.x) || !std::isfinite(position.y))
+        {
+            printf("  position is not finite\n");
+            return false;
+        }
+    }
+    if (graph.mAcyclic)
+    {
+        for (auto& link : graph.mLinks)
+        {
+            if (result[link.InputIdx].x + settings.mLayerSpacing > result[link.OutputIdx].x + Epsilon)
+            {
+                printf("  link %d -> %d doesn't go to a layer on the right\n", link.InputIdx, link.OutputIdx);
+                return false;
+            }
+        }
+    }
+    std::map<float, std::vector<float> > layers;
+    for (auto& position : result)
+        layers[position.x].push_back(position.y);
+    for (auto& layer : layers)
+    {
+        auto& ys = layer.second;
+        std::sort(ys.begin(), ys.end());
+        for (size_t i = 1; i < ys.size(); i++)
+        {
+            if (ys[i] - ys[i - 1] < settings.mNodeSpacing - Epsilon)
+            {
+                printf("  nodes overlap in layer x = %f\n", layer.first);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool CheckIncrementalLayout(const Graph& graph, const std::vector<bool>& relayout, const std::vector<ImVec2>& result)
+{
+    LayeredLayoutSettings settings;
+    const int nodeCount = int(graph.mPositions.size());
+    for (int i = 0; i < nodeCount; i++)
+    {
+        if (!relayout[i] && result[i] != graph.mPositions[i])
+        {
+            printf("  node %d moved without being flagged\n", i);
+            return false;
+        }
+        if (!std::isfinite(result[i].x) || !std::isfinite(result[i].y))
+        {
+            printf("  position is not finite\n");
+            return false;
+        }
+    }
+    // a flagged node with a single link, to a node that doesn't move, is right next to it
+    std::vector<int> linkCount(nodeCount, 0);
+    for (auto& link : graph.mLinks)
+    {
+        linkCount[link.InputIdx]++;
+        linkCount[link.OutputIdx]++;
+    }
+    for (auto& link : graph.mLinks)
+    {
+        int flagged = relayout[link.InputIdx] ? link.InputIdx : link.OutputIdx;
+        int fixed = relayout[link.InputIdx] ? link.OutputIdx : link.InputIdx;
+        if (relayout[fixed] || !relayout[flagged] || linkCount[flagged] != 1)
+            continue;
+        ImVec2 expected = graph.mPositions[fixed] + ImVec2(flagged == link.InputIdx ? -settings.mLayerSpacing : settings.mLayerSpacing, 0.f);
+        if (fabsf(result[flagged].x - expected.x) > Epsilon || fabsf(result[flagged].y - expected.y) > Epsilon)
+        {
+            printf("  node %d isn't placed next to node %d\n", flagged, fixed);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    const Graph graphs[] = {
+        MakeGraph("chains", 1, 1, NodeCount, 0, 1),
+        MakeGraph("sparse dag", 2, 50, NodeCount, 0, 2),
+        MakeGraph("dense dag", 4, 400, NodeCount, 0, 3),
+        MakeGraph("100 components", 2, 20, 100, 0, 4),
+        MakeGraph("cycles", 2, 50, 1000, 50, 5),
+    };
+
+    bool success = true;
+    for (const Graph& graph : graphs)
+    {
+        std::vector<ImVec2> result;
+        double fullTime = Layout(graph, std::vector<bool>(), result);
+        bool fullValid = CheckFullLayout(graph, result);
+
+        // a few edited nodes, and a new node linked to the output of an other one
+        Graph edited = graph;
+        edited.mPositions = result;
+        std::vector<bool> relayout(NodeCount + 1, false);
+        std::mt19937 random(NodeCount);
+        std::uniform_int_distribution<int> node(0, NodeCount - 1);
+        for (int i = 0; i < 20; i++)
+            relayout[node(random)] = true;
+        edited.mPositions.push_back(ImVec2(0.f, 0.f));
+        edited.mLinks.push_back(NodeLink(NodeCount / 2, 0, NodeCount, 0));
+        relayout[NodeCount] = true;
+
+        std::vector<ImVec2> incrementalResult;
+        double incrementalTime = Layout(edited, relayout, incrementalResult);
+        bool incrementalValid = CheckIncrementalLayout(edited, relayout, incrementalResult);
+
+        printf("%-15s %5d nodes %6d links : full %s (%.2f ms), incremental %s (%.2f ms)\n", graph.mName, NodeCount, int(graph.mLinks.size()),
+            fullValid ? "ok" : "FAILED", fullTime, incrementalValid ? "ok" : "FAILED", incrementalTime);
+        success &= fullValid && incrementalValid;
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// https://github.com/CedricGuillemet/Imogen
+//
+// The MIT License(MIT)
+// 
+// Copyright(c) 2019 Cedric Guillemet
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// CPU path tracer against the GPU progressive renderer on the Cornell box of bin/Media.
+// Both renderers converge with the same noise threshold and present with the same output shader.
+// The images are compared as block averages, the remaining noise of both is averaged out.
+// Runs from bin/. Returns 77, skipped for ctest, when no GL 3 context can be created.
+
+#include <GL/gl3w.h>
+#include <SDL.h>
+// SOIL texture loading links against stb_image, implemented by Bitmap.cpp in the application
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include "Loader.h"
+#include "Scene.h"
+#include "Camera.h"
+#include "ProgressiveRenderer.h"
+#include "CPURenderer.h"
+#include "ParallelForThreads.h"
+
+static const char *SceneFilename = "./Media/Scene/cornell.scene";
+static const char *ShadersDirectory = "Stock/PathTracer/Progressive/";
+static const int ImageSize = 256;
+static const int BlockSize = 16;
+static const int MaxFrames = 5000;
+static const float NoiseThreshold = 0.02f;
+static const double MeanTolerance = 0.05; // relative difference of the mean luminance
+static const double BlockTolerance = 0.1; // relative RMS difference of the block luminances
+
+// renders until converged then presents to an RGBA8 target. Returns block luminances
+static std::vector<double> RenderBlocks(GLSLPathTracer::Renderer *renderer, GLuint fbo, int& frameCount)
+{
+    renderer->init();
+    renderer->setFrameBudget(50.f, NoiseThreshold);
+    for (frameCount = 0; frameCount < MaxFrames && renderer->getProgress() < 1.f; frameCount++)
+    {
+        renderer->update(0.1f);
+        renderer->render();
+    }
+
+    std::vector<unsigned char> pixels(ImageSize * ImageSize * 4);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, ImageSize, ImageSize);
+    renderer->present();
+    glReadPixels(0, 0, ImageSize, ImageSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    const int blockCount = ImageSize / BlockSize;
+    std::vector<double> blocks(blockCount * blockCount, 0.);
+    for (int y = 0; y < ImageSize; y++)
+    {
+        for (int x = 0; x < ImageSize; x++)
+        {
+            const unsigned char *pixel = &pixels[(y * ImageSize + x) * 4];
+            const double luminance = (0.3 * pixel[0] + 0.6 * pixel[1] + 0.1 * pixel[2]) / 255.;
+            blocks[(y / BlockSize) * blockCount + x / BlockSize] += luminance / double(BlockSize * BlockSize);
+        }
+    }
+    return blocks;
+}
+
+int main(int argc, char **argv)
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0)
+        return 77;
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_Window *window = SDL_CreateWindow("", 0, 0, 16, 16, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext context = window ? SDL_GL_CreateContext(window) : NULL;
+    if (!context || gl3wInit() != 0)
+    {
+        printf("No GL 3 context, skipped\n");
+        return 77;
+    }
+
+    GLSLPathTracer::Scene *scene = GLSLPathTracer::LoadScene(SceneFilename, ParallelForThreads);
+    if (!scene)
+    {
+        printf("Unable to load %s, run from bin/\n", SceneFilename);
+        return 1;
+    }
+    BVH::BuildParams params;
+    params.parallelFor = ParallelForThreads;
+    scene->buildBVH(params);
+    scene->renderOptions.resolution = glm::ivec2(ImageSize, ImageSize);
+    scene->camera->isMoving = false;
+
+    GLuint texture, fbo;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ImageSize, ImageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    int gpuFrames, cpuFrames;
+    GLSLPathTracer::ProgressiveRenderer gpuRenderer(scene, ShadersDirectory);
+    const std::vector<double> gpuBlocks = RenderBlocks(&gpuRenderer, fbo, gpuFrames);
+    gpuRenderer.finish();
+    GLSLPathTracer::CPURenderer cpuRenderer(scene, ShadersDirectory, ParallelForThreads);
+    const std::vector<double> cpuBlocks = RenderBlocks(&cpuRenderer, fbo, cpuFrames);
+    cpuRenderer.finish();
+
+    double gpuMean = 0., cpuMean = 0., differenceSum = 0., gpuSum = 0.;
+    for (size_t i = 0; i < gpuBlocks.size(); i++)
+    {
+        gpuMean += gpuBlocks[i] / double(gpuBlocks.size());
+        cpuMean += cpuBlocks[i] / double(gpuBlocks.size());
+        differenceSum += (cpuBlocks[i] - gpuBlocks[i]) * (cpuBlocks[i] - gpuBlocks[i]);
+        gpuSum += gpuBlocks[i] * gpuBlocks[i];
+    }
+    const double meanError = fabs(cpuMean - gpuMean) / std::max(gpuMean, 1e-6);
+    const double blockError = sqrt(differenceSum / std::max(gpuSum, 1e-12));
+    printf("GPU : %d frames, mean luminance %.4f\n", gpuFrames, gpuMean);
+    printf("CPU : %d frames, mean luminance %.4f\n", cpuFrames, cpuMean);
+    printf("mean difference %.4f, block RMS difference %.4f\n", meanError, blockError);
+
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &texture);
+    delete scene;
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    const bool success = gpuFrames < MaxFrames && cpuFrames < MaxFrames && meanError <= MeanTolerance && blockError <= BlockTolerance;
+    printf("%s\n", success ? "ok" : "FAILED");
+    return success ? 0 : 1;
+}